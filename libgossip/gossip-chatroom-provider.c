@@ -343,6 +343,7 @@ gossip_chatroom_provider_get_rooms (GossipChatroomProvider *provider)
 void
 gossip_chatroom_provider_browse_rooms (GossipChatroomProvider *provider,
                                        const gchar            *server,
+                                       gboolean                refresh,
                                        GossipChatroomBrowseCb  callback,
                                        gpointer                user_data)
 {
@@ -353,8 +354,22 @@ gossip_chatroom_provider_browse_rooms (GossipChatroomProvider *provider,
     if (GOSSIP_CHATROOM_PROVIDER_GET_IFACE (provider)->browse_rooms) {
         GOSSIP_CHATROOM_PROVIDER_GET_IFACE (provider)->browse_rooms (provider, 
                                                                      server,
+                                                                     refresh,
                                                                      callback,
                                                                      user_data);
     }
 }
 
+void
+gossip_chatroom_provider_update_room_info (GossipChatroomProvider *provider,
+                                           GossipChatroom         *chatroom)
+{
+    g_return_if_fail (GOSSIP_IS_CHATROOM_PROVIDER (provider));
+    g_return_if_fail (GOSSIP_IS_CHATROOM (chatroom));
+
+    if (GOSSIP_CHATROOM_PROVIDER_GET_IFACE (provider)->update_room_info) {
+        GOSSIP_CHATROOM_PROVIDER_GET_IFACE (provider)->update_room_info (provider, 
+                                                                         chatroom);
+    }
+}
+
@@ -44,6 +44,7 @@ typedef void (*GossipChatroomJoinCb)   (GossipChatroomProvider   *provider,
 typedef void (*GossipChatroomBrowseCb) (GossipChatroomProvider   *provider,
                                         const gchar              *server,
                                         GList                    *rooms,
+                                        gboolean                  last_page,
                                         GError                   *error,
                                         gpointer                  user_data);
 
@@ -90,8 +91,11 @@ struct _GossipChatroomProviderIface {
     GList *          (*get_rooms)       (GossipChatroomProvider *provider);
     void             (*browse_rooms)    (GossipChatroomProvider *provider,
                                          const gchar            *server,
+                                         gboolean                refresh,
                                          GossipChatroomBrowseCb  callback,
                                          gpointer                user_data);
+    void             (*update_room_info) (GossipChatroomProvider *provider,
+                                          GossipChatroom         *chatroom);
 };
 
 GType        gossip_chatroom_provider_get_type           (void) G_GNUC_CONST;
@@ -144,8 +148,11 @@ void         gossip_chatroom_provider_invite_decline     (GossipChatroomProvider
 GList *      gossip_chatroom_provider_get_rooms          (GossipChatroomProvider *provider);
 void         gossip_chatroom_provider_browse_rooms       (GossipChatroomProvider *provider,
                                                           const gchar            *server,
+                                                          gboolean                refresh,
                                                           GossipChatroomBrowseCb  callback,
                                                           gpointer                user_data);
+void         gossip_chatroom_provider_update_room_info   (GossipChatroomProvider *provider,
+                                                          GossipChatroom         *chatroom);
 
 G_END_DECLS
 
@@ -34,6 +34,7 @@
 #define GOSSIP_CHATROOM_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GOSSIP_TYPE_CHATROOM, GossipChatroomPrivate))
 
 typedef struct _GossipChatroomPrivate GossipChatroomPrivate;
+typedef struct _ChatroomOccupant      ChatroomOccupant;
 
 struct _GossipChatroomPrivate {
     GossipAccount         *account;
@@ -54,15 +55,34 @@ struct _GossipChatroomPrivate {
     GossipChatroomFeature  features;
     GossipChatroomStatus   status;
 
-    guint                  occupants;
+    guint                  n_occupants;
 
     GossipChatroomError    last_error;
 
-    GHashTable            *contacts;
+    /* ChatroomOccupant by normalized nick, both nick and key are
+     * interned in the string chunk.
+     */
+    GHashTable            *occupants;
+    GStringChunk          *nicks;
     GossipContact         *own_contact;
     gchar                 *own_contact_id_str;
 };
 
+/* Rooms can have thousands of people in them, so they are only kept
+ * as much as the nick list needs. A GossipContact is only made for
+ * one when something asks for it, like a message or a private chat.
+ */
+struct _ChatroomOccupant {
+    const gchar   *nick;
+    const gchar   *key;
+    gchar         *status;
+    guint          role        : 2;
+    guint          affiliation : 3;
+    guint          state       : 3;
+    guint          present     : 1;
+    GossipContact *contact;
+};
+
 static void gossip_chatroom_class_init (GossipChatroomClass *klass);
 static void gossip_chatroom_init       (GossipChatroom      *chatroom);
 static void chatroom_finalize          (GObject             *object);
@@ -74,7 +94,16 @@ static void chatroom_set_property      (GObject             *object,
                                         guint                param_id,
                                         const GValue        *value,
                                         GParamSpec          *pspec);
-static void chatroom_contact_info_free (gpointer             data);
+static gchar *chatroom_normalize_nick  (const gchar         *nick);
+static ChatroomOccupant *
+chatroom_occupant_find                 (GossipChatroom      *chatroom,
+                                        const gchar         *nick);
+static ChatroomOccupant *
+chatroom_occupant_new                  (GossipChatroom      *chatroom,
+                                        const gchar         *nick);
+static void chatroom_occupant_free     (ChatroomOccupant    *occupant);
+static void chatroom_occupant_set_presence
+                                       (ChatroomOccupant    *occupant);
 
 enum {
     PROP_0,
@@ -98,9 +127,9 @@ enum {
 };
 
 enum {
-    CONTACT_JOINED,
-    CONTACT_LEFT,
-    CONTACT_INFO_CHANGED,
+    OCCUPANT_JOINED,
+    OCCUPANT_LEFT,
+    OCCUPANT_CHANGED,
     LAST_SIGNAL
 };
 
@@ -320,33 +349,33 @@ gossip_chatroom_class_init (GossipChatroomClass *klass)
                                                           GOSSIP_TYPE_CONTACT,
                                                           G_PARAM_READWRITE));
 
-    signals[CONTACT_JOINED] =
-        g_signal_new ("contact-joined",
+    signals[OCCUPANT_JOINED] =
+        g_signal_new ("occupant-joined",
                       G_TYPE_FROM_CLASS (object_class),
                       G_SIGNAL_RUN_LAST,
                       0,
                       NULL, NULL,
-                      libgossip_marshal_VOID__OBJECT,
+                      libgossip_marshal_VOID__STRING,
                       G_TYPE_NONE,
-                      1, GOSSIP_TYPE_CONTACT);
-    signals[CONTACT_LEFT] =
-        g_signal_new ("contact-left",
+                      1, G_TYPE_STRING);
+    signals[OCCUPANT_LEFT] =
+        g_signal_new ("occupant-left",
                       G_TYPE_FROM_CLASS (object_class),
                       G_SIGNAL_RUN_LAST,
                       0,
                       NULL, NULL,
-                      libgossip_marshal_VOID__OBJECT,
+                      libgossip_marshal_VOID__STRING,
                       G_TYPE_NONE,
-                      1, GOSSIP_TYPE_CONTACT);
-    signals[CONTACT_INFO_CHANGED] =
-        g_signal_new ("contact-info-changed",
+                      1, G_TYPE_STRING);
+    signals[OCCUPANT_CHANGED] =
+        g_signal_new ("occupant-changed",
                       G_TYPE_FROM_CLASS (object_class),
                       G_SIGNAL_RUN_LAST,
                       0,
                       NULL, NULL,
-                      libgossip_marshal_VOID__OBJECT,
+                      libgossip_marshal_VOID__STRING,
                       G_TYPE_NONE,
-                      1, GOSSIP_TYPE_CONTACT);
+                      1, G_TYPE_STRING);
 
     g_type_class_add_private (object_class, sizeof (GossipChatroomPrivate));
 }
@@ -366,10 +395,14 @@ gossip_chatroom_init (GossipChatroom *chatroom)
 
     priv->status = GOSSIP_CHATROOM_STATUS_INACTIVE;
 
-    priv->contacts = g_hash_table_new_full (gossip_contact_hash,
-                                            gossip_contact_equal,
-                                            (GDestroyNotify) g_object_unref,
-                                            chatroom_contact_info_free);
+    /* Occupants are only known by the room and not the contact
+     * manager, the keys are in the string chunk.
+     */
+    priv->occupants = g_hash_table_new_full (g_str_hash,
+                                             g_str_equal,
+                                             NULL,
+                                             (GDestroyNotify) chatroom_occupant_free);
+    priv->nicks = g_string_chunk_new (1024);
 }
 
 static void
@@ -391,7 +424,8 @@ chatroom_finalize (GObject *object)
     g_free (priv->room);
     g_free (priv->password);
 
-    g_hash_table_destroy (priv->contacts);
+    g_hash_table_destroy (priv->occupants);
+    g_string_chunk_free (priv->nicks);
 
     if (priv->own_contact) {
         g_object_unref (priv->own_contact);
@@ -454,7 +488,7 @@ chatroom_get_property (GObject    *object,
         g_value_set_int (value, priv->status);
         break;
     case PROP_OCCUPANTS:
-        g_value_set_uint (value, priv->occupants);
+        g_value_set_uint (value, priv->n_occupants);
         break;
     case PROP_LAST_ERROR:
         g_value_set_enum (value, priv->last_error);
@@ -815,7 +849,7 @@ gossip_chatroom_get_occupants (GossipChatroom *chatroom)
 
     priv = GOSSIP_CHATROOM_GET_PRIVATE (chatroom);
 
-    return priv->occupants;
+    return priv->n_occupants;
 }
 
 GossipChatroomError
@@ -830,30 +864,57 @@ gossip_chatroom_get_last_error (GossipChatroom *chatroom)
     return priv->last_error;
 }
 
-GossipChatroomContactInfo *
-gossip_chatroom_get_contact_info (GossipChatroom *chatroom,
-                                  GossipContact  *contact)
+gboolean
+gossip_chatroom_get_occupant_info (GossipChatroom            *chatroom,
+                                   const gchar               *nick,
+                                   GossipChatroomContactInfo *info,
+                                   GossipPresenceState       *state)
 {
-    GossipChatroomPrivate *priv;
+    ChatroomOccupant *occupant;
 
-    g_return_val_if_fail (GOSSIP_IS_CHATROOM (chatroom), NULL);
-    g_return_val_if_fail (GOSSIP_IS_CONTACT (contact), NULL);
+    g_return_val_if_fail (GOSSIP_IS_CHATROOM (chatroom), FALSE);
+    g_return_val_if_fail (nick != NULL, FALSE);
 
-    priv = GOSSIP_CHATROOM_GET_PRIVATE (chatroom);
+    occupant = chatroom_occupant_find (chatroom, nick);
+    if (!occupant || !occupant->present) {
+        return FALSE;
+    }
+
+    if (info) {
+        info->role = occupant->role;
+        info->affiliation = occupant->affiliation;
+    }
 
-    return g_hash_table_lookup (priv->contacts, contact);
+    if (state) {
+        *state = occupant->state;
+    }
+
+    return TRUE;
 }
 
+/* The nicks are only good until the occupant leaves, free the list
+ * with g_list_free().
+ */
 GList *
-gossip_chatroom_get_contacts (GossipChatroom *chatroom)
+gossip_chatroom_get_occupant_nicks (GossipChatroom *chatroom)
 {
     GossipChatroomPrivate *priv;
+    GHashTableIter         iter;
+    ChatroomOccupant      *occupant;
+    GList                 *nicks = NULL;
 
     g_return_val_if_fail (GOSSIP_IS_CHATROOM (chatroom), NULL);
 
     priv = GOSSIP_CHATROOM_GET_PRIVATE (chatroom);
 
-    return g_hash_table_get_keys (priv->contacts);
+    g_hash_table_iter_init (&iter, priv->occupants);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &occupant)) {
+        if (occupant->present) {
+            nicks = g_list_prepend (nicks, (gchar *) occupant->nick);
+        }
+    }
+
+    return nicks;
 }
 
 GossipContact *
@@ -1074,7 +1135,8 @@ chatroom_clear_contacts (GossipChatroom *chatroom)
 
     priv = GOSSIP_CHATROOM_GET_PRIVATE (chatroom);
 
-    g_hash_table_remove_all (priv->contacts);
+    g_hash_table_remove_all (priv->occupants);
+    g_string_chunk_clear (priv->nicks);
 }
 
 void
@@ -1121,7 +1183,7 @@ gossip_chatroom_set_occupants (GossipChatroom *chatroom,
 
     priv = GOSSIP_CHATROOM_GET_PRIVATE (chatroom);
 
-    priv->occupants = occupants;
+    priv->n_occupants = occupants;
 
     g_object_notify (G_OBJECT (chatroom), "occupants");
 }
@@ -1141,37 +1203,6 @@ gossip_chatroom_set_last_error (GossipChatroom      *chatroom,
     g_object_notify (G_OBJECT (chatroom), "last-error");
 }
 
-static void
-chatroom_contact_info_free (gpointer data)
-{
-    g_free (data);
-}
-
-void
-gossip_chatroom_set_contact_info (GossipChatroom            *chatroom,
-                                  GossipContact             *contact,
-                                  GossipChatroomContactInfo *info)
-{
-    GossipChatroomPrivate        *priv;
-    GossipChatroomContactInfo *chatroom_contact;
-
-    g_return_if_fail (GOSSIP_IS_CHATROOM (chatroom));
-    g_return_if_fail (GOSSIP_IS_CONTACT (contact));
-    g_return_if_fail (info != NULL);
-
-    priv = GOSSIP_CHATROOM_GET_PRIVATE (chatroom);
-
-    chatroom_contact = g_new0 (GossipChatroomContactInfo, 1);
-    chatroom_contact->role = info->role;
-    chatroom_contact->affiliation = info->affiliation;
-        
-    g_hash_table_insert (priv->contacts, 
-                         g_object_ref (contact),
-                         chatroom_contact);
-
-    g_signal_emit (chatroom, signals[CONTACT_INFO_CHANGED], 0, contact);
-}
-
 void
 gossip_chatroom_set_own_contact (GossipChatroom *chatroom,
                                  GossipContact  *own_contact)
@@ -1389,50 +1420,326 @@ gossip_chatroom_affiliation_to_string (GossipChatroomAffiliation affiliation,
     return "";
 }
 
-void
-gossip_chatroom_contact_joined (GossipChatroom            *chatroom,
-                                GossipContact             *contact,
-                                GossipChatroomContactInfo *info)
+static gchar *
+chatroom_normalize_nick (const gchar *nick)
 {
-    GossipChatroomPrivate     *priv;
-    GossipChatroomContactInfo *chatroom_contact;
+    /* Nicks are compared the way resourceprep does it, NFKC but
+     * without folding case.
+     */
+    return g_utf8_normalize (nick, -1, G_NORMALIZE_ALL_COMPOSE);
+}
 
-    g_return_if_fail (GOSSIP_IS_CHATROOM (chatroom));
-    g_return_if_fail (GOSSIP_IS_CONTACT (contact));
+static ChatroomOccupant *
+chatroom_occupant_find (GossipChatroom *chatroom,
+                        const gchar    *nick)
+{
+    GossipChatroomPrivate *priv;
+    ChatroomOccupant      *occupant;
+    const gchar           *p;
+    gchar                 *key;
 
     priv = GOSSIP_CHATROOM_GET_PRIVATE (chatroom);
 
-    chatroom_contact = g_new0 (GossipChatroomContactInfo, 1);
+    /* Plain ASCII is already normalized */
+    for (p = nick; *p && !(*p & 0x80); p++);
+    if (!*p) {
+        return g_hash_table_lookup (priv->occupants, nick);
+    }
+
+    key = chatroom_normalize_nick (nick);
+    if (!key) {
+        return NULL;
+    }
+
+    occupant = g_hash_table_lookup (priv->occupants, key);
+    g_free (key);
+
+    return occupant;
+}
+
+static ChatroomOccupant *
+chatroom_occupant_new (GossipChatroom *chatroom,
+                       const gchar    *nick)
+{
+    GossipChatroomPrivate *priv;
+    ChatroomOccupant      *occupant;
+    gchar                 *key;
+
+    priv = GOSSIP_CHATROOM_GET_PRIVATE (chatroom);
+
+    key = chatroom_normalize_nick (nick);
+    if (!key) {
+        return NULL;
+    }
+
+    occupant = g_slice_new0 (ChatroomOccupant);
+    occupant->nick = g_string_chunk_insert_const (priv->nicks, nick);
+    occupant->key = g_string_chunk_insert_const (priv->nicks, key);
+    occupant->role = GOSSIP_CHATROOM_ROLE_NONE;
+    occupant->affiliation = GOSSIP_CHATROOM_AFFILIATION_NONE;
+    occupant->state = GOSSIP_PRESENCE_STATE_UNAVAILABLE;
+
+    g_free (key);
+
+    /* Our own presence in the room is for the own contact */
+    if (priv->own_contact && gossip_contact_get_name (priv->own_contact)) {
+        gchar *own_key;
+
+        own_key = chatroom_normalize_nick (gossip_contact_get_name (priv->own_contact));
+        if (own_key && strcmp (occupant->key, own_key) == 0) {
+            occupant->contact = g_object_ref (priv->own_contact);
+        }
+
+        g_free (own_key);
+    }
+
+    g_hash_table_replace (priv->occupants, (gchar *) occupant->key, occupant);
+
+    return occupant;
+}
+
+static void
+chatroom_occupant_free (ChatroomOccupant *occupant)
+{
+    if (occupant->contact) {
+        g_object_unref (occupant->contact);
+    }
+
+    g_free (occupant->status);
+    g_slice_free (ChatroomOccupant, occupant);
+}
+
+/* Only contacts someone asked for get presences */
+static void
+chatroom_occupant_set_presence (ChatroomOccupant *occupant)
+{
+    GossipPresence *presence;
+
+    if (!occupant->contact) {
+        return;
+    }
+
+    if (!occupant->present) {
+        gossip_contact_set_presence_list (occupant->contact, NULL);
+        return;
+    }
+
+    presence = gossip_presence_new ();
+    gossip_presence_set_state (presence, occupant->state);
+    gossip_presence_set_status (presence, occupant->status);
+    gossip_contact_add_presence (occupant->contact, presence);
+    g_object_unref (presence);
+}
+
+/* Returns TRUE if the occupant just joined */
+gboolean
+gossip_chatroom_occupant_update (GossipChatroom            *chatroom,
+                                 const gchar               *nick,
+                                 GossipPresenceState        state,
+                                 const gchar               *status,
+                                 GossipChatroomContactInfo *info)
+{
+    ChatroomOccupant          *occupant;
+    GossipChatroomRole         role;
+    GossipChatroomAffiliation  affiliation;
+    gboolean                   joined;
+    gboolean                   changed;
+
+    g_return_val_if_fail (GOSSIP_IS_CHATROOM (chatroom), FALSE);
+    g_return_val_if_fail (nick != NULL, FALSE);
+
+    occupant = chatroom_occupant_find (chatroom, nick);
+    if (!occupant) {
+        occupant = chatroom_occupant_new (chatroom, nick);
+        if (!occupant) {
+            return FALSE;
+        }
+    }
+
     if (info) {
-        chatroom_contact->role = info->role;
-        chatroom_contact->affiliation = info->affiliation;              
+        role = info->role;
+        affiliation = info->affiliation;
     } else {
-        chatroom_contact->role = GOSSIP_CHATROOM_ROLE_NONE;
-        chatroom_contact->affiliation = GOSSIP_CHATROOM_AFFILIATION_NONE;
+        role = GOSSIP_CHATROOM_ROLE_NONE;
+        affiliation = GOSSIP_CHATROOM_AFFILIATION_NONE;
+    }
+
+    joined = !occupant->present;
+    changed = (occupant->role != role ||
+               occupant->affiliation != affiliation ||
+               occupant->state != state);
+
+    occupant->role = role;
+    occupant->affiliation = affiliation;
+    occupant->state = state;
+    occupant->present = TRUE;
+
+    g_free (occupant->status);
+    occupant->status = G_STR_EMPTY (status) ? NULL : g_strdup (status);
+
+    chatroom_occupant_set_presence (occupant);
+
+    if (joined) {
+        g_signal_emit (chatroom, signals[OCCUPANT_JOINED], 0, occupant->nick);
+    } else if (changed) {
+        g_signal_emit (chatroom, signals[OCCUPANT_CHANGED], 0, occupant->nick);
+    }
+
+    return joined;
+}
+
+void
+gossip_chatroom_occupant_left (GossipChatroom *chatroom,
+                               const gchar    *nick)
+{
+    GossipChatroomPrivate *priv;
+    ChatroomOccupant      *occupant;
+
+    g_return_if_fail (GOSSIP_IS_CHATROOM (chatroom));
+    g_return_if_fail (nick != NULL);
+
+    priv = GOSSIP_CHATROOM_GET_PRIVATE (chatroom);
+
+    occupant = chatroom_occupant_find (chatroom, nick);
+    if (!occupant) {
+        return;
+    }
+
+    if (occupant->present) {
+        g_signal_emit (chatroom, signals[OCCUPANT_LEFT], 0, occupant->nick);
+    }
+
+    /* Anyone still holding on to the contact sees them go offline */
+    occupant->present = FALSE;
+    chatroom_occupant_set_presence (occupant);
+
+    g_hash_table_remove (priv->occupants, occupant->key);
+}
+
+/* Returns the contact for the occupant if something asked for it
+ * already, see gossip_chatroom_get_occupant() to get one regardless.
+ */
+GossipContact *
+gossip_chatroom_find_occupant (GossipChatroom *chatroom,
+                               const gchar    *nick)
+{
+    GossipChatroomPrivate *priv;
+    ChatroomOccupant      *occupant;
+    GossipContact         *contact = NULL;
+
+    g_return_val_if_fail (GOSSIP_IS_CHATROOM (chatroom), NULL);
+    g_return_val_if_fail (nick != NULL, NULL);
+
+    priv = GOSSIP_CHATROOM_GET_PRIVATE (chatroom);
+
+    occupant = chatroom_occupant_find (chatroom, nick);
+    if (occupant) {
+        contact = occupant->contact;
     }
-    if (!g_hash_table_lookup (priv->contacts, contact)) {
-        g_hash_table_insert (priv->contacts,
-                             g_object_ref (contact),
-                             chatroom_contact);
 
-        g_signal_emit (chatroom, signals[CONTACT_JOINED], 0, contact);
+    /* Our own presence in the room is for the own contact */
+    if (!contact && priv->own_contact && 
+        gossip_contact_get_name (priv->own_contact)) {
+        gchar *key, *own_key;
+
+        key = chatroom_normalize_nick (nick);
+        own_key = chatroom_normalize_nick (gossip_contact_get_name (priv->own_contact));
+        if (key && own_key && strcmp (key, own_key) == 0) {
+            contact = priv->own_contact;
+        }
+
+        g_free (own_key);
+        g_free (key);
     }
+
+    return contact;
+}
+
+/* Makes the contact for an occupant the first time it is needed. This
+ * works for nicks that are not in the room too, like the senders of
+ * the history we get when joining, they are kept until the room is
+ * left.
+ */
+GossipContact *
+gossip_chatroom_get_occupant (GossipChatroom *chatroom,
+                              const gchar    *nick)
+{
+    GossipChatroomPrivate *priv;
+    ChatroomOccupant      *occupant;
+    gchar                 *id;
+    gchar                 *display_id;
+
+    g_return_val_if_fail (GOSSIP_IS_CHATROOM (chatroom), NULL);
+    g_return_val_if_fail (nick != NULL, NULL);
+
+    priv = GOSSIP_CHATROOM_GET_PRIVATE (chatroom);
+
+    occupant = chatroom_occupant_find (chatroom, nick);
+    if (!occupant) {
+        occupant = chatroom_occupant_new (chatroom, nick);
+        if (!occupant) {
+            return NULL;
+        }
+    }
+
+    if (occupant->contact) {
+        return occupant->contact;
+    }
+
+    id = g_strconcat (priv->id_str, "/", occupant->nick, NULL);
+    display_id = gossip_jid_string_unescape (id);
+
+    occupant->contact = gossip_contact_new_full (GOSSIP_CONTACT_TYPE_CHATROOM,
+                                                 priv->account,
+                                                 id,
+                                                 display_id,
+                                                 occupant->nick);
+    g_free (display_id);
+    g_free (id);
+
+    chatroom_occupant_set_presence (occupant);
+
+    return occupant->contact;
 }
 
 void
-gossip_chatroom_contact_left (GossipChatroom *chatroom,
-                              GossipContact  *contact)
+gossip_chatroom_occupant_nick_changed (GossipChatroom *chatroom,
+                                       const gchar    *old_nick,
+                                       const gchar    *new_nick)
 {
     GossipChatroomPrivate *priv;
+    ChatroomOccupant      *occupant;
+    gchar                 *key;
 
     g_return_if_fail (GOSSIP_IS_CHATROOM (chatroom));
-    g_return_if_fail (GOSSIP_IS_CONTACT (contact));
+    g_return_if_fail (old_nick != NULL);
+    g_return_if_fail (new_nick != NULL);
 
     priv = GOSSIP_CHATROOM_GET_PRIVATE (chatroom);
 
-    if (g_hash_table_lookup (priv->contacts, contact)) {
-        g_signal_emit (chatroom, signals[CONTACT_LEFT], 0, contact);
-        g_hash_table_remove (priv->contacts, contact);
+    occupant = chatroom_occupant_find (chatroom, old_nick);
+    key = chatroom_normalize_nick (new_nick);
+
+    if (!occupant || !key) {
+        g_free (key);
+        return;
+    }
+
+    g_hash_table_steal (priv->occupants, occupant->key);
+
+    occupant->nick = g_string_chunk_insert_const (priv->nicks, new_nick);
+    occupant->key = g_string_chunk_insert_const (priv->nicks, key);
+    g_free (key);
+
+    g_hash_table_replace (priv->occupants, (gchar *) occupant->key, occupant);
+
+    if (occupant->contact) {
+        gchar *id;
+
+        id = g_strconcat (priv->id_str, "/", occupant->nick, NULL);
+        gossip_contact_set_id (occupant->contact, id);
+        gossip_contact_set_name (occupant->contact, occupant->nick);
+        g_free (id);
     }
 }
 
@@ -1440,21 +1747,20 @@ gboolean
 gossip_chatroom_contact_can_message_all (GossipChatroom *chatroom,
                                          GossipContact  *contact)
 {
-    GossipChatroomPrivate     *priv;
-    GossipChatroomContactInfo *info;
+    GossipChatroomContactInfo info;
 
     g_return_val_if_fail (GOSSIP_IS_CHATROOM (chatroom), FALSE);
     g_return_val_if_fail (GOSSIP_IS_CONTACT (contact), FALSE);
 
-    priv = GOSSIP_CHATROOM_GET_PRIVATE (chatroom);
-
-    info = gossip_chatroom_get_contact_info     (chatroom, contact);
-    if (!info) {
+    if (!gossip_contact_get_name (contact) ||
+        !gossip_chatroom_get_occupant_info (chatroom,
+                                            gossip_contact_get_name (contact),
+                                            &info, NULL)) {
         return FALSE;
     }
 
-    if (info->role != GOSSIP_CHATROOM_ROLE_PARTICIPANT &&
-        info->role != GOSSIP_CHATROOM_ROLE_MODERATOR) {
+    if (info.role != GOSSIP_CHATROOM_ROLE_PARTICIPANT &&
+        info.role != GOSSIP_CHATROOM_ROLE_MODERATOR) {
         return FALSE;
     }
         
@@ -1465,21 +1771,20 @@ gboolean
 gossip_chatroom_contact_can_change_subject (GossipChatroom *chatroom,
                                             GossipContact  *contact)
 {
-    GossipChatroomPrivate     *priv;
-    GossipChatroomContactInfo *info;
+    GossipChatroomContactInfo info;
 
     g_return_val_if_fail (GOSSIP_IS_CHATROOM (chatroom), FALSE);
     g_return_val_if_fail (GOSSIP_IS_CONTACT (contact), FALSE);
 
-    priv = GOSSIP_CHATROOM_GET_PRIVATE (chatroom);
-
-    info = gossip_chatroom_get_contact_info     (chatroom, contact);
-    if (!info) {
+    if (!gossip_contact_get_name (contact) ||
+        !gossip_chatroom_get_occupant_info (chatroom,
+                                            gossip_contact_get_name (contact),
+                                            &info, NULL)) {
         return FALSE;
     }
 
-    if (info->role != GOSSIP_CHATROOM_ROLE_PARTICIPANT &&
-        info->role != GOSSIP_CHATROOM_ROLE_MODERATOR) {
+    if (info.role != GOSSIP_CHATROOM_ROLE_PARTICIPANT &&
+        info.role != GOSSIP_CHATROOM_ROLE_MODERATOR) {
         return FALSE;
     }
         
@@ -1490,20 +1795,19 @@ gboolean
 gossip_chatroom_contact_can_kick (GossipChatroom *chatroom,
                                   GossipContact  *contact)
 {
-    GossipChatroomPrivate     *priv;
-    GossipChatroomContactInfo *info;
+    GossipChatroomContactInfo info;
 
     g_return_val_if_fail (GOSSIP_IS_CHATROOM (chatroom), FALSE);
     g_return_val_if_fail (GOSSIP_IS_CONTACT (contact), FALSE);
 
-    priv = GOSSIP_CHATROOM_GET_PRIVATE (chatroom);
-
-    info = gossip_chatroom_get_contact_info     (chatroom, contact);
-    if (!info) {
+    if (!gossip_contact_get_name (contact) ||
+        !gossip_chatroom_get_occupant_info (chatroom,
+                                            gossip_contact_get_name (contact),
+                                            &info, NULL)) {
         return FALSE;
     }
 
-    if (info->role != GOSSIP_CHATROOM_ROLE_MODERATOR) {
+    if (info.role != GOSSIP_CHATROOM_ROLE_MODERATOR) {
         return FALSE;
     }
         
@@ -1514,20 +1818,19 @@ gboolean
 gossip_chatroom_contact_can_change_role (GossipChatroom *chatroom,
                                          GossipContact  *contact)
 {
-    GossipChatroomPrivate     *priv;
-    GossipChatroomContactInfo *info;
+    GossipChatroomContactInfo info;
 
     g_return_val_if_fail (GOSSIP_IS_CHATROOM (chatroom), FALSE);
     g_return_val_if_fail (GOSSIP_IS_CONTACT (contact), FALSE);
 
-    priv = GOSSIP_CHATROOM_GET_PRIVATE (chatroom);
-
-    info = gossip_chatroom_get_contact_info     (chatroom, contact);
-    if (!info) {
+    if (!gossip_contact_get_name (contact) ||
+        !gossip_chatroom_get_occupant_info (chatroom,
+                                            gossip_contact_get_name (contact),
+                                            &info, NULL)) {
         return FALSE;
     }
 
-    if (info->role != GOSSIP_CHATROOM_ROLE_MODERATOR) {
+    if (info.role != GOSSIP_CHATROOM_ROLE_MODERATOR) {
         return FALSE;
     }
         
@@ -172,10 +172,11 @@ gossip_chatroom_get_status              (GossipChatroom            *chatroom);
 guint          gossip_chatroom_get_occupants           (GossipChatroom            *chatroom);
 GossipChatroomError
 gossip_chatroom_get_last_error          (GossipChatroom            *chatroom);
-GossipChatroomContactInfo *
-gossip_chatroom_get_contact_info        (GossipChatroom            *chatroom,
-                                         GossipContact             *contact);
-GList *        gossip_chatroom_get_contacts            (GossipChatroom            *chatroom);
+gboolean       gossip_chatroom_get_occupant_info       (GossipChatroom            *chatroom,
+                                                        const gchar               *nick,
+                                                        GossipChatroomContactInfo *info,
+                                                        GossipPresenceState       *state);
+GList *        gossip_chatroom_get_occupant_nicks      (GossipChatroom            *chatroom);
 
 GossipContact *gossip_chatroom_get_own_contact         (GossipChatroom            *chatroom);
 const gchar *  gossip_chatroom_get_own_contact_id_str  (GossipChatroom            *chatroom);
@@ -207,9 +208,6 @@ void           gossip_chatroom_set_occupants           (GossipChatroom
                                                         guint                      occupants);
 void           gossip_chatroom_set_last_error          (GossipChatroom            *chatroom,
                                                         GossipChatroomError        last_error);
-void           gossip_chatroom_set_contact_info        (GossipChatroom            *chatroom,
-                                                        GossipContact             *contact,
-                                                        GossipChatroomContactInfo *info);
 void           gossip_chatroom_set_own_contact         (GossipChatroom            *chatroom,
                                                         GossipContact             *contact);
 
@@ -226,12 +224,21 @@ const gchar *  gossip_chatroom_role_to_string          (GossipChatroomRole
 const gchar *  gossip_chatroom_affiliation_to_string   (GossipChatroomAffiliation  affiliation,
                                                         gint                       nr);
 
-/* Actions */
-void           gossip_chatroom_contact_joined          (GossipChatroom            *chatroom,
-                                                        GossipContact             *contact,
+/* Occupants */
+gboolean       gossip_chatroom_occupant_update         (GossipChatroom            *chatroom,
+                                                        const gchar               *nick,
+                                                        GossipPresenceState        state,
+                                                        const gchar               *status,
                                                         GossipChatroomContactInfo *info);
-void           gossip_chatroom_contact_left            (GossipChatroom            *chatroom,
-                                                        GossipContact             *contact);
+void           gossip_chatroom_occupant_left           (GossipChatroom            *chatroom,
+                                                        const gchar               *nick);
+void           gossip_chatroom_occupant_nick_changed   (GossipChatroom            *chatroom,
+                                                        const gchar               *old_nick,
+                                                        const gchar               *new_nick);
+GossipContact *gossip_chatroom_find_occupant           (GossipChatroom            *chatroom,
+                                                        const gchar               *nick);
+GossipContact *gossip_chatroom_get_occupant            (GossipChatroom            *chatroom,
+                                                        const gchar               *nick);
 
 /* Privileges */
 gboolean       gossip_chatroom_contact_can_message_all (GossipChatroom            *chatroom,
@@ -34,59 +34,198 @@
 
 #include "gossip-debug.h"
 
-static gchar    **debug_strv;
-static gboolean   all_domains = FALSE;
+/* Domains after the first 63 share the last bit and are checked by
+ * name in gossip_debug_impl().
+ */
+#define DEBUG_MAX_BITS   63
+#define DEBUG_SHARED_BIT (G_GUINT64_CONSTANT (1) << DEBUG_MAX_BITS)
+
+typedef struct {
+    guint64  bit;
+    gboolean enabled;
+} DebugDomain;
+
+static void     debug_init           (void);
+static gboolean debug_domain_enabled (const gchar *domain);
+static void     debug_update_mask    (void);
+
+/* Starts with all bits set so the first gossip_debug() call ends up
+ * in gossip_debug_register_domain() which reads GOSSIP_DEBUG.
+ */
+guint64 gossip_debug_mask = G_MAXUINT64;
+
+static GHashTable *domains = NULL;
+static gchar     **debug_strv = NULL;
+static gboolean    all_domains = FALSE;
+static guint       n_bits = 0;
 
 static void
 debug_init (void)
 {
-    static gboolean inited = FALSE;
+    if (domains) {
+        return;
+    }
+
+    domains = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                     g_free, g_free);
+
+    gossip_debug_set_domains (g_getenv ("GOSSIP_DEBUG"));
+}
 
-    if (!inited) {
-        const gchar *env;
-        gint         i;
+static gboolean
+debug_domain_enabled (const gchar *domain)
+{
+    gint i;
 
-        env = g_getenv ("GOSSIP_DEBUG");
+    if (all_domains) {
+        return TRUE;
+    }
 
-        if (env) {
-            debug_strv = g_strsplit_set (env, ":, ", 0);
-        } else {
-            debug_strv = NULL;
+    for (i = 0; debug_strv && debug_strv[i]; i++) {
+        if (strcmp (domain, debug_strv[i]) == 0) {
+            return TRUE;
         }
+    }
+
+    return FALSE;
+}
 
-        for (i = 0; debug_strv && debug_strv[i]; i++) {
-            if (strcmp ("all", debug_strv[i]) == 0) {
-                all_domains = TRUE;
-            }
+static void
+debug_update_mask (void)
+{
+    GHashTableIter iter;
+    gpointer       value;
+    guint64        mask = 0;
+
+    g_hash_table_iter_init (&iter, domains);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+        DebugDomain *dd = value;
+
+        if (dd->enabled) {
+            mask |= dd->bit;
         }
+    }
 
-        inited = TRUE;
+    /* Call sites that haven't registered yet have no bit, so if
+     * anything at all is enabled we need them to get past the
+     * first check to find out.
+     */
+    if (all_domains || (debug_strv && debug_strv[0])) {
+        mask |= DEBUG_SHARED_BIT;
     }
+
+    gossip_debug_mask = mask;
 }
 
-void
-gossip_debug_impl (const gchar *domain, const gchar *msg, ...)
+guint64
+gossip_debug_register_domain (const gchar *domain)
 {
-    gint i;
+    DebugDomain *dd;
 
-    g_return_if_fail (domain != NULL);
-    g_return_if_fail (msg != NULL);
+    g_return_val_if_fail (domain != NULL, 0);
 
     debug_init ();
 
-    for (i = 0; debug_strv && debug_strv[i]; i++) {
-        if (all_domains || strcmp (domain, debug_strv[i]) == 0) {
-            va_list args;
+    dd = g_hash_table_lookup (domains, domain);
+    if (dd) {
+        return dd->bit;
+    }
+
+    dd = g_new0 (DebugDomain, 1);
+
+    if (n_bits < DEBUG_MAX_BITS) {
+        dd->bit = G_GUINT64_CONSTANT (1) << n_bits++;
+    } else {
+        dd->bit = DEBUG_SHARED_BIT;
+    }
+
+    dd->enabled = debug_domain_enabled (domain);
+
+    g_hash_table_insert (domains, g_strdup (domain), dd);
 
-            g_print ("%s: ", domain);
+    if (dd->enabled) {
+        gossip_debug_mask |= dd->bit;
+    }
+
+    return dd->bit;
+}
+
+void
+gossip_debug_set_domains (const gchar *str)
+{
+    GHashTableIter iter;
+    gpointer       key, value;
+    gint           i;
+
+    if (!domains) {
+        /* Sets up the table and calls us back with the
+         * environment variable, which this then overrides.
+         */
+        debug_init ();
+    }
+
+    g_strfreev (debug_strv);
+
+    if (str && str[0]) {
+        debug_strv = g_strsplit_set (str, ":, ", 0);
+    } else {
+        debug_strv = NULL;
+    }
 
-            va_start (args, msg);
-            g_vprintf (msg, args);
-            va_end (args);
+    all_domains = FALSE;
 
-            g_print ("\n");
-            break;
+    for (i = 0; debug_strv && debug_strv[i]; i++) {
+        if (strcmp ("all", debug_strv[i]) == 0) {
+            all_domains = TRUE;
         }
     }
+
+    g_hash_table_iter_init (&iter, domains);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+        DebugDomain *dd = value;
+
+        dd->enabled = debug_domain_enabled (key);
+    }
+
+    debug_update_mask ();
 }
 
+gchar *
+gossip_debug_get_domains (void)
+{
+    debug_init ();
+
+    if (!debug_strv) {
+        return g_strdup ("");
+    }
+
+    return g_strjoinv (":", debug_strv);
+}
+
+void
+gossip_debug_impl (const gchar *domain, const gchar *msg, ...)
+{
+    DebugDomain *dd;
+    va_list      args;
+
+    g_return_if_fail (domain != NULL);
+    g_return_if_fail (msg != NULL);
+
+    gossip_debug_register_domain (domain);
+
+    /* Only needed for the shared bit and compilers without
+     * varargs macros, but it's cheap compared to printing.
+     */
+    dd = g_hash_table_lookup (domains, domain);
+    if (!dd->enabled) {
+        return;
+    }
+
+    g_print ("%s: ", domain);
+
+    va_start (args, msg);
+    g_vprintf (msg, args);
+    va_end (args);
+
+    g_print ("\n");
+}
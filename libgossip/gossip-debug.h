@@ -25,17 +25,44 @@
 
 G_BEGIN_DECLS
 
+/* Each call site caches the bit for its domain the first time it
+ * gets past the mask check, after that a disabled domain costs one
+ * test and an enabled one a second test. Nothing in the argument
+ * list is evaluated unless the domain is enabled.
+ */
 #ifdef G_HAVE_ISO_VARARGS
 #  ifdef GOSSIP_DISABLE_DEBUG
 #    define gossip_debug(...)
 #  else
-#    define gossip_debug(...) gossip_debug_impl (__VA_ARGS__)
+#    define gossip_debug(domain, ...)                                       \
+         G_STMT_START {                                                     \
+             static guint64 gossip_debug_bit = 0;                           \
+             if (G_UNLIKELY (gossip_debug_mask != 0)) {                     \
+                 if (gossip_debug_bit == 0) {                               \
+                     gossip_debug_bit = gossip_debug_register_domain (domain); \
+                 }                                                          \
+                 if (gossip_debug_mask & gossip_debug_bit) {                \
+                     gossip_debug_impl (domain, __VA_ARGS__);               \
+                 }                                                          \
+             }                                                              \
+         } G_STMT_END
 #  endif
 #elif defined(G_HAVE_GNUC_VARARGS)
 #  if GOSSIP_DISABLE_DEBUG
 #    define gossip_debug(fmt...)
 #  else
-#    define gossip_debug(fmt...) gossip_debug_impl(fmt)
+#    define gossip_debug(domain, fmt...)                                    \
+         G_STMT_START {                                                     \
+             static guint64 gossip_debug_bit = 0;                           \
+             if (G_UNLIKELY (gossip_debug_mask != 0)) {                     \
+                 if (gossip_debug_bit == 0) {                               \
+                     gossip_debug_bit = gossip_debug_register_domain (domain); \
+                 }                                                          \
+                 if (gossip_debug_mask & gossip_debug_bit) {                \
+                     gossip_debug_impl (domain, fmt);                       \
+                 }                                                          \
+             }                                                              \
+         } G_STMT_END
 #  endif
 #else
 #  if GOSSIP_DISABLE_DEBUG
@@ -45,7 +72,17 @@ G_BEGIN_DECLS
 #  endif
 #endif
 
-void gossip_debug_impl (const gchar *domain, const gchar *msg, ...);
+/* Bits of the enabled domains, don't use directly */
+extern guint64 gossip_debug_mask;
+
+guint64  gossip_debug_register_domain (const gchar *domain);
+void     gossip_debug_impl            (const gchar *domain,
+                                       const gchar *msg,
+                                       ...);
+
+/* Same format as the GOSSIP_DEBUG environment variable */
+void     gossip_debug_set_domains     (const gchar *domains);
+gchar *  gossip_debug_get_domains     (void);
 
 G_END_DECLS
 
@@ -0,0 +1,837 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * Copyright (C) 2007 Imendio AB
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Entity capabilities (XEP-0115). Presence carries a hash of what the
+ * sender's client supports, so disco#info only needs to be asked once
+ * per hash, not once per contact and login. What the hashes stand for
+ * is kept in caps.ini and shared by all accounts. Only sha-1 hashes
+ * that check out against the disco#info reply are kept, the old style
+ * version strings can't be verified. Hashes that don't check out are
+ * not asked about again until the next login.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "gossip-debug.h"
+#include "gossip-utils.h"
+
+#include "gossip-jabber-caps.h"
+#include "gossip-jabber-ns.h"
+#include "gossip-jabber-private.h"
+
+#define DEBUG_DOMAIN "JabberCaps"
+
+#define XMPP_DISCO_INFO_XMLNS      "http://jabber.org/protocol/disco#info"
+#define XMPP_DATA_XMLNS            "jabber:x:data"
+
+#define XMPP_SI_FEATURE            "http://jabber.org/protocol/si"
+#define XMPP_FILE_TRANSFER_FEATURE "http://jabber.org/protocol/si/profile/file-transfer"
+#define XMPP_BYTESTREAMS_FEATURE   "http://jabber.org/protocol/bytestreams"
+#define XMPP_MUC_FEATURE           "http://jabber.org/protocol/muc"
+
+#define CAPS_NODE                  "http://www.imendio.com/projects/gossip/"
+#define CAPS_HASH                  "sha-1"
+
+#define CAPS_DIR_CREATE_MODE       (S_IRUSR | S_IWUSR | S_IXUSR)
+#define CAPS_KEY_FILENAME          "caps.ini"
+
+/* In seconds, new entries are written out together */
+#define CAPS_SAVE_DELAY            5
+
+typedef struct {
+    gchar **identities;  /* "category/type/lang/name", sorted */
+    gchar **features;    /* Sorted */
+    gchar **forms;       /* Extended info forms, in hashing order */
+} CapsInfo;
+
+typedef struct {
+    GossipJabberCaps *caps;
+    gchar            *ver;
+} CapsRequest;
+
+struct _GossipJabberCaps {
+    GossipJabber *jabber;
+    LmConnection *connection;
+
+    /* Full JID -> the ver it last advertised */
+    GHashTable   *vers;
+
+    /* ver -> LmMessageHandler for the disco#info reply */
+    GHashTable   *pending;
+
+    /* vers the disco#info reply didn't match, or had no reply */
+    GHashTable   *failed;
+};
+
+static void             caps_info_free         (CapsInfo           *info);
+static gint             caps_strcmp            (gconstpointer       a,
+                                                gconstpointer       b);
+static gint             caps_strv_cmp          (gconstpointer       a,
+                                                gconstpointer       b);
+static gchar *          caps_compute_ver       (gchar             **identities,
+                                                gchar             **features,
+                                                gchar             **forms);
+static gchar **         caps_get_forms         (LmMessageNode      *query);
+static const gchar *    caps_get_own_ver       (void);
+static gchar *          caps_get_filename      (void);
+static void             caps_cache_init        (void);
+static void             caps_save_foreach      (const gchar        *ver,
+                                                CapsInfo           *info,
+                                                GKeyFile           *key_file);
+static gboolean         caps_cache_save_cb     (gpointer            user_data);
+static void             caps_request_free      (CapsRequest        *request);
+static void             caps_pending_free      (LmMessageHandler   *handler);
+static LmHandlerResult  caps_info_reply_cb     (LmMessageHandler   *handler,
+                                                LmConnection       *connection,
+                                                LmMessage          *m,
+                                                CapsRequest        *request);
+static void             caps_request_info      (GossipJabberCaps   *caps,
+                                                const gchar        *jid,
+                                                const gchar        *node,
+                                                const gchar        *ver);
+static LmHandlerResult  caps_presence_handler  (GossipJabberStanza *stanza,
+                                                GossipJabberCaps   *caps);
+static void             caps_logged_out_cb     (GossipJabber       *jabber,
+                                                GossipAccount      *account,
+                                                gint                reason,
+                                                GossipJabberCaps   *caps);
+
+static const gchar *own_identities[] = {
+    "client/pc//" PACKAGE_STRING
+};
+
+static const gchar *own_features[] = {
+    XMPP_DISCO_INFO_XMLNS,
+    XMPP_SI_FEATURE,
+    XMPP_FILE_TRANSFER_FEATURE,
+    XMPP_BYTESTREAMS_FEATURE,
+    XMPP_MUC_FEATURE,
+    XMPP_PING_XMLNS
+};
+
+/* ver -> CapsInfo, shared by all connections */
+static GHashTable *caps_cache = NULL;
+static guint       caps_save_id = 0;
+
+GossipJabberCaps *
+gossip_jabber_caps_init (GossipJabber *jabber)
+{
+    GossipJabberCaps *caps;
+    LmConnection     *connection;
+
+    g_return_val_if_fail (GOSSIP_IS_JABBER (jabber), NULL);
+
+    connection = _gossip_jabber_get_connection (jabber);
+    g_return_val_if_fail (connection != NULL, NULL);
+
+    caps_cache_init ();
+
+    caps = g_new0 (GossipJabberCaps, 1);
+
+    caps->jabber = g_object_ref (jabber);
+    caps->connection = lm_connection_ref (connection);
+
+    caps->vers = g_hash_table_new_full (g_str_hash,
+                                        g_str_equal,
+                                        g_free,
+                                        g_free);
+    caps->pending = g_hash_table_new_full (g_str_hash,
+                                           g_str_equal,
+                                           g_free,
+                                           (GDestroyNotify) caps_pending_free);
+    caps->failed = g_hash_table_new_full (g_str_hash,
+                                          g_str_equal,
+                                          g_free,
+                                          NULL);
+
+    g_signal_connect (caps->jabber, "disconnected",
+                      G_CALLBACK (caps_logged_out_cb),
+                      caps);
+
+    gossip_jabber_dispatch_add (_gossip_jabber_get_dispatch (jabber),
+                                LM_MESSAGE_TYPE_PRESENCE, NULL,
+                                LM_HANDLER_PRIORITY_NORMAL,
+                                (GossipJabberStanzaFunc) caps_presence_handler,
+                                caps);
+
+    return caps;
+}
+
+void
+gossip_jabber_caps_finalize (GossipJabberCaps *caps)
+{
+    if (!caps) {
+        return;
+    }
+
+    /* Don't lose anything learnt just before quitting */
+    if (caps_save_id) {
+        g_source_remove (caps_save_id);
+        caps_cache_save_cb (NULL);
+    }
+
+    g_signal_handlers_disconnect_by_func (caps->jabber,
+                                          caps_logged_out_cb,
+                                          caps);
+
+    g_hash_table_unref (caps->failed);
+    g_hash_table_unref (caps->pending);
+    g_hash_table_unref (caps->vers);
+
+    lm_connection_unref (caps->connection);
+    g_object_unref (caps->jabber);
+
+    g_free (caps);
+}
+
+static void
+caps_info_free (CapsInfo *info)
+{
+    g_strfreev (info->identities);
+    g_strfreev (info->features);
+    g_strfreev (info->forms);
+
+    g_slice_free (CapsInfo, info);
+}
+
+static gint
+caps_strcmp (gconstpointer a,
+             gconstpointer b)
+{
+    return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+/* Orders fields by their var and forms by their FORM_TYPE, which
+ * come first.
+ */
+static gint
+caps_strv_cmp (gconstpointer a,
+               gconstpointer b)
+{
+    return strcmp (**(gchar ***) a, **(gchar ***) b);
+}
+
+/* The verification string from XEP-0115 section 5.1, the lists have
+ * to be in order already, forms may be NULL.
+ */
+static gchar *
+caps_compute_ver (gchar **identities,
+                  gchar **features,
+                  gchar **forms)
+{
+    GChecksum *checksum;
+    guint8     digest[20];
+    gsize      len;
+    gint       i;
+
+    checksum = g_checksum_new (G_CHECKSUM_SHA1);
+
+    for (i = 0; identities[i]; i++) {
+        g_checksum_update (checksum, (const guchar *) identities[i], -1);
+        g_checksum_update (checksum, (const guchar *) "<", 1);
+    }
+
+    for (i = 0; features[i]; i++) {
+        g_checksum_update (checksum, (const guchar *) features[i], -1);
+        g_checksum_update (checksum, (const guchar *) "<", 1);
+    }
+
+    for (i = 0; forms && forms[i]; i++) {
+        g_checksum_update (checksum, (const guchar *) forms[i], -1);
+        g_checksum_update (checksum, (const guchar *) "<", 1);
+    }
+
+    len = sizeof (digest);
+    g_checksum_get_digest (checksum, digest, &len);
+    g_checksum_free (checksum);
+
+    return g_base64_encode (digest, len);
+}
+
+static const gchar *
+caps_get_own_ver (void)
+{
+    static gchar *ver = NULL;
+    gchar       **identities;
+    gchar       **features;
+    gint          i;
+
+    if (ver) {
+        return ver;
+    }
+
+    identities = g_new0 (gchar *, G_N_ELEMENTS (own_identities) + 1);
+    for (i = 0; i < G_N_ELEMENTS (own_identities); i++) {
+        identities[i] = g_strdup (own_identities[i]);
+    }
+
+    features = g_new0 (gchar *, G_N_ELEMENTS (own_features) + 1);
+    for (i = 0; i < G_N_ELEMENTS (own_features); i++) {
+        features[i] = g_strdup (own_features[i]);
+    }
+
+    qsort (identities, G_N_ELEMENTS (own_identities), sizeof (gchar *), caps_strcmp);
+    qsort (features, G_N_ELEMENTS (own_features), sizeof (gchar *), caps_strcmp);
+
+    ver = caps_compute_ver (identities, features, NULL);
+
+    g_strfreev (identities);
+    g_strfreev (features);
+
+    return ver;
+}
+
+static gchar *
+caps_get_filename (void)
+{
+    gchar *dir;
+    gchar *filename;
+
+    dir = g_build_filename (g_get_home_dir (), ".gnome2", PACKAGE_NAME, NULL);
+    if (!g_file_test (dir, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_DIR)) {
+        gossip_debug (DEBUG_DOMAIN, "Creating directory:'%s'", dir);
+        g_mkdir_with_parents (dir, CAPS_DIR_CREATE_MODE);
+    }
+
+    filename = g_build_filename (dir, CAPS_KEY_FILENAME, NULL);
+    g_free (dir);
+
+    return filename;
+}
+
+static void
+caps_cache_init (void)
+{
+    GKeyFile  *key_file;
+    gchar     *filename;
+    gchar    **groups;
+    gint       i;
+
+    if (caps_cache) {
+        return;
+    }
+
+    caps_cache = g_hash_table_new_full (g_str_hash,
+                                        g_str_equal,
+                                        g_free,
+                                        (GDestroyNotify) caps_info_free);
+
+    key_file = g_key_file_new ();
+    filename = caps_get_filename ();
+
+    if (!g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE, NULL)) {
+        g_key_file_free (key_file);
+        g_free (filename);
+        return;
+    }
+
+    groups = g_key_file_get_groups (key_file, NULL);
+
+    for (i = 0; groups[i]; i++) {
+        CapsInfo *info;
+        gchar    *ver;
+
+        info = g_slice_new0 (CapsInfo);
+        info->identities = g_key_file_get_string_list (key_file, groups[i],
+                                                       "Identities", NULL, NULL);
+        info->features = g_key_file_get_string_list (key_file, groups[i],
+                                                     "Features", NULL, NULL);
+        info->forms = g_key_file_get_string_list (key_file, groups[i],
+                                                  "Forms", NULL, NULL);
+
+        if (!info->identities || !info->features) {
+            caps_info_free (info);
+            continue;
+        }
+
+        /* Whatever was edited in the file since doesn't count */
+        ver = caps_compute_ver (info->identities, info->features, info->forms);
+        if (strcmp (ver, groups[i]) != 0) {
+            gossip_debug (DEBUG_DOMAIN, "Ignoring cached ver:'%s', hash doesn't match",
+                          groups[i]);
+            caps_info_free (info);
+            g_free (ver);
+            continue;
+        }
+
+        g_hash_table_insert (caps_cache, ver, info);
+    }
+
+    gossip_debug (DEBUG_DOMAIN, "Loaded %d cached capabilities from:'%s'",
+                  g_hash_table_size (caps_cache), filename);
+
+    g_strfreev (groups);
+    g_key_file_free (key_file);
+    g_free (filename);
+}
+
+static void
+caps_save_foreach (const gchar *ver,
+                   CapsInfo    *info,
+                   GKeyFile    *key_file)
+{
+    g_key_file_set_string_list (key_file, ver, "Identities",
+                                (const gchar **) info->identities,
+                                g_strv_length (info->identities));
+    g_key_file_set_string_list (key_file, ver, "Features",
+                                (const gchar **) info->features,
+                                g_strv_length (info->features));
+
+    if (info->forms) {
+        g_key_file_set_string_list (key_file, ver, "Forms",
+                                    (const gchar **) info->forms,
+                                    g_strv_length (info->forms));
+    }
+}
+
+static gboolean
+caps_cache_save_cb (gpointer user_data)
+{
+    GError   *error = NULL;
+    GKeyFile *key_file;
+    gchar    *filename;
+    gchar    *content;
+    gsize     length;
+
+    caps_save_id = 0;
+
+    key_file = g_key_file_new ();
+    g_hash_table_foreach (caps_cache, (GHFunc) caps_save_foreach, key_file);
+
+    filename = caps_get_filename ();
+
+    gossip_debug (DEBUG_DOMAIN, "Saving %d capabilities to:'%s'",
+                  g_hash_table_size (caps_cache), filename);
+
+    content = g_key_file_to_data (key_file, &length, NULL);
+    if (!g_file_set_contents (filename, content, length, &error)) {
+        g_warning ("Couldn't save capabilities, error:%d->'%s'",
+                   error->code, error->message);
+        g_error_free (error);
+    }
+
+    g_free (content);
+    g_free (filename);
+    g_key_file_free (key_file);
+
+    return FALSE;
+}
+
+/* The extended info forms from XEP-0115 section 5.4 as they are
+ * hashed: forms ordered by FORM_TYPE, each followed by its fields
+ * ordered by var, each followed by its values in order. Forms
+ * without a FORM_TYPE don't count. NULL if there are none.
+ */
+static gchar **
+caps_get_forms (LmMessageNode *query)
+{
+    GPtrArray     *forms;
+    GPtrArray     *strs;
+    LmMessageNode *x;
+    guint          i;
+    gint           k;
+
+    forms = g_ptr_array_new ();
+
+    for (x = query->children; x; x = x->next) {
+        LmMessageNode *field;
+        GPtrArray     *fields;
+        gchar         *form_type = NULL;
+        const gchar   *xmlns;
+
+        xmlns = lm_message_node_get_attribute (x, "xmlns");
+        if (strcmp (x->name, "x") != 0 || !xmlns ||
+            strcmp (xmlns, XMPP_DATA_XMLNS) != 0) {
+            continue;
+        }
+
+        fields = g_ptr_array_new ();
+
+        for (field = x->children; field; field = field->next) {
+            LmMessageNode *value;
+            GPtrArray     *values;
+            const gchar   *var;
+
+            var = lm_message_node_get_attribute (field, "var");
+            if (strcmp (field->name, "field") != 0 || !var) {
+                continue;
+            }
+
+            values = g_ptr_array_new ();
+            for (value = field->children; value; value = value->next) {
+                if (strcmp (value->name, "value") == 0) {
+                    g_ptr_array_add (values, g_strdup (value->value ? value->value : ""));
+                }
+            }
+
+            if (strcmp (var, "FORM_TYPE") == 0) {
+                if (!form_type && values->len > 0) {
+                    form_type = g_strdup (g_ptr_array_index (values, 0));
+                }
+
+                g_ptr_array_foreach (values, (GFunc) g_free, NULL);
+                g_ptr_array_free (values, TRUE);
+                continue;
+            }
+
+            qsort (values->pdata, values->len, sizeof (gpointer), caps_strcmp);
+
+            /* The var first, then its values */
+            g_ptr_array_insert (values, 0, g_strdup (var));
+            g_ptr_array_add (values, NULL);
+
+            g_ptr_array_add (fields, g_ptr_array_free (values, FALSE));
+        }
+
+        if (!form_type) {
+            g_ptr_array_foreach (fields, (GFunc) g_strfreev, NULL);
+            g_ptr_array_free (fields, TRUE);
+            continue;
+        }
+
+        qsort (fields->pdata, fields->len, sizeof (gpointer), caps_strv_cmp);
+
+        /* The FORM_TYPE first, then each field's var and values */
+        strs = g_ptr_array_new ();
+        g_ptr_array_add (strs, form_type);
+
+        for (i = 0; i < fields->len; i++) {
+            gchar **strv;
+
+            strv = g_ptr_array_index (fields, i);
+            for (k = 0; strv[k]; k++) {
+                g_ptr_array_add (strs, strv[k]);
+            }
+
+            /* The strings now belong to strs */
+            g_free (strv);
+        }
+
+        g_ptr_array_free (fields, TRUE);
+        g_ptr_array_add (strs, NULL);
+
+        g_ptr_array_add (forms, g_ptr_array_free (strs, FALSE));
+    }
+
+    if (forms->len == 0) {
+        g_ptr_array_free (forms, TRUE);
+        return NULL;
+    }
+
+    qsort (forms->pdata, forms->len, sizeof (gpointer), caps_strv_cmp);
+
+    strs = g_ptr_array_new ();
+
+    for (i = 0; i < forms->len; i++) {
+        gchar **strv;
+
+        strv = g_ptr_array_index (forms, i);
+        for (k = 0; strv[k]; k++) {
+            g_ptr_array_add (strs, strv[k]);
+        }
+
+        g_free (strv);
+    }
+
+    g_ptr_array_free (forms, TRUE);
+    g_ptr_array_add (strs, NULL);
+
+    return (gchar **) g_ptr_array_free (strs, FALSE);
+}
+
+static void
+caps_request_free (CapsRequest *request)
+{
+    g_free (request->ver);
+    g_slice_free (CapsRequest, request);
+}
+
+static void
+caps_pending_free (LmMessageHandler *handler)
+{
+    lm_message_handler_invalidate (handler);
+    lm_message_handler_unref (handler);
+}
+
+static LmHandlerResult
+caps_info_reply_cb (LmMessageHandler *handler,
+                    LmConnection     *connection,
+                    LmMessage        *m,
+                    CapsRequest      *request)
+{
+    CapsInfo      *info;
+    LmMessageNode *query;
+    LmMessageNode *node;
+    GPtrArray     *identities;
+    GPtrArray     *features;
+    gchar         *ver;
+
+    query = lm_message_node_get_child (m->node, "query");
+
+    if (lm_message_get_sub_type (m) != LM_MESSAGE_SUB_TYPE_RESULT || !query) {
+        gossip_debug (DEBUG_DOMAIN, "No capabilities for ver:'%s'", request->ver);
+        g_hash_table_insert (request->caps->failed, g_strdup (request->ver), NULL);
+        g_hash_table_remove (request->caps->pending, request->ver);
+        return LM_HANDLER_RESULT_REMOVE_MESSAGE;
+    }
+
+    identities = g_ptr_array_new ();
+    features = g_ptr_array_new ();
+
+    for (node = query->children; node; node = node->next) {
+        const gchar *attr;
+
+        if (strcmp (node->name, "identity") == 0) {
+            const gchar *type;
+            const gchar *lang;
+            const gchar *name;
+
+            attr = lm_message_node_get_attribute (node, "category");
+            type = lm_message_node_get_attribute (node, "type");
+            lang = lm_message_node_get_attribute (node, "xml:lang");
+            name = lm_message_node_get_attribute (node, "name");
+
+            g_ptr_array_add (identities,
+                             g_strdup_printf ("%s/%s/%s/%s",
+                                              attr ? attr : "",
+                                              type ? type : "",
+                                              lang ? lang : "",
+                                              name ? name : ""));
+        } else if (strcmp (node->name, "feature") == 0) {
+            attr = lm_message_node_get_attribute (node, "var");
+            if (attr) {
+                g_ptr_array_add (features, g_strdup (attr));
+            }
+        }
+    }
+
+    qsort (identities->pdata, identities->len, sizeof (gpointer), caps_strcmp);
+    qsort (features->pdata, features->len, sizeof (gpointer), caps_strcmp);
+
+    g_ptr_array_add (identities, NULL);
+    g_ptr_array_add (features, NULL);
+
+    info = g_slice_new0 (CapsInfo);
+    info->identities = (gchar **) g_ptr_array_free (identities, FALSE);
+    info->features = (gchar **) g_ptr_array_free (features, FALSE);
+    info->forms = caps_get_forms (query);
+
+    ver = caps_compute_ver (info->identities, info->features, info->forms);
+
+    if (strcmp (ver, request->ver) == 0) {
+        gossip_debug (DEBUG_DOMAIN, "Caching %d features for ver:'%s'",
+                      g_strv_length (info->features), ver);
+
+        g_hash_table_insert (caps_cache, ver, info);
+
+        if (!caps_save_id) {
+            caps_save_id = g_timeout_add_seconds (CAPS_SAVE_DELAY,
+                                                  caps_cache_save_cb,
+                                                  NULL);
+        }
+    } else {
+        gossip_debug (DEBUG_DOMAIN, "Not caching ver:'%s', reply hashes to:'%s'",
+                      request->ver, ver);
+
+        g_hash_table_insert (request->caps->failed, g_strdup (request->ver), NULL);
+        caps_info_free (info);
+        g_free (ver);
+    }
+
+    g_hash_table_remove (request->caps->pending, request->ver);
+
+    return LM_HANDLER_RESULT_REMOVE_MESSAGE;
+}
+
+static void
+caps_request_info (GossipJabberCaps *caps,
+                   const gchar      *jid,
+                   const gchar      *node,
+                   const gchar      *ver)
+{
+    LmMessage        *m;
+    LmMessageNode    *query;
+    LmMessageHandler *handler;
+    CapsRequest      *request;
+    gchar            *str;
+
+    gossip_debug (DEBUG_DOMAIN, "Asking:'%s' what ver:'%s' means", jid, ver);
+
+    m = lm_message_new_with_sub_type (jid,
+                                      LM_MESSAGE_TYPE_IQ,
+                                      LM_MESSAGE_SUB_TYPE_GET);
+
+    query = lm_message_node_add_child (m->node, "query", NULL);
+    lm_message_node_set_attribute (query, "xmlns", XMPP_DISCO_INFO_XMLNS);
+
+    if (node) {
+        str = g_strdup_printf ("%s#%s", node, ver);
+        lm_message_node_set_attribute (query, "node", str);
+        g_free (str);
+    }
+
+    request = g_slice_new0 (CapsRequest);
+    request->caps = caps;
+    request->ver = g_strdup (ver);
+
+    handler = lm_message_handler_new ((LmHandleMessageFunction) caps_info_reply_cb,
+                                      request,
+                                      (GDestroyNotify) caps_request_free);
+
+    g_hash_table_insert (caps->pending, g_strdup (ver), handler);
+
+    gossip_jabber_cork_send_with_reply (caps->connection, m, handler, NULL);
+    lm_message_unref (m);
+}
+
+/* Sees all presence, unavailable presence doesn't carry <c/> */
+static LmHandlerResult
+caps_presence_handler (GossipJabberStanza *stanza,
+                       GossipJabberCaps   *caps)
+{
+    LmMessageNode *node;
+    const gchar   *from;
+    const gchar   *hash;
+    const gchar   *ver;
+
+    from = stanza->from;
+    if (!from) {
+        return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
+    }
+
+    if (stanza->sub_type == LM_MESSAGE_SUB_TYPE_UNAVAILABLE) {
+        g_hash_table_remove (caps->vers, from);
+        return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
+    }
+
+    node = gossip_jabber_stanza_get_child (stanza, XMPP_CAPS_XMLNS);
+    if (!node) {
+        return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
+    }
+
+    hash = lm_message_node_get_attribute (node, "hash");
+    ver = lm_message_node_get_attribute (node, "ver");
+
+    if (!hash || strcmp (hash, CAPS_HASH) != 0 || G_STR_EMPTY (ver)) {
+        return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
+    }
+
+    g_hash_table_insert (caps->vers, g_strdup (from), g_strdup (ver));
+
+    if (!g_hash_table_lookup (caps_cache, ver) &&
+        !g_hash_table_lookup (caps->pending, ver) &&
+        !g_hash_table_lookup_extended (caps->failed, ver, NULL, NULL)) {
+        caps_request_info (caps, from,
+                           lm_message_node_get_attribute (node, "node"),
+                           ver);
+    }
+
+    return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
+}
+
+static void
+caps_logged_out_cb (GossipJabber     *jabber,
+                    GossipAccount    *account,
+                    gint              reason,
+                    GossipJabberCaps *caps)
+{
+    g_hash_table_remove_all (caps->pending);
+    g_hash_table_remove_all (caps->vers);
+    g_hash_table_remove_all (caps->failed);
+}
+
+/* Adds our own <c/> so others only need to ask what we support once */
+void
+gossip_jabber_caps_add_to_presence (LmMessage *m)
+{
+    LmMessageNode *node;
+
+    g_return_if_fail (m != NULL);
+
+    node = lm_message_node_add_child (m->node, "c", NULL);
+    lm_message_node_set_attributes (node,
+                                    "xmlns", XMPP_CAPS_XMLNS,
+                                    "hash", CAPS_HASH,
+                                    "node", CAPS_NODE,
+                                    "ver", caps_get_own_ver (),
+                                    NULL);
+}
+
+void
+gossip_jabber_caps_add_own_info (LmMessageNode *query)
+{
+    LmMessageNode *node;
+    gint           i;
+
+    g_return_if_fail (query != NULL);
+
+    node = lm_message_node_add_child (query, "identity", NULL);
+    lm_message_node_set_attributes (node,
+                                    "category", "client",
+                                    "type", "pc",
+                                    "name", PACKAGE_STRING,
+                                    NULL);
+
+    for (i = 0; i < G_N_ELEMENTS (own_features); i++) {
+        node = lm_message_node_add_child (query, "feature", NULL);
+        lm_message_node_set_attribute (node, "var", own_features[i]);
+    }
+}
+
+/* Returns TRUE and what the client at jid supports if it advertised
+ * caps we know, the lists belong to the cache.
+ */
+gboolean
+gossip_jabber_caps_get_info (GossipJabberCaps   *caps,
+                             const gchar        *jid,
+                             gchar            ***identities,
+                             gchar            ***features)
+{
+    CapsInfo    *info;
+    const gchar *ver;
+
+    g_return_val_if_fail (caps != NULL, FALSE);
+    g_return_val_if_fail (jid != NULL, FALSE);
+
+    ver = g_hash_table_lookup (caps->vers, jid);
+    if (!ver) {
+        return FALSE;
+    }
+
+    info = g_hash_table_lookup (caps_cache, ver);
+    if (!info) {
+        return FALSE;
+    }
+
+    if (identities) {
+        *identities = info->identities;
+    }
+
+    if (features) {
+        *features = info->features;
+    }
+
+    return TRUE;
+}
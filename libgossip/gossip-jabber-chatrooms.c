@@ -31,10 +31,11 @@
 #include "gossip-ft.h"
 #include "gossip-ft-provider.h"
 #include "gossip-message.h"
+#include "gossip-time.h"
 #include "gossip-utils.h"
 
+#include "gossip-jabber-caps.h"
 #include "gossip-jabber-chatrooms.h"
-#include "gossip-jabber-disco.h"
 #include "gossip-jabber-utils.h"
 #include "gossip-jabber-private.h"
 #include "gossip-jid.h"
@@ -46,8 +47,19 @@
 #define XMPP_MUC_USER_XMLNS  "http://jabber.org/protocol/muc#user"
 #define XMPP_MUC_ADMIN_XMLNS "http://jabber.org/protocol/muc#admin"
 
+#define XMPP_DISCO_ITEMS_XMLNS "http://jabber.org/protocol/disco#items"
+#define XMPP_DISCO_INFO_XMLNS  "http://jabber.org/protocol/disco#info"
+#define XMPP_RSM_XMLNS         "http://jabber.org/protocol/rsm"
+
 #define JOIN_TIMEOUT 20000
 
+/* Rooms asked for at a time when browsing */
+#define BROWSE_PAGE_SIZE 50
+
+/* In seconds */
+#define BROWSE_TIMEOUT   20
+#define BROWSE_CACHE_TTL 600
+
 struct _GossipJabberChatrooms {
     GossipJabber   *jabber;
     GossipPresence *presence;
@@ -58,21 +70,82 @@ struct _GossipJabberChatrooms {
     GHashTable     *chatrooms_by_jid;
     GHashTable     *join_timeouts;
     GHashTable     *join_callbacks;
+
+    /* Server -> BrowseCache */
+    GHashTable     *browse_caches;
+};
+
+/* The rooms found browsing a conference server */
+typedef struct {
+    GossipJabberChatrooms *chatrooms;
+    gchar                 *server;
+
+    GList                 *rooms;
+    GHashTable            *info_requested;
+    gboolean               complete;
+    GossipTime             fetched;
+
+    /* GossipCallbackData for everyone waiting on the browse */
+    GList                 *waiters;
+    LmMessageHandler      *handler;
+    guint                  timeout_id;
+} BrowseCache;
+
+static const struct {
+    const gchar           *var;
+    GossipChatroomFeature  feature;
+} room_features[] = {
+    { "muc_hidden",            GOSSIP_CHATROOM_FEATURE_HIDDEN },
+    { "muc_membersonly",       GOSSIP_CHATROOM_FEATURE_MEMBERS_ONLY },
+    { "muc_moderated",         GOSSIP_CHATROOM_FEATURE_MODERATED },
+    { "muc_nonanonymous",      GOSSIP_CHATROOM_FEATURE_NONANONYMOUS },
+    { "muc_open",              GOSSIP_CHATROOM_FEATURE_OPEN },
+    { "muc_passwordprotected", GOSSIP_CHATROOM_FEATURE_PASSWORD_PROTECTED },
+    { "muc_persistent",        GOSSIP_CHATROOM_FEATURE_PERSISTENT },
+    { "muc_public",            GOSSIP_CHATROOM_FEATURE_PUBLIC },
+    { "muc_semianonymous",     GOSSIP_CHATROOM_FEATURE_SEMIANONYMOUS },
+    { "muc_temporary",         GOSSIP_CHATROOM_FEATURE_TEMPORARY },
+    { "muc_unmoderated",       GOSSIP_CHATROOM_FEATURE_UNMODERATED },
+    { "muc_unsecured",         GOSSIP_CHATROOM_FEATURE_UNSECURED }
 };
 
+/* Rooms are routed by their bare JID with the node case folded like
+ * GossipJID does it, the rest is compared without case. Keys are
+ * slices so incoming stanzas can be looked up by their "from" as it
+ * is.
+ */
+typedef struct {
+    const gchar *str;
+    gsize        len;
+} RouteKey;
+
 static void            logged_out_cb                  (GossipJabber          *jabber,
                                                        GossipAccount         *account,
                                                        gint                   reason,
                                                        GossipJabberChatrooms *chatrooms);
 static void            join_timeout_destroy_notify_cb (gpointer               data);
-static LmHandlerResult message_handler                (LmMessageHandler      *handler,
-                                                       LmConnection          *conn,
-                                                       LmMessage             *message,
+static guint           route_key_hash                 (gconstpointer          key);
+static gboolean        route_key_equal                (gconstpointer          a,
+                                                       gconstpointer          b);
+static void            route_key_free                 (RouteKey              *key);
+static gchar *         route_fold                     (const gchar           *str,
+                                                       gsize                  len);
+static void            route_add                      (GossipJabberChatrooms *chatrooms,
+                                                       GossipChatroom        *chatroom);
+static void            route_remove                   (GossipJabberChatrooms *chatrooms,
+                                                       GossipChatroom        *chatroom);
+static GossipContact * get_occupant                   (GossipChatroom        *chatroom,
+                                                       const gchar           *nick);
+static LmHandlerResult message_handler                (GossipJabberStanza    *stanza,
                                                        GossipJabberChatrooms *chatrooms);
-static LmHandlerResult presence_handler               (LmMessageHandler      *handler,
-                                                       LmConnection          *conn,
-                                                       LmMessage             *message,
+static LmHandlerResult presence_handler               (GossipJabberStanza    *stanza,
                                                        GossipJabberChatrooms *chatrooms);
+static void            browse_cache_free              (BrowseCache           *cache);
+static void            browse_finish                  (BrowseCache           *cache,
+                                                       GList                 *rooms,
+                                                       GError                *error);
+static void            browse_request_page            (BrowseCache           *cache,
+                                                       const gchar           *after);
 
 
 
@@ -81,7 +154,7 @@ gossip_jabber_chatrooms_init (GossipJabber *jabber)
 {
     GossipJabberChatrooms *chatrooms;
     LmConnection          *connection;
-    LmMessageHandler      *handler;
+    GossipJabberDispatch  *dispatch;
 
     g_return_val_if_fail (GOSSIP_IS_JABBER (jabber), NULL);
         
@@ -109,9 +182,9 @@ gossip_jabber_chatrooms_init (GossipJabber *jabber)
                                (GDestroyNotify) g_object_unref,
                                NULL);
     chatrooms->chatrooms_by_jid = 
-        g_hash_table_new_full (gossip_jid_hash_without_resource,
-                               gossip_jid_equal_without_resource, 
-                               (GDestroyNotify) g_object_unref,
+        g_hash_table_new_full (route_key_hash,
+                               route_key_equal,
+                               (GDestroyNotify) route_key_free,
                                (GDestroyNotify) g_object_unref);
     chatrooms->join_timeouts = 
         g_hash_table_new_full (gossip_chatroom_hash,
@@ -123,27 +196,25 @@ gossip_jabber_chatrooms_init (GossipJabber *jabber)
                                gossip_chatroom_equal,
                                (GDestroyNotify) g_object_unref,
                                (GDestroyNotify) gossip_callback_data_free);
+    chatrooms->browse_caches = 
+        g_hash_table_new_full (g_str_hash,
+                               g_str_equal,
+                               NULL,
+                               (GDestroyNotify) browse_cache_free);
 
     /* Set up message and presence handlers */
-    handler = lm_message_handler_new ((LmHandleMessageFunction) message_handler,
-                                      chatrooms, 
-                                      NULL);
-
-    lm_connection_register_message_handler (chatrooms->connection,
-                                            handler,
-                                            LM_MESSAGE_TYPE_MESSAGE,
-                                            LM_HANDLER_PRIORITY_NORMAL);
-    lm_message_handler_unref (handler);
-
-    handler = lm_message_handler_new ((LmHandleMessageFunction) presence_handler,
-                                      chatrooms, 
-                                      NULL);
-
-    lm_connection_register_message_handler (chatrooms->connection,
-                                            handler,
-                                            LM_MESSAGE_TYPE_PRESENCE,
-                                            LM_HANDLER_PRIORITY_FIRST);
-    lm_message_handler_unref (handler);
+    dispatch = _gossip_jabber_get_dispatch (jabber);
+
+    gossip_jabber_dispatch_add (dispatch,
+                                LM_MESSAGE_TYPE_MESSAGE, NULL,
+                                LM_HANDLER_PRIORITY_NORMAL,
+                                (GossipJabberStanzaFunc) message_handler,
+                                chatrooms);
+    gossip_jabber_dispatch_add (dispatch,
+                                LM_MESSAGE_TYPE_PRESENCE, NULL,
+                                LM_HANDLER_PRIORITY_FIRST,
+                                (GossipJabberStanzaFunc) presence_handler,
+                                chatrooms);
 
     return chatrooms;
 }
@@ -174,6 +245,9 @@ gossip_jabber_chatrooms_finalize (GossipJabberChatrooms *chatrooms)
     g_hash_table_unref (chatrooms->join_callbacks);
     chatrooms->join_timeouts = NULL;
 
+    g_hash_table_unref (chatrooms->browse_caches);
+    chatrooms->browse_caches = NULL;
+
     g_signal_handlers_disconnect_by_func (chatrooms->jabber,
                                           logged_out_cb,
                                           chatrooms);
@@ -208,50 +282,167 @@ logged_out_cb (GossipJabber          *jabber,
                gint                   reason,
                GossipJabberChatrooms *chatrooms)
 {
+    GList  *caches, *l;
+    GError *error;
+
     g_hash_table_foreach (chatrooms->chatrooms_by_id,
                           logged_out_foreach,
                           chatrooms);
+
+    /* Browsing can't go on without a connection and what was found
+     * may be out of date by the time we are back.
+     */
+    error = gossip_jabber_error_create (GOSSIP_JABBER_NO_CONNECTION,
+                                        gossip_jabber_error_to_string (GOSSIP_JABBER_NO_CONNECTION));
+
+    caches = g_hash_table_get_values (chatrooms->browse_caches);
+    for (l = caches; l; l = l->next) {
+        BrowseCache *cache;
+
+        cache = l->data;
+        if (cache->handler) {
+            browse_finish (cache, NULL, error);
+        }
+    }
+
+    g_list_free (caches);
+    g_error_free (error);
+
+    g_hash_table_remove_all (chatrooms->browse_caches);
+}
+
+static guint
+route_key_hash (gconstpointer key)
+{
+    const RouteKey *route_key;
+    guint           h = 5381;
+    gsize           i;
+
+    route_key = key;
+
+    for (i = 0; i < route_key->len; i++) {
+        h = (h << 5) + h + g_ascii_tolower (route_key->str[i]);
+    }
+
+    return h;
+}
+
+static gboolean
+route_key_equal (gconstpointer a,
+                 gconstpointer b)
+{
+    const RouteKey *key_a, *key_b;
+
+    key_a = a;
+    key_b = b;
+
+    if (key_a->len != key_b->len) {
+        return FALSE;
+    }
+
+    return g_ascii_strncasecmp (key_a->str, key_b->str, key_a->len) == 0;
+}
+
+static void
+route_key_free (RouteKey *key)
+{
+    g_free ((gchar *) key->str);
+    g_slice_free (RouteKey, key);
+}
+
+/* Casefolds the node of the first len bytes of str */
+static gchar *
+route_fold (const gchar *str,
+            gsize        len)
+{
+    const gchar *at;
+    gchar       *tmp;
+    gchar       *ret;
+
+    at = memchr (str, '@', len);
+    if (!at) {
+        return g_strndup (str, len);
+    }
+
+    tmp = g_utf8_casefold (str, at - str);
+    ret = g_strdup_printf ("%s%.*s", tmp, (gint) (len - (at - str)), at);
+    g_free (tmp);
+
+    return ret;
+}
+
+static void
+route_add (GossipJabberChatrooms *chatrooms,
+           GossipChatroom        *chatroom)
+{
+    RouteKey    *key;
+    const gchar *id_str;
+    const gchar *slash;
+    gsize        len;
+
+    id_str = gossip_chatroom_get_id_str (chatroom);
+    slash = strchr (id_str, '/');
+    len = slash ? slash - id_str : strlen (id_str);
+
+    key = g_slice_new (RouteKey);
+    key->str = route_fold (id_str, len);
+    key->len = strlen (key->str);
+
+    g_hash_table_insert (chatrooms->chatrooms_by_jid,
+                         key,
+                         g_object_ref (chatroom));
+}
+
+static void
+route_remove (GossipJabberChatrooms *chatrooms,
+              GossipChatroom        *chatroom)
+{
+    RouteKey     key;
+    const gchar *id_str;
+    const gchar *slash;
+    gchar       *folded;
+
+    id_str = gossip_chatroom_get_id_str (chatroom);
+    slash = strchr (id_str, '/');
+
+    folded = route_fold (id_str, slash ? slash - id_str : strlen (id_str));
+    key.str = folded;
+    key.len = strlen (folded);
+
+    g_hash_table_remove (chatrooms->chatrooms_by_jid, &key);
+    g_free (folded);
 }
 
 static LmHandlerResult
-message_handler (LmMessageHandler      *handler,
-                 LmConnection          *conn,
-                 LmMessage             *m,
+message_handler (GossipJabberStanza    *stanza,
                  GossipJabberChatrooms *chatrooms)
 {
+    LmMessage        *m;
     LmMessageNode    *node;
-    GossipJID        *jid;
     GossipChatroom   *chatroom;
     GossipChatroomId  id;
     GossipContact    *contact;
     GossipMessage    *message;
-    const gchar      *from;
+    const gchar      *nick;
 
-    if (lm_message_get_sub_type (m) != LM_MESSAGE_SUB_TYPE_GROUPCHAT) {
+    if (stanza->sub_type != LM_MESSAGE_SUB_TYPE_GROUPCHAT) {
         return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
     }
 
-    from = lm_message_node_get_attribute (m->node, "from");
-    jid = gossip_jid_new (from);
-
-    chatroom = g_hash_table_lookup (chatrooms->chatrooms_by_jid, jid);
+    m = stanza->m;
 
+    chatroom = gossip_jabber_chatrooms_find_by_jid (chatrooms, stanza->from, &nick);
     if (!chatroom) {
-        g_object_unref (jid);
         return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;   
     }
 
     id = gossip_chatroom_get_id (chatroom);
 
-    contact = gossip_jabber_get_contact_from_jid (chatrooms->jabber, 
-                                                  from, 
-                                                  FALSE,
-                                                  FALSE,
-                                                  FALSE);
+    contact = get_occupant (chatroom, nick);
 
     node = lm_message_node_get_child (m->node, "body");
     if (node) {
-        if (gossip_jid_get_resource (jid) == NULL) {
+        if (nick == NULL) {
             g_signal_emit_by_name (chatrooms->jabber,
                                    "chatroom-new-event",
                                    id, 
@@ -303,8 +494,6 @@ message_handler (LmMessageHandler      *handler,
         }
     }
 
-    g_object_unref (jid);
-
     return LM_HANDLER_RESULT_REMOVE_MESSAGE;
 
 }
@@ -473,7 +662,6 @@ static void
 leave_chatroom (GossipJabberChatrooms *chatrooms,
                 GossipChatroom        *chatroom)
 {
-    GossipJID        *jid;
     GossipChatroomId  id;
 
     id = gossip_chatroom_get_id (chatroom);
@@ -485,13 +673,9 @@ leave_chatroom (GossipJabberChatrooms *chatrooms,
     gossip_chatroom_set_last_error (chatroom, GOSSIP_CHATROOM_ERROR_NONE);
     gossip_chatroom_set_status (chatroom, GOSSIP_CHATROOM_STATUS_INACTIVE);
 
-    jid = gossip_jid_new (gossip_chatroom_get_id_str (chatroom));
-        
     g_hash_table_remove (chatrooms->chatrooms_by_id, GINT_TO_POINTER (id));
     g_hash_table_remove (chatrooms->chatrooms_by_pointer, chatroom);
-    g_hash_table_remove (chatrooms->chatrooms_by_jid, jid);
-        
-    g_object_unref (jid);
+    route_remove (chatrooms, chatroom);
 }
 
 static void
@@ -528,7 +712,7 @@ create_instant_room (LmConnection   *connection,
                                     "type", "submit",
                                     NULL);
 
-    lm_connection_send (connection, m,  NULL);
+    gossip_jabber_cork_send (connection, m,  NULL);
     lm_message_unref (m);
 }
 
@@ -586,7 +770,7 @@ create_reserved_room (LmConnection   *connection,
     lm_message_node_add_child (child, "value", G_STR_EMPTY (password) ? "" : password);
         
     /* Finally send */
-    lm_connection_send (connection, m,  NULL);
+    gossip_jabber_cork_send (connection, m,  NULL);
     lm_message_unref (m);
 }
 
@@ -618,7 +802,7 @@ request_reserved_room (LmConnection   *connection,
     node = lm_message_node_add_child (m->node, "query", NULL);
     lm_message_node_set_attributes (node, "xmlns", XMPP_MUC_OWNER_XMLNS, NULL);
 
-    lm_connection_send (connection, m,  NULL);
+    gossip_jabber_cork_send (connection, m,  NULL);
     lm_message_unref (m);
 }
 
@@ -707,18 +891,14 @@ join_finish (GossipJabberChatrooms *chatrooms,
 
     /* If we have an error, clean up */
     if (error != GOSSIP_CHATROOM_ERROR_NONE) {
-        GossipJID        *jid;
-        GossipChatroomId  id;
+        GossipChatroomId id;
 
         /* Clean up */
         id = gossip_chatroom_get_id (chatroom);
-        jid = gossip_jid_new (gossip_chatroom_get_id_str (chatroom));
 
         g_hash_table_remove (chatrooms->chatrooms_by_id, GINT_TO_POINTER (id));
         g_hash_table_remove (chatrooms->chatrooms_by_pointer, chatroom);
-        g_hash_table_remove (chatrooms->chatrooms_by_jid, jid);
-
-        g_object_unref (jid);
+        route_remove (chatrooms, chatroom);
 
         return FALSE;
     }
@@ -726,51 +906,48 @@ join_finish (GossipJabberChatrooms *chatrooms,
     return TRUE;
 }
 
-static gchar *
-get_new_id_for_new_nick (GossipContact *contact,
-                         const gchar   *new_nick)
+/* Occupants are kept by the room they are in rather than the contact
+ * manager, so they go away again when they leave. The room only makes
+ * a contact for one when it is needed, like here for who sent a
+ * message. They are only handed to the contact manager if we start
+ * talking to them directly, see gossip_jabber_chatrooms_get_occupant().
+ */
+static GossipContact *
+get_occupant (GossipChatroom *chatroom,
+              const gchar    *nick)
 {
-    GossipJID   *jid;
-    const gchar *id_str;
-    const gchar *id_str_without_resource;
-    gchar       *id_str_with_new_nick;
-
-    id_str = gossip_contact_get_id (contact);
-    jid = gossip_jid_new (id_str);
-    id_str_without_resource = gossip_jid_get_without_resource (jid);
-    id_str_with_new_nick = g_strconcat (id_str_without_resource, "/", new_nick, NULL);
-    g_object_unref (jid);
+    /* No resource means it is the room itself */
+    if (G_STR_EMPTY (nick)) {
+        return NULL;
+    }
 
-    return id_str_with_new_nick;
+    return gossip_chatroom_get_occupant (chatroom, nick);
 }
 
 static LmHandlerResult
-presence_handler (LmMessageHandler      *handler,
-                  LmConnection          *connection,
-                  LmMessage             *m,
+presence_handler (GossipJabberStanza    *stanza,
                   GossipJabberChatrooms *chatrooms)
 {
+    LmMessage                 *m;
     const gchar               *from;
-    GossipJID                 *jid;
+    const gchar               *nick;
+    const gchar               *status;
     GossipContact             *own_contact;
     GossipContact             *contact;
-    GossipPresence            *presence;
+    GossipPresenceState        state;
     GossipChatroom            *chatroom;
     GossipChatroomId           id;
     LmMessageSubType           type;
     LmMessageNode             *node;
-    gboolean                   was_offline;
     LmMessageNode             *muc_user_node;
     GossipChatroomContactInfo  muc_contact_info;
     gchar                     *new_nick;
 
-    from = lm_message_node_get_attribute (m->node, "from");
-    jid = gossip_jid_new (from);
-
-    chatroom = g_hash_table_lookup (chatrooms->chatrooms_by_jid, jid);
+    m = stanza->m;
+    from = stanza->from;
 
+    chatroom = gossip_jabber_chatrooms_find_by_jid (chatrooms, from, &nick);
     if (!chatroom) {
-        g_object_unref (jid);
         return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;   
     }
 
@@ -788,81 +965,64 @@ presence_handler (LmMessageHandler      *handler,
          * again here or any further messages from the room 
          */
         if (!join_finish (chatrooms, chatroom, m)) {
-            g_object_unref (jid);
             return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;       
         }
     }
 
     id = gossip_chatroom_get_id (chatroom);
 
-    type = lm_message_get_sub_type (m);
+    type = stanza->sub_type;
     switch (type) {
     case LM_MESSAGE_SUB_TYPE_AVAILABLE:
-        /* Get details */
-        contact = gossip_jabber_get_contact_from_jid (chatrooms->jabber, 
-                                                      from, 
-                                                      FALSE,
-                                                      FALSE,
-                                                      FALSE);
-
-        presence = gossip_presence_new ();
+        /* No resource means it is the room itself */
+        if (G_STR_EMPTY (nick)) {
+            break;
+        }
 
+        /* The room only keeps the state and role of occupants,
+         * there is no contact or presence made for them here.
+         */
+        state = GOSSIP_PRESENCE_STATE_AVAILABLE;
         node = lm_message_node_get_child (m->node, "show");
         if (node) {
-            GossipPresenceState state;
-
             state = gossip_jabber_presence_state_from_str (node->value);
-            gossip_presence_set_state (presence, state);
         }
 
+        status = NULL;
         node = lm_message_node_get_child (m->node, "status");
         if (node) {
-            gossip_presence_set_status (presence, node->value);
+            status = node->value;
         }
 
-        /* Should signal joined if contact was found but offline */
-        was_offline = !gossip_contact_is_online (contact);
-        gossip_contact_add_presence (contact, presence);
-        g_object_unref (presence);
-
         muc_user_node = find_muc_user_node (m->node);
         muc_contact_info.role = get_role (muc_user_node);
         muc_contact_info.affiliation = get_affiliation (muc_user_node);
 
-        /* Is contact new or updated */
-        if (was_offline) {
+        if (gossip_chatroom_occupant_update (chatroom, nick, state, status,
+                                             &muc_contact_info)) {
             gossip_debug (DEBUG_DOMAIN,
                           "ID[%d] Presence for new joining contact:'%s'",
                           id,
-                          gossip_jid_get_full (jid));
-            gossip_chatroom_contact_joined (chatroom,
-                                            contact,
-                                            &muc_contact_info);
-        } else {
-            gossip_chatroom_set_contact_info (chatroom,
-                                              contact,
-                                              &muc_contact_info);
+                          from);
         }
         break;
 
     case LM_MESSAGE_SUB_TYPE_UNAVAILABLE:
-        contact = gossip_jabber_get_contact_from_jid (chatrooms->jabber, 
-                                                      from, 
-                                                      FALSE,
-                                                      FALSE,
-                                                      FALSE);
+        if (G_STR_EMPTY (nick)) {
+            break;
+        }
 
         new_nick = NULL;
 
         if (gossip_jabber_get_message_is_muc_new_nick (m, &new_nick)) {
             gchar *old_nick;
-            gchar *new_id;
 
-            old_nick = g_strdup (gossip_contact_get_name (contact));
-            new_id = get_new_id_for_new_nick (contact, new_nick);
-            gossip_contact_set_id (contact, new_id);
-            gossip_contact_set_name (contact, new_nick);
-            g_free (new_id);
+            /* Nick changes are rare enough to make the contact
+             * for the signal.
+             */
+            old_nick = g_strdup (nick);
+            gossip_chatroom_occupant_nick_changed (chatroom, old_nick, new_nick);
+            contact = gossip_chatroom_get_occupant (chatroom, new_nick);
             g_free (new_nick);
 
             gossip_debug (DEBUG_DOMAIN,
@@ -882,7 +1042,8 @@ presence_handler (LmMessageHandler      *handler,
         } else {
             own_contact = gossip_chatroom_get_own_contact (chatroom);
 
-            if (gossip_contact_equal (contact, own_contact)) {
+            if (own_contact &&
+                gossip_chatroom_find_occupant (chatroom, nick) == own_contact) {
                 gossip_debug (DEBUG_DOMAIN, 
                               "ID[%d] We have been kicked!", 
                               id);
@@ -899,9 +1060,9 @@ presence_handler (LmMessageHandler      *handler,
                 gossip_debug (DEBUG_DOMAIN,
                               "ID[%d] Contact left:'%s'",
                               id,
-                              gossip_contact_get_id (contact));
+                              from);
 
-                gossip_chatroom_contact_left (chatroom, contact);
+                gossip_chatroom_occupant_left (chatroom, nick);
             }
         }
         break;
@@ -938,12 +1099,10 @@ presence_handler (LmMessageHandler      *handler,
     default:
         gossip_debug (DEBUG_DOMAIN, 
                       "Presence not handled for:'%s'",
-                      gossip_jid_get_full (jid));
+                      from);
         break;
     }
 
-    g_object_unref (jid);
-
     return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
 }
 
@@ -959,7 +1118,6 @@ join_timeout_destroy_notify_cb (gpointer data)
 static gboolean
 join_timeout_cb (GossipCallbackData *timeout_data)
 {
-    GossipJID             *jid;
     GossipChatroomId       id;
     GossipChatroom        *chatroom;
     GossipJabberChatrooms *chatrooms;
@@ -1005,13 +1163,9 @@ join_timeout_cb (GossipCallbackData *timeout_data)
     g_hash_table_remove (chatrooms->join_callbacks, chatroom);
 
     /* Clean up */
-    jid = gossip_jid_new (gossip_chatroom_get_id_str (chatroom));
-        
     g_hash_table_remove (chatrooms->chatrooms_by_id, GINT_TO_POINTER (id));
     g_hash_table_remove (chatrooms->chatrooms_by_pointer, chatroom);
-    g_hash_table_remove (chatrooms->chatrooms_by_jid, jid);
-        
-    g_object_unref (jid);
+    route_remove (chatrooms, chatroom);
 
     gossip_callback_data_free (timeout_data);
 
@@ -1029,7 +1183,6 @@ gossip_jabber_chatrooms_join (GossipJabberChatrooms *chatrooms,
     GossipContact        *own_contact;
     GossipChatroomId      id;
     gchar                *id_str;
-    const gchar          *jid_str;
     const gchar          *show = NULL;
     const gchar          *password;
     guint                 timeout_id;
@@ -1055,8 +1208,6 @@ gossip_jabber_chatrooms_join (GossipJabberChatrooms *chatrooms,
         return id;
     }
 
-    jid_str = gossip_chatroom_get_id_str (chatroom);
-
     /* Get real chatroom. */
     id = gossip_chatroom_get_id (chatroom);
 
@@ -1083,9 +1234,7 @@ gossip_jabber_chatrooms_join (GossipJabberChatrooms *chatrooms,
     g_hash_table_insert (chatrooms->chatrooms_by_pointer, 
                          g_object_ref (chatroom), 
                          GINT_TO_POINTER (1));
-    g_hash_table_insert (chatrooms->chatrooms_by_jid,
-                         gossip_jid_new (jid_str),
-                         g_object_ref (chatroom));
+    route_add (chatrooms, chatroom);
 
     gossip_chatroom_set_last_error (chatroom, GOSSIP_CHATROOM_ERROR_NONE);
     gossip_chatroom_set_status (chatroom, GOSSIP_CHATROOM_STATUS_JOINING);
@@ -1116,11 +1265,13 @@ gossip_jabber_chatrooms_join (GossipJabberChatrooms *chatrooms,
         lm_message_node_add_child (m->node, "show", show);
     }
 
+    gossip_jabber_caps_add_to_presence (m);
+
     id_str = g_strdup_printf ("muc_join_%d", id);
     lm_message_node_set_attribute (m->node, "id", id_str);
     g_free (id_str);
 
-    lm_connection_send (chatrooms->connection, m,  NULL);
+    gossip_jabber_cork_send (chatrooms->connection, m,  NULL);
     lm_message_unref (m);
 
     return id;
@@ -1131,7 +1282,6 @@ gossip_jabber_chatrooms_cancel (GossipJabberChatrooms *chatrooms,
                                 GossipChatroomId       id)
 {
     GossipChatroom     *chatroom;
-    GossipJID          *jid;
     GossipCallbackData *data;
 
     g_return_if_fail (chatrooms != NULL);
@@ -1169,13 +1319,9 @@ gossip_jabber_chatrooms_cancel (GossipJabberChatrooms *chatrooms,
     /* Clean up the user data */
     g_hash_table_remove (chatrooms->join_callbacks, chatroom);
 
-    jid = gossip_jid_new (gossip_chatroom_get_id_str (chatroom));
-        
     g_hash_table_remove (chatrooms->chatrooms_by_id, GINT_TO_POINTER (id));
     g_hash_table_remove (chatrooms->chatrooms_by_pointer, chatroom);
-    g_hash_table_remove (chatrooms->chatrooms_by_jid, jid);
-        
-    g_object_unref (jid);
+    route_remove (chatrooms, chatroom);
 }
 
 void
@@ -1209,7 +1355,7 @@ gossip_jabber_chatrooms_send (GossipJabberChatrooms *chatrooms,
                                       LM_MESSAGE_SUB_TYPE_GROUPCHAT);
     lm_message_node_add_child (m->node, "body", message);
 
-    lm_connection_send (chatrooms->connection, m, NULL);
+    gossip_jabber_cork_send (chatrooms->connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -1246,7 +1392,7 @@ gossip_jabber_chatrooms_change_subject (GossipJabberChatrooms *chatrooms,
 
     lm_message_node_add_child (m->node, "subject", new_subject);
 
-    lm_connection_send (chatrooms->connection, m, NULL);
+    gossip_jabber_cork_send (chatrooms->connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -1291,7 +1437,7 @@ gossip_jabber_chatrooms_change_nick (GossipJabberChatrooms *chatrooms,
     m = lm_message_new (new_id, LM_MESSAGE_TYPE_PRESENCE);
     g_free (new_id);
 
-    lm_connection_send (chatrooms->connection, m, NULL);
+    gossip_jabber_cork_send (chatrooms->connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -1330,7 +1476,7 @@ gossip_jabber_chatrooms_leave (GossipJabberChatrooms *chatrooms,
                                       LM_MESSAGE_TYPE_PRESENCE,
                                       LM_MESSAGE_SUB_TYPE_UNAVAILABLE);
 
-    lm_connection_send (chatrooms->connection, m, NULL);
+    gossip_jabber_cork_send (chatrooms->connection, m, NULL);
     lm_message_unref (m);
 
     leave_chatroom (chatrooms, chatroom);
@@ -1394,7 +1540,7 @@ gossip_jabber_chatrooms_kick (GossipJabberChatrooms *chatrooms,
                                     NULL);
     g_object_unref (jid);
         
-    lm_connection_send (chatrooms->connection, m, NULL);
+    gossip_jabber_cork_send (chatrooms->connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -1470,7 +1616,7 @@ gossip_jabber_chatrooms_invite (GossipJabberChatrooms *chatrooms,
 
     lm_message_node_add_child (node, "reason", reason);
 
-    lm_connection_send (chatrooms->connection, m, NULL);
+    gossip_jabber_cork_send (chatrooms->connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -1560,7 +1706,7 @@ gossip_jabber_chatrooms_invite_decline (GossipJabberChatrooms *chatrooms,
 
     n = lm_message_node_add_child (n, "reason", reason);
 
-    lm_connection_send (chatrooms->connection, m, NULL);
+    gossip_jabber_cork_send (chatrooms->connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -1592,193 +1738,497 @@ gossip_jabber_chatrooms_get_rooms (GossipJabberChatrooms *chatrooms)
 }
 
 static void
-jabber_chatrooms_browse_rooms_cb (GossipJabberDisco     *disco,
-                                  GossipJabberDiscoItem *item,
-                                  gboolean               last_item,
-                                  gboolean               timeout,
-                                  GError                *error,
-                                  GossipCallbackData    *data)
+browse_cache_free (BrowseCache *cache)
 {
-    GossipJID             *jid = NULL;
-    GossipJabberChatrooms *chatrooms;
-    GossipChatroom        *chatroom = NULL;
-    GList                 *list;
-    gchar                 *server;
+    if (cache->timeout_id) {
+        g_source_remove (cache->timeout_id);
+    }
 
-    if (timeout && !last_item) {
-        return;
+    if (cache->handler) {
+        lm_message_handler_invalidate (cache->handler);
+        lm_message_handler_unref (cache->handler);
     }
 
-    chatrooms = data->data1;
-    server = data->data2;
-    list = data->data3;
+    g_list_foreach (cache->waiters, (GFunc) gossip_callback_data_free, NULL);
+    g_list_free (cache->waiters);
+
+    g_list_foreach (cache->rooms, (GFunc) g_object_unref, NULL);
+    g_list_free (cache->rooms);
 
-    if (item) {
-        jid = gossip_jabber_disco_item_get_jid (item);
-        chatroom = g_hash_table_lookup (chatrooms->chatrooms_by_jid, jid);
+    g_hash_table_destroy (cache->info_requested);
+
+    g_free (cache->server);
+    g_slice_free (BrowseCache, cache);
+}
+
+static void
+browse_cache_reset (BrowseCache *cache)
+{
+    g_list_foreach (cache->rooms, (GFunc) g_object_unref, NULL);
+    g_list_free (cache->rooms);
+    cache->rooms = NULL;
+
+    g_hash_table_remove_all (cache->info_requested);
+
+    cache->complete = FALSE;
+    cache->fetched = 0;
+}
+
+/* Hands a page of rooms to everyone waiting for this server */
+static void
+browse_notify (BrowseCache *cache,
+               GList       *rooms,
+               gboolean     last_page,
+               GError      *error)
+{
+    GList *waiters, *l;
+
+    waiters = cache->waiters;
+    if (last_page) {
+        cache->waiters = NULL;
     }
 
-    if (!chatroom && !timeout && !error) {
-        GossipSession         *session;
-        GossipChatroomManager *chatroom_manager;
-        GossipAccount         *account;
-        const gchar           *server;
-        gchar                 *room;
-                
-        gossip_debug (DEBUG_DOMAIN, 
-                      "Chatroom found on server not set up here, creating for:'%s'...",
-                      gossip_jid_get_full (jid));
-
-        account = gossip_jabber_get_account (chatrooms->jabber);
-        server = gossip_jid_get_part_host (jid);
-        room = gossip_jid_get_part_name (jid);
-
-        /* Create new chatroom */
-        session = _gossip_jabber_get_session (chatrooms->jabber);
-        chatroom_manager = gossip_session_get_chatroom_manager (session);
-        chatroom = gossip_chatroom_manager_find_or_create (chatroom_manager, 
-                                                           account, 
-                                                           server, 
-                                                           room,
-                                                           NULL);
+    for (l = waiters; l; l = l->next) {
+        GossipCallbackData     *data;
+        GossipChatroomBrowseCb  callback;
 
-        g_free (room);
+        data = l->data;
+        callback = data->callback;
+
+        (callback) (GOSSIP_CHATROOM_PROVIDER (cache->chatrooms->jabber),
+                    cache->server, rooms, last_page, error, data->user_data);
+    }
+
+    if (last_page) {
+        g_list_foreach (waiters, (GFunc) gossip_callback_data_free, NULL);
+        g_list_free (waiters);
+    }
+}
+
+static void
+browse_finish (BrowseCache *cache,
+               GList       *rooms,
+               GError      *error)
+{
+    if (cache->timeout_id) {
+        g_source_remove (cache->timeout_id);
+        cache->timeout_id = 0;
+    }
+
+    if (cache->handler) {
+        lm_message_handler_invalidate (cache->handler);
+        lm_message_handler_unref (cache->handler);
+        cache->handler = NULL;
     }
 
+    if (!error) {
+        cache->complete = TRUE;
+        cache->fetched = gossip_time_get_current ();
+    }
+
+    browse_notify (cache, rooms, TRUE, error);
+}
+
+static gboolean
+browse_timeout_cb (BrowseCache *cache)
+{
+    GError *error;
+
+    gossip_debug (DEBUG_DOMAIN,
+                  "Browsing rooms on:'%s' timed out after %d seconds",
+                  cache->server, BROWSE_TIMEOUT);
+
+    cache->timeout_id = 0;
+
+    error = gossip_jabber_error_create (GOSSIP_JABBER_TIMED_OUT,
+                                        gossip_jabber_error_to_string (GOSSIP_JABBER_TIMED_OUT));
+    browse_finish (cache, NULL, error);
+    g_error_free (error);
+
+    return FALSE;
+}
+
+static GossipChatroom *
+browse_get_chatroom (GossipJabberChatrooms *chatrooms,
+                     const gchar           *jid_str)
+{
+    GossipSession         *session;
+    GossipChatroomManager *chatroom_manager;
+    GossipAccount         *account;
+    GossipChatroom        *chatroom;
+    gchar                 *server;
+    gchar                 *room;
+    gboolean               created;
+
+    chatroom = gossip_jabber_chatrooms_find_by_jid (chatrooms, jid_str, NULL);
     if (chatroom) {
-        GossipChatroomFeature  features = 0;
-        LmMessageNode         *node;
-        const gchar           *name;
+        return g_object_ref (chatroom);
+    }
 
-        name = gossip_jabber_disco_item_get_name (item);
-        gossip_chatroom_set_name (chatroom, name);
+    room = gossip_jid_string_get_part_name (jid_str);
+    server = gossip_jid_string_get_part_host (jid_str);
 
-        /* Sort ouf the features */
-        if (gossip_jabber_disco_item_has_feature (item, "muc_hidden")) { 
-            features |= GOSSIP_CHATROOM_FEATURE_HIDDEN;
-        }
+    if (G_STR_EMPTY (room) || G_STR_EMPTY (server)) {
+        g_free (room);
+        g_free (server);
+        return NULL;
+    }
 
-        if (gossip_jabber_disco_item_has_feature (item, "muc_membersonly")) { 
-            features |= GOSSIP_CHATROOM_FEATURE_MEMBERS_ONLY;
-        }
+    account = gossip_jabber_get_account (chatrooms->jabber);
+    session = _gossip_jabber_get_session (chatrooms->jabber);
+    chatroom_manager = gossip_session_get_chatroom_manager (session);
+    chatroom = gossip_chatroom_manager_find_or_create (chatroom_manager,
+                                                       account,
+                                                       server,
+                                                       room,
+                                                       &created);
+    g_free (room);
+    g_free (server);
 
-        if (gossip_jabber_disco_item_has_feature (item, "muc_moderated")) { 
-            features |= GOSSIP_CHATROOM_FEATURE_MODERATED;
-        }
+    /* The cache always holds its own reference, one we only get
+     * from the manager when the room is new.
+     */
+    if (!created) {
+        g_object_ref (chatroom);
+    }
 
-        if (gossip_jabber_disco_item_has_feature (item, "muc_nonanonymous")) { 
-            features |= GOSSIP_CHATROOM_FEATURE_NONANONYMOUS;
-        }
+    return chatroom;
+}
 
-        if (gossip_jabber_disco_item_has_feature (item, "muc_open")) { 
-            features |= GOSSIP_CHATROOM_FEATURE_OPEN;
-        }
+static LmHandlerResult
+browse_page_cb (LmMessageHandler *handler,
+                LmConnection     *connection,
+                LmMessage        *m,
+                BrowseCache      *cache)
+{
+    LmMessageNode *query;
+    LmMessageNode *node;
+    const gchar   *last = NULL;
+    GList         *page = NULL;
+    gint           count = -1;
 
-        if (gossip_jabber_disco_item_has_feature (item, "muc_passwordprotected")) { 
-            features |= GOSSIP_CHATROOM_FEATURE_PASSWORD_PROTECTED;
-        }
+    if (cache->timeout_id) {
+        g_source_remove (cache->timeout_id);
+        cache->timeout_id = 0;
+    }
 
-        if (gossip_jabber_disco_item_has_feature (item, "muc_persistent")) { 
-            features |= GOSSIP_CHATROOM_FEATURE_PERSISTENT;
-        }
+    if (lm_message_get_sub_type (m) != LM_MESSAGE_SUB_TYPE_RESULT) {
+        GError *error;
+
+        error = gossip_jabber_error_create (GOSSIP_JABBER_UNAVAILABLE,
+                                            gossip_jabber_error_to_string (GOSSIP_JABBER_UNAVAILABLE));
+        browse_finish (cache, NULL, error);
+        g_error_free (error);
+
+        return LM_HANDLER_RESULT_REMOVE_MESSAGE;
+    }
 
-        if (gossip_jabber_disco_item_has_feature (item, "muc_public")) { 
-            features |= GOSSIP_CHATROOM_FEATURE_PUBLIC;
+    query = lm_message_node_get_child (m->node, "query");
+
+    for (node = query ? query->children : NULL; node; node = node->next) {
+        GossipChatroom *chatroom;
+        const gchar    *jid_str;
+        const gchar    *name;
+
+        if (strcmp (node->name, "set") == 0) {
+            LmMessageNode *child;
+
+            child = lm_message_node_get_child (node, "last");
+            last = child ? child->value : NULL;
+
+            child = lm_message_node_get_child (node, "count");
+            count = child && child->value ? atoi (child->value) : -1;
+            continue;
         }
 
-        if (gossip_jabber_disco_item_has_feature (item, "muc_semianonymous")) { 
-            features |= GOSSIP_CHATROOM_FEATURE_SEMIANONYMOUS;
+        if (strcmp (node->name, "item") != 0) {
+            continue;
         }
 
-        if (gossip_jabber_disco_item_has_feature (item, "muc_temporary")) { 
-            features |= GOSSIP_CHATROOM_FEATURE_TEMPORARY;
+        jid_str = lm_message_node_get_attribute (node, "jid");
+        if (!jid_str) {
+            continue;
         }
 
-        if (gossip_jabber_disco_item_has_feature (item, "muc_unmoderated")) { 
-            features |= GOSSIP_CHATROOM_FEATURE_PERSISTENT;
+        chatroom = browse_get_chatroom (cache->chatrooms, jid_str);
+        if (!chatroom) {
+            continue;
         }
 
-        if (gossip_jabber_disco_item_has_feature (item, "muc_unsecured")) { 
-            features |= GOSSIP_CHATROOM_FEATURE_UNSECURED;
+        name = lm_message_node_get_attribute (node, "name");
+        if (name) {
+            gossip_chatroom_set_name (chatroom, name);
         }
 
-        gossip_chatroom_set_features (chatroom, features);
+        page = g_list_prepend (page, chatroom);
+    }
+
+    page = g_list_reverse (page);
+    cache->rooms = g_list_concat (cache->rooms, page);
 
-        /* Get the MUC specific data */
-        node = gossip_jabber_disco_item_get_data (item);
-        if (node) {
-            node = node->children;
-
-            while (node) {
-                if (node->name && strcmp (node->name, "field") == 0) {
-                    const gchar *var;
-                    const gchar *val;
-
-                    var = lm_message_node_get_attribute (node, "var");
-                    val = lm_message_node_get_value (node->children);
-
-                    if (var && val) {
-                        if (strcmp (var, "muc#roominfo_description") == 0) {
-                            gossip_chatroom_set_description (chatroom, val);
-                        } 
-                        else if (strcmp (var, "muc#roominfo_subject") == 0) {
-                            gossip_chatroom_set_subject (chatroom, val);
-                        }
-                        else if (strcmp (var, "muc#roominfo_occupants") == 0) {
-                            gossip_chatroom_set_occupants (chatroom, atoi (val));
-                        }
-                    }
-                }
+    gossip_debug (DEBUG_DOMAIN,
+                  "Browsed %d rooms on:'%s', %d so far",
+                  g_list_length (page), cache->server,
+                  g_list_length (cache->rooms));
+
+    /* Servers without RSM send everything at once and no <set> */
+    if (page && last && (count < 0 || (gint) g_list_length (cache->rooms) < count)) {
+        browse_notify (cache, page, FALSE, NULL);
+        browse_request_page (cache, last);
+    } else {
+        browse_finish (cache, page, NULL);
+    }
 
-                node = node->next;
-            }
-        }
+    return LM_HANDLER_RESULT_REMOVE_MESSAGE;
+}
 
-        gossip_debug (DEBUG_DOMAIN, 
-                      "Chatroom:'%s' added to list found on server:'%s'...",
-                      gossip_chatroom_get_room (chatroom),
-                      gossip_chatroom_get_server (chatroom));
+static void
+browse_request_page (BrowseCache *cache,
+                     const gchar *after)
+{
+    LmMessage     *m;
+    LmMessageNode *node;
+    gchar         *max;
+
+    m = lm_message_new_with_sub_type (cache->server,
+                                      LM_MESSAGE_TYPE_IQ,
+                                      LM_MESSAGE_SUB_TYPE_GET);
+
+    node = lm_message_node_add_child (m->node, "query", NULL);
+    lm_message_node_set_attribute (node, "xmlns", XMPP_DISCO_ITEMS_XMLNS);
+
+    node = lm_message_node_add_child (node, "set", NULL);
+    lm_message_node_set_attribute (node, "xmlns", XMPP_RSM_XMLNS);
 
-        list = g_list_prepend (list, chatroom);
-        data->data3 = list;
+    max = g_strdup_printf ("%d", BROWSE_PAGE_SIZE);
+    lm_message_node_add_child (node, "max", max);
+    g_free (max);
+
+    if (after) {
+        lm_message_node_add_child (node, "after", after);
     }
 
-    if (last_item) {
-        GossipChatroomBrowseCb callback;
-                
-        callback = data->callback;
-        (callback)(GOSSIP_CHATROOM_PROVIDER (chatrooms->jabber),
-                   server, list, error, data->user_data);
+    if (cache->handler) {
+        lm_message_handler_unref (cache->handler);
+    }
 
-        g_list_foreach (list, (GFunc) g_object_unref, NULL);
-        g_list_free (list);
+    cache->handler = lm_message_handler_new ((LmHandleMessageFunction) browse_page_cb,
+                                             cache, NULL);
 
-        g_free (server);
+    if (!gossip_jabber_cork_send_with_reply (cache->chatrooms->connection, m,
+                                             cache->handler, NULL)) {
+        GError *error;
+
+        lm_message_unref (m);
+
+        error = gossip_jabber_error_create (GOSSIP_JABBER_NO_CONNECTION,
+                                            gossip_jabber_error_to_string (GOSSIP_JABBER_NO_CONNECTION));
+        browse_finish (cache, NULL, error);
+        g_error_free (error);
 
-        gossip_callback_data_free (data);
+        return;
     }
+
+    lm_message_unref (m);
+
+    cache->timeout_id = g_timeout_add_seconds (BROWSE_TIMEOUT,
+                                               (GSourceFunc) browse_timeout_cb,
+                                               cache);
 }
 
+/* Rooms are listed a page at a time as the server sends them, and kept
+ * for BROWSE_CACHE_TTL so opening the list again doesn't ask again
+ * unless refresh is set. Room details are only asked for when they are
+ * wanted, see gossip_jabber_chatrooms_update_room_info().
+ */
 void
 gossip_jabber_chatrooms_browse_rooms (GossipJabberChatrooms  *chatrooms,
                                       const gchar            *server,
+                                      gboolean                refresh,
                                       GossipChatroomBrowseCb  callback,
                                       gpointer                user_data)
 {
-    GossipJabberDisco  *disco;
+    BrowseCache        *cache;
     GossipCallbackData *data;
-        
-    data = gossip_callback_data_new (callback, 
-                                     user_data, 
-                                     chatrooms, 
-                                     g_strdup (server), 
-                                     NULL);
-        
-    disco = gossip_jabber_disco_request (chatrooms->jabber,
-                                         server,
-                                         (GossipJabberDiscoItemFunc) 
-                                         jabber_chatrooms_browse_rooms_cb,
-                                         data);
+
+    g_return_if_fail (chatrooms != NULL);
+    g_return_if_fail (server != NULL);
+    g_return_if_fail (callback != NULL);
+
+    cache = g_hash_table_lookup (chatrooms->browse_caches, server);
+
+    if (cache && cache->complete && !refresh &&
+        gossip_time_get_current () - cache->fetched < BROWSE_CACHE_TTL) {
+        gossip_debug (DEBUG_DOMAIN,
+                      "Using %d cached rooms for:'%s'",
+                      g_list_length (cache->rooms), server);
+
+        (callback) (GOSSIP_CHATROOM_PROVIDER (chatrooms->jabber),
+                    server, cache->rooms, TRUE, NULL, user_data);
+        return;
+    }
+
+    /* Already browsing, catch up and get the rest as it comes */
+    if (cache && cache->handler) {
+        GList *l;
+
+        if (cache->rooms) {
+            (callback) (GOSSIP_CHATROOM_PROVIDER (chatrooms->jabber),
+                        server, cache->rooms, FALSE, NULL, user_data);
+        }
+
+        for (l = cache->waiters; l; l = l->next) {
+            data = l->data;
+
+            if (data->callback == (gpointer) callback && data->user_data == user_data) {
+                return;
+            }
+        }
+
+        data = gossip_callback_data_new (callback, user_data, NULL, NULL, NULL);
+        cache->waiters = g_list_append (cache->waiters, data);
+        return;
+    }
+
+    data = gossip_callback_data_new (callback, user_data, NULL, NULL, NULL);
+
+    if (!cache) {
+        cache = g_slice_new0 (BrowseCache);
+        cache->chatrooms = chatrooms;
+        cache->server = g_strdup (server);
+        cache->info_requested = g_hash_table_new_full (g_direct_hash,
+                                                       g_direct_equal,
+                                                       (GDestroyNotify) g_object_unref,
+                                                       NULL);
+
+        g_hash_table_insert (chatrooms->browse_caches, cache->server, cache);
+    } else {
+        browse_cache_reset (cache);
+    }
+
+    cache->waiters = g_list_append (cache->waiters, data);
+
+    browse_request_page (cache, NULL);
+}
+
+static LmHandlerResult
+room_info_cb (LmMessageHandler *handler,
+              LmConnection     *connection,
+              LmMessage        *m,
+              GossipChatroom   *chatroom)
+{
+    GossipChatroomFeature  features = 0;
+    LmMessageNode         *query;
+    LmMessageNode         *node;
+
+    if (lm_message_get_sub_type (m) != LM_MESSAGE_SUB_TYPE_RESULT) {
+        return LM_HANDLER_RESULT_REMOVE_MESSAGE;
+    }
+
+    query = lm_message_node_get_child (m->node, "query");
+    if (!query) {
+        return LM_HANDLER_RESULT_REMOVE_MESSAGE;
+    }
+
+    for (node = query->children; node; node = node->next) {
+        const gchar *var;
+        gint         i;
+
+        if (strcmp (node->name, "feature") != 0) {
+            continue;
+        }
+
+        var = lm_message_node_get_attribute (node, "var");
+        if (!var) {
+            continue;
+        }
+
+        for (i = 0; i < G_N_ELEMENTS (room_features); i++) {
+            if (strcmp (var, room_features[i].var) == 0) {
+                features |= room_features[i].feature;
+                break;
+            }
+        }
+    }
+
+    gossip_chatroom_set_features (chatroom, features);
+
+    /* Get the MUC specific data */
+    node = lm_message_node_get_child (query, "x");
+    if (node) {
+        node = node->children;
+
+        while (node) {
+            if (node->name && strcmp (node->name, "field") == 0) {
+                const gchar *var;
+                const gchar *val;
+
+                var = lm_message_node_get_attribute (node, "var");
+                val = lm_message_node_get_value (node->children);
+
+                if (var && val) {
+                    if (strcmp (var, "muc#roominfo_description") == 0) {
+                        gossip_chatroom_set_description (chatroom, val);
+                    } 
+                    else if (strcmp (var, "muc#roominfo_subject") == 0) {
+                        gossip_chatroom_set_subject (chatroom, val);
+                    }
+                    else if (strcmp (var, "muc#roominfo_occupants") == 0) {
+                        gossip_chatroom_set_occupants (chatroom, atoi (val));
+                    }
+                }
+            }
+
+            node = node->next;
+        }
+    }
+
+    return LM_HANDLER_RESULT_REMOVE_MESSAGE;
+}
+
+/* Asks for the features, description and number of occupants of a room
+ * found browsing, once for as long as the browsed rooms are cached. The
+ * chatroom is updated when the answer comes.
+ */
+void
+gossip_jabber_chatrooms_update_room_info (GossipJabberChatrooms *chatrooms,
+                                          GossipChatroom        *chatroom)
+{
+    BrowseCache      *cache;
+    LmMessage        *m;
+    LmMessageNode    *node;
+    LmMessageHandler *handler;
+
+    g_return_if_fail (chatrooms != NULL);
+    g_return_if_fail (GOSSIP_IS_CHATROOM (chatroom));
+
+    cache = g_hash_table_lookup (chatrooms->browse_caches,
+                                 gossip_chatroom_get_server (chatroom));
+    if (cache) {
+        if (g_hash_table_lookup (cache->info_requested, chatroom)) {
+            return;
+        }
+
+        g_hash_table_insert (cache->info_requested,
+                             g_object_ref (chatroom),
+                             GINT_TO_POINTER (1));
+    }
+
+    m = lm_message_new_with_sub_type (gossip_chatroom_get_id_str (chatroom),
+                                      LM_MESSAGE_TYPE_IQ,
+                                      LM_MESSAGE_SUB_TYPE_GET);
+
+    node = lm_message_node_add_child (m->node, "query", NULL);
+    lm_message_node_set_attribute (node, "xmlns", XMPP_DISCO_INFO_XMLNS);
+
+    handler = lm_message_handler_new ((LmHandleMessageFunction) room_info_cb,
+                                      g_object_ref (chatroom),
+                                      (GDestroyNotify) g_object_unref);
+
+    gossip_jabber_cork_send_with_reply (chatrooms->connection, m, handler, NULL);
+
+    lm_message_unref (m);
+    lm_message_handler_unref (handler);
 }
 
 static void
@@ -1815,7 +2265,9 @@ jabber_chatrooms_set_presence_foreach (gpointer key,
         lm_message_node_add_child (m->node, "status", status);
     }
 
-    lm_connection_send (connection, m, NULL);
+    gossip_jabber_caps_add_to_presence (m);
+
+    gossip_jabber_cork_send (connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -1836,24 +2288,76 @@ gossip_jabber_chatrooms_set_presence (GossipJabberChatrooms  *chatrooms,
                           chatrooms);
 }
 
-gboolean
-gossip_jabber_chatrooms_get_jid_is_chatroom (GossipJabberChatrooms *chatrooms,
-                                             const gchar           *jid_str)
+/* Finds the room a stanza from jid_str is for without allocating
+ * anything, resource is set to the nick in it if there is one.
+ */
+GossipChatroom *
+gossip_jabber_chatrooms_find_by_jid (GossipJabberChatrooms  *chatrooms,
+                                     const gchar            *jid_str,
+                                     const gchar           **resource)
 {
-    GossipJID *jid;
-    gboolean   ret_val = FALSE;
+    GossipChatroom *chatroom;
+    RouteKey        key;
+    const gchar    *slash;
+    gchar          *folded = NULL;
+    gsize           i;
 
-    if (!chatrooms->chatrooms_by_jid) {
-        return FALSE;
+    g_return_val_if_fail (chatrooms != NULL, NULL);
+
+    if (resource) {
+        *resource = NULL;
     }
 
-    jid = gossip_jid_new (jid_str);
+    if (!jid_str || !chatrooms->chatrooms_by_jid) {
+        return NULL;
+    }
+
+    slash = strchr (jid_str, '/');
 
-    if (g_hash_table_lookup (chatrooms->chatrooms_by_jid, jid)) {
-        ret_val = TRUE;
+    key.str = jid_str;
+    key.len = slash ? slash - jid_str : strlen (jid_str);
+
+    /* ASCII nodes compare the same as they fold, anything else
+     * has to be folded first.
+     */
+    for (i = 0; i < key.len && jid_str[i] != '@'; i++) {
+        if (jid_str[i] & 0x80) {
+            folded = route_fold (jid_str, key.len);
+            key.str = folded;
+            key.len = strlen (folded);
+            break;
+        }
     }
 
-    g_object_unref (jid);
+    chatroom = g_hash_table_lookup (chatrooms->chatrooms_by_jid, &key);
+    g_free (folded);
+
+    if (chatroom && resource && slash) {
+        *resource = slash + 1;
+    }
+
+    return chatroom;
+}
+
+GossipContact *
+gossip_jabber_chatrooms_get_occupant (GossipJabberChatrooms *chatrooms,
+                                      const gchar           *jid_str)
+{
+    GossipChatroom *chatroom;
+    const gchar    *nick;
 
-    return ret_val;
+    chatroom = gossip_jabber_chatrooms_find_by_jid (chatrooms, jid_str, &nick);
+
+    if (!chatroom || G_STR_EMPTY (nick)) {
+        return NULL;
+    }
+
+    return gossip_chatroom_get_occupant (chatroom, nick);
+}
+
+gboolean
+gossip_jabber_chatrooms_get_jid_is_chatroom (GossipJabberChatrooms *chatrooms,
+                                             const gchar           *jid_str)
+{
+    return gossip_jabber_chatrooms_find_by_jid (chatrooms, jid_str, NULL) != NULL;
 }
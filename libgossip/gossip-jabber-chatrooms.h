@@ -80,11 +80,20 @@ void           gossip_jabber_chatrooms_invite_decline      (GossipJabberChatroom
 GList *        gossip_jabber_chatrooms_get_rooms           (GossipJabberChatrooms *chatrooms);
 void           gossip_jabber_chatrooms_browse_rooms        (GossipJabberChatrooms  *chatrooms,
                                                             const gchar            *server,
+                                                            gboolean                refresh,
                                                             GossipChatroomBrowseCb  callback,
                                                             gpointer                user_data);
+void           gossip_jabber_chatrooms_update_room_info    (GossipJabberChatrooms  *chatrooms,
+                                                            GossipChatroom         *chatroom);
 
 void           gossip_jabber_chatrooms_set_presence        (GossipJabberChatrooms *chatrooms,
                                                             GossipPresence        *presence);
+GossipChatroom *
+gossip_jabber_chatrooms_find_by_jid         (GossipJabberChatrooms  *chatrooms,
+                                             const gchar            *jid_str,
+                                             const gchar           **resource);
+GossipContact *gossip_jabber_chatrooms_get_occupant        (GossipJabberChatrooms *chatrooms,
+                                                            const gchar           *jid_str);
 gboolean       gossip_jabber_chatrooms_get_jid_is_chatroom (GossipJabberChatrooms *chatrooms,
                                                             const gchar           *jid_str);
 
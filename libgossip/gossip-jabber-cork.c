@@ -0,0 +1,349 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * Copyright (C) 2007 Imendio AB
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Holds back outgoing stanzas so the bursts we send after logging in
+ * or changing presence in a lot of rooms go out in one write, and in
+ * one TLS record, instead of one each. What is held back is written
+ * once the main loop has nothing more urgent to do, or when enough
+ * has piled up, or when it has waited too long.
+ *
+ * Loudmouth only writes what it is given, so the stanzas are
+ * serialized here and sent raw. Anything sent with a reply handler
+ * goes straight to Loudmouth, after what is held back, so the order
+ * on the wire is the order things were sent in.
+ */
+
+#include <config.h>
+
+#include "gossip-debug.h"
+
+#include "gossip-jabber-cork.h"
+
+#define DEBUG_DOMAIN "JabberCork"
+
+/* Stays well inside one TLS record */
+#define CORK_MAX_BYTES 8192
+
+/* Milliseconds the first stanza held back may wait */
+#define CORK_MAX_DELAY 50
+
+struct _GossipJabberCork {
+    LmConnection *connection;
+    GTimer       *timer;
+
+    GString      *buf;
+    guint         n_queued;
+    gdouble       first_queued;
+    gdouble       queued_sum;    /* When each one held back was sent */
+
+    guint         idle_id;
+    guint         timeout_id;
+
+    /* Writing what was held back failed with nobody to tell */
+    GError       *error;
+
+    /* Statistics */
+    guint         n_stanzas;
+    guint         n_writes;
+    gdouble       latency_sum;
+    gdouble       latency_max;
+};
+
+static GossipJabberCork *cork_lookup     (LmConnection      *connection);
+static gboolean          cork_flush      (GossipJabberCork  *cork,
+                                          GError           **error);
+static gboolean          cork_flush_cb   (GossipJabberCork  *cork);
+
+/* LmConnection -> GossipJabberCork */
+static GHashTable *corks = NULL;
+
+GossipJabberCork *
+gossip_jabber_cork_new (LmConnection *connection)
+{
+    GossipJabberCork *cork;
+
+    g_return_val_if_fail (connection != NULL, NULL);
+
+    if (!corks) {
+        corks = g_hash_table_new (g_direct_hash, g_direct_equal);
+    }
+
+    cork = g_slice_new0 (GossipJabberCork);
+
+    cork->connection = lm_connection_ref (connection);
+    cork->timer = g_timer_new ();
+    cork->buf = g_string_sized_new (CORK_MAX_BYTES);
+
+    g_hash_table_insert (corks, connection, cork);
+
+    return cork;
+}
+
+void
+gossip_jabber_cork_free (GossipJabberCork *cork)
+{
+    if (!cork) {
+        return;
+    }
+
+    if (cork->idle_id) {
+        g_source_remove (cork->idle_id);
+    }
+
+    if (cork->timeout_id) {
+        g_source_remove (cork->timeout_id);
+    }
+
+    g_hash_table_remove (corks, cork->connection);
+
+    g_clear_error (&cork->error);
+    g_string_free (cork->buf, TRUE);
+    g_timer_destroy (cork->timer);
+    lm_connection_unref (cork->connection);
+
+    g_slice_free (GossipJabberCork, cork);
+}
+
+/* Used like lm_connection_send(). Once logged in, errors writing
+ * what is held back are seen by whoever sends next, whether or not
+ * what they send is held back.
+ */
+gboolean
+gossip_jabber_cork_send (LmConnection  *connection,
+                         LmMessage     *m,
+                         GError       **error)
+{
+    GossipJabberCork *cork;
+    GError           *pending;
+    gchar            *str;
+    gdouble           now;
+    gboolean          result = TRUE;
+
+    g_return_val_if_fail (connection != NULL, FALSE);
+    g_return_val_if_fail (m != NULL, FALSE);
+
+    cork = cork_lookup (connection);
+    if (!cork) {
+        return lm_connection_send (connection, m, error);
+    }
+
+    /* Loudmouth has to see the stream being set up itself */
+    if (!lm_connection_is_authenticated (connection)) {
+        cork_flush (cork, NULL);
+        return lm_connection_send (connection, m, error);
+    }
+
+    pending = cork->error;
+    cork->error = NULL;
+
+    str = lm_message_node_to_string (m->node);
+    now = g_timer_elapsed (cork->timer, NULL);
+
+    if (cork->n_queued == 0) {
+        cork->first_queued = now;
+    }
+
+    g_string_append (cork->buf, str);
+    cork->n_queued++;
+    cork->queued_sum += now;
+
+    g_free (str);
+
+    if (cork->buf->len >= CORK_MAX_BYTES) {
+        result = cork_flush (cork, pending ? NULL : error);
+    } else {
+        /* After whatever else came in during this iteration, but
+         * before redrawing.
+         */
+        if (!cork->idle_id) {
+            cork->idle_id = g_idle_add_full (G_PRIORITY_HIGH_IDLE,
+                                             (GSourceFunc) cork_flush_cb,
+                                             cork, NULL);
+        }
+
+        if (!cork->timeout_id) {
+            cork->timeout_id = g_timeout_add (CORK_MAX_DELAY,
+                                              (GSourceFunc) cork_flush_cb,
+                                              cork);
+        }
+    }
+
+    if (pending) {
+        g_propagate_error (error, pending);
+        return FALSE;
+    }
+
+    return result;
+}
+
+gboolean
+gossip_jabber_cork_send_with_reply (LmConnection      *connection,
+                                    LmMessage         *m,
+                                    LmMessageHandler  *handler,
+                                    GError           **error)
+{
+    GossipJabberCork *cork;
+
+    g_return_val_if_fail (connection != NULL, FALSE);
+
+    cork = cork_lookup (connection);
+    if (cork) {
+        cork_flush (cork, NULL);
+    }
+
+    return lm_connection_send_with_reply (connection, m, handler, error);
+}
+
+/* Writes out what is held back now, used before closing */
+void
+gossip_jabber_cork_flush (LmConnection *connection)
+{
+    GossipJabberCork *cork;
+
+    g_return_if_fail (connection != NULL);
+
+    cork = cork_lookup (connection);
+    if (cork) {
+        cork_flush (cork, NULL);
+    }
+}
+
+/* Starts the statistics over, for each new session */
+void
+gossip_jabber_cork_reset_stats (GossipJabberCork *cork)
+{
+    g_return_if_fail (cork != NULL);
+
+    cork->n_stanzas = 0;
+    cork->n_writes = 0;
+    cork->latency_sum = 0;
+    cork->latency_max = 0;
+
+    g_clear_error (&cork->error);
+}
+
+/* Latencies are in milliseconds and only count what was held back */
+void
+gossip_jabber_cork_get_stats (GossipJabberCork *cork,
+                              guint            *stanzas,
+                              guint            *writes_saved,
+                              gdouble          *latency_avg,
+                              gdouble          *latency_max)
+{
+    g_return_if_fail (cork != NULL);
+
+    if (stanzas) {
+        *stanzas = cork->n_stanzas;
+    }
+
+    if (writes_saved) {
+        *writes_saved = cork->n_stanzas - cork->n_writes;
+    }
+
+    if (latency_avg) {
+        if (cork->n_stanzas > 0) {
+            *latency_avg = cork->latency_sum * 1000 / cork->n_stanzas;
+        } else {
+            *latency_avg = 0;
+        }
+    }
+
+    if (latency_max) {
+        *latency_max = cork->latency_max * 1000;
+    }
+}
+
+static GossipJabberCork *
+cork_lookup (LmConnection *connection)
+{
+    if (!corks) {
+        return NULL;
+    }
+
+    return g_hash_table_lookup (corks, connection);
+}
+
+static gboolean
+cork_flush (GossipJabberCork  *cork,
+            GError           **error)
+{
+    gboolean result;
+    gdouble  now;
+
+    if (cork->idle_id) {
+        g_source_remove (cork->idle_id);
+        cork->idle_id = 0;
+    }
+
+    if (cork->timeout_id) {
+        g_source_remove (cork->timeout_id);
+        cork->timeout_id = 0;
+    }
+
+    if (cork->n_queued == 0) {
+        return TRUE;
+    }
+
+    /* The connection went away before we got to it, what is held
+     * back was for that session and must not go out on the next.
+     */
+    if (!lm_connection_is_authenticated (cork->connection)) {
+        gossip_debug (DEBUG_DOMAIN,
+                      "Dropping %d stanzas held back for closed connection",
+                      cork->n_queued);
+        result = TRUE;
+    } else {
+        now = g_timer_elapsed (cork->timer, NULL);
+
+        cork->n_stanzas += cork->n_queued;
+        cork->n_writes++;
+        cork->latency_sum += cork->n_queued * now - cork->queued_sum;
+        cork->latency_max = MAX (cork->latency_max, now - cork->first_queued);
+
+        result = lm_connection_send_raw (cork->connection, cork->buf->str, error);
+    }
+
+    g_string_truncate (cork->buf, 0);
+    cork->n_queued = 0;
+    cork->queued_sum = 0;
+
+    return result;
+}
+
+static gboolean
+cork_flush_cb (GossipJabberCork *cork)
+{
+    GError *error = NULL;
+
+    if (!cork_flush (cork, &error)) {
+        g_warning ("Could not write stanzas held back: %s",
+                   error ? error->message : "no error given");
+
+        /* Whoever sends next gets to know */
+        if (error) {
+            g_clear_error (&cork->error);
+            cork->error = error;
+        }
+    }
+
+    /* Both sources were removed when flushing */
+    return FALSE;
+}
@@ -0,0 +1,50 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * Copyright (C) 2007 Imendio AB
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GOSSIP_JABBER_CORK_H__
+#define __GOSSIP_JABBER_CORK_H__
+
+#include <glib.h>
+#include <loudmouth/loudmouth.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GossipJabberCork GossipJabberCork;
+
+GossipJabberCork *gossip_jabber_cork_new             (LmConnection      *connection);
+void              gossip_jabber_cork_free            (GossipJabberCork  *cork);
+gboolean          gossip_jabber_cork_send            (LmConnection      *connection,
+                                                      LmMessage         *m,
+                                                      GError           **error);
+gboolean          gossip_jabber_cork_send_with_reply (LmConnection      *connection,
+                                                      LmMessage         *m,
+                                                      LmMessageHandler  *handler,
+                                                      GError           **error);
+void              gossip_jabber_cork_flush           (LmConnection      *connection);
+void              gossip_jabber_cork_reset_stats     (GossipJabberCork  *cork);
+void              gossip_jabber_cork_get_stats       (GossipJabberCork  *cork,
+                                                      guint             *stanzas,
+                                                      guint             *writes_saved,
+                                                      gdouble           *latency_avg,
+                                                      gdouble           *latency_max);
+
+G_END_DECLS
+
+#endif /* __GOSSIP_JABBER_CORK_H__ */
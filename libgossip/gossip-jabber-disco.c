@@ -30,7 +30,7 @@
 #include <libgossip/gossip-ft.h>
 #include <libgossip/gossip-utils.h>
 
-#include "gossip-jabber-ns.h"
+#include "gossip-jabber-caps.h"
 #include "gossip-jabber-private.h"
 #include "gossip-jabber-disco.h"
 
@@ -40,11 +40,6 @@
 #define XMPP_DISCO_ITEMS_XMLNS          "http://jabber.org/protocol/disco#items"
 #define XMPP_DISCO_INFO_XMLNS           "http://jabber.org/protocol/disco#info"
 
-#define XMPP_SI_FEATURE                 "http://jabber.org/protocol/si"
-#define XMPP_FILE_TRANSFER_FEATURE      "http://jabber.org/protocol/si/profile/file-transfer"
-#define XMPP_BYTESTREAMS_FEATURE        "http://jabber.org/protocol/bytestreams"
-#define XMPP_MUC_FEATURE                "http://jabber.org/protocol/muc"
-
 /* In seconds */
 #define DISCO_TIMEOUT      20
 #define DISCO_INFO_TIMEOUT 15
@@ -128,13 +123,14 @@ static gboolean           jabber_disco_request_items_timeout_cb (GossipJabberDis
 static void               jabber_disco_handle_items             (GossipJabberDisco     *disco,
                                                                  LmMessage             *m,
                                                                  gpointer               user_data);
+static gboolean           jabber_disco_info_from_caps           (GossipJabberDisco     *disco,
+                                                                 GossipJabberDiscoItem *item);
+static gboolean           jabber_disco_info_from_caps_cb        (GossipJabberDiscoItem *item);
 static void               jabber_disco_request_info             (GossipJabberDisco     *disco);
 static void               jabber_disco_handle_info              (GossipJabberDisco     *disco,
                                                                  LmMessage             *m,
                                                                  gpointer               user_data);
-static LmHandlerResult    jabber_disco_info_handler             (LmMessageHandler      *handler,
-                                                                 LmConnection          *conn,
-                                                                 LmMessage             *m,
+static LmHandlerResult    jabber_disco_info_handler             (GossipJabberStanza    *stanza,
                                                                  GossipJabber          *jabber);
 
 
@@ -447,7 +443,7 @@ jabber_disco_request_items (GossipJabberDisco *disco)
 
     lm_message_node_set_attribute (node, "xmlns", XMPP_DISCO_ITEMS_XMLNS);
 
-    lm_connection_send (connection, m, NULL);
+    gossip_jabber_cork_send (connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -551,6 +547,97 @@ jabber_disco_handle_items (GossipJabberDisco *disco,
     }
 }
 
+/* Fills in the item's info from what its entity capabilities say,
+ * if we know them, so there is no need to ask.
+ */
+static gboolean
+jabber_disco_info_from_caps (GossipJabberDisco     *disco,
+                             GossipJabberDiscoItem *item)
+{
+    GossipJabberCaps *caps;
+    JabberDiscoInfo  *info;
+    gchar           **identities;
+    gchar           **features;
+    gint              i;
+
+    caps = _gossip_jabber_get_caps (disco->jabber);
+    if (!caps) {
+        return FALSE;
+    }
+
+    if (!gossip_jabber_caps_get_info (caps, gossip_jid_get_full (item->jid),
+                                      &identities, &features)) {
+        return FALSE;
+    }
+
+    info = g_slice_new0 (JabberDiscoInfo);
+
+    for (i = 0; identities[i]; i++) {
+        JabberDiscoIdentity  *ident;
+        gchar               **parts;
+
+        /* category/type/lang/name, the name may have slashes */
+        parts = g_strsplit (identities[i], "/", 4);
+        if (g_strv_length (parts) < 4) {
+            g_strfreev (parts);
+            continue;
+        }
+
+        ident = g_slice_new0 (JabberDiscoIdentity);
+        ident->category = g_strdup (parts[0]);
+        ident->type = g_strdup (parts[1]);
+        ident->name = g_strdup (parts[3]);
+
+        info->identities = g_list_append (info->identities, ident);
+
+        g_strfreev (parts);
+    }
+
+    for (i = 0; features[i]; i++) {
+        info->features = g_list_append (info->features, g_strdup (features[i]));
+    }
+
+    item->info = info;
+
+    gossip_debug (DEBUG_DOMAIN, 
+                  "disco info for:'%s' known from caps", 
+                  gossip_jid_get_full (item->jid));
+
+    return TRUE;
+}
+
+static gboolean
+jabber_disco_info_from_caps_cb (GossipJabberDiscoItem *item)
+{
+    GossipJabberDisco *disco;
+
+    item->timeout_id = 0;
+
+    disco = g_hash_table_find (discos, (GHRFunc)jabber_disco_find_item_func, item);
+    if (!disco) {
+        return FALSE;
+    }
+
+    if (!disco->item_lookup) {
+        disco->items_remaining--;
+    }
+
+    if (disco->item_func) {
+        (disco->item_func) (disco,
+                            item,
+                            disco->items_remaining < 1 ? TRUE : FALSE,
+                            FALSE,
+                            NULL,
+                            disco->user_data);
+    }
+
+    if (!disco->item_lookup && disco->items_remaining < 1) {
+        gossip_jabber_disco_destroy (disco);
+    }
+
+    return FALSE;
+}
+
 static void
 jabber_disco_request_info (GossipJabberDisco *disco)
 {
@@ -583,6 +670,15 @@ jabber_disco_request_info (GossipJabberDisco *disco)
             continue;
         }
 
+        /* Answer from the caps cache, but still later like a
+         * reply would be.
+         */
+        if (jabber_disco_info_from_caps (disco, item)) {
+            item->timeout_id = g_idle_add ((GSourceFunc) jabber_disco_info_from_caps_cb,
+                                           item);
+            continue;
+        }
+
         /* Create message */
         m = lm_message_new_with_sub_type (gossip_jid_get_full (item->jid),
                                           LM_MESSAGE_TYPE_IQ,
@@ -603,7 +699,7 @@ jabber_disco_request_info (GossipJabberDisco *disco)
 
         lm_message_node_set_attribute (node, "xmlns", XMPP_DISCO_INFO_XMLNS);
 
-        lm_connection_send (connection, m, NULL);
+        gossip_jabber_cork_send (connection, m, NULL);
         lm_message_unref (m);
     }
 
@@ -724,66 +820,39 @@ jabber_disco_handle_info (GossipJabberDisco *disco,
     }
 }
 
+/* Only subscribed to disco#info */
 static LmHandlerResult
-jabber_disco_info_handler (LmMessageHandler *handler,
-                           LmConnection     *connection,
-                           LmMessage        *request_message,
-                           GossipJabber     *jabber)
+jabber_disco_info_handler (GossipJabberStanza *stanza,
+                           GossipJabber       *jabber)
 {
-    LmMessageSubType  subtype;
+    LmConnection     *connection;
     LmMessage        *m;
-    LmMessageNode    *node;
     LmMessageNode    *q_node;
-    const gchar      *xmlns;
-    const gchar      *to_str;
-    const gchar      *id_str;
+    const gchar      *node_str;
 
-    subtype = lm_message_get_sub_type (request_message);
-    if (subtype != LM_MESSAGE_SUB_TYPE_GET) {
+    if (stanza->sub_type != LM_MESSAGE_SUB_TYPE_GET) {
         return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
     }
 
-    node = lm_message_node_get_child (request_message->node, "query");
-    if(!node) {
-        return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
-    }
+    /* Asked about our caps node, which is the same as asking us */
+    node_str = lm_message_node_get_attribute (stanza->node, "node");
 
-    xmlns = lm_message_node_get_attribute (node, "xmlns");
-    if(!xmlns || strcmp (xmlns, XMPP_DISCO_INFO_XMLNS) != 0) {
-        return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
-    }
-
-    to_str = lm_message_node_get_attribute (request_message->node, "from");
-    id_str = lm_message_node_get_attribute (request_message->node, "id");
-
-    m = lm_message_new_with_sub_type (to_str,
+    m = lm_message_new_with_sub_type (stanza->from,
                                       LM_MESSAGE_TYPE_IQ,
                                       LM_MESSAGE_SUB_TYPE_RESULT);
 
-    lm_message_node_set_attribute (m->node, "id", id_str);
+    lm_message_node_set_attribute (m->node, "id", stanza->id);
     q_node = lm_message_node_add_child (m->node, "query", NULL);
 
     lm_message_node_set_attribute (q_node, "xmlns", XMPP_DISCO_INFO_XMLNS);
-    node = lm_message_node_add_child (q_node, "identity", NULL);
-
-    lm_message_node_set_attribute (node, "category", "client");
-    lm_message_node_set_attribute (node, "type", "pc");
-    lm_message_node_set_attribute (node, "name", PACKAGE_STRING);
-
-    node = lm_message_node_add_child (q_node, "feature", NULL);
-    lm_message_node_set_attribute (node, "var", XMPP_DISCO_INFO_XMLNS);
-    node = lm_message_node_add_child (q_node, "feature", NULL);
-    lm_message_node_set_attribute (node, "var", XMPP_SI_FEATURE);
-    node = lm_message_node_add_child (q_node, "feature", NULL);
-    lm_message_node_set_attribute (node, "var", XMPP_FILE_TRANSFER_FEATURE);
-    node = lm_message_node_add_child (q_node, "feature", NULL);
-    lm_message_node_set_attribute (node, "var", XMPP_BYTESTREAMS_FEATURE);
-    node = lm_message_node_add_child (q_node, "feature", NULL);
-    lm_message_node_set_attribute (node, "var", XMPP_MUC_FEATURE);
-    node = lm_message_node_add_child (q_node, "feature", NULL);
-    lm_message_node_set_attribute (node, "var", XMPP_PING_XMLNS);
-
-    lm_connection_send (connection, m, NULL);
+    if (node_str) {
+        lm_message_node_set_attribute (q_node, "node", node_str);
+    }
+
+    gossip_jabber_caps_add_own_info (q_node);
+
+    connection = _gossip_jabber_get_connection (jabber);
+    gossip_jabber_cork_send (connection, m, NULL);
     lm_message_unref (m);
 
     return LM_HANDLER_RESULT_REMOVE_MESSAGE;
@@ -1257,17 +1326,11 @@ gossip_jabber_disco_item_has_feature (GossipJabberDiscoItem *item,
 void
 gossip_jabber_disco_init (GossipJabber *jabber) 
 {
-    LmConnection     *connection;
-    LmMessageHandler *handler;
-
     g_return_if_fail (GOSSIP_IS_JABBER (jabber));
 
-    connection = _gossip_jabber_get_connection (jabber);
-    handler = lm_message_handler_new ((LmHandleMessageFunction) jabber_disco_info_handler,
-                                      jabber, NULL);
-    lm_connection_register_message_handler (connection,
-                                            handler,
-                                            LM_MESSAGE_TYPE_IQ,
-                                            LM_HANDLER_PRIORITY_NORMAL);
-    lm_message_handler_unref (handler);
+    gossip_jabber_dispatch_add (_gossip_jabber_get_dispatch (jabber),
+                                LM_MESSAGE_TYPE_IQ, XMPP_DISCO_INFO_XMLNS,
+                                LM_HANDLER_PRIORITY_NORMAL,
+                                (GossipJabberStanzaFunc) jabber_disco_info_handler,
+                                jabber);
 }
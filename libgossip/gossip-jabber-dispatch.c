@@ -0,0 +1,393 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * Copyright (C) 2007 Imendio AB
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * One Loudmouth handler per stanza type for everything that listens
+ * for as long as the connection is up. The envelope is read once and
+ * the stanza goes to those who subscribed to the namespace of its
+ * payload and those who want every stanza of its type, in order of
+ * priority and then in the order they subscribed, like Loudmouth
+ * would. A subscriber returning LM_HANDLER_RESULT_REMOVE_MESSAGE
+ * stops it there and for the Loudmouth handlers after us too.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include "gossip-jabber-dispatch.h"
+
+enum {
+    DISPATCH_MESSAGE,
+    DISPATCH_PRESENCE,
+    DISPATCH_IQ,
+    DISPATCH_N_TYPES
+};
+
+typedef struct {
+    guint                   id;
+    gint                    table;
+    GQuark                  xmlns;     /* 0 for every stanza of the type */
+    LmHandlerPriority       priority;
+    GossipJabberStanzaFunc  func;
+    gpointer                user_data;
+} Subscriber;
+
+typedef struct {
+    LmMessageHandler *handler;
+    GList            *any;
+    GHashTable       *by_xmlns;        /* GQuark to GList of Subscriber */
+} DispatchTable;
+
+struct _GossipJabberDispatch {
+    LmConnection  *connection;
+    DispatchTable  tables[DISPATCH_N_TYPES];
+    GHashTable    *subscribers;
+    guint          last_id;
+};
+
+static const LmMessageType dispatch_types[DISPATCH_N_TYPES] = {
+    LM_MESSAGE_TYPE_MESSAGE,
+    LM_MESSAGE_TYPE_PRESENCE,
+    LM_MESSAGE_TYPE_IQ
+};
+
+static gint            dispatch_table_index     (LmMessageType         type);
+static gint            dispatch_subscriber_cmp  (gconstpointer         a,
+                                                 gconstpointer         b);
+static void            dispatch_subscriber_free (Subscriber           *sub);
+static void            dispatch_parse           (GossipJabberStanza   *stanza,
+                                                 LmMessage            *m);
+static LmHandlerResult dispatch_handler         (LmMessageHandler     *handler,
+                                                 LmConnection         *connection,
+                                                 LmMessage            *m,
+                                                 GossipJabberDispatch *dispatch);
+
+GossipJabberDispatch *
+gossip_jabber_dispatch_new (LmConnection *connection)
+{
+    GossipJabberDispatch *dispatch;
+    gint                  i;
+
+    g_return_val_if_fail (connection != NULL, NULL);
+
+    dispatch = g_slice_new0 (GossipJabberDispatch);
+
+    dispatch->connection = lm_connection_ref (connection);
+    dispatch->subscribers =
+        g_hash_table_new_full (g_direct_hash,
+                               g_direct_equal,
+                               NULL,
+                               (GDestroyNotify) dispatch_subscriber_free);
+
+    for (i = 0; i < DISPATCH_N_TYPES; i++) {
+        DispatchTable *table;
+
+        table = &dispatch->tables[i];
+        table->by_xmlns = g_hash_table_new (g_direct_hash, g_direct_equal);
+        table->handler = lm_message_handler_new ((LmHandleMessageFunction) dispatch_handler,
+                                                 dispatch,
+                                                 NULL);
+
+        lm_connection_register_message_handler (connection,
+                                                table->handler,
+                                                dispatch_types[i],
+                                                LM_HANDLER_PRIORITY_NORMAL);
+    }
+
+    return dispatch;
+}
+
+void
+gossip_jabber_dispatch_free (GossipJabberDispatch *dispatch)
+{
+    gint i;
+
+    if (!dispatch) {
+        return;
+    }
+
+    for (i = 0; i < DISPATCH_N_TYPES; i++) {
+        DispatchTable  *table;
+        GHashTableIter  iter;
+        gpointer        list;
+
+        table = &dispatch->tables[i];
+
+        lm_connection_unregister_message_handler (dispatch->connection,
+                                                  table->handler,
+                                                  dispatch_types[i]);
+        lm_message_handler_unref (table->handler);
+
+        g_hash_table_iter_init (&iter, table->by_xmlns);
+        while (g_hash_table_iter_next (&iter, NULL, &list)) {
+            g_list_free (list);
+        }
+
+        g_hash_table_destroy (table->by_xmlns);
+        g_list_free (table->any);
+    }
+
+    g_hash_table_destroy (dispatch->subscribers);
+    lm_connection_unref (dispatch->connection);
+
+    g_slice_free (GossipJabberDispatch, dispatch);
+}
+
+/* Subscribes func to stanzas of type with a payload in xmlns, or to
+ * all of them if xmlns is NULL. Returns an id for
+ * gossip_jabber_dispatch_remove(), which must not be called from a
+ * subscriber.
+ */
+guint
+gossip_jabber_dispatch_add (GossipJabberDispatch   *dispatch,
+                            LmMessageType           type,
+                            const gchar            *xmlns,
+                            LmHandlerPriority       priority,
+                            GossipJabberStanzaFunc  func,
+                            gpointer                user_data)
+{
+    DispatchTable *table;
+    Subscriber    *sub;
+    gint           index;
+
+    g_return_val_if_fail (dispatch != NULL, 0);
+    g_return_val_if_fail (func != NULL, 0);
+
+    index = dispatch_table_index (type);
+    g_return_val_if_fail (index >= 0, 0);
+
+    sub = g_slice_new0 (Subscriber);
+    sub->id = ++dispatch->last_id;
+    sub->table = index;
+    sub->xmlns = xmlns ? g_quark_from_string (xmlns) : 0;
+    sub->priority = priority;
+    sub->func = func;
+    sub->user_data = user_data;
+
+    table = &dispatch->tables[index];
+
+    if (sub->xmlns) {
+        GList *list;
+
+        list = g_hash_table_lookup (table->by_xmlns, GUINT_TO_POINTER (sub->xmlns));
+        list = g_list_insert_sorted (list, sub, dispatch_subscriber_cmp);
+        g_hash_table_insert (table->by_xmlns, GUINT_TO_POINTER (sub->xmlns), list);
+    } else {
+        table->any = g_list_insert_sorted (table->any, sub, dispatch_subscriber_cmp);
+    }
+
+    g_hash_table_insert (dispatch->subscribers, GUINT_TO_POINTER (sub->id), sub);
+
+    return sub->id;
+}
+
+void
+gossip_jabber_dispatch_remove (GossipJabberDispatch *dispatch,
+                               guint                 id)
+{
+    DispatchTable *table;
+    Subscriber    *sub;
+
+    g_return_if_fail (dispatch != NULL);
+
+    sub = g_hash_table_lookup (dispatch->subscribers, GUINT_TO_POINTER (id));
+    if (!sub) {
+        return;
+    }
+
+    table = &dispatch->tables[sub->table];
+
+    if (sub->xmlns) {
+        GList *list;
+
+        list = g_hash_table_lookup (table->by_xmlns, GUINT_TO_POINTER (sub->xmlns));
+        list = g_list_remove (list, sub);
+
+        if (list) {
+            g_hash_table_insert (table->by_xmlns, GUINT_TO_POINTER (sub->xmlns), list);
+        } else {
+            g_hash_table_remove (table->by_xmlns, GUINT_TO_POINTER (sub->xmlns));
+        }
+    } else {
+        table->any = g_list_remove (table->any, sub);
+    }
+
+    g_hash_table_remove (dispatch->subscribers, GUINT_TO_POINTER (id));
+}
+
+/* Finds the payload in xmlns when there is more than one, which is
+ * usual for messages and presence.
+ */
+LmMessageNode *
+gossip_jabber_stanza_get_child (GossipJabberStanza *stanza,
+                                const gchar        *xmlns)
+{
+    LmMessageNode *node;
+
+    g_return_val_if_fail (stanza != NULL, NULL);
+    g_return_val_if_fail (xmlns != NULL, NULL);
+
+    /* Nothing before the first payload has a namespace */
+    for (node = stanza->node; node; node = node->next) {
+        const gchar *ns;
+
+        ns = lm_message_node_get_attribute (node, "xmlns");
+        if (ns && strcmp (ns, xmlns) == 0) {
+            return node;
+        }
+    }
+
+    return NULL;
+}
+
+static gint
+dispatch_table_index (LmMessageType type)
+{
+    gint i;
+
+    for (i = 0; i < DISPATCH_N_TYPES; i++) {
+        if (dispatch_types[i] == type) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* Higher priority first, then in the order they subscribed */
+static gint
+dispatch_subscriber_cmp (gconstpointer a,
+                         gconstpointer b)
+{
+    const Subscriber *sub_a = a;
+    const Subscriber *sub_b = b;
+
+    if (sub_a->priority != sub_b->priority) {
+        return sub_a->priority > sub_b->priority ? -1 : 1;
+    }
+
+    if (sub_a->id != sub_b->id) {
+        return sub_a->id < sub_b->id ? -1 : 1;
+    }
+
+    return 0;
+}
+
+static void
+dispatch_subscriber_free (Subscriber *sub)
+{
+    g_slice_free (Subscriber, sub);
+}
+
+static void
+dispatch_parse (GossipJabberStanza *stanza,
+                LmMessage          *m)
+{
+    LmMessageNode *node;
+    const gchar   *slash;
+
+    stanza->m = m;
+    stanza->type = lm_message_get_type (m);
+    stanza->sub_type = lm_message_get_sub_type (m);
+    stanza->from = lm_message_node_get_attribute (m->node, "from");
+    stanza->id = lm_message_node_get_attribute (m->node, "id");
+    stanza->bare_len = 0;
+    stanza->resource = NULL;
+    stanza->node = NULL;
+    stanza->xmlns = NULL;
+    stanza->routed = FALSE;
+
+    if (stanza->from) {
+        slash = strchr (stanza->from, '/');
+        if (slash) {
+            stanza->bare_len = slash - stanza->from;
+            stanza->resource = slash + 1;
+        } else {
+            stanza->bare_len = strlen (stanza->from);
+        }
+    }
+
+    for (node = m->node->children; node; node = node->next) {
+        const gchar *xmlns;
+
+        xmlns = lm_message_node_get_attribute (node, "xmlns");
+        if (xmlns) {
+            stanza->node = node;
+            stanza->xmlns = xmlns;
+            break;
+        }
+    }
+}
+
+static LmHandlerResult
+dispatch_handler (LmMessageHandler     *handler,
+                  LmConnection         *connection,
+                  LmMessage            *m,
+                  GossipJabberDispatch *dispatch)
+{
+    GossipJabberStanza  stanza;
+    DispatchTable      *table;
+    GList              *any;
+    GList              *routed = NULL;
+    gint                index;
+
+    index = dispatch_table_index (lm_message_get_type (m));
+    if (index < 0) {
+        return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
+    }
+
+    table = &dispatch->tables[index];
+
+    dispatch_parse (&stanza, m);
+
+    /* A namespace nobody subscribed to was never made a quark */
+    if (stanza.xmlns) {
+        GQuark xmlns;
+
+        xmlns = g_quark_try_string (stanza.xmlns);
+        if (xmlns) {
+            routed = g_hash_table_lookup (table->by_xmlns, GUINT_TO_POINTER (xmlns));
+        }
+    }
+
+    stanza.routed = routed != NULL;
+
+    /* Both lists are already in the order subscribers run in */
+    any = table->any;
+    while (any || routed) {
+        Subscriber *sub;
+
+        if (!routed ||
+            (any && dispatch_subscriber_cmp (any->data, routed->data) < 0)) {
+            sub = any->data;
+            any = any->next;
+        } else {
+            sub = routed->data;
+            routed = routed->next;
+        }
+
+        if (sub->func (&stanza, sub->user_data) == LM_HANDLER_RESULT_REMOVE_MESSAGE) {
+            return LM_HANDLER_RESULT_REMOVE_MESSAGE;
+        }
+    }
+
+    return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
+}
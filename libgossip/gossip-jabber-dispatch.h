@@ -0,0 +1,66 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * Copyright (C) 2007 Imendio AB
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GOSSIP_JABBER_DISPATCH_H__
+#define __GOSSIP_JABBER_DISPATCH_H__
+
+#include <glib.h>
+#include <loudmouth/loudmouth.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GossipJabberDispatch GossipJabberDispatch;
+
+/* The envelope of an incoming stanza, read once before it is handed
+ * to anyone. Strings point into the message and are only valid while
+ * it is being dispatched.
+ */
+typedef struct {
+    LmMessage        *m;
+    LmMessageType     type;
+    LmMessageSubType  sub_type;
+    const gchar      *from;
+    gsize             bare_len;  /* Length of from without the resource */
+    const gchar      *resource;  /* NULL if from has none */
+    const gchar      *id;
+    LmMessageNode    *node;      /* First child with a namespace */
+    const gchar      *xmlns;
+    gboolean          routed;    /* Someone subscribed to xmlns */
+} GossipJabberStanza;
+
+typedef LmHandlerResult (*GossipJabberStanzaFunc) (GossipJabberStanza *stanza,
+                                                   gpointer            user_data);
+
+GossipJabberDispatch *gossip_jabber_dispatch_new       (LmConnection           *connection);
+void                  gossip_jabber_dispatch_free      (GossipJabberDispatch   *dispatch);
+guint                 gossip_jabber_dispatch_add       (GossipJabberDispatch   *dispatch,
+                                                        LmMessageType           type,
+                                                        const gchar            *xmlns,
+                                                        LmHandlerPriority       priority,
+                                                        GossipJabberStanzaFunc  func,
+                                                        gpointer                user_data);
+void                  gossip_jabber_dispatch_remove    (GossipJabberDispatch   *dispatch,
+                                                        guint                   id);
+LmMessageNode *       gossip_jabber_stanza_get_child   (GossipJabberStanza     *stanza,
+                                                        const gchar            *xmlns);
+
+G_END_DECLS
+
+#endif /* __GOSSIP_JABBER_DISPATCH_H__ */
@@ -91,10 +91,12 @@ static void            jabber_ft_add_jid_sid_to_table       (GossipJabberFTs   *
                                                              const gchar       *jid,
                                                              const gchar       *sid,
                                                              guint              id);
-static LmHandlerResult jabber_ft_iq_si_handler              (LmMessageHandler  *handler,
-                                                             LmConnection      *conn,
-                                                             LmMessage         *message,
-                                                             GossipJabber      *jabber);
+static LmHandlerResult jabber_ft_iq_si_handler              (GossipJabberStanza *stanza,
+                                                             GossipJabber       *jabber);
+static LmHandlerResult jabber_ft_iq_bytestreams_handler     (GossipJabberStanza *stanza,
+                                                             GossipJabber       *jabber);
+static LmHandlerResult jabber_ft_iq_error_handler           (GossipJabberStanza *stanza,
+                                                             GossipJabber       *jabber);
 static void            jabber_ft_handle_request             (GossipJabber      *jabber,
                                                              LmMessage         *m);
 static void            jabber_ft_handle_error               (GossipJabber      *jabber,
@@ -114,9 +116,9 @@ static gchar *         jabber_ft_get_unique_sid             (void);
 GossipJabberFTs *
 gossip_jabber_ft_init (GossipJabber *jabber)
 {
-    GossipJabberFTs  *fts;
-    LmConnection     *connection;
-    LmMessageHandler *handler;
+    GossipJabberFTs      *fts;
+    LmConnection         *connection;
+    GossipJabberDispatch *dispatch;
 
     g_return_val_if_fail (GOSSIP_IS_JABBER (jabber), NULL);
 
@@ -166,14 +168,27 @@ gossip_jabber_ft_init (GossipJabber *jabber)
                                            NULL,
                                            (GDestroyNotify) g_hash_table_destroy);
 
-    handler = lm_message_handler_new ((LmHandleMessageFunction) jabber_ft_iq_si_handler,
-                                      jabber, NULL);
-
-    lm_connection_register_message_handler (connection,
-                                            handler,
-                                            LM_MESSAGE_TYPE_IQ,
-                                            LM_HANDLER_PRIORITY_NORMAL);
-    lm_message_handler_unref (handler);
+    dispatch = _gossip_jabber_get_dispatch (jabber);
+
+    gossip_jabber_dispatch_add (dispatch,
+                                LM_MESSAGE_TYPE_IQ, XMPP_FILE_TRANSFER_XMLNS,
+                                LM_HANDLER_PRIORITY_NORMAL,
+                                (GossipJabberStanzaFunc) jabber_ft_iq_si_handler,
+                                jabber);
+    gossip_jabber_dispatch_add (dispatch,
+                                LM_MESSAGE_TYPE_IQ, XMPP_BYTESTREAMS_PROTOCOL,
+                                LM_HANDLER_PRIORITY_NORMAL,
+                                (GossipJabberStanzaFunc) jabber_ft_iq_bytestreams_handler,
+                                jabber);
+
+    /* Errors don't always echo what was asked, they are matched
+     * on the id instead.
+     */
+    gossip_jabber_dispatch_add (dispatch,
+                                LM_MESSAGE_TYPE_IQ, NULL,
+                                LM_HANDLER_PRIORITY_NORMAL,
+                                (GossipJabberStanzaFunc) jabber_ft_iq_error_handler,
+                                jabber);
 
     return fts;
 }
@@ -356,27 +371,14 @@ jabber_ft_add_jid_sid_to_table (GossipJabberFTs *fts,
 }
 
 static LmHandlerResult
-jabber_ft_iq_streamhost (LmConnection *conn,
-                         LmMessage    *m,
-                         GossipJabber *jabber)
+jabber_ft_iq_streamhost (GossipJabberStanza *stanza,
+                         GossipJabber       *jabber)
 {
     GossipJabberFTs *fts;
     LmMessageNode   *node;
     const gchar     *attr;
-    const gchar     *iq_id;
-
-    node = lm_message_node_get_child (m->node, "query");
-    if(!node) {
-        /* child node is not a query */
-        return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
-    }
-
-    attr = lm_message_node_get_attribute (node, "xmlns");
-    if(!attr || strcmp (attr, XMPP_BYTESTREAMS_PROTOCOL) != 0) {
-        return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
-    }
 
-    node = lm_message_node_get_child (node, "streamhost-used");
+    node = lm_message_node_get_child (stanza->node, "streamhost-used");
     if(!node) {
         return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
     }
@@ -386,39 +388,26 @@ jabber_ft_iq_streamhost (LmConnection *conn,
         return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
     }
 
-    iq_id = lm_message_node_get_attribute (m->node, "id");
     fts = _gossip_jabber_get_fts (jabber);
-    lm_bs_session_streamhost_activate (fts->bs_session, iq_id, attr);
+    lm_bs_session_streamhost_activate (fts->bs_session, stanza->id, attr);
 
     return LM_HANDLER_RESULT_REMOVE_MESSAGE;
 }
 
 static LmHandlerResult
-jabber_ft_iq_query (LmConnection *conn,
-                    LmMessage    *m,
-                    GossipJabber *jabber)
+jabber_ft_iq_query (GossipJabberStanza *stanza,
+                    GossipJabber       *jabber)
 {
     LmMessageNode   *child;
     LmMessageNode   *node;
     GossipJabberFTs *fts;
-    const gchar     *xmlns;
     const gchar     *sid;
-    const gchar     *iq_id;
     const gchar     *host;
     const gchar     *port;
     const gchar     *jid;
     guint            id;
 
-    node = lm_message_node_get_child (m->node, "query");
-    if(!node) {
-        /* Child node is not a query */
-        return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
-    }
-
-    xmlns = lm_message_node_get_attribute (node, "xmlns");
-    if(!xmlns || strcmp (xmlns, XMPP_BYTESTREAMS_PROTOCOL) != 0) {
-        return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
-    }
+    node = stanza->node;
 
     sid = lm_message_node_get_attribute (node, "sid");
     if(!sid) {
@@ -426,20 +415,18 @@ jabber_ft_iq_query (LmConnection *conn,
         return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
     }
 
-    jid = lm_message_node_get_attribute (m->node, "from");
-    if (!jid) {
+    if (!stanza->from) {
         return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
     }
 
-    id = jabber_ft_guess_id_by_sid_and_sender (jabber, sid, jid);
+    id = jabber_ft_guess_id_by_sid_and_sender (jabber, sid, stanza->from);
     if (id == 0) {
         /* Previos records for transfer doesn't exist */
         return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
     }
         
-    iq_id = lm_message_node_get_attribute (m->node, "id");
     fts = _gossip_jabber_get_fts (jabber);
-    lm_bs_session_set_iq_id (fts->bs_session, id, iq_id);
+    lm_bs_session_set_iq_id (fts->bs_session, id, stanza->id);
 
     /* Get all children named "streamhost" */
     for (child = node->children; child; child = child->next) {
@@ -527,7 +514,7 @@ jabber_ft_send_streamhosts (LmConnection *conn,
                                   port_str,
                                   jid_str);
         
-    lm_connection_send (conn, m, NULL);
+    gossip_jabber_cork_send (conn, m, NULL);
 
     iq_id = lm_message_node_get_attribute (m->node, "id");
     lm_bs_session_set_iq_id (fts->bs_session, id, iq_id);
@@ -539,25 +526,18 @@ jabber_ft_send_streamhosts (LmConnection *conn,
 }
 
 static LmHandlerResult
-jabber_ft_feature_result (LmConnection *conn,
-                          LmMessage    *m,
-                          GossipJabber *jabber)
+jabber_ft_feature_result (GossipJabberStanza *stanza,
+                          GossipJabber       *jabber)
 {
     GossipJabberFTs *fts;
     GossipFT        *ft;
-    const gchar     *id_str;
     LmMessageNode   *node;
     const gchar     *attr;
 
     fts = _gossip_jabber_get_fts (jabber);
     g_return_val_if_fail (fts != NULL, LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS);
 
-    node = lm_message_node_get_child (m->node, "si");
-
-    /* Already tested in jabber_ft_iq_si_handler */
-    g_return_val_if_fail (node != NULL, LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS);
-
-    node = lm_message_node_get_child (node, "feature");
+    node = lm_message_node_get_child (stanza->node, "feature");
     if (!node) {
         return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
     }
@@ -597,76 +577,57 @@ jabber_ft_feature_result (LmConnection *conn,
         return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
     }
 
-    id_str = lm_message_node_get_attribute (m->node, "id");
-    ft = g_hash_table_lookup (fts->ft_ids, id_str);
+    ft = g_hash_table_lookup (fts->ft_ids, stanza->id);
     if (!ft) {
         return LM_HANDLER_RESULT_REMOVE_MESSAGE;
     }
 
-    jabber_ft_send_streamhosts (conn, jabber, ft);
+    jabber_ft_send_streamhosts (fts->connection, jabber, ft);
 
     return LM_HANDLER_RESULT_REMOVE_MESSAGE;
 }
 
 static LmHandlerResult
-jabber_ft_iq_si_handler (LmMessageHandler *handler,
-                         LmConnection     *conn,
-                         LmMessage        *m,
-                         GossipJabber     *jabber)
+jabber_ft_iq_si_handler (GossipJabberStanza *stanza,
+                         GossipJabber       *jabber)
 {
-    LmMessageSubType  subtype;
-    LmMessageNode    *node;
-    const gchar      *xmlns;
-
-    subtype = lm_message_get_sub_type (m);
-
-    if (subtype != LM_MESSAGE_SUB_TYPE_GET &&
-        subtype != LM_MESSAGE_SUB_TYPE_SET &&
-        subtype != LM_MESSAGE_SUB_TYPE_RESULT &&
-        subtype != LM_MESSAGE_SUB_TYPE_ERROR) {
-        return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
-    }
+    const gchar *profile;
 
-    if (subtype == LM_MESSAGE_SUB_TYPE_ERROR) {
-        /* Handle it */
-        jabber_ft_handle_error (jabber, m);
+    profile = lm_message_node_get_attribute (stanza->node, "profile");
+    if (profile && strcmp (profile, XMPP_FILE_TRANSFER_PROFILE) == 0) {
+        jabber_ft_handle_request (jabber, stanza->m);
         return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
     }
 
-    node = lm_message_node_get_child (m->node, "si");
-    if (!node) {
-        if (subtype == LM_MESSAGE_SUB_TYPE_SET) {
-            return jabber_ft_iq_query (conn, m, jabber);
-        } 
-        else if (subtype == LM_MESSAGE_SUB_TYPE_RESULT) {
-            return jabber_ft_iq_streamhost (conn, m, jabber);
-        } else {
-            return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
-        }
+    if (stanza->sub_type == LM_MESSAGE_SUB_TYPE_RESULT) {
+        return jabber_ft_feature_result (stanza, jabber);
     }
 
-    xmlns = lm_message_node_get_attribute (node, "xmlns");
-
-    if (xmlns && strcmp (xmlns, XMPP_FILE_TRANSFER_XMLNS) == 0) {
-        const gchar *profile;
+    /* Gets and sets for other profiles are not answered:
+     *  - No Jabber spec for this that I could see (mjr) 
+     */
+    return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
+}
 
-        profile = lm_message_node_get_attribute (node, "profile");
-        if (profile && strcmp (profile, XMPP_FILE_TRANSFER_PROFILE) == 0) {
-            jabber_ft_handle_request (jabber, m);
-            return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
-        }
-        if (subtype == LM_MESSAGE_SUB_TYPE_RESULT) {
-            return jabber_ft_feature_result (conn, m, jabber);
-        }
+static LmHandlerResult
+jabber_ft_iq_bytestreams_handler (GossipJabberStanza *stanza,
+                                  GossipJabber       *jabber)
+{
+    if (stanza->sub_type == LM_MESSAGE_SUB_TYPE_SET) {
+        return jabber_ft_iq_query (stanza, jabber);
+    } else if (stanza->sub_type == LM_MESSAGE_SUB_TYPE_RESULT) {
+        return jabber_ft_iq_streamhost (stanza, jabber);
     }
 
-    /* If a get, return error for unsupported IQ */
-    if (subtype == LM_MESSAGE_SUB_TYPE_GET ||
-        subtype == LM_MESSAGE_SUB_TYPE_SET) {
-        /* Ddo something:
-         *  - No Jabber spec for this that I could see (mjr) 
-         */
-        return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
+    return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
+}
+
+static LmHandlerResult
+jabber_ft_iq_error_handler (GossipJabberStanza *stanza,
+                            GossipJabber       *jabber)
+{
+    if (stanza->sub_type == LM_MESSAGE_SUB_TYPE_ERROR) {
+        jabber_ft_handle_error (jabber, stanza->m);
     }
 
     return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
@@ -1079,7 +1040,7 @@ gossip_jabber_ft_send (GossipJabberFTs *fts,
     g_free (file_path);
 
     /* Send */
-    lm_connection_send (connection, m, NULL);
+    gossip_jabber_cork_send (connection, m, NULL);
     lm_message_unref (m);
 
     g_free (file_name);
@@ -1169,7 +1130,7 @@ gossip_jabber_ft_accept (GossipJabberFTs *fts,
     lm_message_node_add_child (node, "value", XMPP_BYTESTREAMS_PROTOCOL);
 
     /* Send */
-    lm_connection_send (connection, m, NULL);
+    gossip_jabber_cork_send (connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -1220,7 +1181,7 @@ gossip_jabber_ft_decline (GossipJabberFTs *fts,
                                     NULL);
 
     /* Send */
-    lm_connection_send (connection, m, NULL);
+    gossip_jabber_cork_send (connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -1290,7 +1251,7 @@ gossip_jabber_ft_iib_start (GossipJabber *jabber,
                                     "xmlns", XMPP_IBB_PROTOCOL,
                                     NULL);
 
-    lm_connection_send (connection, m, NULL);
+    gossip_jabber_cork_send (connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -1314,7 +1275,7 @@ gossip_jabber_ft_iib_start_response (GossipJabber *jabber,
                                     "id", id,
                                     NULL);
 
-    lm_connection_send (connection, m, NULL);
+    gossip_jabber_cork_send (connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -1357,7 +1318,7 @@ gossip_jabber_ft_iib_error (GossipJabber *jabber,
                                     "xmlns", XMPP_ERROR_XMLNS,
                                     NULL);
 
-    lm_connection_send (connection, m, NULL);
+    gossip_jabber_cork_send (connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -1411,7 +1372,7 @@ gossip_jabber_ft_iib_send (GossipJabber *jabber,
                                     "action", "error",
                                     NULL);
 
-    lm_connection_send (connection, m, NULL);
+    gossip_jabber_cork_send (connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -1441,7 +1402,7 @@ gossip_jabber_ft_iib_finish (GossipJabber *jabber,
                                     "sid", sid,
                                     NULL);
 
-    lm_connection_send (connection, m, NULL);
+    gossip_jabber_cork_send (connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -1465,6 +1426,6 @@ gossip_jabber_ft_iib_finish_response (GossipJabber *jabber,
                                     "id", id,
                                     NULL);
 
-    lm_connection_send (connection, m, NULL);
+    gossip_jabber_cork_send (connection, m, NULL);
     lm_message_unref (m);
 }
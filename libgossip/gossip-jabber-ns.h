@@ -26,5 +26,6 @@
 #define XMPP_ROSTER_XMLNS          "jabber:iq:roster"
 #define XMPP_REGISTER_XMLNS        "jabber:iq:register"
 #define XMPP_PING_XMLNS            "urn:xmpp:ping"
+#define XMPP_CAPS_XMLNS            "http://jabber.org/protocol/caps"
 
 #endif /* __GOSSIP_JABBER_NS_H__ */
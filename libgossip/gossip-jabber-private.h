@@ -25,18 +25,24 @@
 
 #include "gossip-session.h"
 #include "gossip-jabber.h"
+#include "gossip-jabber-caps.h"
+#include "gossip-jabber-cork.h"
+#include "gossip-jabber-dispatch.h"
 #include "gossip-jabber-ft.h"
 
 G_BEGIN_DECLS
 
-LmConnection *   _gossip_jabber_new_connection (GossipJabber  *jabber,
-                                                GossipAccount *account);
-gboolean         _gossip_jabber_set_connection (LmConnection  *connection,
-                                                GossipJabber  *jabber,
-                                                GossipAccount *account);
-LmConnection *   _gossip_jabber_get_connection (GossipJabber  *jabber);
-GossipSession *  _gossip_jabber_get_session    (GossipJabber  *jabber);
-GossipJabberFTs *_gossip_jabber_get_fts        (GossipJabber  *jabber);
+LmConnection *    _gossip_jabber_new_connection (GossipJabber  *jabber,
+                                                 GossipAccount *account);
+gboolean          _gossip_jabber_set_connection (LmConnection  *connection,
+                                                 GossipJabber  *jabber,
+                                                 GossipAccount *account);
+LmConnection *    _gossip_jabber_get_connection (GossipJabber  *jabber);
+GossipSession *   _gossip_jabber_get_session    (GossipJabber  *jabber);
+GossipJabberFTs * _gossip_jabber_get_fts        (GossipJabber  *jabber);
+GossipJabberCaps *_gossip_jabber_get_caps       (GossipJabber  *jabber);
+GossipJabberDispatch *
+                  _gossip_jabber_get_dispatch   (GossipJabber  *jabber);
 
 G_END_DECLS
 
@@ -30,6 +30,7 @@
 #include <libgossip/gossip-presence.h>
 #include <libgossip/gossip-version-info.h>
 
+#include "gossip-jabber-cork.h"
 #include "gossip-jabber-services.h"
 
 #define DEBUG_DOMAIN "JabberServices"
@@ -185,7 +186,7 @@ gossip_jabber_services_get_version (LmConnection           *connection,
     handler = lm_message_handler_new ((LmHandleMessageFunction) jabber_services_get_version_cb,
                                       data, g_free);
 
-    result = lm_connection_send_with_reply (connection, m, handler, error);
+    result = gossip_jabber_cork_send_with_reply (connection, m, handler, error);
 
     lm_message_unref (m);
     lm_message_handler_unref (handler);
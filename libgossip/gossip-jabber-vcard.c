@@ -251,7 +251,7 @@ gossip_jabber_vcard_get (GossipJabber         *jabber,
                                       data,
                                       (GDestroyNotify) jabber_vcard_free);
 
-    if (!lm_connection_send_with_reply (connection, m, handler, error)) {
+    if (!gossip_jabber_cork_send_with_reply (connection, m, handler, error)) {
         gossip_debug (DEBUG_DOMAIN, 
                       "Failed to get VCard for JID:'%s' (could not send request)", 
                       jid_str);
@@ -384,7 +384,7 @@ gossip_jabber_vcard_set (GossipJabber    *jabber,
                                       data,
                                       g_free);
 
-    result = lm_connection_send_with_reply (connection, m, handler, error);
+    result = gossip_jabber_cork_send_with_reply (connection, m, handler, error);
 
     lm_message_unref (m);
     lm_message_handler_unref (handler);
@@ -42,6 +42,7 @@
 #include "gossip-session.h"
 
 #include "gossip-jid.h"
+#include "gossip-jabber-caps.h"
 #include "gossip-jabber-chatrooms.h"
 #include "gossip-jabber-ns.h"
 #include "gossip-jabber-ft.h"
@@ -83,6 +84,8 @@ struct _GossipJabberPrivate {
     GossipSession         *session;
 
     LmConnection          *connection;
+    GossipJabberDispatch  *dispatch;
+    GossipJabberCork      *cork;
     LmSSLStatus            ssl_status;
     gboolean               ssl_disconnection;
 
@@ -104,6 +107,7 @@ struct _GossipJabberPrivate {
     /* Extended parts */
     GossipJabberChatrooms *chatrooms;
     GossipJabberFTs       *fts;
+    GossipJabberCaps      *caps;
 
     /* Used to hold a list of composing message ids, this is so we
      * can send the cancelation to the last message id.
@@ -168,17 +172,13 @@ static GossipPresence * jabber_get_presence                 (LmMessage
 static void             jabber_get_groups_foreach_cb        (gpointer                    key,
                                                              gpointer                    value,
                                                              gpointer                    user_data);
-static LmHandlerResult  jabber_message_handler              (LmMessageHandler           *handler,
-                                                             LmConnection               *conn,
-                                                             LmMessage                  *message,
+static LmHandlerResult  jabber_message_handler              (GossipJabberStanza         *stanza,
                                                              GossipJabber               *jabber);
-static LmHandlerResult  jabber_presence_handler             (LmMessageHandler           *handler,
-                                                             LmConnection               *conn,
-                                                             LmMessage                  *message,
+static LmHandlerResult  jabber_presence_handler             (GossipJabberStanza         *stanza,
                                                              GossipJabber               *jabber);
-static LmHandlerResult  jabber_iq_query_handler             (LmMessageHandler           *handler,
-                                                             LmConnection               *conn,
-                                                             LmMessage                  *message,
+static LmHandlerResult  jabber_iq_query_handler             (GossipJabberStanza         *stanza,
+                                                             GossipJabber               *jabber);
+static LmHandlerResult  jabber_iq_unknown_handler           (GossipJabberStanza         *stanza,
                                                              GossipJabber               *jabber);
 static LmHandlerResult  jabber_subscription_message_handler (LmMessageHandler           *handler,
                                                              LmConnection               *connection,
@@ -234,8 +234,11 @@ static void             jabber_chatroom_invite_decline      (GossipChatroomProvi
 static GList *          jabber_chatroom_get_rooms           (GossipChatroomProvider     *provider);
 static void             jabber_chatroom_browse_rooms        (GossipChatroomProvider     *provider,
                                                              const gchar                *server,
+                                                             gboolean                    refresh,
                                                              GossipChatroomBrowseCb      callback,
                                                              gpointer                    user_data);
+static void             jabber_chatroom_update_room_info    (GossipChatroomProvider     *provider,
+                                                             GossipChatroom             *chatroom);
 
 /* File Transfers */
 static void             jabber_ft_init                      (GossipFTProviderIface      *iface);
@@ -269,6 +272,8 @@ enum {
     NEW_MESSAGE,
     CONTACT_ADDED,
     CONTACT_REMOVED,
+    ROSTER_UPDATING,
+    ROSTER_UPDATED,
     COMPOSING,
 
     /* Used to get password from user. */
@@ -366,6 +371,27 @@ gossip_jabber_class_init (GossipJabberClass *klass)
                       G_TYPE_NONE,
                       1, GOSSIP_TYPE_CONTACT);
 
+    /* Around a batch of contacts being added, changed or removed,
+     * like the roster we get when logging in.
+     */
+    signals[ROSTER_UPDATING] =
+        g_signal_new ("roster-updating",
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL, NULL,
+                      libgossip_marshal_VOID__VOID,
+                      G_TYPE_NONE, 0);
+
+    signals[ROSTER_UPDATED] =
+        g_signal_new ("roster-updated",
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL, NULL,
+                      libgossip_marshal_VOID__VOID,
+                      G_TYPE_NONE, 0);
+
     signals[COMPOSING] =
         g_signal_new ("composing",
                       G_TYPE_FROM_CLASS (klass),
@@ -474,6 +500,10 @@ gossip_jabber_finalize (GObject *object)
     if (priv->fts) {
         gossip_jabber_ft_finalize (priv->fts);
     }
+    gossip_jabber_caps_finalize (priv->caps);
+
+    gossip_jabber_dispatch_free (priv->dispatch);
+    gossip_jabber_cork_free (priv->cork);
 
     g_hash_table_unref (priv->vcards);
 
@@ -568,7 +598,6 @@ gossip_jabber_setup (GossipJabber  *jabber,
                      GossipAccount *account)
 {
     GossipJabberPrivate *priv;
-    LmMessageHandler *handler;
 
     g_return_if_fail (GOSSIP_IS_JABBER (jabber));
     g_return_if_fail (GOSSIP_IS_ACCOUNT (account));
@@ -585,38 +614,53 @@ gossip_jabber_setup (GossipJabber  *jabber,
      */
     lm_connection_set_keep_alive_rate (priv->connection, 30);
 
+    /* Small stanzas sent in a burst go out in one write */
+    priv->cork = gossip_jabber_cork_new (priv->connection);
+
     lm_connection_set_disconnect_function (priv->connection,
                                            (LmDisconnectFunction) jabber_disconnected_cb,
                                            jabber, NULL);
 
-    /* Set up handlers for messages and presence */
-    handler = lm_message_handler_new ((LmHandleMessageFunction) jabber_message_handler,
-                                      jabber, NULL);
-    lm_connection_register_message_handler (priv->connection,
-                                            handler,
-                                            LM_MESSAGE_TYPE_MESSAGE,
-                                            LM_HANDLER_PRIORITY_NORMAL);
-    lm_message_handler_unref (handler);
-
-    handler = lm_message_handler_new ((LmHandleMessageFunction) jabber_presence_handler,
-                                      jabber, NULL);
-    lm_connection_register_message_handler (priv->connection,
-                                            handler,
-                                            LM_MESSAGE_TYPE_PRESENCE,
-                                            LM_HANDLER_PRIORITY_NORMAL);
-    lm_message_handler_unref (handler);
-
-    handler = lm_message_handler_new ((LmHandleMessageFunction) jabber_iq_query_handler,
-                                      jabber, NULL);
-    lm_connection_register_message_handler (priv->connection,
-                                            handler,
-                                            LM_MESSAGE_TYPE_IQ,
-                                            LM_HANDLER_PRIORITY_NORMAL);
-    lm_message_handler_unref (handler);
+    /* Set up handlers for messages and presence, the extended
+     * modules add theirs to the same dispatcher.
+     */
+    priv->dispatch = gossip_jabber_dispatch_new (priv->connection);
+
+    gossip_jabber_dispatch_add (priv->dispatch,
+                                LM_MESSAGE_TYPE_MESSAGE, NULL,
+                                LM_HANDLER_PRIORITY_NORMAL,
+                                (GossipJabberStanzaFunc) jabber_message_handler,
+                                jabber);
+    gossip_jabber_dispatch_add (priv->dispatch,
+                                LM_MESSAGE_TYPE_PRESENCE, NULL,
+                                LM_HANDLER_PRIORITY_NORMAL,
+                                (GossipJabberStanzaFunc) jabber_presence_handler,
+                                jabber);
+    gossip_jabber_dispatch_add (priv->dispatch,
+                                LM_MESSAGE_TYPE_IQ, XMPP_PING_XMLNS,
+                                LM_HANDLER_PRIORITY_NORMAL,
+                                (GossipJabberStanzaFunc) jabber_iq_query_handler,
+                                jabber);
+    gossip_jabber_dispatch_add (priv->dispatch,
+                                LM_MESSAGE_TYPE_IQ, XMPP_ROSTER_XMLNS,
+                                LM_HANDLER_PRIORITY_NORMAL,
+                                (GossipJabberStanzaFunc) jabber_iq_query_handler,
+                                jabber);
+    gossip_jabber_dispatch_add (priv->dispatch,
+                                LM_MESSAGE_TYPE_IQ, XMPP_VERSION_XMLNS,
+                                LM_HANDLER_PRIORITY_NORMAL,
+                                (GossipJabberStanzaFunc) jabber_iq_query_handler,
+                                jabber);
+    gossip_jabber_dispatch_add (priv->dispatch,
+                                LM_MESSAGE_TYPE_IQ, NULL,
+                                LM_HANDLER_PRIORITY_LAST,
+                                (GossipJabberStanzaFunc) jabber_iq_unknown_handler,
+                                jabber);
 
     /* Initiate extended modules */
     priv->chatrooms = gossip_jabber_chatrooms_init (jabber);
     priv->fts = gossip_jabber_ft_init (jabber);
+    priv->caps = gossip_jabber_caps_init (jabber);
     gossip_jabber_disco_init (jabber);
 
 #ifdef USE_TRANSPORTS
@@ -780,6 +824,7 @@ gossip_jabber_logout (GossipJabber *jabber)
     priv->disconnect_request = TRUE;
 
     if (priv->connection) {
+        gossip_jabber_cork_flush (priv->connection);
         lm_connection_close (priv->connection, NULL);
     }
 }
@@ -895,6 +940,11 @@ jabber_connected_cb (LmConnection *connection,
 
     priv = GOSSIP_JABBER_GET_PRIVATE (jabber);
 
+    /* The statistics logged when disconnecting are per session */
+    if (priv->cork) {
+        gossip_jabber_cork_reset_stats (priv->cork);
+    }
+
     if (priv->disconnect_request) {
         /* This is so we go no further that way we don't issue
          * warnings for connections we stopped ourselves.
@@ -1015,14 +1065,15 @@ jabber_auth_cb (LmConnection *connection,
     lm_message_node_set_attributes (node,
                                     "xmlns", XMPP_ROSTER_XMLNS,
                                     NULL);
-    lm_connection_send (priv->connection, m, NULL);
+    gossip_jabber_cork_send (priv->connection, m, NULL);
     lm_message_unref (m);
 
     /* Notify others that we are online */
     m = lm_message_new_with_sub_type (NULL,
                                       LM_MESSAGE_TYPE_PRESENCE,
                                       LM_MESSAGE_SUB_TYPE_AVAILABLE);
-    lm_connection_send (priv->connection, m, NULL);
+    gossip_jabber_caps_add_to_presence (m);
+    gossip_jabber_cork_send (priv->connection, m, NULL);
     lm_message_unref (m);
 
     g_signal_emit_by_name (jabber, "connected", priv->account);
@@ -1054,11 +1105,29 @@ jabber_disconnected_cb (LmConnection       *connection,
         priv->connection_timeout_id = 0;
     }
 
+    if (priv->cork) {
+        guint   stanzas, writes_saved;
+        gdouble latency_avg, latency_max;
+
+        /* Drops anything still held back for this session */
+        gossip_jabber_cork_flush (connection);
+
+        gossip_jabber_cork_get_stats (priv->cork,
+                                      &stanzas, &writes_saved,
+                                      &latency_avg, &latency_max);
+        gossip_debug (DEBUG_DOMAIN,
+                      "Held back %d stanzas, saving %d writes, "
+                      "adding %.1f ms on average and %.1f ms at most",
+                      stanzas, writes_saved, latency_avg, latency_max);
+    }
+
     /* Signal removal of each contact */
     if (priv->contact_list) {
+        g_signal_emit (jabber, signals[ROSTER_UPDATING], 0);
         g_hash_table_foreach_remove (priv->contact_list,
                                      jabber_logout_contact_foreach,
                                      jabber);
+        g_signal_emit (jabber, signals[ROSTER_UPDATED], 0);
     }
 
     switch (reason) {
@@ -1221,9 +1290,9 @@ gossip_jabber_change_password (GossipJabber        *jabber,
                                                   ad,
                                                   NULL);
 
-    ok = lm_connection_send_with_reply (priv->connection, m,
-                                        ad->message_handler,
-                                        NULL);
+    ok = gossip_jabber_cork_send_with_reply (priv->connection, m,
+                                             ad->message_handler,
+                                             NULL);
     lm_message_unref (m);
 
     if (!ok) {
@@ -1423,7 +1492,7 @@ gossip_jabber_send_message (GossipJabber *jabber, GossipMessage *message)
         lm_message_node_add_child (node, "composing", NULL);
     }
 
-    lm_connection_send (priv->connection, m, NULL);
+    gossip_jabber_cork_send (priv->connection, m, NULL);
     lm_message_unref (m);
 
     g_free (jid_str);
@@ -1482,7 +1551,7 @@ gossip_jabber_send_composing (GossipJabber  *jabber,
         }
     }
 
-    lm_connection_send (priv->connection, m, NULL);
+    gossip_jabber_cork_send (priv->connection, m, NULL);
     lm_message_unref (m);
 
     g_free (jid_str);
@@ -1573,7 +1642,9 @@ gossip_jabber_set_presence (GossipJabber *jabber, GossipPresence *presence)
     lm_message_node_add_child (node, "photo", sha1);
     g_free (sha1);
 
-    lm_connection_send (priv->connection, m, NULL);
+    gossip_jabber_caps_add_to_presence (m);
+
+    gossip_jabber_cork_send (priv->connection, m, NULL);
     lm_message_unref (m);
 
     /* Don't forget to set any chatroom status too */
@@ -1686,7 +1757,7 @@ gossip_jabber_add_contact (GossipJabber *jabber,
             g_free (escaped);
         }
 
-        lm_connection_send (priv->connection, m, NULL);
+        gossip_jabber_cork_send (priv->connection, m, NULL);
         lm_message_unref (m);
     }
 
@@ -1704,7 +1775,7 @@ gossip_jabber_add_contact (GossipJabber *jabber,
         lm_message_node_add_child (m->node, "status", escaped);
         g_free (escaped);
 
-        lm_connection_send (priv->connection, m, NULL);
+        gossip_jabber_cork_send (priv->connection, m, NULL);
         lm_message_unref (m);
     } else {
         gossip_debug (DEBUG_DOMAIN, "NOT Sending subscribe request, "
@@ -1750,7 +1821,7 @@ gossip_jabber_rename_contact (GossipJabber  *jabber,
         g_free (escaped);
     }
 
-    lm_connection_send (priv->connection, m, NULL);
+    gossip_jabber_cork_send (priv->connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -1782,7 +1853,7 @@ gossip_jabber_remove_contact (GossipJabber  *jabber,
                                     "subscription", "remove",
                                     NULL);
 
-    lm_connection_send (priv->connection, m, NULL);
+    gossip_jabber_cork_send (priv->connection, m, NULL);
     lm_message_unref (m);
 
     /* Remove current subscription */
@@ -2001,7 +2072,7 @@ jabber_group_rename_foreach_cb (gpointer key,
     lm_message_node_add_child (node, "group", escaped);
     g_free (escaped);
 
-    lm_connection_send (priv->connection, m, NULL);
+    gossip_jabber_cork_send (priv->connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -2203,11 +2274,10 @@ jabber_composing_timeout_cb (JabberData *data)
 }
 
 static LmHandlerResult
-jabber_message_handler (LmMessageHandler *handler,
-                        LmConnection     *conn,
-                        LmMessage        *m,
-                        GossipJabber     *jabber)
+jabber_message_handler (GossipJabberStanza *stanza,
+                        GossipJabber       *jabber)
 {
+    LmMessage            *m;
     LmMessageNode        *node;
     LmMessageSubType      sub_type;
     GossipJabberPrivate  *priv;
@@ -2223,10 +2293,11 @@ jabber_message_handler (LmMessageHandler *handler,
 
     priv = GOSSIP_JABBER_GET_PRIVATE (jabber);
 
-    gossip_debug (DEBUG_DOMAIN, "New message from:'%s'",
-                  lm_message_node_get_attribute (m->node, "from"));
+    m = stanza->m;
+
+    gossip_debug (DEBUG_DOMAIN, "New message from:'%s'", stanza->from);
 
-    sub_type = lm_message_get_sub_type (m);
+    sub_type = stanza->sub_type;
     if (sub_type != LM_MESSAGE_SUB_TYPE_NOT_SET &&
         sub_type != LM_MESSAGE_SUB_TYPE_NORMAL &&
         sub_type != LM_MESSAGE_SUB_TYPE_CHAT &&
@@ -2234,7 +2305,7 @@ jabber_message_handler (LmMessageHandler *handler,
         return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
     }
 
-    from_str = lm_message_node_get_attribute (m->node, "from");
+    from_str = stanza->from;
 
     from = gossip_jabber_get_contact_from_jid (jabber,
                                                from_str,
@@ -2359,27 +2430,16 @@ jabber_message_handler (LmMessageHandler *handler,
      * groupchats, we take the name from the resource, which carries the
      * nick for those messages.
      */
-    if (gossip_jabber_chatrooms_get_jid_is_chatroom (priv->chatrooms,
-                                                     from_str)) {
-        GossipJID   *jid;
-        const gchar *resource;
-
-        jid = gossip_jid_new (from_str);
-        resource = gossip_jid_get_resource (jid);
-        if (!resource) {
-            resource = "";
-        }
-
-        gossip_contact_set_name (from, resource);
-
-        g_object_unref (jid);
+    if (gossip_jabber_chatrooms_find_by_jid (priv->chatrooms,
+                                             from_str,
+                                             &resource)) {
+        gossip_contact_set_name (from, resource ? resource : "");
     }
 
     gossip_message_set_sender (message, from);
     gossip_message_set_body (message, body);
 
-    resource = gossip_jid_string_get_part_resource (from_str);
-    gossip_message_set_explicit_resource (message, resource);
+    gossip_message_set_explicit_resource (message, stanza->resource);
 
     if (subject) {
         gossip_message_set_subject (message, subject);
@@ -2406,26 +2466,24 @@ jabber_message_handler (LmMessageHandler *handler,
 }
 
 static LmHandlerResult
-jabber_presence_handler (LmMessageHandler *handler,
-                         LmConnection     *conn,
-                         LmMessage        *m,
-                         GossipJabber     *jabber)
+jabber_presence_handler (GossipJabberStanza *stanza,
+                         GossipJabber       *jabber)
 {
     GossipJabberPrivate *priv;
     GossipContact    *contact;
+    LmMessage        *m;
     const gchar      *from;
-    const gchar      *type;
 
     priv = GOSSIP_JABBER_GET_PRIVATE (jabber);
 
-    from = lm_message_node_get_attribute (m->node, "from");
+    m = stanza->m;
+    from = stanza->from;
 
     if (gossip_jabber_chatrooms_get_jid_is_chatroom (priv->chatrooms, from)) {
         return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
     }
 
-    gossip_debug (DEBUG_DOMAIN, "New presence from:'%s'",
-                  lm_message_node_get_attribute (m->node, "from"));
+    gossip_debug (DEBUG_DOMAIN, "New presence from:'%s'", from);
 
     contact = gossip_jabber_get_contact_from_jid (jabber, 
                                                   from, 
@@ -2433,34 +2491,24 @@ jabber_presence_handler (LmMessageHandler *handler,
                                                   FALSE, 
                                                   TRUE);
 
-    /* Get the type */
-    type = lm_message_node_get_attribute (m->node, "type");
-    if (!type) {
-        type = "available";
-    }
-
-    if (strcmp (type, "subscribe") == 0) {
+    switch (stanza->sub_type) {
+    case LM_MESSAGE_SUB_TYPE_SUBSCRIBE:
         g_signal_emit_by_name (jabber, "subscription-request", contact, NULL);
 
         return LM_HANDLER_RESULT_REMOVE_MESSAGE;
-    } else if (strcmp (type, "subscribed") == 0) {
-        /* Handled in the roster handling code */
-        return LM_HANDLER_RESULT_REMOVE_MESSAGE;
-    } else if (strcmp (type, "unsubscribed") == 0) {
+    case LM_MESSAGE_SUB_TYPE_SUBSCRIBED:
+    case LM_MESSAGE_SUB_TYPE_UNSUBSCRIBED:
         /* Handled in the roster handling code */
         return LM_HANDLER_RESULT_REMOVE_MESSAGE;
+    default:
+        break;
     }
 
     if (contact) {
         GossipPresence *presence;
-        GossipJID      *jid;
         const gchar    *resource;
 
-        jid = gossip_jid_new (from);
-        resource = gossip_jid_get_resource (jid);
-        if (!resource) {
-            resource = "";
-        }
+        resource = stanza->resource ? stanza->resource : "";
 
         presence = jabber_get_presence (m);
         if (!presence) {
@@ -2492,68 +2540,56 @@ jabber_presence_handler (LmMessageHandler *handler,
 
             g_object_unref (presence);
         }
-
-        g_object_unref (jid);
     }
 
     return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
 }
 
+/* Only subscribed to the namespaces below */
 static LmHandlerResult
-jabber_iq_query_handler (LmMessageHandler *handler,
-                         LmConnection     *conn,
-                         LmMessage        *m,
-                         GossipJabber     *jabber)
+jabber_iq_query_handler (GossipJabberStanza *stanza,
+                         GossipJabber       *jabber)
 {
-    GossipJabberPrivate *priv;
-    LmMessageNode    *node;
-    const gchar      *xmlns;
-
-    priv = GOSSIP_JABBER_GET_PRIVATE (jabber);
-
-    if (lm_message_get_sub_type (m) != LM_MESSAGE_SUB_TYPE_GET &&
-        lm_message_get_sub_type (m) != LM_MESSAGE_SUB_TYPE_SET &&
-        lm_message_get_sub_type (m) != LM_MESSAGE_SUB_TYPE_RESULT) {
+    if (stanza->sub_type != LM_MESSAGE_SUB_TYPE_GET &&
+        stanza->sub_type != LM_MESSAGE_SUB_TYPE_SET &&
+        stanza->sub_type != LM_MESSAGE_SUB_TYPE_RESULT) {
         return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
     }
-        
-    node = lm_message_node_get_child (m->node, "ping");
-    if (node) {
-        xmlns = lm_message_node_get_attribute (node, "xmlns");
-        if (xmlns && strcmp (xmlns, XMPP_PING_XMLNS) == 0) {
-            jabber_request_for_ping (jabber, m);
-            return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
-        }       
-    }
 
-    node = lm_message_node_get_child (m->node, "query");
-    if (!node) {
-        return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
+    if (strcmp (stanza->xmlns, XMPP_PING_XMLNS) == 0) {
+        jabber_request_for_ping (jabber, stanza->m);
+    } else if (strcmp (stanza->xmlns, XMPP_ROSTER_XMLNS) == 0) {
+        jabber_request_for_roster (jabber, stanza->m);
+    } else if (strcmp (stanza->xmlns, XMPP_VERSION_XMLNS) == 0) {
+        jabber_request_for_version (jabber, stanza->m);
     }
 
-    xmlns = lm_message_node_get_attribute (node, "xmlns");
-    if (xmlns && strcmp (xmlns, XMPP_ROSTER_XMLNS) == 0) {
-        jabber_request_for_roster (jabber, m);
-        return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
-    }
+    return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
+}
 
-    if (xmlns && strcmp (xmlns, XMPP_REGISTER_XMLNS) == 0) {
-        /* Do nothing at this point */
+/* Runs last for every IQ, a get or set for a namespace nobody
+ * subscribed to gets an error back.
+ */
+static LmHandlerResult
+jabber_iq_unknown_handler (GossipJabberStanza *stanza,
+                           GossipJabber       *jabber)
+{
+    if (stanza->routed || !stanza->xmlns) {
         return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
     }
 
-    if (xmlns && strcmp (xmlns, XMPP_VERSION_XMLNS) == 0) {
-        jabber_request_for_version (jabber, m);
+    if (stanza->sub_type != LM_MESSAGE_SUB_TYPE_GET &&
+        stanza->sub_type != LM_MESSAGE_SUB_TYPE_SET) {
         return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
     }
 
-    /* If a get, return error for unsupported IQ */
-    if (lm_message_get_sub_type (m) == LM_MESSAGE_SUB_TYPE_GET ||
-        lm_message_get_sub_type (m) == LM_MESSAGE_SUB_TYPE_SET) {
-        jabber_request_for_unknown (jabber, m);
+    /* Registration is answered by whoever asked for it */
+    if (strcmp (stanza->xmlns, XMPP_REGISTER_XMLNS) == 0) {
         return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
     }
 
+    jabber_request_for_unknown (jabber, stanza->m);
+
     return LM_HANDLER_RESULT_ALLOW_MORE_HANDLERS;
 }
 
@@ -2589,7 +2625,7 @@ jabber_subscription_message_handler (LmMessageHandler  *handler,
     id = gossip_contact_get_id (own_contact);
     lm_message_node_set_attribute (new_message->node, "from", id);
 
-    lm_connection_send (connection, new_message, NULL);
+    gossip_jabber_cork_send (connection, new_message, NULL);
     lm_message_unref (new_message);
 
     /* Send our presence */
@@ -2599,7 +2635,7 @@ jabber_subscription_message_handler (LmMessageHandler  *handler,
 
     lm_message_node_set_attribute (new_message->node, "from", id);
 
-    lm_connection_send (connection, new_message, NULL);
+    gossip_jabber_cork_send (connection, new_message, NULL);
     lm_message_unref (new_message);
 
     g_free (to);
@@ -2660,7 +2696,7 @@ jabber_request_for_version (GossipJabber *jabber,
                                    gossip_version_info_get_os (info));
     }
 
-    lm_connection_send (priv->connection, r, NULL);
+    gossip_jabber_cork_send (priv->connection, r, NULL);
     lm_message_unref (r);
 }
 
@@ -2689,7 +2725,7 @@ jabber_request_for_ping (GossipJabber *jabber,
     }
         
     gossip_debug (DEBUG_DOMAIN, "Ping request from:'%s'", from);
-    lm_connection_send (priv->connection, reply, NULL);
+    gossip_jabber_cork_send (priv->connection, reply, NULL);
     lm_message_unref (reply);
 }
 
@@ -2707,6 +2743,8 @@ jabber_request_for_roster (GossipJabber *jabber,
         return;
     }
 
+    g_signal_emit (jabber, signals[ROSTER_UPDATING], 0);
+
     for (node = node->children; node; node = node->next) {
         GossipContact     *contact;
         GossipContactType  type;
@@ -2812,6 +2850,8 @@ jabber_request_for_roster (GossipJabber *jabber,
             g_signal_emit_by_name (jabber, "contact-added", contact);
         }
     }
+
+    g_signal_emit (jabber, signals[ROSTER_UPDATED], 0);
 }
 
 static void
@@ -2851,7 +2891,7 @@ jabber_request_for_unknown (GossipJabber *jabber,
     node = lm_message_node_add_child (node, "service-unavailable", NULL);
     lm_message_node_set_attribute (node, "xmlns", "urn:ietf:params:xml:ns:xmpp-stanzas");
 
-    lm_connection_send (priv->connection, new_m, NULL);
+    gossip_jabber_cork_send (priv->connection, new_m, NULL);
 
     lm_message_unref (new_m);
 }
@@ -2877,6 +2917,7 @@ jabber_chatroom_init (GossipChatroomProviderIface *iface)
     iface->invite_decline  = jabber_chatroom_invite_decline;
     iface->get_rooms       = jabber_chatroom_get_rooms;
     iface->browse_rooms    = jabber_chatroom_browse_rooms;
+    iface->update_room_info = jabber_chatroom_update_room_info;
 }
 
 static GossipChatroomId
@@ -3099,6 +3140,7 @@ jabber_chatroom_get_rooms (GossipChatroomProvider *provider)
 static void
 jabber_chatroom_browse_rooms (GossipChatroomProvider *provider,
                               const gchar            *server,
+                              gboolean                refresh,
                               GossipChatroomBrowseCb  callback,
                               gpointer                user_data)
 {
@@ -3112,10 +3154,26 @@ jabber_chatroom_browse_rooms (GossipChatroomProvider *provider,
     jabber = GOSSIP_JABBER (provider);
     priv = GOSSIP_JABBER_GET_PRIVATE (jabber);
 
-    gossip_jabber_chatrooms_browse_rooms (priv->chatrooms, server, 
+    gossip_jabber_chatrooms_browse_rooms (priv->chatrooms, server, refresh,
                                           callback, user_data);
 }
 
+static void
+jabber_chatroom_update_room_info (GossipChatroomProvider *provider,
+                                  GossipChatroom         *chatroom)
+{
+    GossipJabber        *jabber;
+    GossipJabberPrivate *priv;
+
+    g_return_if_fail (GOSSIP_IS_JABBER (provider));
+    g_return_if_fail (GOSSIP_IS_CHATROOM (chatroom));
+
+    jabber = GOSSIP_JABBER (provider);
+    priv = GOSSIP_JABBER_GET_PRIVATE (jabber);
+
+    gossip_jabber_chatrooms_update_room_info (priv->chatrooms, chatroom);
+}
+
 /*
  * ft
  */
@@ -3316,11 +3374,22 @@ gossip_jabber_get_contact_from_jid (GossipJabber *jabber,
         if (!G_STR_EMPTY (resource)) {
             type = GOSSIP_CONTACT_TYPE_CHATROOM;
 
-            contact = gossip_contact_manager_find_or_create (contact_manager,
-                                                             priv->account,
-                                                             type,
-                                                             gossip_jid_get_full (jid),
-                                                             &created);
+            /* Occupants only live in their room until we talk to
+             * them directly, then they are promoted to the contact
+             * manager like any other contact.
+             */
+            contact = gossip_jabber_chatrooms_get_occupant (priv->chatrooms, jid_str);
+
+            if (contact) {
+                created = gossip_contact_manager_add (contact_manager, contact);
+            } else {
+                contact = gossip_contact_manager_find_or_create (contact_manager,
+                                                                 priv->account,
+                                                                 type,
+                                                                 gossip_jid_get_full (jid),
+                                                                 &created);
+            }
+
             gossip_contact_set_name (contact, resource);
 
             if (!created && set_permanent) {
@@ -3395,7 +3464,7 @@ gossip_jabber_send_subscribed (GossipJabber  *jabber,
                                       LM_MESSAGE_TYPE_PRESENCE,
                                       LM_MESSAGE_SUB_TYPE_SUBSCRIBED);
 
-    lm_connection_send (priv->connection, m, NULL);
+    gossip_jabber_cork_send (priv->connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -3418,7 +3487,7 @@ gossip_jabber_send_unsubscribed (GossipJabber  *jabber,
                                       LM_MESSAGE_TYPE_PRESENCE,
                                       LM_MESSAGE_SUB_TYPE_UNSUBSCRIBED);
 
-    lm_connection_send (priv->connection, m, NULL);
+    gossip_jabber_cork_send (priv->connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -3643,3 +3712,27 @@ _gossip_jabber_get_fts (GossipJabber *jabber)
 
     return priv->fts;
 }
+
+GossipJabberCaps *
+_gossip_jabber_get_caps (GossipJabber *jabber)
+{
+    GossipJabberPrivate *priv;
+
+    g_return_val_if_fail (GOSSIP_IS_JABBER (jabber), NULL);
+
+    priv = GOSSIP_JABBER_GET_PRIVATE (jabber);
+
+    return priv->caps;
+}
+
+GossipJabberDispatch *
+_gossip_jabber_get_dispatch (GossipJabber *jabber)
+{
+    GossipJabberPrivate *priv;
+
+    g_return_val_if_fail (GOSSIP_IS_JABBER (jabber), NULL);
+
+    priv = GOSSIP_JABBER_GET_PRIVATE (jabber);
+
+    return priv->dispatch;
+}
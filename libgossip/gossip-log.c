@@ -138,6 +138,30 @@ typedef struct {
     gchar         *filename;
 } ContactNames;
 
+/* Reads a conversation backwards a page at a time. A day file is what
+ * we parse in one go, so only the day we are in is held in memory and
+ * going further back costs one more day file rather than all of them.
+ */
+struct _GossipLogReader {
+    GossipLogManager *manager;
+    GossipContact    *contact;
+    GossipChatroom   *chatroom;
+
+    /* Days we have logs for, oldest first */
+    GPtrArray        *dates;
+
+    /* The day that is parsed, messages before position have not been
+     * handed out yet.
+     */
+    guint             day;
+    GPtrArray        *messages;
+    guint             position;
+
+    /* Where the last seek put us, going forward stops here */
+    guint             end_day;
+    guint             end_position;
+};
+
 typedef struct {
     GossipContact        *contact;
     GossipChatroom       *chatroom;
@@ -217,6 +241,10 @@ static void            log_set_links_from_message              (GossipLogManager
                                                                 const gchar           *body);
 static GList *         log_get_links                           (GossipLogManager      *manager, 
                                                                 GossipAccount         *account);
+static GossipLogReader *log_reader_new                         (GossipLogManager      *manager,
+                                                                GList                 *dates);
+static gboolean        log_reader_load_day                     (GossipLogReader       *reader,
+                                                                guint                  day);
 
 G_DEFINE_TYPE (GossipLogManager, gossip_log_manager, G_TYPE_OBJECT);
 
@@ -2342,6 +2370,257 @@ gossip_log_exists_for_chatroom (GossipChatroom *chatroom)
     return exists;
 }
 
+/*
+ * Reading backwards
+ */
+static GossipLogReader *
+log_reader_new (GossipLogManager *manager,
+                GList            *dates)
+{
+    GossipLogReader *reader;
+    GList           *l;
+
+    reader = g_new0 (GossipLogReader, 1);
+
+    reader->manager = g_object_ref (manager);
+    reader->dates = g_ptr_array_new ();
+
+    /* Takes the dates */
+    for (l = dates; l; l = l->next) {
+        g_ptr_array_add (reader->dates, l->data);
+    }
+
+    g_list_free (dates);
+
+    /* Nothing parsed yet, the first page comes from the last day */
+    reader->day = reader->dates->len;
+    reader->end_day = reader->dates->len;
+
+    return reader;
+}
+
+static gboolean
+log_reader_load_day (GossipLogReader *reader,
+                     guint            day)
+{
+    GList       *messages, *l;
+    const gchar *date;
+
+    if (day >= reader->dates->len) {
+        return FALSE;
+    }
+
+    date = g_ptr_array_index (reader->dates, day);
+
+    if (reader->contact) {
+        messages = gossip_log_get_messages_for_contact (reader->manager,
+                                                        reader->contact,
+                                                        date);
+    } else {
+        messages = gossip_log_get_messages_for_chatroom (reader->manager,
+                                                         reader->chatroom,
+                                                         date);
+    }
+
+    if (reader->messages) {
+        g_ptr_array_foreach (reader->messages, (GFunc) g_object_unref, NULL);
+        g_ptr_array_free (reader->messages, TRUE);
+    }
+
+    reader->messages = g_ptr_array_sized_new (g_list_length (messages));
+
+    for (l = messages; l; l = l->next) {
+        g_ptr_array_add (reader->messages, l->data);
+    }
+
+    g_list_free (messages);
+
+    reader->day = day;
+    reader->position = 0;
+
+    gossip_debug (DEBUG_DOMAIN, "Reader parsed %s, %d messages",
+                  date, reader->messages->len);
+
+    return TRUE;
+}
+
+GossipLogReader *
+gossip_log_reader_new_for_contact (GossipLogManager *manager,
+                                   GossipContact    *contact)
+{
+    GossipLogReader *reader;
+
+    g_return_val_if_fail (GOSSIP_IS_LOG_MANAGER (manager), NULL);
+    g_return_val_if_fail (GOSSIP_IS_CONTACT (contact), NULL);
+
+    reader = log_reader_new (manager, gossip_log_get_dates_for_contact (contact));
+    reader->contact = g_object_ref (contact);
+
+    return reader;
+}
+
+GossipLogReader *
+gossip_log_reader_new_for_chatroom (GossipLogManager *manager,
+                                    GossipChatroom   *chatroom)
+{
+    GossipLogReader *reader;
+
+    g_return_val_if_fail (GOSSIP_IS_LOG_MANAGER (manager), NULL);
+    g_return_val_if_fail (GOSSIP_IS_CHATROOM (chatroom), NULL);
+
+    reader = log_reader_new (manager, gossip_log_get_dates_for_chatroom (chatroom));
+    reader->chatroom = g_object_ref (chatroom);
+
+    return reader;
+}
+
+void
+gossip_log_reader_free (GossipLogReader *reader)
+{
+    g_return_if_fail (reader != NULL);
+
+    if (reader->messages) {
+        g_ptr_array_foreach (reader->messages, (GFunc) g_object_unref, NULL);
+        g_ptr_array_free (reader->messages, TRUE);
+    }
+
+    g_ptr_array_foreach (reader->dates, (GFunc) g_free, NULL);
+    g_ptr_array_free (reader->dates, TRUE);
+
+    if (reader->contact) {
+        g_object_unref (reader->contact);
+    }
+
+    if (reader->chatroom) {
+        g_object_unref (reader->chatroom);
+    }
+
+    g_object_unref (reader->manager);
+
+    g_free (reader);
+}
+
+/* Positions the reader so the next page ends with the last message
+ * logged before the given time, usually the oldest one already shown.
+ */
+void
+gossip_log_reader_seek (GossipLogReader *reader,
+                        GossipTime       before)
+{
+    guint day;
+
+    g_return_if_fail (reader != NULL);
+
+    for (day = reader->dates->len; day > 0; day--) {
+        GossipMessage *message;
+        guint          position;
+
+        if (!log_reader_load_day (reader, day - 1)) {
+            break;
+        }
+
+        /* Days are in order so we only go back until one has
+         * something older than what we want.
+         */
+        for (position = reader->messages->len; position > 0; position--) {
+            message = g_ptr_array_index (reader->messages, position - 1);
+            if (gossip_message_get_timestamp (message) < before) {
+                break;
+            }
+        }
+
+        reader->position = position;
+        if (position > 0) {
+            break;
+        }
+    }
+
+    reader->end_day = reader->day;
+    reader->end_position = reader->position;
+}
+
+gboolean
+gossip_log_reader_has_previous (GossipLogReader *reader)
+{
+    g_return_val_if_fail (reader != NULL, FALSE);
+
+    return reader->position > 0 || reader->day > 0;
+}
+
+/* Returns up to n_messages messages in the order they were logged,
+ * those just before what was returned last time.
+ */
+GList *
+gossip_log_reader_get_previous (GossipLogReader *reader,
+                                guint            n_messages)
+{
+    GList *messages = NULL;
+
+    g_return_val_if_fail (reader != NULL, NULL);
+
+    while (n_messages > 0) {
+        GossipMessage *message;
+
+        if (reader->position == 0) {
+            if (reader->day == 0 ||
+                !log_reader_load_day (reader, reader->day - 1)) {
+                break;
+            }
+
+            reader->position = reader->messages->len;
+            continue;
+        }
+
+        reader->position--;
+
+        message = g_ptr_array_index (reader->messages, reader->position);
+        messages = g_list_prepend (messages, g_object_ref (message));
+
+        n_messages--;
+    }
+
+    return messages;
+}
+
+/* Gives back the last n_messages handed out, the newest ones first,
+ * so they are returned again once older ones have been read.
+ */
+void
+gossip_log_reader_forward (GossipLogReader *reader,
+                           guint            n_messages)
+{
+    g_return_if_fail (reader != NULL);
+
+    while (n_messages > 0) {
+        guint limit;
+
+        if (!reader->messages) {
+            break;
+        }
+
+        if (reader->day == reader->end_day) {
+            limit = reader->end_position;
+        } else {
+            limit = reader->messages->len;
+        }
+
+        if (reader->position < limit) {
+            guint step;
+
+            step = MIN (n_messages, limit - reader->position);
+
+            reader->position += step;
+            n_messages -= step;
+            continue;
+        }
+
+        if (reader->day >= reader->end_day ||
+            !log_reader_load_day (reader, reader->day + 1)) {
+            break;
+        }
+    }
+}
+
 /* FIXME: Use this code for searching since that is really slow. */
 #if 0
 static void
@@ -42,6 +42,7 @@ typedef struct _GossipLogManager      GossipLogManager;
 typedef struct _GossipLogManagerClass GossipLogManagerClass;
 typedef struct _GossipLogSearchHit    GossipLogSearchHit;
 typedef struct _GossipLogLinkHit      GossipLogLinkHit;
+typedef struct _GossipLogReader       GossipLogReader;
 
 struct _GossipLogManager {
     GObject parent;
@@ -103,6 +104,21 @@ void              gossip_log_message_for_chatroom      (GossipLogManager      *m
 gboolean          gossip_log_exists_for_chatroom       (GossipChatroom        *chatroom);
 
 
+/* Reading backwards a page at a time */
+GossipLogReader * gossip_log_reader_new_for_contact    (GossipLogManager      *manager,
+                                                        GossipContact         *contact);
+GossipLogReader * gossip_log_reader_new_for_chatroom   (GossipLogManager      *manager,
+                                                        GossipChatroom        *chatroom);
+void              gossip_log_reader_free               (GossipLogReader       *reader);
+void              gossip_log_reader_seek               (GossipLogReader       *reader,
+                                                        GossipTime             before);
+gboolean          gossip_log_reader_has_previous       (GossipLogReader       *reader);
+GList *           gossip_log_reader_get_previous       (GossipLogReader       *reader,
+                                                        guint                  n_messages);
+void              gossip_log_reader_forward            (GossipLogReader       *reader,
+                                                        guint                  n_messages);
+
+
 /* Searching */
 GList *           gossip_log_search_new                (GossipLogManager      *manager,
                                                         const gchar           *text);
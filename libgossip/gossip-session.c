@@ -112,6 +112,10 @@ static void            session_jabber_contact_added              (GossipJabber
 static void            session_jabber_contact_removed            (GossipJabber         *jabber,
                                                                   GossipContact        *contact,
                                                                   GossipSession        *session);
+static void            session_jabber_roster_updating            (GossipJabber         *jabber,
+                                                                  GossipSession        *session);
+static void            session_jabber_roster_updated             (GossipJabber         *jabber,
+                                                                  GossipSession        *session);
 static void            session_jabber_composing                  (GossipJabber         *jabber,
                                                                   GossipContact        *contact,
                                                                   gboolean              composing,
@@ -149,6 +153,8 @@ enum {
     NEW_MESSAGE,
     CONTACT_ADDED,
     CONTACT_REMOVED,
+    ROSTER_UPDATING,
+    ROSTER_UPDATED,
     COMPOSING,
     CHATROOM_AUTO_CONNECT,
 
@@ -286,6 +292,24 @@ gossip_session_class_init (GossipSessionClass *klass)
                       G_TYPE_NONE,
                       1, GOSSIP_TYPE_CONTACT);
 
+    signals[ROSTER_UPDATING] =
+        g_signal_new ("roster-updating",
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL, NULL,
+                      libgossip_marshal_VOID__VOID,
+                      G_TYPE_NONE, 0);
+
+    signals[ROSTER_UPDATED] =
+        g_signal_new ("roster-updated",
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL, NULL,
+                      libgossip_marshal_VOID__VOID,
+                      G_TYPE_NONE, 0);
+
     signals[COMPOSING] =
         g_signal_new ("composing",
                       G_TYPE_FROM_CLASS (klass),
@@ -406,6 +430,12 @@ session_jabber_signals_setup (GossipSession *session,
     g_signal_connect (jabber, "contact-removed",
                       G_CALLBACK (session_jabber_contact_removed),
                       session);
+    g_signal_connect (jabber, "roster-updating",
+                      G_CALLBACK (session_jabber_roster_updating),
+                      session);
+    g_signal_connect (jabber, "roster-updated",
+                      G_CALLBACK (session_jabber_roster_updated),
+                      session);
     g_signal_connect (jabber, "composing",
                       G_CALLBACK (session_jabber_composing),
                       session);
@@ -600,6 +630,20 @@ session_jabber_contact_removed (GossipJabber  *jabber,
     }
 }
 
+static void
+session_jabber_roster_updating (GossipJabber  *jabber,
+                                GossipSession *session)
+{
+    g_signal_emit (session, signals[ROSTER_UPDATING], 0);
+}
+
+static void
+session_jabber_roster_updated (GossipJabber  *jabber,
+                               GossipSession *session)
+{
+    g_signal_emit (session, signals[ROSTER_UPDATED], 0);
+}
+
 static void
 session_jabber_composing (GossipJabber  *jabber,
                           GossipContact *contact,
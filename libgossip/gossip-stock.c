@@ -30,6 +30,12 @@
 
 static GtkIconFactory *icon_factory = NULL;
 
+/* Rendered pixbufs keyed by "stock-id:size", these are shared so
+ * presence updates don't render a new pixbuf each time.
+ */
+static GHashTable     *pixbuf_cache = NULL;
+static gulong          icon_theme_changed_id = 0;
+
 static GtkStockItem stock_items[] = {
     { GOSSIP_STOCK_OFFLINE,                 NULL },
     { GOSSIP_STOCK_AVAILABLE,               NULL },
@@ -44,6 +50,14 @@ static GtkStockItem stock_items[] = {
     { GOSSIP_STOCK_FILE_TRANSFER,           NULL }
 };
 
+static void
+stock_icon_theme_changed_cb (GtkIconTheme *icon_theme,
+                             gpointer      user_data)
+{
+    /* Anything we rendered may have come from the old theme */
+    g_hash_table_remove_all (pixbuf_cache);
+}
+
 void
 gossip_stock_init (void)
 {
@@ -78,6 +92,16 @@ gossip_stock_init (void)
 
         g_object_unref (pixbuf);
     }
+
+    pixbuf_cache = g_hash_table_new_full (g_str_hash,
+                                          g_str_equal,
+                                          (GDestroyNotify) g_free,
+                                          (GDestroyNotify) g_object_unref);
+
+    icon_theme_changed_id = 
+        g_signal_connect (gtk_icon_theme_get_default (), "changed",
+                          G_CALLBACK (stock_icon_theme_changed_cb),
+                          NULL);
 }
 
 void
@@ -85,17 +109,71 @@ gossip_stock_finalize (void)
 {
     g_assert (icon_factory != NULL);
 
+    g_signal_handler_disconnect (gtk_icon_theme_get_default (),
+                                 icon_theme_changed_id);
+    icon_theme_changed_id = 0;
+
+    g_hash_table_destroy (pixbuf_cache);
+    pixbuf_cache = NULL;
+
     gtk_icon_factory_remove_default (icon_factory);
 
     icon_factory = NULL;
 }
 
+/* Renders all our own stock icons up front so the first roster
+ * population doesn't have to.
+ */
+void
+gossip_stock_preload (GtkWidget   *widget,
+                      GtkIconSize  size)
+{
+    gint i;
+
+    g_return_if_fail (GTK_IS_WIDGET (widget));
+
+    for (i = 0; i < G_N_ELEMENTS (stock_items); i++) {
+        GdkPixbuf *pixbuf;
+
+        pixbuf = gossip_stock_create_pixbuf (widget, 
+                                             stock_items[i].stock_id,
+                                             size);
+        if (pixbuf) {
+            g_object_unref (pixbuf);
+        }
+    }
+}
+
+/* The pixbuf returned is shared, callers get a new reference and
+ * must not modify it.
+ */
 GdkPixbuf *
 gossip_stock_create_pixbuf (GtkWidget   *widget,
                             const gchar *stock,
                             GtkIconSize  size)
 {
-    return gtk_widget_render_icon (widget, stock, size, NULL);
+    GdkPixbuf *pixbuf;
+    gchar      key[128];
+
+    if (!pixbuf_cache) {
+        return gtk_widget_render_icon (widget, stock, size, NULL);
+    }
+
+    g_snprintf (key, sizeof (key), "%s:%d", stock, size);
+
+    pixbuf = g_hash_table_lookup (pixbuf_cache, key);
+    if (pixbuf) {
+        return g_object_ref (pixbuf);
+    }
+
+    pixbuf = gtk_widget_render_icon (widget, stock, size, NULL);
+    if (!pixbuf) {
+        return NULL;
+    }
+
+    g_hash_table_insert (pixbuf_cache, g_strdup (key), g_object_ref (pixbuf));
+
+    return pixbuf;
 }
 
 
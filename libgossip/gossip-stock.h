@@ -48,6 +48,8 @@ G_BEGIN_DECLS
 
 void         gossip_stock_init          (void);
 void         gossip_stock_finalize      (void);
+void         gossip_stock_preload       (GtkWidget   *widget,
+                                         GtkIconSize  size);
 GdkPixbuf *  gossip_stock_create_pixbuf (GtkWidget   *widget,
                                          const gchar *stock,
                                          GtkIconSize  size);
@@ -609,7 +609,7 @@ gossip_transport_account_remove (GossipTransportAccount *account)
                                         "subscription", "remove",
                                         NULL);
 
-        lm_connection_send (connection, m, NULL);
+        gossip_jabber_cork_send (connection, m, NULL);
         lm_message_unref (m);
     }
 
@@ -634,7 +634,7 @@ gossip_transport_account_remove (GossipTransportAccount *account)
                                     "subscription", "remove",
                                     NULL);
 
-    lm_connection_send (connection, m, NULL);
+    gossip_jabber_cork_send (connection, m, NULL);
     lm_message_unref (m);
 
     /* unregister the service - new method */
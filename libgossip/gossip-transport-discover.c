@@ -379,7 +379,7 @@ transport_disco_request_items (GossipTransportDisco *disco)
 
     lm_message_node_set_attribute (node, "xmlns", "http://jabber.org/protocol/disco#items");
 
-    lm_connection_send (connection, m, NULL);
+    gossip_jabber_cork_send (connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -529,7 +529,7 @@ transport_disco_request_info (GossipTransportDisco *disco)
 
         lm_message_node_set_attribute (node, "xmlns", "http://jabber.org/protocol/disco#info");
 
-        lm_connection_send (connection, m, NULL);
+        gossip_jabber_cork_send (connection, m, NULL);
         lm_message_unref (m);
     }
 
@@ -696,7 +696,7 @@ gossip_transport_protocol_id_to_jid (GossipTransportProtocol       *protocol,
 
     lm_message_node_add_child (node, "prompt", id);
 
-    lm_connection_send (connection, m, NULL);
+    gossip_jabber_cork_send (connection, m, NULL);
     lm_message_unref (m);
 }
 
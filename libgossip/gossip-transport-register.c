@@ -165,7 +165,7 @@ gossip_transport_unregister (GossipJabber                  *jabber,
 
     lm_message_node_set_attribute (node, "xmlns", "jabber:iq:register");
 
-    lm_connection_send (connection, m, NULL);
+    gossip_jabber_cork_send (connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -303,7 +303,7 @@ transport_unregister_message_handler (LmMessageHandler    *handler,
 
     lm_message_node_add_child (node, "remove", NULL);
 
-    lm_connection_send (connection, new_message, NULL);
+    gossip_jabber_cork_send (connection, new_message, NULL);
     lm_message_unref (new_message);
 
     return LM_HANDLER_RESULT_REMOVE_MESSAGE;
@@ -379,7 +379,7 @@ gossip_transport_requirements (GossipJabber                    *jabber,
 
     lm_message_node_set_attribute (node, "xmlns", "jabber:iq:register");
 
-    lm_connection_send (connection, m, NULL);
+    gossip_jabber_cork_send (connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -615,7 +615,7 @@ gossip_transport_register (GossipJabber                *jabber,
         lm_message_node_add_child (node, "email", email);
     }
 
-    lm_connection_send (connection, m, NULL);
+    gossip_jabber_cork_send (connection, m, NULL);
     lm_message_unref (m);
 }
 
@@ -26,7 +26,6 @@
 #include <string.h>
 #include <time.h>
 #include <sys/types.h>
-#include <regex.h>
 
 #include <glib/gi18n.h>
 
@@ -38,8 +37,6 @@
 
 #define DEBUG_DOMAIN "Utils"
 
-static void regex_init (void);
-
 gchar *
 gossip_substring (const gchar *str,
                   gint         start,
@@ -49,123 +46,441 @@ gossip_substring (const gchar *str,
 }
 
 /*
- * Regular Expression code to match urls.
+ * Finding urls and e-mail addresses.
+ *
+ * This used to be done with four POSIX regular expressions run over
+ * the message one after the other, which gets slow for long pastes.
+ * The scanner below walks the message once and matches the same
+ * expressions by hand, for reference they were:
+ *
+ *   GOSSIP_REGEX_AS_IS:   SCHEME "//(" USER "@)?[" HOSTCHARS ".]+"
+ *                         "(:[0-9]+)?(" URLPATH ")?"
+ *   GOSSIP_REGEX_BROWSER: "(www|ftp)[" HOSTCHARS "]*\\.[" HOSTCHARS ".]+"
+ *                         "(:[0-9]+)?(" URLPATH ")?"
+ *   GOSSIP_REGEX_EMAIL:   "(mailto:)?[a-z0-9][a-z0-9.-]*@[a-z0-9]"
+ *                         "[a-z0-9-]*(\\.[a-z0-9][a-z0-9-]*)+"
+ *   GOSSIP_REGEX_OTHER:   "news:[-A-Z\\^_a-z{|}~!\"#$%&'()*+,./0-9;:=?`]+"
+ *                         "@[" HOSTCHARS ".]+(:[0-9]+)?"
+ *
+ * all case insensitive and with:
+ *
+ *   USERCHARS "-A-Za-z0-9"
+ *   PASSCHARS "-A-Za-z0-9,?;.:/!%$^*&~\"#'"
+ *   HOSTCHARS "-A-Za-z0-9"
+ *   PATHCHARS "-A-Za-z0-9_$.+!*(),;:@&=?/~#%"
+ *   SCHEME    "(news:|telnet:|nntp:|file:/|https?:|ftps?:|webcal:)"
+ *   USER      "[" USERCHARS "]+(:["PASSCHARS "]+)?"
+ *   URLPATH   "/[" PATHCHARS "]*[^]'.}>) \t\r\n,\\\"]"
+ *
+ * Like regexec() we report the leftmost match and the longest one
+ * starting there, then carry on after it.
  */
-#define USERCHARS "-A-Za-z0-9"
-#define PASSCHARS "-A-Za-z0-9,?;.:/!%$^*&~\"#'"
-#define HOSTCHARS "-A-Za-z0-9"
-#define PATHCHARS "-A-Za-z0-9_$.+!*(),;:@&=?/~#%"
-#define SCHEME    "(news:|telnet:|nntp:|file:/|https?:|ftps?:|webcal:)"
-#define USER      "[" USERCHARS "]+(:["PASSCHARS "]+)?"
-#define URLPATH   "/[" PATHCHARS "]*[^]'.}>) \t\r\n,\\\"]"
+enum {
+    URL_CHARS_ALNUM     = 1 << 0,
+    URL_CHARS_DIGIT     = 1 << 1,
+    URL_CHARS_USER      = 1 << 2, /* Also HOSTCHARS */
+    URL_CHARS_PASS      = 1 << 3,
+    URL_CHARS_HOST      = 1 << 4, /* HOSTCHARS and '.' */
+    URL_CHARS_PATH      = 1 << 5,
+    URL_CHARS_PATH_STOP = 1 << 6, /* Can't end a path */
+    URL_CHARS_LOCAL     = 1 << 7, /* Local part of an e-mail address */
+    URL_CHARS_NEWS      = 1 << 8
+};
+
+#define URL_CHARS_COUNT 9
+
+typedef struct {
+    gint start;
+    gint end;
+} UrlRun;
+
+typedef struct {
+    const gchar *msg;
+    gint         len;
+
+    /* Where the last runs of each character class we looked at end,
+     * so trying lots of starting points inside one long run doesn't
+     * make us scan it over and over again.
+     */
+    UrlRun       runs[URL_CHARS_COUNT];
+
+    /* Same for the domain after the last '@' we looked at. */
+    gint         email_at;
+    gint         email_end;
+} UrlScanner;
+
+static guint16 url_chars[256];
+
+static const gchar *url_schemes[] = {
+    "news:", "telnet:", "nntp:", "file:/",
+    "http:", "https:", "ftp:", "ftps:", "webcal:"
+};
 
-static regex_t dingus[GOSSIP_REGEX_ALL];
+static void
+url_chars_add (guint16      chars,
+               const gchar *str)
+{
+    for (; *str; str++) {
+        url_chars[(guchar) *str] |= chars;
+    }
+}
 
 static void
-regex_init (void)
+url_chars_init (void)
 {
-    static gboolean  inited = FALSE;
-    const gchar     *expression;
-    gint             i;
+    static gboolean inited = FALSE;
+    gint            c;
 
     if (inited) {
         return;
     }
 
-    for (i = 0; i < GOSSIP_REGEX_ALL; i++) {
-        switch (i) {
-        case GOSSIP_REGEX_AS_IS:
-            expression =
-                SCHEME "//(" USER "@)?[" HOSTCHARS ".]+"
-                "(:[0-9]+)?(" URLPATH ")?";
-            break;
-        case GOSSIP_REGEX_BROWSER:
-            expression =
-                "(www|ftp)[" HOSTCHARS "]*\\.[" HOSTCHARS ".]+"
-                "(:[0-9]+)?(" URLPATH ")?";
-            break;
-        case GOSSIP_REGEX_EMAIL:
-            expression =
-                "(mailto:)?[a-z0-9][a-z0-9.-]*@[a-z0-9]"
-                "[a-z0-9-]*(\\.[a-z0-9][a-z0-9-]*)+";
-            break;
-        case GOSSIP_REGEX_OTHER:
-            expression =
-                "news:[-A-Z\\^_a-z{|}~!\"#$%&'()*+,./0-9;:=?`]+"
-                "@[" HOSTCHARS ".]+(:[0-9]+)?";
-            break;
-        default:
-            /* Silence the compiler. */
-            expression = NULL;
-            continue;
+    for (c = 0; c < 256; c++) {
+        if (g_ascii_isalnum (c)) {
+            url_chars[c] |=
+                URL_CHARS_ALNUM | URL_CHARS_USER | URL_CHARS_PASS |
+                URL_CHARS_HOST | URL_CHARS_PATH | URL_CHARS_LOCAL |
+                URL_CHARS_NEWS;
         }
 
-        memset (&dingus[i], 0, sizeof (regex_t));
-        regcomp (&dingus[i], expression, REG_EXTENDED | REG_ICASE);
+        if (g_ascii_isdigit (c)) {
+            url_chars[c] |= URL_CHARS_DIGIT;
+        }
     }
 
+    url_chars_add (URL_CHARS_USER | URL_CHARS_PASS | URL_CHARS_HOST |
+                   URL_CHARS_PATH | URL_CHARS_LOCAL | URL_CHARS_NEWS,
+                   "-");
+    url_chars_add (URL_CHARS_PASS, ",?;.:/!%$^*&~\"#'");
+    url_chars_add (URL_CHARS_HOST, ".");
+    url_chars_add (URL_CHARS_PATH, "_$.+!*(),;:@&=?/~#%");
+    url_chars_add (URL_CHARS_PATH_STOP, "]'.}>) \t\r\n,\\\"");
+    url_chars_add (URL_CHARS_LOCAL, ".");
+    url_chars_add (URL_CHARS_NEWS, "\\^_{|}~!\"#$%&'()*+,./;:=?`");
+
     inited = TRUE;
 }
 
+static inline gboolean
+url_is (UrlScanner *scanner,
+        gint        pos,
+        guint16     chars)
+{
+    /* The trailing nul is in no class, so this is safe at the end. */
+    return (url_chars[(guchar) scanner->msg[pos]] & chars) != 0;
+}
+
+static gint
+url_run_end (UrlScanner *scanner,
+             gint        pos,
+             guint16     chars)
+{
+    UrlRun *run;
+
+    /* One cached run per character class */
+    run = &scanner->runs[g_bit_nth_lsf (chars, -1)];
+
+    if (pos >= run->start && pos < run->end) {
+        return run->end;
+    }
+
+    run->start = pos;
+    run->end = pos;
+
+    while (url_is (scanner, run->end, chars)) {
+        run->end++;
+    }
+
+    return run->end;
+}
+
+static gint
+url_scan_port (UrlScanner *scanner,
+               gint        pos)
+{
+    /* (:[0-9]+)? */
+    if (scanner->msg[pos] != ':' || !url_is (scanner, pos + 1, URL_CHARS_DIGIT)) {
+        return pos;
+    }
+
+    for (pos++; url_is (scanner, pos, URL_CHARS_DIGIT); pos++);
+
+    return pos;
+}
+
+static gint
+url_scan_path (UrlScanner *scanner,
+               gint        pos)
+{
+    gint run_end;
+    gint i;
+
+    /* (/[PATHCHARS]*[^]'.}>) \t\r\n,\"])? */
+    if (scanner->msg[pos] != '/') {
+        return pos;
+    }
+
+    run_end = url_run_end (scanner, pos + 1, URL_CHARS_PATH);
+
+    /* Longest is the whole run plus whatever comes after it... */
+    if (run_end < scanner->len && !url_is (scanner, run_end, URL_CHARS_PATH_STOP)) {
+        const gchar *next;
+
+        next = g_utf8_next_char (scanner->msg + run_end);
+        return MIN (next - scanner->msg, scanner->len);
+    }
+
+    /* ...otherwise back off to the last character that may end it. */
+    for (i = run_end - 1; i > pos; i--) {
+        if (!url_is (scanner, i, URL_CHARS_PATH_STOP)) {
+            return i + 1;
+        }
+    }
+
+    return pos;
+}
+
+static gint
+url_scan_host_port_path (UrlScanner *scanner,
+                         gint        pos,
+                         gboolean    with_path)
+{
+    gint end;
+
+    /* [HOSTCHARS.]+(:[0-9]+)? and maybe a path */
+    end = url_run_end (scanner, pos, URL_CHARS_HOST);
+    if (end == pos) {
+        return -1;
+    }
+
+    end = url_scan_port (scanner, end);
+
+    if (with_path) {
+        end = url_scan_path (scanner, end);
+    }
+
+    return end;
+}
+
+static gint
+url_match_as_is (UrlScanner *scanner,
+                 gint        pos)
+{
+    const gchar *msg;
+    gint         i;
+    gint         end, end_with_user;
+    gint         user_end;
+
+    msg = scanner->msg + pos;
+
+    for (i = 0; i < G_N_ELEMENTS (url_schemes); i++) {
+        gint len;
+
+        if (g_ascii_tolower (msg[0]) != url_schemes[i][0]) {
+            continue;
+        }
+
+        len = strlen (url_schemes[i]);
+        if (g_ascii_strncasecmp (msg, url_schemes[i], len) == 0 &&
+            msg[len] == '/' && msg[len + 1] == '/') {
+            break;
+        }
+    }
+
+    if (i == G_N_ELEMENTS (url_schemes)) {
+        return -1;
+    }
+
+    pos += strlen (url_schemes[i]) + 2;
+
+    end = url_scan_host_port_path (scanner, pos, TRUE);
+
+    /* The user and password are optional, go with whichever of the
+     * two gives the longer match.
+     */
+    end_with_user = -1;
+    user_end = url_run_end (scanner, pos, URL_CHARS_USER);
+
+    if (user_end > pos && scanner->msg[user_end] == ':' &&
+        url_is (scanner, user_end + 1, URL_CHARS_PASS)) {
+        user_end = url_run_end (scanner, user_end + 1, URL_CHARS_PASS);
+    }
+
+    if (user_end > pos && scanner->msg[user_end] == '@') {
+        end_with_user = url_scan_host_port_path (scanner, user_end + 1, TRUE);
+    }
+
+    return MAX (end, end_with_user);
+}
+
+static gint
+url_match_browser (UrlScanner *scanner,
+                   gint        pos)
+{
+    const gchar *msg;
+    gint         dot;
+
+    msg = scanner->msg + pos;
+
+    if (g_ascii_tolower (msg[0]) != 'w' && g_ascii_tolower (msg[0]) != 'f') {
+        return -1;
+    }
+
+    if (g_ascii_strncasecmp (msg, "www", 3) != 0 &&
+        g_ascii_strncasecmp (msg, "ftp", 3) != 0) {
+        return -1;
+    }
+
+    dot = url_run_end (scanner, pos + 3, URL_CHARS_USER);
+    if (scanner->msg[dot] != '.') {
+        return -1;
+    }
+
+    return url_scan_host_port_path (scanner, dot + 1, TRUE);
+}
+
+static gint
+url_scan_domain (UrlScanner *scanner,
+                 gint        pos)
+{
+    gint labels = 0;
+
+    /* [a-z0-9][a-z0-9-]*(\.[a-z0-9][a-z0-9-]*)+ */
+    if (!url_is (scanner, pos, URL_CHARS_ALNUM)) {
+        return -1;
+    }
+
+    pos = url_run_end (scanner, pos, URL_CHARS_USER);
+
+    while (scanner->msg[pos] == '.' &&
+           url_is (scanner, pos + 1, URL_CHARS_ALNUM)) {
+        pos = url_run_end (scanner, pos + 1, URL_CHARS_USER);
+        labels++;
+    }
+
+    return labels > 0 ? pos : -1;
+}
+
+static gint
+url_match_address (UrlScanner *scanner,
+                   gint        pos)
+{
+    gint at;
+
+    /* [a-z0-9][a-z0-9.-]*@domain */
+    if (!url_is (scanner, pos, URL_CHARS_ALNUM)) {
+        return -1;
+    }
+
+    at = url_run_end (scanner, pos, URL_CHARS_LOCAL);
+    if (scanner->msg[at] != '@') {
+        return -1;
+    }
+
+    if (scanner->email_at != at) {
+        scanner->email_at = at;
+        scanner->email_end = url_scan_domain (scanner, at + 1);
+    }
+
+    return scanner->email_end;
+}
+
+static gint
+url_match_email (UrlScanner *scanner,
+                 gint        pos)
+{
+    gint end;
+
+    if (g_ascii_tolower (scanner->msg[pos]) == 'm' &&
+        g_ascii_strncasecmp (scanner->msg + pos, "mailto:", 7) == 0) {
+        end = url_match_address (scanner, pos + 7);
+        if (end != -1) {
+            return end;
+        }
+    }
+
+    return url_match_address (scanner, pos);
+}
+
+static gint
+url_match_other (UrlScanner *scanner,
+                 gint        pos)
+{
+    gint at;
+
+    if (g_ascii_tolower (scanner->msg[pos]) != 'n' ||
+        g_ascii_strncasecmp (scanner->msg + pos, "news:", 5) != 0) {
+        return -1;
+    }
+
+    at = url_run_end (scanner, pos + 5, URL_CHARS_NEWS);
+    if (at == pos + 5 || scanner->msg[at] != '@') {
+        return -1;
+    }
+
+    return url_scan_host_port_path (scanner, at + 1, FALSE);
+}
+
 gint
 gossip_regex_match (GossipRegExType  type,
                     const gchar     *msg,
                     GArray          *start,
                     GArray          *end)
 {
-    regmatch_t matches[1];
-    gint       ret = 0;
+    UrlScanner scanner;
     gint       num_matches = 0;
-    gint       offset = 0;
-    gint       i;
-
-    g_return_val_if_fail (type >= 0 || type <= GOSSIP_REGEX_ALL, 0);
+    gint       pos;
 
-    regex_init ();
+    g_return_val_if_fail (type >= 0 && type <= GOSSIP_REGEX_ALL, 0);
+    g_return_val_if_fail (msg != NULL, 0);
 
-    while (!ret && type != GOSSIP_REGEX_ALL) {
-        ret = regexec (&dingus[type], msg + offset, 1, matches, 0);
-        if (ret == 0) {
-            gint s;
+    url_chars_init ();
 
-            num_matches++;
+    memset (&scanner, 0, sizeof (scanner));
+    scanner.msg = msg;
+    scanner.len = strlen (msg);
+    scanner.email_at = -1;
 
-            s = matches[0].rm_so + offset;
-            offset = matches[0].rm_eo + offset;
+    for (pos = 0; pos < scanner.len; ) {
+        gint match_end = -1;
 
-            g_array_append_val (start, s);
-            g_array_append_val (end, offset);
+        /* Everything we look for starts with a letter or digit */
+        if (!url_is (&scanner, pos, URL_CHARS_ALNUM)) {
+            pos++;
+            continue;
         }
-    }
 
-    if (type != GOSSIP_REGEX_ALL) {
-        gossip_debug (DEBUG_DOMAIN,
-                      "Found %d matches for regex type:%d",
-                      num_matches, type);
-        return num_matches;
-    }
+        if (type == GOSSIP_REGEX_AS_IS || type == GOSSIP_REGEX_ALL) {
+            match_end = MAX (match_end, url_match_as_is (&scanner, pos));
+        }
 
-    /* If GOSSIP_REGEX_ALL then we run ALL regex's on the string. */
-    for (i = 0; i < GOSSIP_REGEX_ALL; i++, ret = 0) {
-        while (!ret) {
-            ret = regexec (&dingus[i], msg + offset, 1, matches, 0);
-            if (ret == 0) {
-                gint s;
+        if (type == GOSSIP_REGEX_BROWSER || type == GOSSIP_REGEX_ALL) {
+            match_end = MAX (match_end, url_match_browser (&scanner, pos));
+        }
 
-                num_matches++;
+        if (type == GOSSIP_REGEX_EMAIL || type == GOSSIP_REGEX_ALL) {
+            match_end = MAX (match_end, url_match_email (&scanner, pos));
+        }
 
-                s = matches[0].rm_so + offset;
-                offset = matches[0].rm_eo + offset;
+        if (type == GOSSIP_REGEX_OTHER || type == GOSSIP_REGEX_ALL) {
+            match_end = MAX (match_end, url_match_other (&scanner, pos));
+        }
 
-                g_array_append_val (start, s);
-                g_array_append_val (end, offset);
-            }
+        if (match_end <= pos) {
+            pos++;
+            continue;
         }
+
+        g_array_append_val (start, pos);
+        g_array_append_val (end, match_end);
+        num_matches++;
+
+        pos = match_end;
     }
 
     gossip_debug (DEBUG_DOMAIN,
-                  "Found %d matches for ALL regex types",
-                  num_matches);
+                  "Found %d matches for regex type:%d",
+                  num_matches, type);
 
     return num_matches;
 }
@@ -856,6 +856,9 @@ app_setup (GossipSession *session)
     app_connection_items_setup (glade);
     g_object_unref (glade);
 
+    /* Render the presence icons once, they are shared after that */
+    gossip_stock_preload (priv->window, GTK_ICON_SIZE_MENU);
+
     /* Setup specialised widgets */
     gossip_debug (DEBUG_DOMAIN_SETUP, "Configuring specialised widgets");
 
@@ -0,0 +1,259 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * Copyright (C) 2007 Imendio AB
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Renders a synthetic chat backlog into a GossipChatView that is shown
+ * on screen, once a message at a time the way backlogs used to be
+ * added and once with gossip_chat_view_append_messages(), and prints
+ * how long each took including the time needed to lay it out.
+ *
+ * Build with "make gossip-chat-view-bench", run with the number of
+ * messages to use (200 by default) and optionally the number of runs.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include <gtk/gtk.h>
+
+#include "gossip-chat-view.h"
+
+#define BENCH_SENDERS 5
+
+static const gchar *bench_bodies[] = {
+    "Hi there :)",
+    "Did anyone look at the patch I sent yesterday? It is at "
+    "http://www.example.com/patches/gossip-backlog.diff",
+    "/me goes for lunch",
+    "ok",
+    "That should be fixed in the next release, the trimming was "
+    "walking the whole buffer every time a message came in which "
+    "gets really slow in busy rooms that have been open for days ;)",
+    "mail me at someone@example.com if it breaks again"
+};
+
+static GList *
+bench_create_backlog (GossipContact *own_contact,
+                      guint          n_messages)
+{
+    GossipAccount *account;
+    GossipContact *senders[BENCH_SENDERS];
+    GList         *messages = NULL;
+    GossipTime     timestamp;
+    guint          i;
+
+    account = gossip_contact_get_account (own_contact);
+
+    for (i = 0; i < BENCH_SENDERS; i++) {
+        gchar *id, *name;
+
+        id = g_strdup_printf ("user%d@example.com", i);
+        name = g_strdup_printf ("User %d", i);
+
+        senders[i] = gossip_contact_new_full (GOSSIP_CONTACT_TYPE_CHATROOM,
+                                              account, id, id, name);
+        g_free (id);
+        g_free (name);
+    }
+
+    timestamp = gossip_time_get_current () - n_messages * 30;
+
+    for (i = 0; i < n_messages; i++) {
+        GossipMessage *message;
+        GossipContact *sender;
+
+        /* Mostly other people talking, every fifth one is us */
+        if (i % 5 == 0) {
+            sender = own_contact;
+        } else {
+            sender = senders[g_random_int_range (0, BENCH_SENDERS)];
+        }
+
+        message = gossip_message_new (GOSSIP_MESSAGE_TYPE_CHAT_ROOM, NULL);
+        gossip_message_set_sender (message, sender);
+        gossip_message_set_body (message,
+                                 bench_bodies[g_random_int_range (0, G_N_ELEMENTS (bench_bodies))]);
+        gossip_message_set_timestamp (message, timestamp + i * 30);
+
+        messages = g_list_prepend (messages, message);
+    }
+
+    for (i = 0; i < BENCH_SENDERS; i++) {
+        g_object_unref (senders[i]);
+    }
+
+    return g_list_reverse (messages);
+}
+
+static void
+bench_flush (void)
+{
+    /* Let the view validate and draw what was added */
+    while (gtk_events_pending ()) {
+        gtk_main_iteration ();
+    }
+
+    gdk_window_process_all_updates ();
+}
+
+static GossipChatView *
+bench_create_view (GtkWidget **window)
+{
+    GossipChatView *view;
+    GtkWidget      *sw;
+
+    *window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_default_size (GTK_WINDOW (*window), 500, 400);
+
+    sw = gtk_scrolled_window_new (NULL, NULL);
+    gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (sw),
+                                    GTK_POLICY_NEVER,
+                                    GTK_POLICY_ALWAYS);
+    gtk_container_add (GTK_CONTAINER (*window), sw);
+
+    view = gossip_chat_view_new ();
+    gtk_container_add (GTK_CONTAINER (sw), GTK_WIDGET (view));
+
+    gtk_widget_show_all (*window);
+    bench_flush ();
+
+    return view;
+}
+
+static gdouble
+bench_one_by_one (GList         *messages,
+                  GossipContact *own_contact)
+{
+    GossipChatView *view;
+    GtkWidget      *window;
+    GTimer         *timer;
+    GList          *l;
+    gdouble         elapsed;
+
+    view = bench_create_view (&window);
+
+    timer = g_timer_new ();
+
+    gossip_chat_view_allow_scroll (view, FALSE);
+
+    for (l = messages; l; l = l->next) {
+        GossipMessage *message;
+        GossipContact *sender;
+
+        message = l->data;
+        sender = gossip_message_get_sender (message);
+
+        if (gossip_contact_equal (own_contact, sender)) {
+            gossip_chat_view_append_message_from_self (view, message,
+                                                       own_contact, NULL);
+        } else {
+            gossip_chat_view_append_message_from_other (view, message,
+                                                        sender, NULL);
+        }
+    }
+
+    gossip_chat_view_allow_scroll (view, TRUE);
+    gossip_chat_view_scroll_down (view);
+    bench_flush ();
+
+    elapsed = g_timer_elapsed (timer, NULL);
+
+    g_timer_destroy (timer);
+    gtk_widget_destroy (window);
+
+    return elapsed;
+}
+
+static gdouble
+bench_batch (GList         *messages,
+             GossipContact *own_contact)
+{
+    GossipChatView *view;
+    GtkWidget      *window;
+    GTimer         *timer;
+    gdouble         elapsed;
+
+    view = bench_create_view (&window);
+
+    timer = g_timer_new ();
+
+    gossip_chat_view_append_messages (view, messages, own_contact);
+    bench_flush ();
+
+    elapsed = g_timer_elapsed (timer, NULL);
+
+    g_timer_destroy (timer);
+    gtk_widget_destroy (window);
+
+    return elapsed;
+}
+
+int
+main (int argc, char *argv[])
+{
+    GossipAccount *account;
+    GossipContact *own_contact;
+    GList         *messages;
+    guint          n_messages = 200;
+    guint          n_runs = 5;
+    gdouble        one_by_one = 0.0;
+    gdouble        batch = 0.0;
+    guint          i;
+
+    gtk_init (&argc, &argv);
+
+    if (argc > 1) {
+        n_messages = atoi (argv[1]);
+    }
+
+    if (argc > 2) {
+        n_runs = MAX (atoi (argv[2]), 1);
+    }
+
+    account = g_object_new (GOSSIP_TYPE_ACCOUNT,
+                            "name", "Benchmark",
+                            "id", "benchmark@example.com",
+                            NULL);
+    own_contact = gossip_contact_new_full (GOSSIP_CONTACT_TYPE_USER,
+                                           account,
+                                           "benchmark@example.com",
+                                           "benchmark@example.com",
+                                           "Me");
+
+    g_print ("Rendering %u backlog messages, %u runs\n", n_messages, n_runs);
+    messages = bench_create_backlog (own_contact, n_messages);
+
+    for (i = 0; i < n_runs; i++) {
+        one_by_one += bench_one_by_one (messages, own_contact);
+        batch += bench_batch (messages, own_contact);
+    }
+
+    g_print ("  %-32s %8.3f s\n", "one message at a time", one_by_one / n_runs);
+    g_print ("  %-32s %8.3f s\n", "gossip_chat_view_append_messages", batch / n_runs);
+
+    g_list_foreach (messages, (GFunc) g_object_unref, NULL);
+    g_list_free (messages);
+
+    g_object_unref (own_contact);
+    g_object_unref (account);
+
+    return EXIT_SUCCESS;
+}
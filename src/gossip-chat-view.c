@@ -30,19 +30,39 @@
 
 #include "gossip-app.h"
 #include "gossip-preferences.h"
+#include "gossip-search-index.h"
 #include "gossip-smiley.h"
 #include "gossip-theme-manager.h"
 #include "gossip-theme-utils.h"
-#include "gossip-text-iter.h"
 #include "gossip-ui-utils.h"
 #include "gossip-chat-view.h"
 
 #define DEBUG_DOMAIN "ChatView"
 
-#define MAX_LINES       800
+/* The scrollback is bounded in message blocks rather than lines, when
+ * it is full we drop the oldest TRIM_BLOCKS in one go so the cost of
+ * trimming is spread out over many appends.
+ */
+#define MAX_BLOCKS      500
+#define TRIM_BLOCKS     (MAX_BLOCKS / 10)
 #define MAX_SCROLL_TIME 0.4 /* Seconds */
 #define SCROLL_DELAY    33  /* Milliseconds */
 
+/* Older messages are read from the logs a page at a time when the
+ * view is scrolled to the top. They are kept on top of the MAX_BLOCKS
+ * of the conversation itself and pages are dropped again once they
+ * are HISTORY_EVICT_SCREENS screens above what is shown.
+ */
+#define HISTORY_PAGE_SIZE     25
+#define MAX_HISTORY_BLOCKS    (HISTORY_PAGE_SIZE * 8)
+#define HISTORY_EVICT_SCREENS 3
+#define RING_BLOCKS           (MAX_BLOCKS + MAX_HISTORY_BLOCKS)
+
+/* Matches outside the visible part are highlighted when idle, this
+ * many at a time.
+ */
+#define HIGHLIGHT_CHUNK       100
+
 #define GET_PRIV(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GOSSIP_TYPE_CHAT_VIEW, GossipChatViewPriv))
 
 struct _GossipChatViewPriv {
@@ -59,11 +79,48 @@ struct _GossipChatViewPriv {
     GTimer        *scroll_timer;
     gboolean       is_group_chat;
 
+    /* Ring of marks at the start of each block in the buffer, the
+     * oldest one is at block_head.
+     */
+    GtkTextMark   *block_marks[RING_BLOCKS];
+    GossipTime     block_times[RING_BLOCKS];
+    guint          block_head;
+    guint          block_count;
+
+    /* Pages of logged messages at the top of the buffer, the first
+     * history_blocks blocks of the ring.
+     */
+    GossipLogReader *history_reader;
+    GossipContact *history_own_contact;
+    GQueue        *history_pages;
+    guint          history_blocks;
+    gboolean       history_seeked;
+    guint          history_idle_id;
+    GtkAdjustment *vadjustment;
+
+    /* Set while a page is inserted at the top of the buffer */
+    GtkTextMark   *prepend_mark;
+    GPtrArray     *prepend_marks;
+    GArray        *prepend_times;
+
     GtkTextMark   *find_mark_previous;
     GtkTextMark   *find_mark_next;
     gboolean       find_wrapped;
     gboolean       find_last_direction;
 
+    /* Built on the first search and kept up to date after that */
+    GossipSearchIndex *search_index;
+    gboolean       search_index_dirty;
+
+    /* Highlighting what is not on screen, from highlight_mark on
+     * and after wrapping around up to highlight_stop.
+     */
+    gchar         *highlight_text;
+    GtkTextMark   *highlight_mark;
+    GtkTextMark   *highlight_stop;
+    gboolean       highlight_wrapped;
+    guint          highlight_idle_id;
+
     /* This is for the group chat so we know if the "other" last contact
      * changed, so we know whether to insert a header or not.
      */
@@ -75,6 +132,11 @@ struct _GossipChatViewPriv {
     guint          notify_font_name_id;
 };
 
+typedef struct {
+    guint n_blocks;
+    guint n_messages;
+} HistoryPage;
+
 static void     gossip_chat_view_class_init          (GossipChatViewClass      *klass);
 static void     gossip_chat_view_init                (GossipChatView           *view);
 static void     chat_view_finalize                   (GObject                  *object);
@@ -85,6 +147,12 @@ static gboolean chat_view_drag_motion                (GtkWidget                *
                                                       guint                     time);
 static void     chat_view_size_allocate              (GtkWidget                *widget,
                                                       GtkAllocation            *alloc);
+static void     chat_view_set_scroll_adjustments_cb  (GossipChatView           *view,
+                                                      GtkAdjustment            *hadj,
+                                                      GtkAdjustment            *vadj,
+                                                      gpointer                  user_data);
+static void     chat_view_value_changed_cb           (GtkAdjustment            *adj,
+                                                      GossipChatView           *view);
 static void     chat_view_set_tags                   (GossipChatView           *view);
 static void     chat_view_set_font_name              (GtkWidget                *view);
 static void     chat_view_notify_font_name_cb        (GossipConf               *conf,
@@ -106,7 +174,7 @@ static gboolean chat_view_url_event_cb               (GtkTextTag               *
                                                       GObject                  *object,
                                                       GdkEvent                 *event,
                                                       GtkTextIter              *iter,
-                                                      GtkTextBuffer            *buffer);
+                                                      gpointer                  user_data);
 static void     chat_view_web_services_google_cb     (GtkMenuItem              *menuitem, 
                                                       const gchar              *text);
 static void     chat_view_web_services_wikipedia_cb  (GtkMenuItem              *menuitem, 
@@ -119,7 +187,49 @@ static void     chat_view_copy_address_cb            (GtkMenuItem              *
                                                       const gchar              *url);
 static void     chat_view_clear_view_cb              (GtkMenuItem              *menuitem,
                                                       GossipChatView           *view);
+static void     chat_view_insert_text_cb             (GtkTextBuffer            *buffer,
+                                                      GtkTextIter              *location,
+                                                      const gchar              *text,
+                                                      gint                      len,
+                                                      GossipChatView           *view);
+static void     chat_view_insert_object_cb           (GtkTextBuffer            *buffer,
+                                                      GtkTextIter              *location,
+                                                      gpointer                  object,
+                                                      GossipChatView           *view);
+static void     chat_view_delete_range_cb            (GtkTextBuffer            *buffer,
+                                                      GtkTextIter              *start,
+                                                      GtkTextIter              *end,
+                                                      GossipChatView           *view);
+static GossipSearchIndex *
+                chat_view_get_search_index           (GossipChatView           *view);
+static gboolean chat_view_search_forward             (GossipChatView           *view,
+                                                      const GtkTextIter        *iter,
+                                                      const gchar              *str,
+                                                      GtkTextIter              *match_start,
+                                                      GtkTextIter              *match_end);
+static gboolean chat_view_search_backward            (GossipChatView           *view,
+                                                      const GtkTextIter        *iter,
+                                                      const gchar              *str,
+                                                      GtkTextIter              *match_start,
+                                                      GtkTextIter              *match_end);
+static void     chat_view_highlight_stop             (GossipChatView           *view);
+static gboolean chat_view_highlight_idle_cb          (GossipChatView           *view);
 static gboolean chat_view_is_scrolled_down           (GossipChatView           *view);
+static void     chat_view_trim_blocks                (GossipChatView           *view,
+                                                      guint                     n_blocks);
+static void     chat_view_begin_block                (GossipChatView           *view,
+                                                      GossipTime                timestamp);
+static void     chat_view_forget_blocks              (GossipChatView           *view);
+static void     chat_view_insert_message             (GossipChatView           *view,
+                                                      GossipMessage            *msg,
+                                                      gboolean                  from_self);
+static void     chat_view_history_forget             (GossipChatView           *view);
+static void     chat_view_history_prepend            (GossipChatView           *view,
+                                                      GList                    *msgs);
+static gboolean chat_view_history_load               (GossipChatView           *view,
+                                                      guint                     n_messages);
+static void     chat_view_history_evict              (GossipChatView           *view);
+static gboolean chat_view_history_idle_cb            (GossipChatView           *view);
 static void     chat_view_invite_accept_cb           (GtkWidget                *button,
                                                       gpointer                  user_data);
 static void     chat_view_invite_decline_cb          (GtkWidget                *button,
@@ -153,10 +263,16 @@ gossip_chat_view_init (GossipChatView *view)
 {
     GossipChatViewPriv *priv;
     gboolean            show_avatars;
+    GTimer             *timer;
 
     priv = GET_PRIV (view);
 
-    priv->buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
+    timer = g_timer_new ();
+
+    /* The view keeps the reference to the buffer */
+    priv->buffer = gtk_text_buffer_new (gossip_theme_get_tag_table ());
+    gtk_text_view_set_buffer (GTK_TEXT_VIEW (view), priv->buffer);
+    g_object_unref (priv->buffer);
 
     gossip_chat_view_set_last_block_type (view, BLOCK_TYPE_NONE);
     gossip_chat_view_set_last_timestamp (view, 0);
@@ -165,6 +281,8 @@ gossip_chat_view_init (GossipChatView *view)
 
     priv->is_group_chat = FALSE;
 
+    priv->history_pages = g_queue_new ();
+
     g_object_set (view,
                   "wrap-mode", GTK_WRAP_WORD_CHAR,
                   "editable", FALSE,
@@ -215,11 +333,38 @@ gossip_chat_view_init (GossipChatView *view)
                       G_CALLBACK (chat_view_populate_popup),
                       NULL);
 
+    g_signal_connect_after (view,
+                            "set-scroll-adjustments",
+                            G_CALLBACK (chat_view_set_scroll_adjustments_cb),
+                            NULL);
+
+    /* Keeps the search index, if there is one, in step */
+    g_signal_connect_after (priv->buffer,
+                            "insert-text",
+                            G_CALLBACK (chat_view_insert_text_cb),
+                            view);
+    g_signal_connect_after (priv->buffer,
+                            "insert-pixbuf",
+                            G_CALLBACK (chat_view_insert_object_cb),
+                            view);
+    g_signal_connect_after (priv->buffer,
+                            "insert-child-anchor",
+                            G_CALLBACK (chat_view_insert_object_cb),
+                            view);
+    g_signal_connect (priv->buffer,
+                      "delete-range",
+                      G_CALLBACK (chat_view_delete_range_cb),
+                      view);
+
     g_signal_connect_object (gossip_theme_manager_get (),
                              "theme-changed",
                              G_CALLBACK (chat_view_theme_changed_cb),
                              view,
                              0);
+
+    gossip_debug (DEBUG_DOMAIN, "Created view in %.2f ms",
+                  g_timer_elapsed (timer, NULL) * 1000);
+    g_timer_destroy (timer);
 }
 
 static void
@@ -258,6 +403,34 @@ chat_view_finalize (GObject *object)
     if (priv->scroll_timeout) {
         g_source_remove (priv->scroll_timeout);
     }
+
+    if (priv->vadjustment) {
+        g_signal_handlers_disconnect_by_func (priv->vadjustment,
+                                              chat_view_value_changed_cb,
+                                              view);
+        g_object_unref (priv->vadjustment);
+    }
+
+    if (priv->history_idle_id) {
+        g_source_remove (priv->history_idle_id);
+    }
+
+    g_queue_foreach (priv->history_pages, (GFunc) g_free, NULL);
+    g_queue_free (priv->history_pages);
+
+    if (priv->history_reader) {
+        gossip_log_reader_free (priv->history_reader);
+    }
+
+    if (priv->history_own_contact) {
+        g_object_unref (priv->history_own_contact);
+    }
+
+    chat_view_highlight_stop (view);
+
+    if (priv->search_index) {
+        gossip_search_index_free (priv->search_index);
+    }
         
     G_OBJECT_CLASS (gossip_chat_view_parent_class)->finalize (object);
 }
@@ -295,14 +468,82 @@ chat_view_size_allocate (GtkWidget     *widget,
     }
 }
 
+static void
+chat_view_set_scroll_adjustments_cb (GossipChatView *view,
+                                     GtkAdjustment  *hadj,
+                                     GtkAdjustment  *vadj,
+                                     gpointer        user_data)
+{
+    GossipChatViewPriv *priv;
+
+    priv = GET_PRIV (view);
+
+    if (priv->vadjustment) {
+        g_signal_handlers_disconnect_by_func (priv->vadjustment,
+                                              chat_view_value_changed_cb,
+                                              view);
+        g_object_unref (priv->vadjustment);
+        priv->vadjustment = NULL;
+    }
+
+    if (vadj) {
+        priv->vadjustment = g_object_ref (vadj);
+        g_signal_connect (vadj,
+                          "value-changed",
+                          G_CALLBACK (chat_view_value_changed_cb),
+                          view);
+    }
+}
+
+static void
+chat_view_value_changed_cb (GtkAdjustment  *adj,
+                            GossipChatView *view)
+{
+    GossipChatViewPriv *priv;
+
+    priv = GET_PRIV (view);
+
+    if (!priv->history_reader || priv->history_idle_id) {
+        return;
+    }
+
+    /* Nothing to scroll, so the user can't have asked for more */
+    if (adj->upper - adj->lower <= adj->page_size) {
+        return;
+    }
+
+    if (adj->value > adj->lower && g_queue_is_empty (priv->history_pages)) {
+        return;
+    }
+
+    /* Don't change the buffer from inside the adjustment signal */
+    priv->history_idle_id = g_idle_add ((GSourceFunc) chat_view_history_idle_cb,
+                                        view);
+}
+
 static void
 chat_view_set_tags (GossipChatView *view)
 {
     GossipChatViewPriv *priv;
+    GtkTextTagTable    *table;
     GtkTextTag         *tag;
 
     priv = GET_PRIV (view);
 
+    /* The tag table is shared by all views, only the first one has to
+     * create the tags.
+     */
+    table = gtk_text_buffer_get_tag_table (priv->buffer);
+    tag = gtk_text_tag_table_lookup (table, "link");
+
+    if (tag) {
+        g_signal_connect (view,
+                          "motion-notify-event",
+                          G_CALLBACK (chat_view_event_cb),
+                          tag);
+        return;
+    }
+
     gtk_text_buffer_create_tag (priv->buffer,
                                 "cut",
                                 NULL);
@@ -326,7 +567,7 @@ chat_view_set_tags (GossipChatView *view)
     g_signal_connect (tag,
                       "event",
                       G_CALLBACK (chat_view_url_event_cb),
-                      priv->buffer);
+                      NULL);
 
     g_signal_connect (view,
                       "motion-notify-event",
@@ -642,10 +883,14 @@ chat_view_url_event_cb (GtkTextTag    *tag,
                         GObject       *object,
                         GdkEvent      *event,
                         GtkTextIter   *iter,
-                        GtkTextBuffer *buffer)
+                        gpointer       user_data)
 {
-    GtkTextIter  start, end;
-    gchar       *str;
+    GtkTextBuffer *buffer;
+    GtkTextIter    start, end;
+    gchar         *str;
+
+    /* The tag is shared, so go by the buffer the event happened in */
+    buffer = gtk_text_iter_get_buffer (iter);
 
     /* If the link is being selected, don't do anything. */
     gtk_text_buffer_get_selection_bounds (buffer, &start, &end);
@@ -783,6 +1028,158 @@ chat_view_clear_view_cb (GtkMenuItem    *menuitem,
     gossip_chat_view_clear (view);
 }
 
+static void
+chat_view_insert_text_cb (GtkTextBuffer  *buffer,
+                          GtkTextIter    *location,
+                          const gchar    *text,
+                          gint            len,
+                          GossipChatView *view)
+{
+    GossipChatViewPriv *priv;
+
+    priv = GET_PRIV (view);
+
+    if (!priv->search_index || priv->search_index_dirty) {
+        return;
+    }
+
+    /* Appending is all the index can follow, for anything else it
+     * is built again on the next search.
+     */
+    if (gtk_text_iter_is_end (location)) {
+        gossip_search_index_append (priv->search_index, text, len);
+    } else {
+        priv->search_index_dirty = TRUE;
+    }
+}
+
+static void
+chat_view_insert_object_cb (GtkTextBuffer  *buffer,
+                            GtkTextIter    *location,
+                            gpointer        object,
+                            GossipChatView *view)
+{
+    /* Pixbufs and widgets take up one character in the buffer */
+    chat_view_insert_text_cb (buffer, location, "\xef\xbf\xbc", 3, view);
+}
+
+static void
+chat_view_delete_range_cb (GtkTextBuffer  *buffer,
+                           GtkTextIter    *start,
+                           GtkTextIter    *end,
+                           GossipChatView *view)
+{
+    GossipChatViewPriv *priv;
+
+    priv = GET_PRIV (view);
+
+    if (!priv->search_index || priv->search_index_dirty) {
+        return;
+    }
+
+    /* Trimming the scrollback cuts from the start */
+    if (gtk_text_iter_is_start (start)) {
+        gossip_search_index_trim (priv->search_index,
+                                  gtk_text_iter_get_offset (end));
+    } else {
+        priv->search_index_dirty = TRUE;
+    }
+}
+
+static GossipSearchIndex *
+chat_view_get_search_index (GossipChatView *view)
+{
+    GossipChatViewPriv *priv;
+    GtkTextIter         start, end;
+    gchar              *text;
+
+    priv = GET_PRIV (view);
+
+    if (priv->search_index && !priv->search_index_dirty) {
+        return priv->search_index;
+    }
+
+    if (priv->search_index) {
+        gossip_search_index_free (priv->search_index);
+    }
+
+    gossip_debug (DEBUG_DOMAIN, "Building search index");
+
+    /* With the 0xFFFC for pixbufs and widgets so offsets match */
+    gtk_text_buffer_get_bounds (priv->buffer, &start, &end);
+    text = gtk_text_buffer_get_slice (priv->buffer, &start, &end, TRUE);
+
+    priv->search_index = gossip_search_index_new ();
+    priv->search_index_dirty = FALSE;
+
+    gossip_search_index_append (priv->search_index, text, -1);
+    g_free (text);
+
+    return priv->search_index;
+}
+
+/* Like gossip_text_iter_forward_search() but using the index. */
+static gboolean
+chat_view_search_forward (GossipChatView    *view,
+                          const GtkTextIter *iter,
+                          const gchar       *str,
+                          GtkTextIter       *match_start,
+                          GtkTextIter       *match_end)
+{
+    GossipChatViewPriv *priv;
+    GossipSearchIndex  *index;
+    gint                n, start, end;
+
+    priv = GET_PRIV (view);
+
+    index = chat_view_get_search_index (view);
+    if (gossip_search_index_find (index, str) == 0) {
+        return FALSE;
+    }
+
+    n = gossip_search_index_find_forward (index, gtk_text_iter_get_offset (iter));
+    if (n < 0) {
+        return FALSE;
+    }
+
+    gossip_search_index_get_match (index, n, &start, &end);
+    gtk_text_buffer_get_iter_at_offset (priv->buffer, match_start, start);
+    gtk_text_buffer_get_iter_at_offset (priv->buffer, match_end, end);
+
+    return TRUE;
+}
+
+/* Like gossip_text_iter_backward_search() but using the index. */
+static gboolean
+chat_view_search_backward (GossipChatView    *view,
+                           const GtkTextIter *iter,
+                           const gchar       *str,
+                           GtkTextIter       *match_start,
+                           GtkTextIter       *match_end)
+{
+    GossipChatViewPriv *priv;
+    GossipSearchIndex  *index;
+    gint                n, start, end;
+
+    priv = GET_PRIV (view);
+
+    index = chat_view_get_search_index (view);
+    if (gossip_search_index_find (index, str) == 0) {
+        return FALSE;
+    }
+
+    n = gossip_search_index_find_backward (index, gtk_text_iter_get_offset (iter));
+    if (n < 0) {
+        return FALSE;
+    }
+
+    gossip_search_index_get_match (index, n, &start, &end);
+    gtk_text_buffer_get_iter_at_offset (priv->buffer, match_start, start);
+    gtk_text_buffer_get_iter_at_offset (priv->buffer, match_end, end);
+
+    return TRUE;
+}
+
 static gboolean
 chat_view_is_scrolled_down (GossipChatView *view)
 {
@@ -803,49 +1200,407 @@ chat_view_is_scrolled_down (GossipChatView *view)
 }
 
 static void
-chat_view_maybe_trim_buffer (GossipChatView *view)
+chat_view_trim_blocks (GossipChatView *view,
+                       guint           n_blocks)
 {
     GossipChatViewPriv *priv;
     GtkTextIter         top, bottom;
-    gint                line;
-    gint                remove;
-    GtkTextTagTable    *table;
-    GtkTextTag         *tag;
+    GtkTextMark        *mark;
+    guint               n_history;
+    guint               i;
 
     priv = GET_PRIV (view);
 
-    gtk_text_buffer_get_end_iter (priv->buffer, &bottom);
-    line = gtk_text_iter_get_line (&bottom);
-    if (line < MAX_LINES) {
+    /* History pages only go as a whole, and the reader gets their
+     * messages back so they are read again when scrolling up.
+     */
+    n_history = 0;
+    while (n_history < n_blocks && !g_queue_is_empty (priv->history_pages)) {
+        HistoryPage *page;
+
+        page = g_queue_pop_head (priv->history_pages);
+
+        n_history += page->n_blocks;
+        priv->history_blocks -= page->n_blocks;
+        gossip_log_reader_forward (priv->history_reader, page->n_messages);
+
+        g_free (page);
+    }
+
+    /* Once the conversation itself is cut, the next page has to be
+     * looked up from what is then the oldest block.
+     */
+    if (n_blocks > n_history) {
+        priv->history_seeked = FALSE;
+    }
+
+    n_blocks = MAX (n_blocks, n_history);
+
+    if (n_blocks == 0) {
         return;
     }
 
-    remove = line - MAX_LINES;
+    if (n_blocks >= priv->block_count) {
+        n_blocks = priv->block_count;
+        gtk_text_buffer_get_end_iter (priv->buffer, &bottom);
+    } else {
+        /* Every mark sits where a block starts so cutting up to one
+         * of them never leaves half a message (or a dangling tag)
+         * behind.
+         */
+        mark = priv->block_marks[(priv->block_head + n_blocks) % RING_BLOCKS];
+        gtk_text_buffer_get_iter_at_mark (priv->buffer, &bottom, mark);
+    }
+
     gtk_text_buffer_get_start_iter (priv->buffer, &top);
 
-    bottom = top;
-    if (!gtk_text_iter_forward_lines (&bottom, remove)) {
+    if (!gtk_text_iter_equal (&top, &bottom)) {
+        gtk_text_buffer_delete (priv->buffer, &top, &bottom);
+    }
+
+    for (i = 0; i < n_blocks; i++) {
+        mark = priv->block_marks[priv->block_head];
+        gtk_text_buffer_delete_mark (priv->buffer, mark);
+        priv->block_marks[priv->block_head] = NULL;
+
+        priv->block_head = (priv->block_head + 1) % RING_BLOCKS;
+    }
+
+    priv->block_count -= n_blocks;
+
+    gossip_debug (DEBUG_DOMAIN, "Trimmed %d blocks from the buffer",
+                  n_blocks);
+}
+
+static void
+chat_view_maybe_trim_buffer (GossipChatView *view)
+{
+    GossipChatViewPriv *priv;
+
+    priv = GET_PRIV (view);
+
+    if (priv->block_count - priv->history_blocks < MAX_BLOCKS) {
         return;
     }
 
-    /* Track backwords to a place where we can safely cut, we don't do it in
-     * the middle of a tag.
-     */
-    table = gtk_text_buffer_get_tag_table (priv->buffer);
-    tag = gtk_text_tag_table_lookup (table, "cut");
-    if (!tag) {
+    chat_view_trim_blocks (view, priv->history_blocks + TRIM_BLOCKS);
+}
+
+static void
+chat_view_begin_block (GossipChatView *view,
+                       GossipTime      timestamp)
+{
+    GossipChatViewPriv *priv;
+    GtkTextMark        *mark;
+    GtkTextIter         iter;
+    guint               tail;
+
+    priv = GET_PRIV (view);
+
+    if (!priv->prepend_mark) {
+        chat_view_maybe_trim_buffer (view);
+    }
+
+    /* Left gravity so the mark stays in front of what is appended. */
+    gossip_chat_view_get_end_iter (view, &iter);
+    mark = gtk_text_buffer_create_mark (priv->buffer, NULL, &iter, TRUE);
+
+    if (priv->prepend_mark) {
+        /* Goes in front of the ring once the page is done */
+        g_ptr_array_add (priv->prepend_marks, mark);
+        g_array_append_val (priv->prepend_times, timestamp);
         return;
     }
 
-    if (!gtk_text_iter_forward_to_tag_toggle (&bottom, tag)) {
+    tail = (priv->block_head + priv->block_count) % RING_BLOCKS;
+    priv->block_marks[tail] = mark;
+    priv->block_times[tail] = timestamp;
+    priv->block_count++;
+}
+
+static void
+chat_view_forget_blocks (GossipChatView *view)
+{
+    GossipChatViewPriv *priv;
+    guint               i;
+
+    priv = GET_PRIV (view);
+
+    for (i = 0; i < priv->block_count; i++) {
+        guint index;
+
+        index = (priv->block_head + i) % RING_BLOCKS;
+        gtk_text_buffer_delete_mark (priv->buffer, priv->block_marks[index]);
+        priv->block_marks[index] = NULL;
+    }
+
+    priv->block_head = 0;
+    priv->block_count = 0;
+
+    chat_view_history_forget (view);
+}
+
+static void
+chat_view_history_forget (GossipChatView *view)
+{
+    GossipChatViewPriv *priv;
+
+    priv = GET_PRIV (view);
+
+    g_queue_foreach (priv->history_pages, (GFunc) g_free, NULL);
+    g_queue_clear (priv->history_pages);
+
+    priv->history_blocks = 0;
+    priv->history_seeked = FALSE;
+}
+
+static void
+chat_view_history_prepend (GossipChatView *view,
+                           GList          *msgs)
+{
+    GossipChatViewPriv *priv;
+    GtkTextIter         iter;
+    GtkTextMark        *anchor = NULL;
+    GtkTextMark        *old_head = NULL;
+    GossipContact      *last_contact;
+    BlockType           last_block_type;
+    time_t              last_timestamp;
+    HistoryPage        *page;
+    GList              *l;
+    guint               n_messages = 0;
+    gint                i;
+
+    priv = GET_PRIV (view);
+
+    if (priv->block_count > 0) {
+        GdkRectangle rect;
+
+        old_head = priv->block_marks[priv->block_head];
+
+        /* Remember the line at the top of the view so we can put it
+         * back there once the page is in.
+         */
+        gtk_text_view_get_visible_rect (GTK_TEXT_VIEW (view), &rect);
+        gtk_text_view_get_line_at_y (GTK_TEXT_VIEW (view), &iter, rect.y, NULL);
+        anchor = gtk_text_buffer_create_mark (priv->buffer, NULL, &iter, FALSE);
+    }
+
+    /* The page is laid out as if it started the conversation, so
+     * the themes add their headers and time stamps to it.
+     */
+    last_contact = priv->last_contact;
+    last_block_type = priv->last_block_type;
+    last_timestamp = priv->last_timestamp;
+
+    priv->last_contact = NULL;
+    priv->last_block_type = BLOCK_TYPE_NONE;
+    priv->last_timestamp = 0;
+
+    /* Right gravity so it moves along with what we insert in front */
+    gtk_text_buffer_get_start_iter (priv->buffer, &iter);
+    priv->prepend_mark = gtk_text_buffer_create_mark (priv->buffer, NULL,
+                                                      &iter, FALSE);
+    priv->prepend_marks = g_ptr_array_new ();
+    priv->prepend_times = g_array_new (FALSE, FALSE, sizeof (GossipTime));
+
+    gtk_text_buffer_begin_user_action (priv->buffer);
+
+    for (l = msgs; l; l = l->next) {
+        GossipMessage *msg;
+        gboolean       from_self;
+
+        msg = l->data;
+        n_messages++;
+
+        if (!gossip_message_get_body (msg)) {
+            continue;
+        }
+
+        from_self = priv->history_own_contact &&
+            gossip_contact_equal (priv->history_own_contact,
+                                  gossip_message_get_sender (msg));
+
+        chat_view_insert_message (view, msg, from_self);
+    }
+
+    gtk_text_buffer_end_user_action (priv->buffer);
+
+    /* The old first block started the buffer and its left gravity
+     * mark stayed there, in front of the page.
+     */
+    gtk_text_buffer_get_iter_at_mark (priv->buffer, &iter, priv->prepend_mark);
+    if (old_head) {
+        gtk_text_buffer_move_mark (priv->buffer, old_head, &iter);
+    }
+
+    for (i = (gint) priv->prepend_marks->len - 1; i >= 0; i--) {
+        priv->block_head = (priv->block_head + RING_BLOCKS - 1) % RING_BLOCKS;
+        priv->block_marks[priv->block_head] = g_ptr_array_index (priv->prepend_marks, i);
+        priv->block_times[priv->block_head] = g_array_index (priv->prepend_times,
+                                                             GossipTime, i);
+        priv->block_count++;
+    }
+
+    /* Messages without a body make no block, they are counted with
+     * the page below so the reader can be given them back.
+     */
+    page = g_queue_peek_head (priv->history_pages);
+    if (priv->prepend_marks->len > 0 || !page) {
+        page = g_new0 (HistoryPage, 1);
+        g_queue_push_head (priv->history_pages, page);
+    }
+
+    page->n_blocks += priv->prepend_marks->len;
+    page->n_messages += n_messages;
+    priv->history_blocks += priv->prepend_marks->len;
+
+    gossip_debug (DEBUG_DOMAIN, "Prepended %d logged messages as %d blocks",
+                  n_messages, priv->prepend_marks->len);
+
+    g_ptr_array_free (priv->prepend_marks, TRUE);
+    g_array_free (priv->prepend_times, TRUE);
+    priv->prepend_marks = NULL;
+    priv->prepend_times = NULL;
+
+    gtk_text_buffer_delete_mark (priv->buffer, priv->prepend_mark);
+    priv->prepend_mark = NULL;
+
+    gossip_chat_view_set_last_contact (view, NULL);
+    priv->last_contact = last_contact;
+    priv->last_block_type = last_block_type;
+    priv->last_timestamp = last_timestamp;
+
+    if (anchor) {
+        gtk_text_view_scroll_to_mark (GTK_TEXT_VIEW (view), anchor,
+                                      0.0, TRUE, 0.0, 0.0);
+        gtk_text_buffer_delete_mark (priv->buffer, anchor);
+    }
+}
+
+static gboolean
+chat_view_history_load (GossipChatView *view,
+                        guint           n_messages)
+{
+    GossipChatViewPriv *priv;
+    GList              *msgs;
+
+    priv = GET_PRIV (view);
+
+    if (!priv->history_reader) {
+        return FALSE;
+    }
+
+    n_messages = MIN (n_messages, MAX_HISTORY_BLOCKS - priv->history_blocks);
+    if (n_messages == 0) {
+        gossip_debug (DEBUG_DOMAIN, "History is full, not loading more");
+        return FALSE;
+    }
+
+    if (!priv->history_seeked) {
+        GossipTime before;
+
+        /* Carry on from the oldest thing shown, or from the newest
+         * logged message if there is nothing yet.
+         */
+        if (priv->block_count > 0) {
+            before = priv->block_times[priv->block_head];
+        } else {
+            before = G_MAXLONG;
+        }
+
+        gossip_log_reader_seek (priv->history_reader, before);
+        priv->history_seeked = TRUE;
+    }
+
+    if (!gossip_log_reader_has_previous (priv->history_reader)) {
+        return FALSE;
+    }
+
+    msgs = gossip_log_reader_get_previous (priv->history_reader, n_messages);
+    if (!msgs) {
+        return FALSE;
+    }
+
+    chat_view_history_prepend (view, msgs);
+
+    g_list_foreach (msgs, (GFunc) g_object_unref, NULL);
+    g_list_free (msgs);
+
+    return TRUE;
+}
+
+static void
+chat_view_history_evict (GossipChatView *view)
+{
+    GossipChatViewPriv *priv;
+    GtkAdjustment      *adj;
+
+    priv = GET_PRIV (view);
+
+    adj = priv->vadjustment;
+    if (!adj) {
         return;
     }
 
-    if (!gtk_text_iter_equal (&top, &bottom)) {
-        gtk_text_buffer_delete (priv->buffer, &top, &bottom);
+    /* Drop pages from the top while the whole page is far enough
+     * above the view that nobody is looking at it.
+     */
+    while (!g_queue_is_empty (priv->history_pages)) {
+        HistoryPage *page;
+        GtkTextIter  iter;
+        guint        index;
+        gint         y;
+
+        page = g_queue_peek_head (priv->history_pages);
+
+        if (page->n_blocks == 0) {
+            /* Nothing in it to show, just give it back */
+            g_queue_pop_head (priv->history_pages);
+            gossip_log_reader_forward (priv->history_reader, page->n_messages);
+            g_free (page);
+            continue;
+        }
+
+        index = (priv->block_head + page->n_blocks) % RING_BLOCKS;
+        gtk_text_buffer_get_iter_at_mark (priv->buffer, &iter,
+                                          priv->block_marks[index]);
+        gtk_text_view_get_line_yrange (GTK_TEXT_VIEW (view), &iter, &y, NULL);
+
+        if (y > adj->value - HISTORY_EVICT_SCREENS * adj->page_size) {
+            break;
+        }
+
+        gossip_debug (DEBUG_DOMAIN, "Evicting history page of %d blocks",
+                      page->n_blocks);
+
+        chat_view_trim_blocks (view, page->n_blocks);
     }
 }
 
+static gboolean
+chat_view_history_idle_cb (GossipChatView *view)
+{
+    GossipChatViewPriv *priv;
+    GtkAdjustment      *adj;
+
+    priv = GET_PRIV (view);
+
+    priv->history_idle_id = 0;
+
+    adj = priv->vadjustment;
+    if (!adj) {
+        return FALSE;
+    }
+
+    if (adj->value <= adj->lower) {
+        chat_view_history_load (view, HISTORY_PAGE_SIZE);
+    } else {
+        chat_view_history_evict (view);
+    }
+
+    return FALSE;
+}
+
 static void
 chat_view_invite_accept_cb (GtkWidget *button,
                             gpointer   user_data)
@@ -957,25 +1712,81 @@ gossip_chat_view_new (void)
     return g_object_new (GOSSIP_TYPE_CHAT_VIEW, NULL);
 }
 
-static void
-chat_view_append_message (GossipChatView *view,
-                          GossipMessage  *msg,
-                          GossipContact  *contact,
-                          GdkPixbuf      *avatar,
-                          gboolean        from_self)
+/* Where themes insert the next bit of a block, the end of the buffer
+ * unless a page of history is being put in at the top.
+ */
+void
+gossip_chat_view_get_end_iter (GossipChatView *view,
+                               GtkTextIter    *iter)
 {
     GossipChatViewPriv *priv;
-    gboolean            bottom;
+
+    g_return_if_fail (GOSSIP_IS_CHAT_VIEW (view));
+    g_return_if_fail (iter != NULL);
 
     priv = GET_PRIV (view);
 
-    if (!gossip_message_get_body (msg)) {
-        return;
+    if (priv->prepend_mark) {
+        gtk_text_buffer_get_iter_at_mark (priv->buffer, iter, priv->prepend_mark);
+    } else {
+        gtk_text_buffer_get_end_iter (priv->buffer, iter);
     }
+}
 
-    bottom = chat_view_is_scrolled_down (view);
+/* Takes the reader, older messages are read from it and put above
+ * what is in the view when scrolling to the top.
+ */
+void
+gossip_chat_view_set_history (GossipChatView  *view,
+                              GossipLogReader *reader,
+                              GossipContact   *own_contact)
+{
+    GossipChatViewPriv *priv;
+
+    g_return_if_fail (GOSSIP_IS_CHAT_VIEW (view));
+    g_return_if_fail (own_contact == NULL || GOSSIP_IS_CONTACT (own_contact));
+
+    priv = GET_PRIV (view);
+
+    if (priv->history_reader) {
+        gossip_log_reader_free (priv->history_reader);
+    }
+
+    if (priv->history_own_contact) {
+        g_object_unref (priv->history_own_contact);
+    }
+
+    priv->history_reader = reader;
+    priv->history_own_contact = own_contact ? g_object_ref (own_contact) : NULL;
+
+    /* Pages already shown came from the old reader, keep them but
+     * don't give anything back to the new one.
+     */
+    g_queue_foreach (priv->history_pages, (GFunc) g_free, NULL);
+    g_queue_clear (priv->history_pages);
+    priv->history_blocks = 0;
+    priv->history_seeked = FALSE;
+}
+
+gboolean
+gossip_chat_view_load_history (GossipChatView *view,
+                               guint           n_messages)
+{
+    g_return_val_if_fail (GOSSIP_IS_CHAT_VIEW (view), FALSE);
+
+    return chat_view_history_load (view, n_messages);
+}
+
+static void
+chat_view_insert_message (GossipChatView *view,
+                          GossipMessage  *msg,
+                          gboolean        from_self)
+{
+    GossipChatViewPriv *priv;
+
+    priv = GET_PRIV (view);
 
-    chat_view_maybe_trim_buffer (view);
+    chat_view_begin_block (view, gossip_message_get_timestamp (msg));
 
     /* Handle action messages (/me) and normal messages, in combination with
      * irc style and fancy style.
@@ -987,6 +1798,24 @@ chat_view_append_message (GossipChatView *view,
         gossip_theme_append_message (priv->theme, priv->theme_context,
                                      view, msg, from_self);
     }
+}
+
+static void
+chat_view_append_message (GossipChatView *view,
+                          GossipMessage  *msg,
+                          GossipContact  *contact,
+                          GdkPixbuf      *avatar,
+                          gboolean        from_self)
+{
+    gboolean bottom;
+
+    if (!gossip_message_get_body (msg)) {
+        return;
+    }
+
+    bottom = chat_view_is_scrolled_down (view);
+
+    chat_view_insert_message (view, msg, from_self);
 
     if (bottom) {
         gossip_chat_view_scroll_down_smoothly (view);
@@ -1019,6 +1848,84 @@ gossip_chat_view_append_message_from_other (GossipChatView *view,
     chat_view_append_message (view, msg, contact, avatar, FALSE);
 }
 
+void
+gossip_chat_view_append_messages (GossipChatView *view,
+                                  GList          *msgs,
+                                  GossipContact  *own_contact)
+{
+    GossipChatViewPriv *priv;
+    GList              *l;
+    guint               n_total;
+    guint               n_msgs;
+    guint               n_free;
+    gboolean            bottom;
+    gboolean            allow_scrolling;
+
+    g_return_if_fail (GOSSIP_IS_CHAT_VIEW (view));
+    g_return_if_fail (own_contact == NULL || GOSSIP_IS_CONTACT (own_contact));
+
+    priv = GET_PRIV (view);
+
+    if (!msgs) {
+        return;
+    }
+
+    /* Anything older than the last MAX_BLOCKS messages would be
+     * trimmed again straight away, so don't bother rendering it.
+     */
+    n_total = n_msgs = g_list_length (msgs);
+    for (l = msgs; l && n_msgs > MAX_BLOCKS; l = l->next) {
+        n_msgs--;
+    }
+
+    gossip_debug (DEBUG_DOMAIN, "Appending %d messages (%d skipped)",
+                  n_msgs, n_total - n_msgs);
+
+    bottom = chat_view_is_scrolled_down (view);
+
+    /* Make room for the whole batch up front so we trim at most once,
+     * any history above the conversation goes first.
+     */
+    n_free = MAX_BLOCKS - (priv->block_count - priv->history_blocks);
+    if (n_msgs > n_free) {
+        guint n_trim;
+
+        n_trim = ((n_msgs - n_free + TRIM_BLOCKS - 1) / TRIM_BLOCKS) * TRIM_BLOCKS;
+        n_trim = MIN (n_trim, priv->block_count - priv->history_blocks);
+        chat_view_trim_blocks (view, priv->history_blocks + n_trim);
+    }
+
+    allow_scrolling = priv->allow_scrolling;
+    priv->allow_scrolling = FALSE;
+
+    gtk_text_buffer_begin_user_action (priv->buffer);
+
+    for (; l; l = l->next) {
+        GossipMessage *msg;
+        gboolean       from_self;
+
+        msg = l->data;
+
+        if (!gossip_message_get_body (msg)) {
+            continue;
+        }
+
+        from_self = own_contact &&
+            gossip_contact_equal (own_contact,
+                                  gossip_message_get_sender (msg));
+
+        chat_view_insert_message (view, msg, from_self);
+    }
+
+    gtk_text_buffer_end_user_action (priv->buffer);
+
+    priv->allow_scrolling = allow_scrolling;
+
+    if (bottom) {
+        gossip_chat_view_scroll_down (view);
+    }
+}
+
 void
 gossip_chat_view_append_event (GossipChatView *view,
                                const gchar    *str)
@@ -1033,7 +1940,7 @@ gossip_chat_view_append_event (GossipChatView *view,
 
     bottom = chat_view_is_scrolled_down (view);
 
-    chat_view_maybe_trim_buffer (view);
+    chat_view_begin_block (view, gossip_time_get_current ());
 
     gossip_theme_append_event (priv->theme, 
                                priv->theme_context,
@@ -1058,17 +1965,19 @@ gossip_chat_view_append_invite (GossipChatView *view,
     const gchar          *id_str;
     const gchar          *reason;
     gboolean              bottom;
-    const gchar          *tag;
+    gchar                *tag;
     gchar                *str;
 
     g_return_if_fail (GOSSIP_IS_CHAT_VIEW (view));
 
     priv = GET_PRIV (view);
 
-    tag = "invite";
+    tag = gossip_theme_get_tag_name (priv->theme, "invite");
 
     bottom = chat_view_is_scrolled_down (view);
 
+    chat_view_begin_block (view, gossip_time_get_current ());
+
     invite = gossip_message_get_invite (message);
     inviter = gossip_chatroom_invite_get_inviter (invite);
     id_str = gossip_chatroom_invite_get_id (invite);
@@ -1162,6 +2071,8 @@ gossip_chat_view_append_invite (GossipChatView *view,
                                               tag,
                                               NULL);
 
+    g_free (tag);
+
     if (bottom) {
         gossip_chat_view_scroll_down_smoothly (view);
     }
@@ -1179,17 +2090,19 @@ gossip_chat_view_append_button (GossipChatView *view,
     GtkTextChildAnchor   *anchor;
     GtkTextIter           iter;
     gboolean              bottom;
-    const gchar          *tag;
+    gchar                *tag;
 
     g_return_if_fail (GOSSIP_IS_CHAT_VIEW (view));
     g_return_if_fail (button1 != NULL);
 
     priv = GET_PRIV (view);
 
-    tag = "invite";
+    tag = gossip_theme_get_tag_name (priv->theme, "invite");
 
     bottom = chat_view_is_scrolled_down (view);
 
+    chat_view_begin_block (view, gossip_time_get_current ());
+
     /* FIXME: We don't call this because it breaks, GossipMessage
      * can not be NULL.
      */
@@ -1238,6 +2151,8 @@ gossip_chat_view_append_button (GossipChatView *view,
                                               tag,
                                               NULL);
 
+    g_free (tag);
+
     if (bottom) {
         gossip_chat_view_scroll_down_smoothly (view);
     }
@@ -1393,6 +2308,8 @@ gossip_chat_view_clear (GossipChatView *view)
 
     g_return_if_fail (GOSSIP_IS_CHAT_VIEW (view));
 
+    chat_view_forget_blocks (view);
+
     buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
     gtk_text_buffer_set_text (buffer, "", -1);
 
@@ -1464,11 +2381,11 @@ gossip_chat_view_find_previous (GossipChatView *view,
 
     priv->find_last_direction = FALSE;
 
-    found = gossip_text_iter_backward_search (&iter_at_mark,
-                                              search_criteria,
-                                              &iter_match_start,
-                                              &iter_match_end,
-                                              NULL);
+    found = chat_view_search_backward (view,
+                                       &iter_at_mark,
+                                       search_criteria,
+                                       &iter_match_start,
+                                       &iter_match_end);
 
     if (!found) {
         gboolean result = FALSE;
@@ -1579,11 +2496,11 @@ gossip_chat_view_find_next (GossipChatView *view,
 
     priv->find_last_direction = TRUE;
 
-    found = gossip_text_iter_forward_search (&iter_at_mark,
-                                             search_criteria,
-                                             &iter_match_start,
-                                             &iter_match_end,
-                                             NULL);
+    found = chat_view_search_forward (view,
+                                      &iter_at_mark,
+                                      search_criteria,
+                                      &iter_match_start,
+                                      &iter_match_end);
 
     if (!found) {
         gboolean result = FALSE;
@@ -1668,11 +2585,11 @@ gossip_chat_view_find_abilities (GossipChatView *view,
             gtk_text_buffer_get_start_iter (buffer, &iter_at_mark);
         }
                 
-        *can_do_previous = gossip_text_iter_backward_search (&iter_at_mark,
-                                                             search_criteria,
-                                                             &iter_match_start,
-                                                             &iter_match_end,
-                                                             NULL);
+        *can_do_previous = chat_view_search_backward (view,
+                                                      &iter_at_mark,
+                                                      search_criteria,
+                                                      &iter_match_start,
+                                                      &iter_match_end);
     }
 
     if (can_do_next) {
@@ -1684,34 +2601,145 @@ gossip_chat_view_find_abilities (GossipChatView *view,
             gtk_text_buffer_get_start_iter (buffer, &iter_at_mark);
         }
                 
-        *can_do_next = gossip_text_iter_forward_search (&iter_at_mark,
-                                                        search_criteria,
-                                                        &iter_match_start,
-                                                        &iter_match_end,
-                                                        NULL);
+        *can_do_next = chat_view_search_forward (view,
+                                                 &iter_at_mark,
+                                                 search_criteria,
+                                                 &iter_match_start,
+                                                 &iter_match_end);
+    }
+}
+
+static void
+chat_view_highlight_stop (GossipChatView *view)
+{
+    GossipChatViewPriv *priv;
+
+    priv = GET_PRIV (view);
+
+    if (priv->highlight_idle_id) {
+        g_source_remove (priv->highlight_idle_id);
+        priv->highlight_idle_id = 0;
+    }
+
+    if (priv->highlight_mark) {
+        gtk_text_buffer_delete_mark (priv->buffer, priv->highlight_mark);
+        gtk_text_buffer_delete_mark (priv->buffer, priv->highlight_stop);
+        priv->highlight_mark = NULL;
+        priv->highlight_stop = NULL;
+    }
+
+    g_free (priv->highlight_text);
+    priv->highlight_text = NULL;
+}
+
+/* Tags the matches starting in [from, to), at most max of them, and
+ * returns the offset to carry on from or -1 when all are done.
+ */
+static gint
+chat_view_highlight_range (GossipChatView *view,
+                           const gchar    *text,
+                           gint            from,
+                           gint            to,
+                           guint           max)
+{
+    GossipChatViewPriv *priv;
+    GossipSearchIndex  *index;
+    guint               n_matches;
+    gint                n;
+
+    priv = GET_PRIV (view);
+
+    index = chat_view_get_search_index (view);
+    n_matches = gossip_search_index_find (index, text);
+
+    n = gossip_search_index_find_forward (index, from);
+    if (n < 0) {
+        return -1;
+    }
+
+    for (; n < (gint) n_matches; n++) {
+        GtkTextIter iter_start, iter_end;
+        gint        start, end;
+
+        gossip_search_index_get_match (index, n, &start, &end);
+        if (to >= 0 && start >= to) {
+            break;
+        }
+
+        if (max-- == 0) {
+            return start;
+        }
+
+        gtk_text_buffer_get_iter_at_offset (priv->buffer, &iter_start, start);
+        gtk_text_buffer_get_iter_at_offset (priv->buffer, &iter_end, end);
+        gtk_text_buffer_apply_tag_by_name (priv->buffer, "highlight",
+                                           &iter_start, &iter_end);
     }
+
+    return -1;
+}
+
+static gboolean
+chat_view_highlight_idle_cb (GossipChatView *view)
+{
+    GossipChatViewPriv *priv;
+    GtkTextIter         iter;
+    gint                from, to, next;
+
+    priv = GET_PRIV (view);
+
+    gtk_text_buffer_get_iter_at_mark (priv->buffer, &iter, priv->highlight_mark);
+    from = gtk_text_iter_get_offset (&iter);
+
+    if (priv->highlight_wrapped) {
+        gtk_text_buffer_get_iter_at_mark (priv->buffer, &iter, priv->highlight_stop);
+        to = gtk_text_iter_get_offset (&iter);
+    } else {
+        to = -1;
+    }
+
+    next = chat_view_highlight_range (view, priv->highlight_text,
+                                      from, to, HIGHLIGHT_CHUNK);
+
+    if (next >= 0) {
+        gtk_text_buffer_get_iter_at_offset (priv->buffer, &iter, next);
+        gtk_text_buffer_move_mark (priv->buffer, priv->highlight_mark, &iter);
+        return TRUE;
+    }
+
+    if (!priv->highlight_wrapped) {
+        /* Below the view is done, now what is above it */
+        priv->highlight_wrapped = TRUE;
+
+        gtk_text_buffer_get_start_iter (priv->buffer, &iter);
+        gtk_text_buffer_move_mark (priv->buffer, priv->highlight_mark, &iter);
+        return TRUE;
+    }
+
+    priv->highlight_idle_id = 0;
+    chat_view_highlight_stop (view);
+
+    return FALSE;
 }
 
 void
 gossip_chat_view_highlight (GossipChatView *view,
                             const gchar    *text)
 {
-    GtkTextBuffer *buffer;
-    GtkTextIter    iter;
-    GtkTextIter    iter_start;
-    GtkTextIter    iter_end;
-    GtkTextIter    iter_match_start;
-    GtkTextIter    iter_match_end;
-    gboolean       found;
+    GossipChatViewPriv *priv;
+    GtkTextIter         iter_start;
+    GtkTextIter         iter_end;
+    GdkRectangle        rect;
+    gint                top, bottom;
 
     g_return_if_fail (GOSSIP_IS_CHAT_VIEW (view));
 
-    buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
+    priv = GET_PRIV (view);
 
-    gtk_text_buffer_get_start_iter (buffer, &iter);
+    chat_view_highlight_stop (view);
 
-    gtk_text_buffer_get_bounds (buffer, &iter_start, &iter_end);
-    gtk_text_buffer_remove_tag_by_name (buffer, "highlight",
+    gtk_text_buffer_get_bounds (priv->buffer, &iter_start, &iter_end);
+    gtk_text_buffer_remove_tag_by_name (priv->buffer, "highlight",
                                         &iter_start,
                                         &iter_end);
 
@@ -1719,24 +2747,29 @@ gossip_chat_view_highlight (GossipChatView *view,
         return;
     }
 
-    while (1) {
-        found = gossip_text_iter_forward_search (&iter,
-                                                 text,
-                                                 &iter_match_start,
-                                                 &iter_match_end,
-                                                 NULL);
-
-        if (!found) {
-            break;
-        }
-
-        gtk_text_buffer_apply_tag_by_name (buffer, "highlight",
-                                           &iter_match_start,
-                                           &iter_match_end);
-
-        iter = iter_match_end;
-        gtk_text_iter_forward_char (&iter);
-    }
+    /* What can be seen is done straight away, the rest when idle so
+     * typing in the find bar doesn't wait for the whole buffer.
+     */
+    gtk_text_view_get_visible_rect (GTK_TEXT_VIEW (view), &rect);
+    gtk_text_view_get_line_at_y (GTK_TEXT_VIEW (view), &iter_start,
+                                 rect.y, NULL);
+    gtk_text_view_get_line_at_y (GTK_TEXT_VIEW (view), &iter_end,
+                                 rect.y + rect.height, NULL);
+    gtk_text_iter_forward_line (&iter_end);
+
+    top = gtk_text_iter_get_offset (&iter_start);
+    bottom = gtk_text_iter_get_offset (&iter_end);
+
+    chat_view_highlight_range (view, text, top, bottom, G_MAXUINT);
+
+    priv->highlight_text = g_strdup (text);
+    priv->highlight_mark = gtk_text_buffer_create_mark (priv->buffer, NULL,
+                                                        &iter_end, TRUE);
+    priv->highlight_stop = gtk_text_buffer_create_mark (priv->buffer, NULL,
+                                                        &iter_start, TRUE);
+    priv->highlight_wrapped = FALSE;
+    priv->highlight_idle_id = g_idle_add ((GSourceFunc) chat_view_highlight_idle_cb,
+                                          view);
 }
 
 void
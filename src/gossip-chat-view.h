@@ -59,6 +59,13 @@ typedef enum {
 
 GType           gossip_chat_view_get_type                  (void) G_GNUC_CONST;
 GossipChatView *gossip_chat_view_new                       (void);
+void            gossip_chat_view_get_end_iter              (GossipChatView *view,
+                                                            GtkTextIter    *iter);
+void            gossip_chat_view_set_history               (GossipChatView *view,
+                                                            GossipLogReader *reader,
+                                                            GossipContact  *own_contact);
+gboolean        gossip_chat_view_load_history              (GossipChatView *view,
+                                                            guint           n_messages);
 void            gossip_chat_view_append_message_from_self  (GossipChatView *view,
                                                             GossipMessage  *msg,
                                                             GossipContact  *my_contact,
@@ -67,6 +74,9 @@ void            gossip_chat_view_append_message_from_other (GossipChatView *view
                                                             GossipMessage  *msg,
                                                             GossipContact  *my_contact,
                                                             GdkPixbuf      *avatar);
+void            gossip_chat_view_append_messages           (GossipChatView *view,
+                                                            GList          *msgs,
+                                                            GossipContact  *own_contact);
 void            gossip_chat_view_append_event              (GossipChatView *view,
                                                             const gchar    *str);
 void            gossip_chat_view_append_invite             (GossipChatView *view,
@@ -52,7 +52,11 @@ static ContactGroup *contact_group_new         (const gchar  *name,
                                                 gboolean      expanded);
 static void          contact_group_free        (ContactGroup *group);
 
-static GList *groups = NULL;
+/* Group name to ContactGroup, the key is owned by the group. This
+ * is looked up every time a group row is shown so it has to be
+ * cheap.
+ */
+static GHashTable *groups = NULL;
 
 void
 gossip_contact_groups_get_all (void)
@@ -62,9 +66,12 @@ gossip_contact_groups_get_all (void)
 
     /* If already set up clean up first */
     if (groups) {
-        g_list_foreach (groups, (GFunc)contact_group_free, NULL);
-        g_list_free (groups);
-        groups = NULL;
+        g_hash_table_remove_all (groups);
+    } else {
+        groups = g_hash_table_new_full (g_str_hash,
+                                        g_str_equal,
+                                        NULL,
+                                        (GDestroyNotify) contact_group_free);
     }
 
     dir = g_build_filename (g_get_home_dir (), ".gnome2", PACKAGE_NAME, NULL);
@@ -142,7 +149,7 @@ contact_groups_file_parse (const gchar *filename)
             }
 
             contact_group = contact_group_new (name, expanded);
-            groups = g_list_append (groups, contact_group);
+            g_hash_table_replace (groups, contact_group->name, contact_group);
 
             xmlFree (name);
             xmlFree (expanded_str);
@@ -151,7 +158,7 @@ contact_groups_file_parse (const gchar *filename)
         node = node->next;
     }
 
-    gossip_debug (DEBUG_DOMAIN, "Parsed %d contact groups", g_list_length (groups));
+    gossip_debug (DEBUG_DOMAIN, "Parsed %d contact groups", g_hash_table_size (groups));
 
     xmlFreeDoc(doc);
     xmlFreeParserCtxt (ctxt);
@@ -187,7 +194,7 @@ contact_groups_file_save (void)
     xmlDocPtr   doc;
     xmlNodePtr  root;
     xmlNodePtr  node;
-    GList      *l;
+    GList      *values, *l;
     gchar      *dir;
     gchar      *file;
 
@@ -203,7 +210,9 @@ contact_groups_file_save (void)
     node = xmlNewChild (root, NULL, "account", NULL);
     xmlNewProp (node, "name", "Default");
 
-    for (l = groups; l; l = l->next) {
+    values = g_hash_table_get_values (groups);
+
+    for (l = values; l; l = l->next) {
         ContactGroup *cg;
         xmlNodePtr    subnode;
 
@@ -214,6 +223,8 @@ contact_groups_file_save (void)
         xmlNewProp (subnode, "name", cg->name);
     }
 
+    g_list_free (values);
+
     /* Make sure the XML is indented properly */
     xmlIndentTreeOutput = 1;
 
@@ -232,54 +243,47 @@ contact_groups_file_save (void)
 gboolean
 gossip_contact_group_get_expanded (const gchar *group)
 {
-    GList    *l;
-    gboolean  default_val = TRUE;
+    ContactGroup *cg;
+    gboolean      default_val = TRUE;
 
     g_return_val_if_fail (group != NULL, default_val);
 
-    for (l = groups; l; l = l->next) {
-        ContactGroup *cg = l->data;
-
-        if (!cg || !cg->name) {
-            continue;
-        }
+    if (!groups) {
+        return default_val;
+    }
 
-        if (strcmp (cg->name, group) == 0) {
-            return cg->expanded;
-        }
+    cg = g_hash_table_lookup (groups, group);
+    if (!cg) {
+        return default_val;
     }
 
-    return default_val;
+    return cg->expanded;
 }
 
 void
 gossip_contact_group_set_expanded (const gchar *group,
                                    gboolean     expanded)
 {
-    GList        *l;
     ContactGroup *cg;
-    gboolean      changed = FALSE;
 
     g_return_if_fail (group != NULL);
 
-    for (l = groups; l; l = l->next) {
-        ContactGroup *cg = l->data;
-
-        if (!cg || !cg->name) {
-            continue;
-        }
+    if (!groups) {
+        gossip_contact_groups_get_all ();
+    }
 
-        if (strcmp (cg->name, group) == 0) {
-            cg->expanded = expanded;
-            changed = TRUE;
-            break;
+    cg = g_hash_table_lookup (groups, group);
+    if (cg) {
+        /* Nothing to save */
+        if (cg->expanded == expanded) {
+            return;
         }
-    }
 
-    /* if here... we don't have a ContactGroup for the group. */
-    if (!changed) {
+        cg->expanded = expanded;
+    } else {
+        /* if here... we don't have a ContactGroup for the group. */
         cg = contact_group_new (group, expanded);
-        groups = g_list_append (groups, cg);
+        g_hash_table_insert (groups, cg->name, cg);
     }
 
     contact_groups_file_save ();
@@ -56,15 +56,26 @@
 /* Time to wait before updating a user (i.e. to throttle updates) */
 #define UPDATE_USER_DELAY_TIME 500
 
+/* Number of contacts updated at once (e.g. everyone's presence
+ * after logging in) for which sorting and filtering once is cheaper
+ * than doing it for each row.
+ */
+#define UPDATE_FREEZE_THRESHOLD 10
+
 #define GET_PRIV(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GOSSIP_TYPE_CONTACT_LIST, GossipContactListPriv))
 
 struct _GossipContactListPriv {
     GossipSession         *session;
 
     GHashTable            *flash_table;
+    GHashTable            *contacts;
+    GHashTable            *shown_contacts;
+    GHashTable            *groups;
     GHashTable            *active_contacts;
     GHashTable            *update_contacts;
+    guint                  update_id;
     GHashTable            *set_group_state;
+    guint                  set_group_state_id;
 
     GtkUIManager          *ui;
 
@@ -83,19 +94,30 @@ struct _GossipContactListPriv {
     guint                  flash_heartbeat_id;
 
     GossipContactListSort  sort_criterium;
+
+    gint                   freeze_count;
+    GTimer                *freeze_timer;
+    GtkTreeRowReference   *freeze_selected;
+    GtkTreeRowReference   *freeze_top;
 };
 
 typedef struct {
-    GtkTreeIter  iter;
-    const gchar *name;
-    gboolean     found;
-} FindGroup;
+    GtkTreeRowReference *row;
+    gint                 members;
+    gint                 online;
+    gint                 shown;
+} ContactListGroup;
 
 typedef struct {
-    GossipContact *contact;
-    gboolean       found;
-    GList         *iters;
-} FindContact;
+    GList               *rows;
+    GList               *groups;
+    gboolean             is_online;
+    gboolean             is_shown;
+
+    /* Casefolded id and name for the filter, NULL until needed */
+    gchar               *key_id;
+    gchar               *key_name;
+} ContactListEntry;
 
 typedef struct {
     GossipContactList *list;
@@ -109,12 +131,6 @@ typedef struct {
     guint              timeout_id;
 } ActiveContactData;
 
-typedef struct {
-    GossipContactList *list;
-    gchar             *group;
-    guint              timeout_id;
-} SetGroupStateData;
-
 static void     gossip_contact_list_class_init               (GossipContactListClass *klass);
 static void     gossip_contact_list_init                     (GossipContactList      *list);
 static void     contact_list_finalize                        (GObject                *object);
@@ -140,9 +156,13 @@ static void     contact_list_contact_added_cb                (GossipSession
 static void     contact_list_contact_updated_cb              (GossipContact          *contact,
                                                               GParamSpec             *param,
                                                               GossipContactList      *list);
+static gboolean contact_list_contact_updated_delay_cb        (GossipContactList      *list);
 static void     contact_list_contact_groups_updated_cb       (GossipContact          *contact,
                                                               GParamSpec             *param,
                                                               GossipContactList      *list);
+static void     contact_list_contact_search_keys_cb          (GossipContact          *contact,
+                                                              GParamSpec             *param,
+                                                              GossipContactList      *list);
 static void     contact_list_contact_removed_cb              (GossipSession          *session,
                                                               GossipContact          *contact,
                                                               GossipContactList      *list);
@@ -150,6 +170,10 @@ static void     contact_list_contact_composing_cb            (GossipSession
                                                               GossipContact          *contact,
                                                               gboolean                composing,
                                                               GossipContactList      *list);
+static void     contact_list_roster_updating_cb              (GossipSession          *session,
+                                                              GossipContactList      *list);
+static void     contact_list_roster_updated_cb               (GossipSession          *session,
+                                                              GossipContactList      *list);
 static void     contact_list_contact_set_active_destroy_cb   (ActiveContactData      *data);
 static gboolean contact_list_contact_set_active_cb           (ActiveContactData      *data);
 static void     contact_list_contact_set_active              (GossipContactList      *list,
@@ -163,12 +187,13 @@ static void     contact_list_get_group                       (GossipContactList
                                                               GtkTreeIter            *iter_group_to_set,
                                                               GtkTreeIter            *iter_separator_to_set,
                                                               gboolean               *created);
-static gboolean contact_list_get_group_foreach               (GtkTreeModel           *model,
-                                                              GtkTreePath            *path,
-                                                              GtkTreeIter            *iter,
-                                                              FindGroup              *fg);
-static void     contact_list_set_group_state_destroy_cb      (SetGroupStateData      *data);
-static gboolean contact_list_set_group_state_cb              (SetGroupStateData      *data);
+static gboolean contact_list_group_get_iter                  (GossipContactList      *list,
+                                                              ContactListGroup       *group,
+                                                              GtkTreeIter            *iter);
+static void     contact_list_group_free                      (ContactListGroup       *group);
+static void     contact_list_queue_group_state               (GossipContactList      *list,
+                                                              const gchar            *name);
+static gboolean contact_list_set_group_state_cb              (GossipContactList      *list);
 static void     contact_list_set_group_state                 (GossipContactList      *list,
                                                               GtkTreeModel           *model,
                                                               GtkTreeIter            *iter,
@@ -179,6 +204,16 @@ static void     contact_list_remove_contact                  (GossipContactList
                                                               GossipContact          *contact,
                                                               gboolean                shallow_remove);
 static void     contact_list_create_model                    (GossipContactList      *list);
+static void     contact_list_create_filter                   (GossipContactList      *list);
+static void     contact_list_refilter                        (GossipContactList      *list);
+static void     contact_list_apply_sort                      (GossipContactList      *list);
+static void     contact_list_restore_group_states            (GossipContactList      *list);
+static GtkTreeRowReference *
+                contact_list_freeze_row_new                  (GossipContactList      *list,
+                                                              GtkTreePath            *path);
+static GtkTreePath *
+                contact_list_freeze_row_get_path             (GossipContactList      *list,
+                                                              GtkTreeRowReference    *row);
 static void     contact_list_setup_view                      (GossipContactList      *list);
 static void     contact_list_drag_data_received              (GtkWidget              *widget,
                                                               GdkDragContext         *context,
@@ -258,12 +293,27 @@ static gint     contact_list_state_sort_func                 (GtkTreeModel
 static gboolean contact_list_filter_func                     (GtkTreeModel           *model,
                                                               GtkTreeIter            *iter,
                                                               GossipContactList      *list);
+static gboolean contact_list_filter_show_contact_for_events  (GossipContactList      *list,
+                                                              GossipContact          *contact);
+static gboolean contact_list_filter_show_contact_for_match   (GossipContactList      *list,
+                                                              GossipContact          *contact);
+static ContactListEntry *contact_list_entry_get              (GossipContactList      *list,
+                                                              GossipContact          *contact);
+static void     contact_list_entry_free                      (ContactListEntry       *entry);
+static void     contact_list_entry_add_group                 (GossipContactList      *list,
+                                                              ContactListEntry       *entry,
+                                                              const gchar            *name);
+static void     contact_list_entry_add_row                   (GossipContactList      *list,
+                                                              ContactListEntry       *entry,
+                                                              GtkTreeIter            *iter);
+static void     contact_list_entry_update                    (GossipContactList      *list,
+                                                              GossipContact          *contact);
+static void     contact_list_entry_remove                    (GossipContactList      *list,
+                                                              GossipContact          *contact);
+static void     contact_list_entries_refresh                 (GossipContactList      *list);
+static void     contact_list_entries_narrow                  (GossipContactList      *list);
 static GList *  contact_list_find_contact                    (GossipContactList      *list,
                                                               GossipContact          *contact);
-static gboolean contact_list_find_contact_foreach            (GtkTreeModel           *model,
-                                                              GtkTreePath            *path,
-                                                              GtkTreeIter            *iter,
-                                                              FindContact            *fc);
 static void     contact_list_action_cb                       (GtkAction              *action,
                                                               GossipContactList      *list);
 static void     contact_list_action_activated                (GossipContactList      *list,
@@ -537,23 +587,55 @@ gossip_contact_list_init (GossipContactList *list)
                                                (GDestroyNotify) g_object_unref,
                                                (GDestroyNotify) g_object_unref);
 
+    /* Maps a contact to the row references (one per group) it
+     * has in the store, so we don't have to walk the model each
+     * time we want to find a contact.
+     */
+    priv->contacts = g_hash_table_new_full (gossip_contact_hash,
+                                            gossip_contact_equal,
+                                            (GDestroyNotify) g_object_unref,
+                                            (GDestroyNotify) 
+                                            contact_list_entry_free);
+
+    /* The subset of the above which are currently shown, so
+     * narrowing the filter only has to look at those.
+     */
+    priv->shown_contacts = g_hash_table_new (gossip_contact_hash,
+                                             gossip_contact_equal);
+
+    /* Maps a group name to its row and the number of members,
+     * online members and shown members it has, so the filter
+     * doesn't have to look at every contact for each group.
+     */
+    priv->groups = g_hash_table_new_full (g_str_hash,
+                                          g_str_equal,
+                                          (GDestroyNotify) g_free,
+                                          (GDestroyNotify) 
+                                          contact_list_group_free);
+
     priv->active_contacts = g_hash_table_new_full (gossip_contact_hash,
                                                    gossip_contact_equal,
                                                    (GDestroyNotify) g_object_unref,
                                                    (GDestroyNotify) 
                                                    contact_list_contact_set_active_destroy_cb);
 
+    /* The contacts waiting to be updated, this is done for all of
+     * them at once after a short delay.
+     */
     priv->update_contacts = g_hash_table_new_full (gossip_contact_hash,
                                                    gossip_contact_equal,
                                                    (GDestroyNotify) g_object_unref,
-                                                   (GDestroyNotify) 
-                                                   contact_list_contact_set_active_destroy_cb);
+                                                   NULL);
 
+    /* The groups which need their expanded state restored, this
+     * is done for all of them at once in an idle.
+     */
     priv->set_group_state = g_hash_table_new_full (g_str_hash,
                                                    g_str_equal,
                                                    (GDestroyNotify) g_free,
-                                                   (GDestroyNotify) 
-                                                   contact_list_set_group_state_destroy_cb);
+                                                   NULL);
+
+    priv->freeze_timer = g_timer_new ();
 
     contact_list_create_model (list);
     contact_list_setup_view (list);
@@ -606,6 +688,14 @@ gossip_contact_list_init (GossipContactList *list)
                       "composing",
                       G_CALLBACK (contact_list_contact_composing_cb),
                       list);
+    g_signal_connect (priv->session,
+                      "roster-updating",
+                      G_CALLBACK (contact_list_roster_updating_cb),
+                      list);
+    g_signal_connect (priv->session,
+                      "roster-updated",
+                      G_CALLBACK (contact_list_roster_updated_cb),
+                      list);
 
     /* Connect to event manager signals. */
     g_signal_connect (gossip_app_get_event_manager (),
@@ -646,17 +736,33 @@ contact_list_finalize (GObject *object)
     g_object_unref (priv->session);
 
     g_hash_table_destroy (priv->flash_table);
+    g_hash_table_destroy (priv->shown_contacts);
+    g_hash_table_destroy (priv->contacts);
+    g_hash_table_destroy (priv->groups);
     /* FIXME: Shouldn't we free the groups hash table? */
     g_hash_table_destroy (priv->active_contacts);
     g_hash_table_destroy (priv->update_contacts);
     g_hash_table_destroy (priv->set_group_state);
 
+    if (priv->set_group_state_id) {
+        g_source_remove (priv->set_group_state_id);
+    }
+
+    if (priv->update_id) {
+        g_source_remove (priv->update_id);
+    }
+
+    g_timer_destroy (priv->freeze_timer);
+
     g_free (priv->filter_text);
 
     g_object_unref (priv->ui);
 
     g_object_unref (priv->store);
-    g_object_unref (priv->filter);
+
+    if (priv->filter) {
+        g_object_unref (priv->filter);
+    }
 
     G_OBJECT_CLASS (gossip_contact_list_parent_class)->finalize (object);
 }
@@ -850,6 +956,11 @@ contact_list_contact_update (GossipContactList *list,
         contact_list_contact_set_active (list, contact, TRUE, TRUE);
     }
 
+    /* Update the group counters before the rows change so the
+     * filter sees the new state for the parent groups.
+     */
+    contact_list_entry_update (list, contact);
+
     /* Get all necessary pixbufs */
     pixbuf_presence = gossip_pixbuf_for_contact (contact);
     pixbuf_composing = gossip_stock_create_pixbuf (gossip_app_get_window (),
@@ -947,32 +1058,52 @@ contact_list_contact_groups_updated_cb (GossipContact     *contact,
 }
 
 static gboolean
-contact_list_contact_updated_delay_cb (ActiveContactData *data)
+contact_list_contact_updated_delay_cb (GossipContactList *list)
 {
-    GossipContactList     *list;
     GossipContactListPriv *priv;
-    GossipContact         *contact;
+    GList                 *contacts, *l;
+    gboolean               freeze;
 
-    g_return_val_if_fail (data != NULL, FALSE);
+    priv = GET_PRIV (list);
 
-    list = data->list;
-    contact = data->contact;
+    priv->update_id = 0;
 
-    priv = GET_PRIV (list);
+    /* Updating a contact can add or remove others, so we work on
+     * our own list of the contacts waiting.
+     */
+    contacts = g_hash_table_get_keys (priv->update_contacts);
+    g_list_foreach (contacts, (GFunc) g_object_ref, NULL);
+
+    freeze = g_list_length (contacts) >= UPDATE_FREEZE_THRESHOLD;
+    if (freeze) {
+        gossip_contact_list_freeze (list);
+    }
+
+    for (l = contacts; l; l = l->next) {
+        GossipContact *contact;
+
+        contact = l->data;
+
+        if (!g_hash_table_remove (priv->update_contacts, contact)) {
+            gossip_debug (DEBUG_DOMAIN,
+                          "Contact:'%s' updated, ignoring due to removal",
+                          gossip_contact_get_name (contact));
+            continue;
+        }
 
-    if (g_hash_table_lookup (priv->update_contacts, contact)) {
         gossip_debug (DEBUG_DOMAIN,
                       "Contact:'%s' updated, checking roster is in sync...",
                       gossip_contact_get_name (contact));
         contact_list_contact_update (list, contact);
-    } else {
-        gossip_debug (DEBUG_DOMAIN,
-                      "Contact:'%s' updated, ignoring due to removal",
-                      gossip_contact_get_name (contact));
     }
 
-    g_hash_table_remove (priv->update_contacts, contact);
-                
+    if (freeze) {
+        gossip_contact_list_thaw (list);
+    }
+
+    g_list_foreach (contacts, (GFunc) g_object_unref, NULL);
+    g_list_free (contacts);
+
     return FALSE;
 }
 
@@ -981,27 +1112,51 @@ contact_list_contact_updated_cb (GossipContact     *contact,
                                  GParamSpec        *param,
                                  GossipContactList *list)
 {
+    GossipContactListPriv *priv;
+
+    priv = GET_PRIV (list);
+
     /* Since we may get many updates at one time, we throttle
-     * these to make sure we don't over update the roster for the
-     * same contact.
+     * these and update every contact which changed in one go,
+     * this also makes sure we don't over update the roster for
+     * the same contact.
      */ 
+    if (!g_hash_table_lookup (priv->update_contacts, contact)) {
+        g_hash_table_insert (priv->update_contacts,
+                             g_object_ref (contact),
+                             contact);
+    }
 
-    ActiveContactData     *data;
+    if (!priv->update_id) {
+        priv->update_id = g_timeout_add (UPDATE_USER_DELAY_TIME,
+                                         (GSourceFunc) contact_list_contact_updated_delay_cb,
+                                         list);
+    }
+}
+
+static void
+contact_list_contact_search_keys_cb (GossipContact     *contact,
+                                     GParamSpec        *param,
+                                     GossipContactList *list)
+{
     GossipContactListPriv *priv;
+    ContactListEntry      *entry;
 
     priv = GET_PRIV (list);
 
-    /* Always remove the last one as part of the throttling */
-    g_hash_table_remove (priv->update_contacts, contact);
-        
-    data = g_new0 (ActiveContactData, 1);
-    data->list = g_object_ref (list);
-    data->contact = g_object_ref (contact);
-    data->timeout_id = g_timeout_add (UPDATE_USER_DELAY_TIME,
-                                      (GSourceFunc) contact_list_contact_updated_delay_cb,
-                                      data);
+    /* The id or name changed, the filter keys are recreated
+     * the next time they are needed.
+     */
+    entry = g_hash_table_lookup (priv->contacts, contact);
+    if (!entry) {
+        return;
+    }
 
-    g_hash_table_insert (priv->update_contacts, g_object_ref (contact), data);
+    g_free (entry->key_id);
+    entry->key_id = NULL;
+
+    g_free (entry->key_name);
+    entry->key_name = NULL;
 }
 
 static void
@@ -1079,6 +1234,20 @@ contact_list_contact_composing_cb (GossipSession     *session,
     g_list_free (iters);
 }
 
+static void
+contact_list_roster_updating_cb (GossipSession     *session,
+                                 GossipContactList *list)
+{
+    gossip_contact_list_freeze (list);
+}
+
+static void
+contact_list_roster_updated_cb (GossipSession     *session,
+                                GossipContactList *list)
+{
+    gossip_contact_list_thaw (list);
+}
+
 static void
 contact_list_contact_set_active_destroy_cb (ActiveContactData *data)
 {
@@ -1108,7 +1277,7 @@ contact_list_contact_set_active_cb (ActiveContactData *data)
 
     gossip_debug (DEBUG_DOMAIN, 
                   "Refiltering model, active contact state changed");
-    gtk_tree_model_filter_refilter (GTK_TREE_MODEL_FILTER (priv->filter));
+    contact_list_refilter (data->list);
 
     return FALSE;
 }
@@ -1137,6 +1306,22 @@ contact_list_contact_set_active (GossipContactList *list,
      */
     g_hash_table_remove (priv->active_contacts, contact);
 
+    if (active) {
+        ActiveContactData *data;
+
+        data = g_new0 (ActiveContactData, 1);
+        data->list = g_object_ref (list);
+        data->contact = g_object_ref (contact);
+        data->timeout_id = g_timeout_add (ACTIVE_USER_SHOW_TIME,
+                                          (GSourceFunc) contact_list_contact_set_active_cb,
+                                          data);
+                
+        g_hash_table_insert (priv->active_contacts, g_object_ref (contact), data);
+    }
+
+    /* Being active may be the only reason the contact is shown */
+    contact_list_entry_update (list, contact);
+
     model = GTK_TREE_MODEL (priv->store);
     iters = contact_list_find_contact (list, contact);
 
@@ -1177,19 +1362,6 @@ contact_list_contact_set_active (GossipContactList *list,
 
     g_list_foreach (iters, (GFunc) gtk_tree_iter_free, NULL);
     g_list_free (iters);
-
-    if (active) {
-        ActiveContactData *data;
-
-        data = g_new0 (ActiveContactData, 1);
-        data->list = g_object_ref (list);
-        data->contact = g_object_ref (contact);
-        data->timeout_id = g_timeout_add (ACTIVE_USER_SHOW_TIME,
-                                          (GSourceFunc) contact_list_contact_set_active_cb,
-                                          data);
-                
-        g_hash_table_insert (priv->active_contacts, g_object_ref (contact), data);
-    }
 }
 
 static gchar *
@@ -1235,32 +1407,32 @@ contact_list_get_parent_group (GtkTreeModel *model,
 }
 
 static gboolean
-contact_list_get_group_foreach (GtkTreeModel *model,
-                                GtkTreePath  *path,
-                                GtkTreeIter  *iter,
-                                FindGroup    *fg)
+contact_list_group_get_iter (GossipContactList *list,
+                             ContactListGroup  *group,
+                             GtkTreeIter       *iter)
 {
-    gchar    *str;
-    gboolean  is_group;
+    GossipContactListPriv *priv;
+    GtkTreePath           *path;
+    gboolean               found;
+
+    priv = GET_PRIV (list);
 
-    /* Groups are only at the top level. */
-    if (gtk_tree_path_get_depth (path) != 1) {
+    path = gtk_tree_row_reference_get_path (group->row);
+    if (!path) {
         return FALSE;
     }
 
-    gtk_tree_model_get (model, iter,
-                        COL_NAME, &str,
-                        COL_IS_GROUP, &is_group,
-                        -1);
-
-    if (is_group && strcmp (str, fg->name) == 0) {
-        fg->found = TRUE;
-        fg->iter = *iter;
-    }
+    found = gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->store), iter, path);
+    gtk_tree_path_free (path);
 
-    g_free (str);
+    return found;
+}
 
-    return fg->found;
+static void
+contact_list_group_free (ContactListGroup *group)
+{
+    gtk_tree_row_reference_free (group->row);
+    g_free (group);
 }
 
 static void
@@ -1273,20 +1445,21 @@ contact_list_get_group (GossipContactList *list,
     GossipContactListPriv *priv;
     GtkTreeModel          *model;
     GtkTreeIter            iter_group, iter_separator;
-    FindGroup              fg;
+    ContactListGroup      *group;
+    gboolean               found = FALSE;
 
     priv = GET_PRIV (list);
 
-    memset (&fg, 0, sizeof (fg));
+    model = GTK_TREE_MODEL (priv->store);
 
-    fg.name = name;
+    group = g_hash_table_lookup (priv->groups, name);
+    if (group) {
+        found = contact_list_group_get_iter (list, group, &iter_group);
+    }
 
-    model = GTK_TREE_MODEL (priv->store);
-    gtk_tree_model_foreach (model,
-                            (GtkTreeModelForeachFunc) contact_list_get_group_foreach,
-                            &fg);
+    if (!found) {
+        GtkTreePath *path;
 
-    if (!fg.found) {
         gossip_debug (DEBUG_DOMAIN, " - Adding group:'%s' to model", name);
 
         if (created) {
@@ -1303,6 +1476,14 @@ contact_list_get_group (GossipContactList *list,
                             COL_IS_SEPARATOR, FALSE,
                             -1);
 
+        path = gtk_tree_model_get_path (model, &iter_group);
+
+        group = g_new0 (ContactListGroup, 1);
+        group->row = gtk_tree_row_reference_new (model, path);
+        g_hash_table_replace (priv->groups, g_strdup (name), group);
+
+        gtk_tree_path_free (path);
+
         if (iter_group_to_set) {
             *iter_group_to_set = iter_group;
         }
@@ -1325,12 +1506,11 @@ contact_list_get_group (GossipContactList *list,
         }
 
         if (iter_group_to_set) {
-            *iter_group_to_set = fg.iter;
+            *iter_group_to_set = iter_group;
         }
 
-        iter_separator = fg.iter;
-
-        if (gtk_tree_model_iter_next (model, &iter_separator)) {
+        /* The separator is always sorted first in the group */
+        if (gtk_tree_model_iter_children (model, &iter_separator, &iter_group)) {
             gboolean is_separator;
 
             gtk_tree_model_get (model, &iter_separator,
@@ -1345,41 +1525,67 @@ contact_list_get_group (GossipContactList *list,
 }
 
 static void
-contact_list_set_group_state_destroy_cb (SetGroupStateData *data)
+contact_list_queue_group_state (GossipContactList *list,
+                                const gchar       *name)
 {
-    g_source_remove (data->timeout_id);
-    g_free (data->group);
-    g_object_unref (data->list);
-    g_free (data);
+    GossipContactListPriv *priv;
+
+    priv = GET_PRIV (list);
+
+    if (!g_hash_table_lookup (priv->set_group_state, name)) {
+        g_hash_table_insert (priv->set_group_state, g_strdup (name), GINT_TO_POINTER (TRUE));
+    }
+
+    if (!priv->set_group_state_id) {
+        priv->set_group_state_id = g_idle_add ((GSourceFunc) 
+                                               contact_list_set_group_state_cb,
+                                               list);
+    }
 }
 
 static gboolean
-contact_list_set_group_state_cb (SetGroupStateData *data)
+contact_list_set_group_state_cb (GossipContactList *list)
 {
     GossipContactListPriv *priv;
-    FindGroup              fg;
-
-    priv = GET_PRIV (data->list);
-        
-    memset (&fg, 0, sizeof (fg));
+    GHashTable            *names;
+    GHashTableIter         hash_iter;
+    gpointer               key;
+    ContactListGroup      *group;
+    GtkTreeIter            iter, filter_iter;
 
-    fg.name = data->group;
-
-    gtk_tree_model_foreach (priv->filter,
-                            (GtkTreeModelForeachFunc) contact_list_get_group_foreach,
-                            &fg);
+    priv = GET_PRIV (list);
 
-    if (fg.found) {
-        GtkTreeIter iter;
+    /* Expanding rows can run the filter again which queues more
+     * groups, those go in a new set and get their own idle.
+     */
+    names = priv->set_group_state;
+    priv->set_group_state = g_hash_table_new_full (g_str_hash,
+                                                   g_str_equal,
+                                                   (GDestroyNotify) g_free,
+                                                   NULL);
+    priv->set_group_state_id = 0;
 
-        iter = fg.iter;
-        contact_list_set_group_state (data->list, 
-                                      priv->filter, 
-                                      &iter, 
-                                      data->group);
+    gossip_debug (DEBUG_DOMAIN, 
+                  "Setting state for %d groups",
+                  g_hash_table_size (names));
+
+    g_hash_table_iter_init (&hash_iter, names);
+    while (g_hash_table_iter_next (&hash_iter, &key, NULL)) {
+        group = g_hash_table_lookup (priv->groups, key);
+
+        if (group && priv->filter &&
+            contact_list_group_get_iter (list, group, &iter) &&
+            gtk_tree_model_filter_convert_child_iter_to_iter (GTK_TREE_MODEL_FILTER (priv->filter),
+                                                              &filter_iter,
+                                                              &iter)) {
+            contact_list_set_group_state (list, 
+                                          priv->filter, 
+                                          &filter_iter, 
+                                          key);
+        }
     }
 
-    g_hash_table_remove (priv->set_group_state, data->group); 
+    g_hash_table_destroy (names);
 
     return FALSE;
 }
@@ -1451,6 +1657,7 @@ contact_list_add_contact (GossipContactList *list,
     GtkTreeModel          *model;
     GList                 *l, *groups;
     GList                 *iters;
+    ContactListEntry      *entry;
 
     /* Note: The shallow_add flag is here so we know if we
      * should connect the signal handlers for GossipContact.
@@ -1474,6 +1681,20 @@ contact_list_add_contact (GossipContactList *list,
 
         return;
     }
+
+    /* Start from a clean entry, the group counters are updated
+     * as we add the contact to each group below.
+     */
+    contact_list_entry_remove (list, contact);
+
+    entry = contact_list_entry_get (list, contact);
+    entry->is_online = gossip_contact_is_online (contact);
+    entry->is_shown = (contact_list_filter_show_contact_for_events (list, contact) &&
+                       contact_list_filter_show_contact_for_match (list, contact));
+
+    if (entry->is_shown) {
+        g_hash_table_insert (priv->shown_contacts, contact, entry);
+    }
         
     /* Add signals */
     gossip_debug (DEBUG_DOMAIN, " - Setting signal handlers");
@@ -1490,8 +1711,15 @@ contact_list_add_contact (GossipContactList *list,
     g_signal_connect (contact, "notify::avatar",
                       G_CALLBACK (contact_list_contact_updated_cb),
                       list);
+    g_signal_connect (contact, "notify::id",
+                      G_CALLBACK (contact_list_contact_search_keys_cb),
+                      list);
+    g_signal_connect (contact, "notify::name",
+                      G_CALLBACK (contact_list_contact_search_keys_cb),
+                      list);
 
-    model = gtk_tree_view_get_model (GTK_TREE_VIEW (list));
+    /* NULL while frozen, group states are then restored when thawing */
+    model = priv->filter;
 
     /* If no groups just add it at the top level. */
     groups = gossip_contact_get_groups (contact);
@@ -1528,6 +1756,8 @@ contact_list_add_contact (GossipContactList *list,
                             COL_IS_SEPARATOR, FALSE,
                             -1);
 
+        contact_list_entry_add_row (list, entry, &iter);
+
         if (pixbuf_avatar) {
             g_object_unref (pixbuf_avatar);
         }
@@ -1560,6 +1790,7 @@ contact_list_add_contact (GossipContactList *list,
         }
 
         contact_list_get_group (list, name, &iter_group, &iter_separator, &created);
+        contact_list_entry_add_group (list, entry, name);
 
         if (priv->show_avatars && !priv->is_compact) {
             show_avatar = TRUE;
@@ -1569,9 +1800,10 @@ contact_list_add_contact (GossipContactList *list,
          * the row-changed signal on the parent so it prompts
          * it to be refreshed by the filter func and doesn't
          * give us warnings about nodes inserted with parents
-         * not in the tree.
+         * not in the tree. This is needed for new groups too,
+         * since they were filtered before they had members.
          */
-        if (!created) {
+        {
             GtkTreeModel *model;
 
             model = GTK_TREE_MODEL (priv->store);
@@ -1603,13 +1835,16 @@ contact_list_add_contact (GossipContactList *list,
                             COL_IS_SEPARATOR, FALSE,
                             -1);
 
+        contact_list_entry_add_row (list, entry, &iter);
+
         if (pixbuf_avatar) {
             g_object_unref (pixbuf_avatar);
         }
 
         g_object_unref (pixbuf_status);
 
-        if (!created) {
+        /* When frozen, the states are restored when thawing */
+        if (!created || !priv->filter) {
             continue;
         }
 
@@ -1648,6 +1883,12 @@ contact_list_remove_contact (GossipContactList *list,
     priv = GET_PRIV (list);
 
     iters = contact_list_find_contact (list, contact);
+
+    /* Drop the group counters first so the filter func sees the
+     * groups without this contact when we emit row-changed below.
+     */
+    contact_list_entry_remove (list, contact);
+
     if (iters) {
         /* Clean up model */
         model = GTK_TREE_MODEL (priv->store);
@@ -1669,6 +1910,14 @@ contact_list_remove_contact (GossipContactList *list,
                 children = gtk_tree_model_iter_n_children (model, &parent_iter);
 
                 if (children <= 2) {
+                    gchar *name;
+
+                    gtk_tree_model_get (model, &parent_iter,
+                                        COL_NAME, &name,
+                                        -1);
+                    g_hash_table_remove (priv->groups, name);
+                    g_free (name);
+
                     refilter = TRUE;
                     gtk_tree_store_remove (priv->store, &parent_iter);
                 } else {
@@ -1704,7 +1953,7 @@ contact_list_remove_contact (GossipContactList *list,
     if (refilter) {
         gossip_debug (DEBUG_DOMAIN, 
                       " - Refiltering model, contact/groups at the topmost level");
-        gtk_tree_model_filter_refilter (GTK_TREE_MODEL_FILTER (priv->filter));
+        contact_list_refilter (list);
     }
 
     gossip_debug (DEBUG_DOMAIN, " - Unsetting signal handlers");
@@ -1715,6 +1964,9 @@ contact_list_remove_contact (GossipContactList *list,
     g_signal_handlers_disconnect_by_func (contact,
                                           contact_list_contact_updated_cb,
                                           list);
+    g_signal_handlers_disconnect_by_func (contact,
+                                          contact_list_contact_search_keys_cb,
+                                          list);
 
     if (!shallow_remove) {
         gossip_debug (DEBUG_DOMAIN, " - Removing information (flash/update/active)");
@@ -1740,6 +1992,13 @@ contact_list_create_model (GossipContactList *list)
         g_object_unref (priv->filter);
     }
 
+    /* Row references are only valid for the store they were
+     * created with.
+     */
+    g_hash_table_remove_all (priv->shown_contacts);
+    g_hash_table_remove_all (priv->contacts);
+    g_hash_table_remove_all (priv->groups);
+
     priv->store = gtk_tree_store_new (COL_COUNT,
                                       GDK_TYPE_PIXBUF,     /* Status pixbuf */
                                       GDK_TYPE_PIXBUF,     /* Avatar pixbuf */
@@ -1769,8 +2028,21 @@ contact_list_create_model (GossipContactList *list)
 
     gossip_contact_list_set_sort_criterium (list, priv->sort_criterium);
 
-    /* Create filter */
-    priv->filter = gtk_tree_model_filter_new (model, NULL);
+    if (priv->freeze_count == 0) {
+        contact_list_create_filter (list);
+    } else {
+        priv->filter = NULL;
+    }
+}
+
+static void
+contact_list_create_filter (GossipContactList *list)
+{
+    GossipContactListPriv *priv;
+
+    priv = GET_PRIV (list);
+
+    priv->filter = gtk_tree_model_filter_new (GTK_TREE_MODEL (priv->store), NULL);
 
     gtk_tree_model_filter_set_visible_func (GTK_TREE_MODEL_FILTER (priv->filter),
                                             (GtkTreeModelFilterVisibleFunc)
@@ -1781,52 +2053,168 @@ contact_list_create_model (GossipContactList *list)
 }
 
 static void
-contact_list_setup_view (GossipContactList *list)
+contact_list_refilter (GossipContactList *list)
 {
-    GtkCellRenderer   *cell;
-    GtkTreeViewColumn *col;
-    gint               i;
-
-    g_object_set (list,
-                  "headers-visible", FALSE,
-                  "reorderable", TRUE,
-                  "show-expanders", FALSE,
-                  "search-column", -1,
-                  NULL);
+    GossipContactListPriv *priv;
 
-    col = gtk_tree_view_column_new ();
+    priv = GET_PRIV (list);
 
-    /* State */
-    cell = gtk_cell_renderer_pixbuf_new ();
-    gtk_tree_view_column_pack_start (col, cell, FALSE);
-    gtk_tree_view_column_set_cell_data_func (
-        col, cell,
-        (GtkTreeCellDataFunc) contact_list_pixbuf_cell_data_func,
-        list, NULL);
+    /* While frozen there is no filter, a new one is created
+     * when thawing which looks at every row anyway.
+     */
+    if (!priv->filter) {
+        return;
+    }
 
-    g_object_set (cell,
-                  "xpad", 5,
-                  "ypad", 1,
-                  "visible", FALSE,
-                  NULL);
+    gtk_tree_model_filter_refilter (GTK_TREE_MODEL_FILTER (priv->filter));
+}
 
-    /* Name */
-    cell = gossip_cell_renderer_text_new ();
-    gtk_tree_view_column_pack_start (col, cell, TRUE);
-    gtk_tree_view_column_set_cell_data_func (
-        col, cell,
-        (GtkTreeCellDataFunc) contact_list_text_cell_data_func,
-        list, NULL);
+static void
+contact_list_apply_sort (GossipContactList *list)
+{
+    GossipContactListPriv *priv;
 
-    gtk_tree_view_column_add_attribute (col, cell,
-                                        "name", COL_NAME);
-    gtk_tree_view_column_add_attribute (col, cell,
-                                        "status", COL_STATUS);
-    gtk_tree_view_column_add_attribute (col, cell,
-                                        "is_group", COL_IS_GROUP);
+    priv = GET_PRIV (list);
 
-    /* Avatar */
-    cell = gtk_cell_renderer_pixbuf_new ();
+    switch (priv->sort_criterium) {
+    case GOSSIP_CONTACT_LIST_SORT_STATE:
+        gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (priv->store),
+                                              COL_STATUS,
+                                              GTK_SORT_ASCENDING);
+        break;
+                
+    case GOSSIP_CONTACT_LIST_SORT_NAME:
+        gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (priv->store),
+                                              COL_NAME,
+                                              GTK_SORT_ASCENDING);
+        break;
+    }
+}
+
+static void
+contact_list_restore_group_states (GossipContactList *list)
+{
+    GossipContactListPriv *priv;
+    GHashTableIter         hash_iter;
+    gpointer               key, value;
+    GtkTreeIter            iter, filter_iter;
+
+    priv = GET_PRIV (list);
+
+    g_hash_table_iter_init (&hash_iter, priv->groups);
+    while (g_hash_table_iter_next (&hash_iter, &key, &value)) {
+        if (!contact_list_group_get_iter (list, value, &iter)) {
+            continue;
+        }
+
+        if (!gtk_tree_model_filter_convert_child_iter_to_iter (GTK_TREE_MODEL_FILTER (priv->filter),
+                                                               &filter_iter,
+                                                               &iter)) {
+            continue;
+        }
+
+        contact_list_set_group_state (list, priv->filter, &filter_iter, key);
+    }
+}
+
+static GtkTreeRowReference *
+contact_list_freeze_row_new (GossipContactList *list,
+                             GtkTreePath       *path)
+{
+    GossipContactListPriv *priv;
+    GtkTreeRowReference   *row;
+    GtkTreePath           *child_path;
+
+    priv = GET_PRIV (list);
+
+    /* Refer to the row in the store, which we keep while frozen */
+    child_path = gtk_tree_model_filter_convert_path_to_child_path (GTK_TREE_MODEL_FILTER (priv->filter),
+                                                                   path);
+    if (!child_path) {
+        return NULL;
+    }
+
+    row = gtk_tree_row_reference_new (GTK_TREE_MODEL (priv->store), child_path);
+    gtk_tree_path_free (child_path);
+
+    return row;
+}
+
+static GtkTreePath *
+contact_list_freeze_row_get_path (GossipContactList   *list,
+                                  GtkTreeRowReference *row)
+{
+    GossipContactListPriv *priv;
+    GtkTreePath           *child_path;
+    GtkTreePath           *path;
+
+    priv = GET_PRIV (list);
+
+    if (!row) {
+        return NULL;
+    }
+
+    child_path = gtk_tree_row_reference_get_path (row);
+    gtk_tree_row_reference_free (row);
+
+    if (!child_path) {
+        return NULL;
+    }
+
+    path = gtk_tree_model_filter_convert_child_path_to_path (GTK_TREE_MODEL_FILTER (priv->filter),
+                                                             child_path);
+    gtk_tree_path_free (child_path);
+
+    return path;
+}
+
+static void
+contact_list_setup_view (GossipContactList *list)
+{
+    GtkCellRenderer   *cell;
+    GtkTreeViewColumn *col;
+    gint               i;
+
+    g_object_set (list,
+                  "headers-visible", FALSE,
+                  "reorderable", TRUE,
+                  "show-expanders", FALSE,
+                  "search-column", -1,
+                  NULL);
+
+    col = gtk_tree_view_column_new ();
+
+    /* State */
+    cell = gtk_cell_renderer_pixbuf_new ();
+    gtk_tree_view_column_pack_start (col, cell, FALSE);
+    gtk_tree_view_column_set_cell_data_func (
+        col, cell,
+        (GtkTreeCellDataFunc) contact_list_pixbuf_cell_data_func,
+        list, NULL);
+
+    g_object_set (cell,
+                  "xpad", 5,
+                  "ypad", 1,
+                  "visible", FALSE,
+                  NULL);
+
+    /* Name */
+    cell = gossip_cell_renderer_text_new ();
+    gtk_tree_view_column_pack_start (col, cell, TRUE);
+    gtk_tree_view_column_set_cell_data_func (
+        col, cell,
+        (GtkTreeCellDataFunc) contact_list_text_cell_data_func,
+        list, NULL);
+
+    gtk_tree_view_column_add_attribute (col, cell,
+                                        "name", COL_NAME);
+    gtk_tree_view_column_add_attribute (col, cell,
+                                        "status", COL_STATUS);
+    gtk_tree_view_column_add_attribute (col, cell,
+                                        "is_group", COL_IS_GROUP);
+
+    /* Avatar */
+    cell = gtk_cell_renderer_pixbuf_new ();
     gtk_tree_view_column_pack_start (col, cell, FALSE);
     gtk_tree_view_column_set_cell_data_func (
         col, cell,
@@ -1917,7 +2305,7 @@ contact_list_drag_data_received (GtkWidget         *widget,
         }
 
         model = gtk_tree_view_get_model (GTK_TREE_VIEW (widget));
-        if (!gtk_tree_model_get_iter (model, &iter, path)) {
+        if (!model || !gtk_tree_model_get_iter (model, &iter, path)) {
             gossip_debug (DEBUG_DOMAIN, "Couldn't get an iterator for the path");
             goto out;
         }
@@ -1978,6 +2366,10 @@ contact_list_drag_data_received (GtkWidget         *widget,
             gchar    *name;
 
             model = gtk_tree_view_get_model (GTK_TREE_VIEW (widget));
+            if (!model) {
+                goto out;
+            }
+
             name = contact_list_get_parent_group (model, path);
 
             if (groups && name &&
@@ -2177,7 +2569,7 @@ contact_list_drag_data_get (GtkWidget             *widget,
     priv = GET_PRIV (widget);
 
     model = gtk_tree_view_get_model (GTK_TREE_VIEW (widget));
-    if (!priv->drag_row) {
+    if (!model || !priv->drag_row) {
         return;
     }
 
@@ -2374,9 +2766,12 @@ contact_list_text_cell_data_func (GtkTreeViewColumn *tree_column,
                                   GtkTreeIter       *iter,
                                   GossipContactList *list)
 {
-    gboolean is_group;
-    gboolean is_active;
-    gboolean show_status;
+    GossipContactListPriv *priv;
+    gboolean               is_group;
+    gboolean               is_active;
+    gboolean               show_status;
+
+    priv = GET_PRIV (list);
 
     gtk_tree_model_get (model, iter,
                         COL_IS_GROUP, &is_group,
@@ -2388,6 +2783,24 @@ contact_list_text_cell_data_func (GtkTreeViewColumn *tree_column,
                   "show-status", show_status,
                   NULL);
 
+    if (is_group) {
+        ContactListGroup *group;
+        gchar            *name;
+
+        gtk_tree_model_get (model, iter, COL_NAME, &name, -1);
+
+        group = g_hash_table_lookup (priv->groups, name);
+        if (group) {
+            gchar *str;
+
+            str = g_strdup_printf ("%s (%d/%d)", name, group->online, group->members);
+            g_object_set (cell, "name", str, NULL);
+            g_free (str);
+        }
+
+        g_free (name);
+    }
+
     contact_list_cell_set_background (list, cell, is_group, is_active);
 }
 
@@ -2514,6 +2927,9 @@ contact_list_button_press_event_cb (GossipContactList *list,
 
     selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (list));
     model = gtk_tree_view_get_model (GTK_TREE_VIEW (list));
+    if (!model) {
+        return FALSE;
+    }
 
     gtk_widget_grab_focus (GTK_WIDGET (list));
 
@@ -2566,6 +2982,9 @@ contact_list_row_activated_cb (GossipContactList *list,
 
     view = GTK_TREE_VIEW (list);
     model = gtk_tree_view_get_model (view);
+    if (!model) {
+        return;
+    }
 
     gtk_tree_model_get_iter (model, &iter, path);
     gtk_tree_model_get (model, &iter, COL_CONTACT, &contact, -1);
@@ -2587,6 +3006,9 @@ contact_list_row_expand_or_collapse_cb (GossipContactList *list,
     gboolean      expanded;
 
     model = gtk_tree_view_get_model (GTK_TREE_VIEW (list));
+    if (!model) {
+        return;
+    }
 
     gtk_tree_model_get (model, iter,
                         COL_NAME, &name,
@@ -2785,7 +3207,7 @@ contact_list_filter_show_contact_for_match (GossipContactList *list,
                                             GossipContact     *contact)
 {
     GossipContactListPriv *priv;
-    gchar                 *str;
+    ContactListEntry      *entry;
     gboolean               visible = FALSE;
 
     priv = GET_PRIV (list);
@@ -2796,17 +3218,26 @@ contact_list_filter_show_contact_for_match (GossipContactList *list,
                       gossip_contact_get_name (contact));
         return TRUE;
     }
+
+    entry = g_hash_table_lookup (priv->contacts, contact);
+    if (!entry) {
+        return FALSE;
+    }
+
+    if (!entry->key_id) {
+        entry->key_id = g_utf8_casefold (gossip_contact_get_id (contact), -1);
+    }
+
+    if (!entry->key_name) {
+        entry->key_name = g_utf8_casefold (gossip_contact_get_name (contact), -1);
+    }
         
     /* Check contact id */
-    str = g_utf8_casefold (gossip_contact_get_id (contact), -1);
-    visible = G_STR_EMPTY (str) || strstr (str, priv->filter_text);
-    g_free (str);
+    visible = G_STR_EMPTY (entry->key_id) || strstr (entry->key_id, priv->filter_text);
         
     if (!visible) {
         /* Check contact name */
-        str = g_utf8_casefold (gossip_contact_get_name (contact), -1);
-        visible = G_STR_EMPTY (str) || strstr (str, priv->filter_text);
-        g_free (str);
+        visible = G_STR_EMPTY (entry->key_name) || strstr (entry->key_name, priv->filter_text);
     }
 
     gossip_debug (DEBUG_DOMAIN_FILTER, 
@@ -2854,29 +3285,22 @@ contact_list_filter_show_group_for_contacts (GossipContactList *list,
                                              const gchar       *group)
 {
     GossipContactListPriv *priv;
-    const GList           *contacts;
-    const GList           *l;
+    ContactListGroup      *lg;
     gboolean               show_group = FALSE;
 
     priv = GET_PRIV (list);
 
     /* At this point, we need to check in advance if this
      * group should be shown because a contact we want to
-     * show exists in it.
+     * show exists in it, the counters are kept up to date as
+     * contacts change so we don't need to look at them here.
      */
-    contacts = gossip_session_get_contacts (priv->session);
-    for (l = contacts; l && !show_group; l = l->next) {
-        if (!gossip_contact_is_in_group (l->data, group)) {
-            continue;
-        }
-
-        if (contact_list_filter_show_contact_for_events (list, l->data) &&
-            contact_list_filter_show_contact_for_match (list, l->data)) {
-            gossip_debug (DEBUG_DOMAIN_FILTER, 
-                          "---- Filter func:   group:'%s' match, contacts have match/events",
-                          group);
-            show_group = TRUE;
-        }
+    lg = g_hash_table_lookup (priv->groups, group);
+    if (lg && lg->shown > 0) {
+        gossip_debug (DEBUG_DOMAIN_FILTER, 
+                      "---- Filter func:   group:'%s' match, %d contacts have match/events",
+                      group, lg->shown);
+        show_group = TRUE;
     }
 
     return show_group;
@@ -2922,23 +3346,12 @@ contact_list_filter_func_show_group (GtkTreeModel      *model,
 
     if (contact_list_filter_show_group_for_match (list, group) || 
         contact_list_filter_show_group_for_contacts (list, group)) {
-        GossipContactListPriv *priv;
-        SetGroupStateData     *data;
-
-        priv = GET_PRIV (list);
-
         visible = TRUE;
 
-        g_hash_table_remove (priv->set_group_state, group); 
-
-        data = g_new0 (SetGroupStateData, 1);
-        data->list = g_object_ref (list);
-        data->group = g_strdup (group);
-        data->timeout_id = g_idle_add ((GSourceFunc) 
-                                       contact_list_set_group_state_cb,
-                                       data);
-                
-        g_hash_table_insert (priv->set_group_state, g_strdup (group), data);
+        /* The row may have just been shown, we set its expanded
+         * state once we are back in the main loop.
+         */
+        contact_list_queue_group_state (list, group);
     }
 
     gossip_debug (DEBUG_DOMAIN_FILTER,
@@ -2992,44 +3405,251 @@ contact_list_filter_func (GtkTreeModel      *model,
     return FALSE;
 }
 
-static gboolean
-contact_list_iter_equal_contact (GtkTreeModel  *model,
-                                 GtkTreeIter   *iter,
-                                 GossipContact *contact)
+static ContactListEntry *
+contact_list_entry_get (GossipContactList *list,
+                        GossipContact     *contact)
 {
-    GossipContact *c;
-    gboolean       equal;
+    GossipContactListPriv *priv;
+    ContactListEntry      *entry;
 
-    gtk_tree_model_get (model, iter,
-                        COL_CONTACT, &c,
-                        -1);
+    priv = GET_PRIV (list);
 
-    if (!c) {
-        return FALSE;
+    entry = g_hash_table_lookup (priv->contacts, contact);
+    if (!entry) {
+        entry = g_new0 (ContactListEntry, 1);
+        g_hash_table_insert (priv->contacts, g_object_ref (contact), entry);
     }
 
-    equal = gossip_contact_equal (c, contact);
-    g_object_unref (c);
+    return entry;
+}
+
+static void
+contact_list_entry_free (ContactListEntry *entry)
+{
+    g_list_foreach (entry->rows, (GFunc) gtk_tree_row_reference_free, NULL);
+    g_list_free (entry->rows);
+
+    g_list_foreach (entry->groups, (GFunc) g_free, NULL);
+    g_list_free (entry->groups);
+
+    g_free (entry->key_id);
+    g_free (entry->key_name);
 
-    return equal;
+    g_free (entry);
 }
 
-static gboolean
-contact_list_find_contact_foreach (GtkTreeModel *model,
-                                   GtkTreePath  *path,
-                                   GtkTreeIter  *iter,
-                                   FindContact  *fc)
+static void
+contact_list_entry_apply_counts (GossipContactList *list,
+                                 ContactListEntry  *entry,
+                                 gint               delta)
 {
-    if (contact_list_iter_equal_contact (model, iter, fc->contact)) {
-        fc->found = TRUE;
-        fc->iters = g_list_append (fc->iters, gtk_tree_iter_copy (iter));
+    GossipContactListPriv *priv;
+    GList                 *l;
+
+    priv = GET_PRIV (list);
+
+    for (l = entry->groups; l; l = l->next) {
+        ContactListGroup *group;
+
+        group = g_hash_table_lookup (priv->groups, l->data);
+        if (!group) {
+            continue;
+        }
+
+        group->members += delta;
+
+        if (entry->is_online) {
+            group->online += delta;
+        }
+
+        if (entry->is_shown) {
+            group->shown += delta;
+        }
     }
+}
 
-    /* We want to find ALL contacts that match, this means if we
-     * have the same contact in 3 groups, all iters should be
-     * returned.
+static void
+contact_list_entry_add_group (GossipContactList *list,
+                              ContactListEntry  *entry,
+                              const gchar       *name)
+{
+    GossipContactListPriv *priv;
+    ContactListGroup      *group;
+
+    priv = GET_PRIV (list);
+
+    entry->groups = g_list_prepend (entry->groups, g_strdup (name));
+
+    group = g_hash_table_lookup (priv->groups, name);
+    if (!group) {
+        return;
+    }
+
+    group->members++;
+
+    if (entry->is_online) {
+        group->online++;
+    }
+
+    if (entry->is_shown) {
+        group->shown++;
+    }
+}
+
+static void
+contact_list_entry_add_row (GossipContactList *list,
+                            ContactListEntry  *entry,
+                            GtkTreeIter       *iter)
+{
+    GossipContactListPriv *priv;
+    GtkTreeModel          *model;
+    GtkTreePath           *path;
+
+    priv = GET_PRIV (list);
+
+    model = GTK_TREE_MODEL (priv->store);
+
+    path = gtk_tree_model_get_path (model, iter);
+    entry->rows = g_list_prepend (entry->rows, 
+                                  gtk_tree_row_reference_new (model, path));
+    gtk_tree_path_free (path);
+}
+
+static void
+contact_list_entry_update (GossipContactList *list,
+                           GossipContact     *contact)
+{
+    GossipContactListPriv *priv;
+    ContactListEntry      *entry;
+
+    priv = GET_PRIV (list);
+
+    entry = g_hash_table_lookup (priv->contacts, contact);
+    if (!entry) {
+        return;
+    }
+
+    contact_list_entry_apply_counts (list, entry, -1);
+
+    entry->is_online = gossip_contact_is_online (contact);
+    entry->is_shown = (contact_list_filter_show_contact_for_events (list, contact) &&
+                       contact_list_filter_show_contact_for_match (list, contact));
+
+    contact_list_entry_apply_counts (list, entry, 1);
+
+    if (entry->is_shown) {
+        g_hash_table_insert (priv->shown_contacts, contact, entry);
+    } else {
+        g_hash_table_remove (priv->shown_contacts, contact);
+    }
+}
+
+static void
+contact_list_entry_remove (GossipContactList *list,
+                           GossipContact     *contact)
+{
+    GossipContactListPriv *priv;
+    ContactListEntry      *entry;
+
+    priv = GET_PRIV (list);
+
+    entry = g_hash_table_lookup (priv->contacts, contact);
+    if (!entry) {
+        return;
+    }
+
+    contact_list_entry_apply_counts (list, entry, -1);
+
+    g_hash_table_remove (priv->shown_contacts, contact);
+    g_hash_table_remove (priv->contacts, contact);
+}
+
+static void
+contact_list_entries_refresh (GossipContactList *list)
+{
+    GossipContactListPriv *priv;
+    GHashTableIter         iter;
+    gpointer               contact;
+
+    priv = GET_PRIV (list);
+
+    /* Used when something affecting every contact changes, like
+     * the filter text or showing offline contacts.
      */
-    return FALSE;
+    g_hash_table_iter_init (&iter, priv->contacts);
+    while (g_hash_table_iter_next (&iter, &contact, NULL)) {
+        contact_list_entry_update (list, contact);
+    }
+}
+
+static void
+contact_list_entries_narrow (GossipContactList *list)
+{
+    GossipContactListPriv *priv;
+    GtkTreeModel          *model;
+    GHashTableIter         hash_iter;
+    gpointer               value;
+    GList                 *contacts, *l;
+
+    priv = GET_PRIV (list);
+
+    model = GTK_TREE_MODEL (priv->store);
+
+    /* When the filter text only gets more specific, contacts
+     * which are hidden now can't match, so we only have to
+     * recheck those which are shown and tell the filter about
+     * the rows which changed instead of refiltering everything.
+     */
+    contacts = g_hash_table_get_keys (priv->shown_contacts);
+
+    for (l = contacts; l; l = l->next) {
+        ContactListEntry *entry;
+        GList            *rows;
+
+        contact_list_entry_update (list, l->data);
+
+        entry = g_hash_table_lookup (priv->contacts, l->data);
+        if (!entry || entry->is_shown) {
+            continue;
+        }
+
+        for (rows = entry->rows; rows; rows = rows->next) {
+            GtkTreePath *path;
+            GtkTreeIter  iter;
+
+            path = gtk_tree_row_reference_get_path (rows->data);
+            if (!path) {
+                continue;
+            }
+
+            if (gtk_tree_model_get_iter (model, &iter, path)) {
+                gtk_tree_model_row_changed (model, path, &iter);
+            }
+
+            gtk_tree_path_free (path);
+        }
+    }
+
+    g_list_free (contacts);
+
+    /* Groups may be shown or hidden by their name matching, so
+     * they all need checking, there are few of them anyway.
+     */
+    g_hash_table_iter_init (&hash_iter, priv->groups);
+    while (g_hash_table_iter_next (&hash_iter, NULL, &value)) {
+        ContactListGroup *group;
+        GtkTreeIter       iter;
+
+        group = value;
+
+        if (contact_list_group_get_iter (list, group, &iter)) {
+            GtkTreePath *path;
+
+            path = gtk_tree_model_get_path (model, &iter);
+            gtk_tree_model_row_changed (model, path, &iter);
+            gtk_tree_path_free (path);
+        }
+    }
 }
 
 static GList *
@@ -3038,25 +3658,41 @@ contact_list_find_contact (GossipContactList *list,
 {
     GossipContactListPriv *priv;
     GtkTreeModel          *model;
-    GList                 *l = NULL;
-    FindContact            fc;
+    ContactListEntry      *entry;
+    GList                 *l;
+    GList                 *iters = NULL;
 
     priv = GET_PRIV (list);
 
-    memset (&fc, 0, sizeof (fc));
-
-    fc.contact = contact;
+    /* We want to find ALL rows for this contact, this means if
+     * we have the same contact in 3 groups, all iters should be
+     * returned.
+     */
+    entry = g_hash_table_lookup (priv->contacts, contact);
+    if (!entry) {
+        return NULL;
+    }
 
     model = GTK_TREE_MODEL (priv->store);
-    gtk_tree_model_foreach (model,
-                            (GtkTreeModelForeachFunc) contact_list_find_contact_foreach,
-                            &fc);
 
-    if (fc.found) {
-        l = fc.iters;
+    for (l = entry->rows; l; l = l->next) {
+        GtkTreePath *path;
+        GtkTreeIter  iter;
+
+        path = gtk_tree_row_reference_get_path (l->data);
+        if (!path) {
+            /* Row was removed from under us, e.g. with its group */
+            continue;
+        }
+
+        if (gtk_tree_model_get_iter (model, &iter, path)) {
+            iters = g_list_prepend (iters, gtk_tree_iter_copy (&iter));
+        }
+
+        gtk_tree_path_free (path);
     }
 
-    return l;
+    return iters;
 }
 
 static void
@@ -3694,11 +4330,13 @@ gossip_contact_list_set_show_offline (GossipContactList *list,
     /* Disable temporarily. */
     priv->show_active = FALSE;
 
+    contact_list_entries_refresh (list);
+
     /* Simply refilter the model */
     gossip_debug (DEBUG_DOMAIN, 
                   "Refiltering %s offline contacts", 
                   show_offline ? "showing" : "not showing");
-    gtk_tree_model_filter_refilter (GTK_TREE_MODEL_FILTER (priv->filter));
+    contact_list_refilter (list);
 
     /* Restore to original setting. */
     priv->show_active = show_active;
@@ -3758,19 +4396,110 @@ gossip_contact_list_set_sort_criterium (GossipContactList     *list,
 
     priv->sort_criterium = sort_criterium;
 
-    switch (sort_criterium) {
-    case GOSSIP_CONTACT_LIST_SORT_STATE:
-        gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (priv->store),
-                                              COL_STATUS,
-                                              GTK_SORT_ASCENDING);
-        break;
-                
-    case GOSSIP_CONTACT_LIST_SORT_NAME:
-        gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (priv->store),
-                                              COL_NAME,
-                                              GTK_SORT_ASCENDING);
-        break;
+    /* When frozen, the store is sorted once when thawing */
+    if (priv->freeze_count > 0) {
+        return;
     }
+
+    contact_list_apply_sort (list);
+}
+
+/* Used around a batch of changes, which must be made before getting
+ * back to the main loop, so the view is never seen without its model.
+ */
+void
+gossip_contact_list_freeze (GossipContactList *list)
+{
+    GossipContactListPriv *priv;
+    GtkTreeSelection      *selection;
+    GtkTreeIter            iter;
+    GtkTreePath           *path;
+
+    g_return_if_fail (GOSSIP_IS_CONTACT_LIST (list));
+
+    priv = GET_PRIV (list);
+
+    if (priv->freeze_count++ > 0) {
+        return;
+    }
+
+    gossip_debug (DEBUG_DOMAIN, "Freezing contact list");
+
+    g_timer_start (priv->freeze_timer);
+
+    /* Remember what was selected and scrolled to, the view loses
+     * both when it is detached.
+     */
+    selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (list));
+    if (gtk_tree_selection_get_selected (selection, NULL, &iter)) {
+        path = gtk_tree_model_get_path (priv->filter, &iter);
+        priv->freeze_selected = contact_list_freeze_row_new (list, path);
+        gtk_tree_path_free (path);
+    }
+
+    if (gtk_tree_view_get_visible_range (GTK_TREE_VIEW (list), &path, NULL)) {
+        priv->freeze_top = contact_list_freeze_row_new (list, path);
+        gtk_tree_path_free (path);
+    }
+
+    /* Detach the view and drop the filter so changes to the
+     * store don't cause any filtering, redrawing or expanding
+     * and stop sorting so new rows are just prepended. All of
+     * this is done once in gossip_contact_list_thaw().
+     */
+    gtk_tree_view_set_model (GTK_TREE_VIEW (list), NULL);
+
+    g_object_unref (priv->filter);
+    priv->filter = NULL;
+
+    gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (priv->store),
+                                          GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID,
+                                          GTK_SORT_ASCENDING);
+}
+
+void
+gossip_contact_list_thaw (GossipContactList *list)
+{
+    GossipContactListPriv *priv;
+    GtkTreePath           *path;
+
+    g_return_if_fail (GOSSIP_IS_CONTACT_LIST (list));
+
+    priv = GET_PRIV (list);
+
+    g_return_if_fail (priv->freeze_count > 0);
+
+    if (--priv->freeze_count > 0) {
+        return;
+    }
+
+    contact_list_apply_sort (list);
+    contact_list_create_filter (list);
+    contact_list_restore_group_states (list);
+
+    path = contact_list_freeze_row_get_path (list, priv->freeze_selected);
+    if (path) {
+        GtkTreeSelection *selection;
+
+        selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (list));
+        gtk_tree_selection_select_path (selection, path);
+        gtk_tree_path_free (path);
+    }
+
+    path = contact_list_freeze_row_get_path (list, priv->freeze_top);
+    if (path) {
+        gtk_tree_view_scroll_to_cell (GTK_TREE_VIEW (list), path, NULL, TRUE, 0, 0);
+        gtk_tree_path_free (path);
+    }
+
+    priv->freeze_selected = NULL;
+    priv->freeze_top = NULL;
+
+    gossip_debug (DEBUG_DOMAIN, 
+                  "Thawed contact list, %d groups, %d contacts in %.3f seconds",
+                  g_hash_table_size (priv->groups),
+                  g_hash_table_size (priv->contacts),
+                  g_timer_elapsed (priv->freeze_timer, NULL));
 }
 
 void
@@ -3778,20 +4507,42 @@ gossip_contact_list_set_filter (GossipContactList *list,
                                 const gchar       *filter)
 {
     GossipContactListPriv *priv;
+    gchar                 *old_filter_text;
+    gboolean               narrowing;
 
     g_return_if_fail (GOSSIP_IS_CONTACT_LIST (list));
 
     priv = GET_PRIV (list);
 
-    g_free (priv->filter_text);
+    old_filter_text = priv->filter_text;
     if (filter) {
         priv->filter_text = g_utf8_casefold (filter, -1);
     } else {
         priv->filter_text = NULL;
     }
 
+    /* If the old text is contained in the new text, nothing
+     * hidden now can become visible (e.g. typing one more
+     * character).
+     */
+    narrowing = (!G_STR_EMPTY (priv->filter_text) &&
+                 (G_STR_EMPTY (old_filter_text) || 
+                  strstr (priv->filter_text, old_filter_text) != NULL));
+
+    g_free (old_filter_text);
+
+    if (narrowing) {
+        gossip_debug (DEBUG_DOMAIN, 
+                      "Narrowing shown contacts to those matching name/id/group:'%s' (insensitively)",
+                      filter);
+        contact_list_entries_narrow (list);
+        return;
+    }
+
+    contact_list_entries_refresh (list);
+
     gossip_debug (DEBUG_DOMAIN, 
                   "Refiltering showing contacts matching name/id/group:'%s' (insensitively)",
                   filter);
-    gtk_tree_model_filter_refilter (GTK_TREE_MODEL_FILTER (priv->filter));
+    contact_list_refilter (list);
 }
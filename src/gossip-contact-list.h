@@ -85,6 +85,8 @@ void                  gossip_contact_list_set_sort_criterium (GossipContactList
                                                               GossipContactListSort  sort_criterium);
 void                  gossip_contact_list_set_filter         (GossipContactList     *list,
                                                               const gchar           *filter);
+void                  gossip_contact_list_freeze             (GossipContactList     *list);
+void                  gossip_contact_list_thaw               (GossipContactList     *list);
 G_END_DECLS
 
 #endif /* __GOSSIP_CONTACT_LIST_H__ */
@@ -110,6 +110,12 @@ static gboolean gossip_dbus_new_message          (GossipDBus    *obj,
                                                   GError       **error);
 static gboolean gossip_dbus_toggle_roster        (GossipDBus    *obj,
                                                   GError       **error);
+static gboolean gossip_dbus_set_debug_domains    (GossipDBus    *obj,
+                                                  const gchar   *domains,
+                                                  GError       **error);
+static gboolean gossip_dbus_get_debug_domains    (GossipDBus    *obj,
+                                                  char         **domains,
+                                                  GError       **error);
 
 #include "gossip-dbus-glue.h"
 
@@ -414,6 +420,29 @@ gossip_dbus_toggle_roster (GossipDBus  *obj,
     return TRUE;
 }
 
+static gboolean
+gossip_dbus_set_debug_domains (GossipDBus   *obj,
+                               const gchar  *domains,
+                               GError      **error)
+{
+    /* Same format as GOSSIP_DEBUG, an empty string turns it off */
+    gossip_debug_set_domains (domains);
+
+    gossip_debug (DEBUG_DOMAIN, "Debug domains set to:'%s'", domains);
+
+    return TRUE;
+}
+
+static gboolean
+gossip_dbus_get_debug_domains (GossipDBus   *obj,
+                               char        **domains,
+                               GError      **error)
+{
+    *domains = gossip_debug_get_domains ();
+
+    return TRUE;
+}
+
 GQuark
 gossip_dbus_error_quark (void)
 {
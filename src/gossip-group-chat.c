@@ -37,6 +37,7 @@
 #include "gossip-contact-info-dialog.h"
 #include "gossip-glade.h"
 #include "gossip-group-chat.h"
+#include "gossip-nick-trie.h"
 #include "gossip-private-chat.h"
 #include "gossip-sound.h"
 #include "gossip-ui-utils.h"
@@ -47,6 +48,11 @@
 
 #define GET_PRIV(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GOSSIP_TYPE_GROUP_CHAT, GossipGroupChatPriv))
 
+/* Joins pending at once from this many on are added to the nick list
+ * with the model detached from the view and unsorted.
+ */
+#define CL_BATCH_THRESHOLD 32
+
 struct _GossipGroupChatPriv {
     GossipChatroomProvider *chatroom_provider;
     GossipChatroom         *chatroom;
@@ -66,7 +72,17 @@ struct _GossipGroupChatPriv {
 
     GtkWidget              *treeview;
 
-    GCompletion            *completion;
+    /* Nick -> GtkTreeRowReference of its row in the nick list */
+    GHashTable             *rows;
+    GtkTreeRowReference    *role_rows[GOSSIP_CHATROOM_ROLE_NONE + 1];
+
+    /* Nicks joined but not yet in the nick list */
+    GHashTable             *pending;
+    guint                   pending_id;
+    GTimer                 *join_timer;
+
+    /* Nicks in the room for tab completion */
+    GossipNickTrie         *nicks;
 
     GList                  *private_chats;
 
@@ -78,25 +94,12 @@ struct _GossipGroupChatPriv {
     GossipTime              time_joined;
 };
 
-typedef struct {
-    GossipGroupChat *chat;
-    GossipContact   *contact;
-    gboolean         found;
-    GtkTreeIter      found_iter;
-} ContactFindData;
-
 typedef struct {
     GossipGroupChat *chat;
     GossipContact   *contact;
     GtkWidget       *entry;
 } ChatInviteData;
 
-typedef struct {
-    GtkTreeIter        iter;
-    GossipChatroomRole role;
-    gboolean           found;
-} FindRoleIterData;
-
 static void            group_chat_contact_list_iface_init     (GossipContactListIfaceClass  *iface);
 static void            group_chat_finalize                    (GObject                      *object);
 static void            group_chat_retry_connection_clicked_cb (GtkWidget                    *button,
@@ -126,9 +129,6 @@ static void            group_chat_drag_data_received          (GtkWidget
                                                                GossipGroupChat              *chat);
 static void            group_chat_widget_destroy_cb           (GtkWidget                    *widget,
                                                                GossipGroupChat              *chat);
-static gint            group_chat_contacts_completion_func    (const gchar                  *s1,
-                                                               const gchar                  *s2,
-                                                               gsize                         n);
 static void            group_chat_create_ui                   (GossipGroupChat              *chat);
 static void            group_chat_chatroom_name_cb            (GossipChatroom               *chatroom,
                                                                GParamSpec                   *spec,
@@ -170,25 +170,20 @@ static void            group_chat_dialog_new                  (GossipGroupChat
                                                                const gchar                  *action,
                                                                const gchar                  *message,
                                                                const gchar                  *pretext);
-static void            group_chat_contact_joined_cb           (GossipChatroom               *chatroom,
-                                                               GossipContact                *contact,
+static void            group_chat_occupant_joined_cb          (GossipChatroom               *chatroom,
+                                                               const gchar                  *nick,
                                                                GossipGroupChat              *chat);
-static void            group_chat_contact_left_cb             (GossipChatroom               *chatroom,
-                                                               GossipContact                *contact,
+static void            group_chat_occupant_left_cb            (GossipChatroom               *chatroom,
+                                                               const gchar                  *nick,
                                                                GossipGroupChat              *chat);
-static void            group_chat_contact_info_changed_cb     (GossipChatroom               *chatroom,
-                                                               GossipContact                *contact,
-                                                               GossipGroupChat              *chat);
-static void            group_chat_contact_add                 (GossipGroupChat              *chat,
-                                                               GossipContact                *contact);
-static void            group_chat_contact_remove              (GossipGroupChat              *chat,
-                                                               GossipContact                *contact);
-static void            group_chat_contact_presence_updated_cb (GossipContact                *contact,
-                                                               GParamSpec                   *param,
-                                                               GossipGroupChat              *chat);
-static void            group_chat_contact_updated_cb          (GossipContact                *contact,
-                                                               GParamSpec                   *param,
+static void            group_chat_occupant_changed_cb         (GossipChatroom               *chatroom,
+                                                               const gchar                  *nick,
                                                                GossipGroupChat              *chat);
+static void            group_chat_occupant_add                (GossipGroupChat              *chat,
+                                                               const gchar                  *nick);
+static gboolean        group_chat_occupant_add_pending_cb     (GossipGroupChat              *chat);
+static void            group_chat_occupant_remove             (GossipGroupChat              *chat,
+                                                               const gchar                  *nick);
 static void            group_chat_private_chat_new            (GossipGroupChat              *chat,
                                                                GossipContact                *contact);
 static void            group_chat_private_chat_removed        (GossipGroupChat              *chat,
@@ -196,11 +191,6 @@ static void            group_chat_private_chat_removed        (GossipGroupChat
 static void            group_chat_private_chat_stop_foreach   (GossipChat                   *private_chat,
                                                                GossipGroupChat              *chat);
 static void            group_chat_send                        (GossipGroupChat              *chat);
-static gboolean        group_chat_get_nick_list_foreach       (GtkTreeModel                 *model,
-                                                               GtkTreePath                  *path,
-                                                               GtkTreeIter                  *iter,
-                                                               GList                       **list);
-static GList *         group_chat_get_nick_list               (GossipGroupChat              *chat);
 static GtkWidget *     group_chat_get_widget                  (GossipChat                   *chat);
 static const gchar *   group_chat_get_name                    (GossipChat                   *chat);
 static gchar *         group_chat_get_tooltip                 (GossipChat                   *chat);
@@ -213,6 +203,7 @@ static void            group_chat_set_show_contacts           (GossipChat
 static gboolean        group_chat_is_group_chat               (GossipChat                   *chat);
 static gboolean        group_chat_is_connected                (GossipChat                   *chat);
 static void            group_chat_get_role_iter               (GossipGroupChat              *chat,
+                                                               GtkTreeModel                 *model,
                                                                GossipChatroomRole            role,
                                                                GtkTreeIter                  *iter);
 static void            group_chat_cl_row_activated_cb         (GtkTreeView                  *view,
@@ -227,12 +218,16 @@ static gint            group_chat_cl_sort_func                (GtkTreeModel
                                                                GtkTreeIter                  *iter_b,
                                                                gpointer                      user_data);
 static void            group_chat_cl_setup                    (GossipGroupChat              *chat);
-static gboolean        group_chat_cl_find_foreach             (GtkTreeModel                 *model,
-                                                               GtkTreePath                  *path,
-                                                               GtkTreeIter                  *iter,
-                                                               ContactFindData              *data);
+static void            group_chat_cl_clear                    (GossipGroupChat              *chat);
+static gboolean        group_chat_cl_insert                   (GossipGroupChat              *chat,
+                                                               GtkTreeModel                 *model,
+                                                               const gchar                  *nick,
+                                                               GtkTreeIter                  *iter);
+static GtkTreeRowReference *
+group_chat_cl_row_reference_new        (GtkTreeModel                 *model,
+                                        GtkTreeIter                  *iter);
 static gboolean        group_chat_cl_find                     (GossipGroupChat              *chat,
-                                                               GossipContact                *contact,
+                                                               const gchar                  *nick,
                                                                GtkTreeIter                  *iter);
 static void            group_chat_cl_pixbuf_cell_data_func    (GtkTreeViewColumn            *tree_column,
                                                                GtkCellRenderer              *cell,
@@ -270,7 +265,6 @@ static void            group_chat_scroll_down_when_idle       (GossipGroupChat
 enum {
     COL_STATUS,
     COL_NAME,
-    COL_CONTACT,
     COL_IS_HEADER,
     COL_HEADER_ROLE,
     NUMBER_OF_COLS
@@ -327,6 +321,17 @@ gossip_group_chat_init (GossipGroupChat *chat)
 
     priv->contacts_visible = TRUE;
 
+    priv->rows = g_hash_table_new_full (g_str_hash,
+                                        g_str_equal,
+                                        g_free,
+                                        (GDestroyNotify) gtk_tree_row_reference_free);
+    priv->pending = g_hash_table_new_full (g_str_hash,
+                                           g_str_equal,
+                                           g_free,
+                                           NULL);
+
+    priv->nicks = gossip_nick_trie_new ();
+
     g_signal_connect_object (gossip_app_get_session (),
                              "protocol-connected",
                              G_CALLBACK (group_chat_protocol_connected_cb),
@@ -352,7 +357,6 @@ group_chat_finalize (GObject *object)
     GossipChatroomId      id;
     GossipChatroomStatus  status;
     GList                *l;
-    GList                *contacts;
 
     gossip_debug (DEBUG_DOMAIN, "Finalized:%p", object);
 
@@ -368,18 +372,6 @@ group_chat_finalize (GObject *object)
     id = gossip_chatroom_get_id (priv->chatroom);
     g_hash_table_steal (group_chats, GINT_TO_POINTER (id));
 
-    contacts = gossip_chatroom_get_contacts (priv->chatroom);
-    for (l = contacts; l; l = l->next) {
-        g_signal_handlers_disconnect_by_func (l->data,
-                                              group_chat_contact_updated_cb,
-                                              chat);
-        g_signal_handlers_disconnect_by_func (l->data,
-                                              group_chat_contact_presence_updated_cb,
-                                              chat);
-    }
-
-    g_list_free (contacts);
-
     g_signal_handlers_disconnect_by_func (priv->chatroom, 
                                           group_chat_chatroom_name_cb,
                                           chat);
@@ -405,13 +397,13 @@ group_chat_finalize (GObject *object)
                                           group_chat_error_cb,
                                           chat);
     g_signal_handlers_disconnect_by_func (priv->chatroom,
-                                          group_chat_contact_joined_cb,
+                                          group_chat_occupant_joined_cb,
                                           chat);
     g_signal_handlers_disconnect_by_func (priv->chatroom,
-                                          group_chat_contact_left_cb,
+                                          group_chat_occupant_left_cb,
                                           chat);
     g_signal_handlers_disconnect_by_func (priv->chatroom,
-                                          group_chat_contact_info_changed_cb,
+                                          group_chat_occupant_changed_cb,
                                           chat);
 
     /* Make sure we do this AFTER removing signal handlers
@@ -442,6 +434,19 @@ group_chat_finalize (GObject *object)
         g_source_remove (priv->scroll_idle_id);
     }
 
+    if (priv->pending_id) {
+        g_source_remove (priv->pending_id);
+    }
+
+    group_chat_cl_clear (chat);
+    g_hash_table_destroy (priv->rows);
+    g_hash_table_destroy (priv->pending);
+    gossip_nick_trie_free (priv->nicks);
+
+    if (priv->join_timer) {
+        g_timer_destroy (priv->join_timer);
+    }
+
     G_OBJECT_CLASS (gossip_group_chat_parent_class)->finalize (object);
 }
 
@@ -515,10 +520,15 @@ group_chat_chatroom_status_update (GossipGroupChat     *chat,
         GtkTreeModel *model;
         GtkTreeStore *store;
                 
+        group_chat_cl_clear (chat);
+
         view = GTK_TREE_VIEW (priv->treeview);
         model = gtk_tree_view_get_model (view);
         store = GTK_TREE_STORE (model);
         gtk_tree_store_clear (store);
+
+        gossip_nick_trie_free (priv->nicks);
+        priv->nicks = gossip_nick_trie_new ();
     }
         
     /* Either print state or error */
@@ -573,6 +583,13 @@ group_chat_join (GossipGroupChat *chat)
 
     priv = GET_PRIV (chat);
 
+    /* Used to tell how long it takes before the nick list is usable */
+    if (priv->join_timer) {
+        g_timer_start (priv->join_timer);
+    } else {
+        priv->join_timer = g_timer_new ();
+    }
+
     gossip_chatroom_provider_join (priv->chatroom_provider,
                                    priv->chatroom,
                                    (GossipChatroomJoinCb) group_chat_join_cb,
@@ -727,10 +744,9 @@ group_chat_key_press_event_cb (GtkWidget       *widget,
     gdouble              val;
     GtkTextBuffer       *buffer;
     GtkTextIter          start, current;
-    gchar               *nick, *completed;
+    gchar               *nick;
     gint                 len;
-    GList               *list, *l, *completed_list;
-    gboolean  is_start_of_buffer;
+    gboolean             is_start_of_buffer;
 
     priv = GET_PRIV (chat);
 
@@ -802,6 +818,11 @@ group_chat_key_press_event_cb (GtkWidget       *widget,
     if ((event->state & GDK_CONTROL_MASK) != GDK_CONTROL_MASK &&
         (event->state & GDK_SHIFT_MASK) != GDK_SHIFT_MASK &&
         event->keyval == GDK_Tab) {
+        const gchar *completed;
+        gint         common_len;
+        gboolean     spoke;
+        guint        n;
+
         buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (GOSSIP_CHAT (chat)->input_text_view));
         gtk_text_buffer_get_iter_at_mark (buffer, &current, gtk_text_buffer_get_insert (buffer));
 
@@ -811,60 +832,33 @@ group_chat_key_press_event_cb (GtkWidget       *widget,
         is_start_of_buffer = gtk_text_iter_is_start (&start);
 
         nick = gtk_text_buffer_get_text (buffer, &start, &current, FALSE);
-
-        g_completion_clear_items (priv->completion);
-
         len = strlen (nick);
 
-        list = group_chat_get_nick_list (chat);
-
-        g_completion_add_items (priv->completion, list);
-
-        completed_list = g_completion_complete (priv->completion,
-                                                nick,
-                                                &completed);
+        n = gossip_nick_trie_complete (priv->nicks, nick,
+                                       &completed, &common_len, &spoke);
 
         g_free (nick);
 
-        if (completed) {
-            int       len;
-            gchar    *text;
-
+        if (n == 1) {
+            /* Use the nick as it is instead of what was typed
+             * which might be cased all wrong. Fixes #120876
+             */
             gtk_text_buffer_delete (buffer, &start, &current);
+            gtk_text_buffer_insert_at_cursor (buffer, completed, -1);
 
-            len = g_list_length (completed_list);
-
-            if (len == 1) {
-                /* If we only have one hit, use that text
-                 * instead of the text in completed since the
-                 * completed text will use the typed string
-                 * which might be cased all wrong.
-                 * Fixes #120876
-                 * */
-                text = (gchar *) completed_list->data;
-            } else {
-                text = completed;
+            if (is_start_of_buffer) {
+                gtk_text_buffer_insert_at_cursor (buffer, ", ", 2);
             }
-
-            gtk_text_buffer_insert_at_cursor (buffer, text, strlen (text));
-
-            if (len == 1) {
-                if (is_start_of_buffer) {
-                    gtk_text_buffer_insert_at_cursor (buffer, ", ", 2);
-                }
-            }
-
-            g_free (completed);
-        }
-
-        g_completion_clear_items (priv->completion);
-
-        for (l = list; l; l = l->next) {
-            g_free (l->data);
+        } else if (n > 1 && common_len > len) {
+            /* Complete as far as all of them agree */
+            gtk_text_buffer_delete (buffer, &start, &current);
+            gtk_text_buffer_insert_at_cursor (buffer, completed, common_len);
+        } else if (n > 1 && spoke) {
+            /* Nothing more in common, go for who spoke last */
+            gtk_text_buffer_delete (buffer, &start, &current);
+            gtk_text_buffer_insert_at_cursor (buffer, completed, -1);
         }
 
-        g_list_free (list);
-
         return TRUE;
     }
 
@@ -950,30 +944,6 @@ group_chat_widget_destroy_cb (GtkWidget       *widget,
     g_hash_table_remove (group_chats, GINT_TO_POINTER (id));
 }
 
-static gint
-group_chat_contacts_completion_func (const gchar *s1,
-                                     const gchar *s2,
-                                     gsize        n)
-{
-    gchar *tmp, *nick1, *nick2;
-    gint   ret;
-
-    tmp = g_utf8_normalize (s1, -1, G_NORMALIZE_DEFAULT);
-    nick1 = g_utf8_casefold (tmp, -1);
-    g_free (tmp);
-
-    tmp = g_utf8_normalize (s2, -1, G_NORMALIZE_DEFAULT);
-    nick2 = g_utf8_casefold (tmp, -1);
-    g_free (tmp);
-
-    ret = strncmp (nick1, nick2, n);
-
-    g_free (nick1);
-    g_free (nick2);
-
-    return ret;
-}
-
 static void
 group_chat_create_ui (GossipGroupChat *chat)
 {
@@ -1103,11 +1073,6 @@ group_chat_create_ui (GossipGroupChat *chat)
                       G_CALLBACK (group_chat_drag_data_received),
                       chat);
 
-    /* Add nick name completion */
-    priv->completion = g_completion_new (NULL);
-    g_completion_set_compare (priv->completion,
-                              group_chat_contacts_completion_func);
-
     group_chat_cl_setup (chat);
 
     /* Set widget focus order */
@@ -1188,8 +1153,6 @@ group_chat_kicked_cb (GossipChatroomProvider *provider,
 {
     GossipGroupChatPriv *priv;
     GossipChatView      *chatview;
-    GList               *contacts;
-    GList               *l;
 
     priv = GET_PRIV (chat);
 
@@ -1201,17 +1164,6 @@ group_chat_kicked_cb (GossipChatroomProvider *provider,
 
     chatview = GOSSIP_CHAT (chat)->view;
 
-    contacts = gossip_chatroom_get_contacts (priv->chatroom);
-    for (l = contacts; l; l = l->next) {
-        g_signal_handlers_disconnect_by_func (l->data,
-                                              group_chat_contact_updated_cb,
-                                              chat);
-        g_signal_handlers_disconnect_by_func (l->data,
-                                              group_chat_contact_presence_updated_cb,
-                                              chat);
-    }
-    g_list_free (contacts);
-
     gtk_widget_set_sensitive (priv->hbox_subject, FALSE);
     gtk_widget_set_sensitive (priv->scrolled_window_contacts, FALSE);
     gtk_widget_set_sensitive (priv->scrolled_window_input, FALSE);
@@ -1247,6 +1199,12 @@ group_chat_nick_changed_cb (GossipChatroomProvider *provider,
                   old_nick,
                   gossip_contact_get_name (contact));
 
+    gossip_nick_trie_remove (priv->nicks, old_nick);
+    gossip_nick_trie_add (priv->nicks, gossip_contact_get_name (contact));
+
+    group_chat_occupant_remove (chat, old_nick);
+    group_chat_occupant_add (chat, gossip_contact_get_name (contact));
+
     chatview = GOSSIP_CHAT (chat)->view;
 
     str = g_strdup_printf (_("%s is now known as %s"),
@@ -1289,6 +1247,11 @@ group_chat_new_message_cb (GossipChatroomProvider *provider,
 
     is_incoming = !gossip_contact_equal (sender, own_contact);
 
+    /* Whoever spoke last comes first when completing nicks */
+    if (is_incoming) {
+        gossip_nick_trie_touch (priv->nicks, gossip_contact_get_name (sender));
+    }
+
     gossip_debug (DEBUG_DOMAIN, 
                   "[%d] New message with timestamp:%d, message %s backlog, %s incoming", 
                   id, timestamp, 
@@ -1554,6 +1517,8 @@ gossip_group_chat_get_selected_contact (GossipGroupChat *group_chat)
     GtkTreeIter          iter;
     GtkTreeModel        *model;
     GossipContact       *contact;
+    gboolean             is_header;
+    gchar               *name;
 
     g_return_val_if_fail (GOSSIP_IS_GROUP_CHAT (group_chat), NULL);
 
@@ -1564,9 +1529,21 @@ gossip_group_chat_get_selected_contact (GossipGroupChat *group_chat)
         return NULL;
     }
 
-    gtk_tree_model_get (model, &iter, COL_CONTACT, &contact, -1);
+    gtk_tree_model_get (model, &iter,
+                        COL_IS_HEADER, &is_header,
+                        COL_NAME, &name,
+                        -1);
+
+    if (is_header || !name) {
+        g_free (name);
+        return NULL;
+    }
+
+    /* The nick list only has nicks, the contact is made here */
+    contact = gossip_chatroom_get_occupant (priv->chatroom, name);
+    g_free (name);
 
-    return contact;
+    return contact ? g_object_ref (contact) : NULL;
 }
 
 static void
@@ -1580,6 +1557,7 @@ group_chat_cl_row_activated_cb (GtkTreeView       *view,
     GossipContact       *contact;
     GtkTreeModel        *model;
     GtkTreeIter          iter;
+    gchar               *name;
 
     if (gtk_tree_path_get_depth (path) == 1) {
         /* Do nothing for role groups */
@@ -1591,17 +1569,18 @@ group_chat_cl_row_activated_cb (GtkTreeView       *view,
     gtk_tree_model_get_iter (model, &iter, path);
     gtk_tree_model_get (model,
                         &iter,
-                        COL_CONTACT, &contact,
+                        COL_NAME, &name,
                         -1);
 
     priv = GET_PRIV (chat);
     own_contact = gossip_chatroom_get_own_contact (priv->chatroom);
+    contact = gossip_chatroom_get_occupant (priv->chatroom, name);
 
-    if (!gossip_contact_equal (own_contact, contact)) {
+    if (contact && !gossip_contact_equal (own_contact, contact)) {
         group_chat_private_chat_new (chat, contact);
     }
 
-    g_object_unref (contact);
+    g_free (name);
 }
 
 static gint
@@ -1628,25 +1607,21 @@ group_chat_cl_sort_func (GtkTreeModel *model,
 
         return role_a - role_b;
     } else {
-        GossipContact *contact_a, *contact_b;
-        const gchar   *name_a, *name_b;
-        gint           ret_val;
+        gchar *name_a, *name_b;
+        gint   ret_val;
 
         gtk_tree_model_get (model, iter_a,
-                            COL_CONTACT, &contact_a,
+                            COL_NAME, &name_a,
                             -1);
 
         gtk_tree_model_get (model, iter_b,
-                            COL_CONTACT, &contact_b,
+                            COL_NAME, &name_b,
                             -1);
 
-        name_a = gossip_contact_get_name (contact_a);
-        name_b = gossip_contact_get_name (contact_b);
-
         ret_val = g_ascii_strcasecmp (name_a, name_b);
 
-        g_object_unref (contact_a);
-        g_object_unref (contact_b);
+        g_free (name_a);
+        g_free (name_b);
 
         return ret_val;
     }
@@ -1718,7 +1693,6 @@ group_chat_cl_setup (GossipGroupChat *chat)
     store = gtk_tree_store_new (NUMBER_OF_COLS,
                                 GDK_TYPE_PIXBUF,
                                 G_TYPE_STRING,
-                                G_TYPE_OBJECT,
                                 G_TYPE_BOOLEAN,
                                 G_TYPE_INT);
 
@@ -1778,59 +1752,67 @@ group_chat_cl_setup (GossipGroupChat *chat)
                       chat);
 }
 
-static gboolean
-group_chat_cl_find_foreach (GtkTreeModel    *model,
-                            GtkTreePath     *path,
-                            GtkTreeIter     *iter,
-                            ContactFindData *data)
+static GtkTreeRowReference *
+group_chat_cl_row_reference_new (GtkTreeModel *model,
+                                 GtkTreeIter  *iter)
 {
-    GossipContact *contact;
-    gboolean       equal;
-
-    if (gtk_tree_path_get_depth (path) == 1) {
-        /* No contacts on depth 1 */
-        return FALSE;
-    }
-
-    gtk_tree_model_get (model, iter, COL_CONTACT, &contact, -1);
-
-    equal = gossip_contact_equal (data->contact, contact);
-    g_object_unref (contact);
+    GtkTreeRowReference *row_ref;
+    GtkTreePath         *path;
 
-    if (equal) {
-        data->found = TRUE;
-        data->found_iter = *iter;
-    }
+    path = gtk_tree_model_get_path (model, iter);
+    row_ref = gtk_tree_row_reference_new (model, path);
+    gtk_tree_path_free (path);
 
-    return equal;
+    return row_ref;
 }
 
 static gboolean
 group_chat_cl_find (GossipGroupChat *chat,
-                    GossipContact   *contact,
+                    const gchar     *nick,
                     GtkTreeIter     *iter)
 {
     GossipGroupChatPriv *priv;
-    ContactFindData      data;
+    GtkTreeRowReference *row_ref;
     GtkTreeModel        *model;
+    GtkTreePath         *path;
+    gboolean             found;
 
     priv = GET_PRIV (chat);
 
-    data.found = FALSE;
-    data.contact = contact;
-    data.chat = chat;
+    row_ref = g_hash_table_lookup (priv->rows, nick);
+    if (!row_ref) {
+        return FALSE;
+    }
+
+    path = gtk_tree_row_reference_get_path (row_ref);
+    if (!path) {
+        return FALSE;
+    }
 
-    model = gtk_tree_view_get_model (GTK_TREE_VIEW (priv->treeview));
+    model = gtk_tree_row_reference_get_model (row_ref);
+    found = gtk_tree_model_get_iter (model, iter, path);
+    gtk_tree_path_free (path);
 
-    gtk_tree_model_foreach (model,
-                            (GtkTreeModelForeachFunc) group_chat_cl_find_foreach,
-                            &data);
+    return found;
+}
 
-    if (data.found) {
-        *iter = data.found_iter;
-    }
+static void
+group_chat_cl_clear (GossipGroupChat *chat)
+{
+    GossipGroupChatPriv *priv;
+    gint                 i;
+
+    priv = GET_PRIV (chat);
 
-    return data.found;
+    g_hash_table_remove_all (priv->rows);
+    g_hash_table_remove_all (priv->pending);
+
+    for (i = 0; i < G_N_ELEMENTS (priv->role_rows); i++) {
+        if (priv->role_rows[i]) {
+            gtk_tree_row_reference_free (priv->role_rows[i]);
+            priv->role_rows[i] = NULL;
+        }
+    }
 }
 
 static void
@@ -1965,39 +1947,27 @@ group_chat_cl_set_background (GossipGroupChat *chat,
 }
 
 static void
-group_chat_contact_joined_cb (GossipChatroom  *chatroom,
-                              GossipContact   *contact,
-                              GossipGroupChat *chat)
+group_chat_occupant_joined_cb (GossipChatroom  *chatroom,
+                               const gchar     *nick,
+                               GossipGroupChat *chat)
 {
     GossipGroupChatPriv *priv;
     GossipContact       *own_contact;
 
     priv = GET_PRIV (chat);
 
-    gossip_debug (DEBUG_DOMAIN, 
-                  "Contact joined:'%s' (refs:%d)",
-                  gossip_contact_get_id (contact),
-                  G_OBJECT (contact)->ref_count);
-
-    group_chat_contact_add (chat, contact);
-
-    g_signal_connect (contact, "notify::presences",
-                      G_CALLBACK (group_chat_contact_presence_updated_cb),
-                      chat);
-    g_signal_connect (contact, "notify::name",
-                      G_CALLBACK (group_chat_contact_updated_cb),
-                      chat);
+    gossip_debug (DEBUG_DOMAIN, "Occupant joined:'%s'", nick);
 
-    g_signal_emit_by_name (chat, "contact-added", contact);
+    group_chat_occupant_add (chat, nick);
+    gossip_nick_trie_add (priv->nicks, nick);
 
     /* Add event to chatroom */
     own_contact = gossip_chatroom_get_own_contact (chatroom);
 
-    if (!gossip_contact_equal (own_contact, contact)) {
+    if (gossip_chatroom_find_occupant (chatroom, nick) != own_contact) {
         gchar *str;
 
-        str = g_strdup_printf (_("%s has joined the room"),
-                               gossip_contact_get_name (contact));
+        str = g_strdup_printf (_("%s has joined the room"), nick);
                 
         group_chat_set_scrolling_for_events (chat, TRUE);
         gossip_chat_view_append_event (GOSSIP_CHAT (chat)->view, str);
@@ -2008,39 +1978,27 @@ group_chat_contact_joined_cb (GossipChatroom  *chatroom,
 }
 
 static void
-group_chat_contact_left_cb (GossipChatroom  *chatroom,
-                            GossipContact   *contact,
-                            GossipGroupChat *chat)
+group_chat_occupant_left_cb (GossipChatroom  *chatroom,
+                             const gchar     *nick,
+                             GossipGroupChat *chat)
 {
     GossipGroupChatPriv *priv;
     GossipContact       *own_contact;
 
     priv = GET_PRIV (chat);
 
-    gossip_debug (DEBUG_DOMAIN, 
-                  "Contact left:'%s' (refs:%d)",
-                  gossip_contact_get_id (contact),
-                  G_OBJECT (contact)->ref_count);
-
-    g_signal_handlers_disconnect_by_func (contact,
-                                          group_chat_contact_updated_cb,
-                                          chat);
-    g_signal_handlers_disconnect_by_func (contact,
-                                          group_chat_contact_presence_updated_cb,
-                                          chat);
-
-    group_chat_contact_remove (chat, contact);
+    gossip_debug (DEBUG_DOMAIN, "Occupant left:'%s'", nick);
 
-    g_signal_emit_by_name (chat, "contact_removed", contact);
+    group_chat_occupant_remove (chat, nick);
+    gossip_nick_trie_remove (priv->nicks, nick);
 
     /* Add event to chatroom */
     own_contact = gossip_chatroom_get_own_contact (chatroom);
 
-    if (!gossip_contact_equal (own_contact, contact)) {
+    if (gossip_chatroom_find_occupant (chatroom, nick) != own_contact) {
         gchar *str;
 
-        str = g_strdup_printf (_("%s has left the room"),
-                               gossip_contact_get_name (contact));
+        str = g_strdup_printf (_("%s has left the room"), nick);
 
         group_chat_set_scrolling_for_events (chat, TRUE);
         gossip_chat_view_append_event (GOSSIP_CHAT (chat)->view, str);
@@ -2051,135 +2009,248 @@ group_chat_contact_left_cb (GossipChatroom  *chatroom,
 }
 
 static void
-group_chat_contact_info_changed_cb (GossipChatroom  *chatroom,
-                                    GossipContact   *contact,
-                                    GossipGroupChat *chat)
-{
-    group_chat_contact_remove (chat, contact);
-    group_chat_contact_add (chat, contact);
-}
-
-static void
-group_chat_contact_add (GossipGroupChat *chat,
-                        GossipContact   *contact)
+group_chat_occupant_changed_cb (GossipChatroom  *chatroom,
+                                const gchar     *nick,
+                                GossipGroupChat *chat)
 {
     GossipGroupChatPriv       *priv;
-    GossipChatroomContactInfo *info;
-    GossipChatroomRole         role = GOSSIP_CHATROOM_ROLE_NONE;
+    GossipChatroomContactInfo  info;
+    GossipChatroomRole         role;
+    GossipPresenceState        state;
     GtkTreeModel              *model;
-    GtkTreeIter                iter;
-    GtkTreeIter                parent;
+    GtkTreeIter                iter, parent;
     GdkPixbuf                 *pixbuf;
-    GtkTreePath               *path;
 
     priv = GET_PRIV (chat);
 
-    pixbuf = gossip_pixbuf_for_contact (contact);
-
-    info = gossip_chatroom_get_contact_info (priv->chatroom, contact);
-    if (info) {
-        role = info->role;
+    if (!group_chat_cl_find (chat, nick, &iter) ||
+        !gossip_chatroom_get_occupant_info (chatroom, nick, &info, &state)) {
+        return;
     }
-    group_chat_get_role_iter (chat, role, &parent);
 
     model = gtk_tree_view_get_model (GTK_TREE_VIEW (priv->treeview));
-    gtk_tree_store_append (GTK_TREE_STORE (model), &iter, &parent);
+    gtk_tree_model_iter_parent (model, &parent, &iter);
+    gtk_tree_model_get (model, &parent,
+                        COL_HEADER_ROLE, &role,
+                        -1);
 
-    gtk_tree_store_set (GTK_TREE_STORE (model),
-                        &iter,
-                        COL_CONTACT, contact,
-                        COL_NAME, gossip_contact_get_name (contact),
+    /* A new role means a new place in the list */
+    if (role != info.role) {
+        group_chat_occupant_remove (chat, nick);
+        group_chat_occupant_add (chat, nick);
+        return;
+    }
+
+    pixbuf = gossip_pixbuf_for_presence_state (state);
+    gtk_tree_store_set (GTK_TREE_STORE (model), &iter,
                         COL_STATUS, pixbuf,
-                        COL_IS_HEADER, FALSE,
                         -1);
+    g_object_unref (pixbuf);
+}
 
-    path = gtk_tree_model_get_path (model, &parent);
-    gtk_tree_view_expand_row (GTK_TREE_VIEW (priv->treeview), path, TRUE);
-    gtk_tree_path_free (path);
+/* Inserts the row for the occupant without looking at the view, the
+ * caller expands the header rows.
+ */
+static gboolean
+group_chat_cl_insert (GossipGroupChat *chat,
+                      GtkTreeModel    *model,
+                      const gchar     *nick,
+                      GtkTreeIter     *iter)
+{
+    GossipGroupChatPriv       *priv;
+    GossipChatroomContactInfo  info;
+    GossipPresenceState        state;
+    GtkTreeIter                parent;
+    GdkPixbuf                 *pixbuf;
+
+    priv = GET_PRIV (chat);
+
+    if (!gossip_chatroom_get_occupant_info (priv->chatroom, nick, &info, &state)) {
+        return FALSE;
+    }
+
+    pixbuf = gossip_pixbuf_for_presence_state (state);
+
+    group_chat_get_role_iter (chat, model, info.role, &parent);
+
+    gtk_tree_store_insert_with_values (GTK_TREE_STORE (model),
+                                       iter, &parent, -1,
+                                       COL_NAME, nick,
+                                       COL_STATUS, pixbuf,
+                                       COL_IS_HEADER, FALSE,
+                                       -1);
 
     g_object_unref (pixbuf);
+
+    return TRUE;
 }
 
 static void
-group_chat_contact_remove (GossipGroupChat *chat,
-                           GossipContact   *contact)
+group_chat_occupant_add (GossipGroupChat *chat,
+                         const gchar     *nick)
 {
     GossipGroupChatPriv *priv;
-    GtkTreeIter          iter;
 
     priv = GET_PRIV (chat);
 
-    if (group_chat_cl_find (chat, contact, &iter)) {
-        GtkTreeModel *model;
-        GtkTreeIter   parent;
-
-        model = gtk_tree_view_get_model (GTK_TREE_VIEW (priv->treeview));
-        gtk_tree_model_iter_parent (model, &parent, &iter);
-
-        gtk_tree_store_remove (GTK_TREE_STORE (model), &iter);
+    /* Rows are added from an idle so a flood of joins, like the one
+     * we get when joining a room, ends up in the list in one go.
+     */
+    if (!g_hash_table_lookup (priv->pending, nick)) {
+        g_hash_table_insert (priv->pending, 
+                             g_strdup (nick),
+                             GINT_TO_POINTER (1));
+    }
 
-        if (!gtk_tree_model_iter_has_child (model, &parent)) {
-            gtk_tree_store_remove (GTK_TREE_STORE (model), &parent);
-        }
+    if (!priv->pending_id) {
+        priv->pending_id = g_idle_add ((GSourceFunc) group_chat_occupant_add_pending_cb,
+                                       chat);
     }
 }
 
-static void
-group_chat_contact_presence_updated_cb (GossipContact   *contact,
-                                        GParamSpec      *param,
-                                        GossipGroupChat *chat)
+static gboolean
+group_chat_occupant_add_pending_cb (GossipGroupChat *chat)
 {
     GossipGroupChatPriv *priv;
-    GtkTreeIter          iter;
+    GtkTreeView         *view;
+    GtkTreeModel        *model;
+    GtkTreeSortable     *sortable;
+    GHashTable          *pending;
+    GList               *nicks, *l;
+    GArray              *iters;
+    GTimer              *timer;
+    guint                n;
+    guint                i;
+    gboolean             batch;
 
     priv = GET_PRIV (chat);
 
-    gossip_debug (DEBUG_DOMAIN, 
-                  "Contact Presence Updated:'%s'",
-                  gossip_contact_get_id (contact));
+    priv->pending_id = 0;
 
-    if (group_chat_cl_find (chat, contact, &iter)) {
-        GdkPixbuf    *pixbuf;
-        GtkTreeModel *model;
+    timer = g_timer_new ();
 
-        pixbuf = gossip_pixbuf_for_contact (contact);
+    view = GTK_TREE_VIEW (priv->treeview);
+    model = gtk_tree_view_get_model (view);
+    sortable = GTK_TREE_SORTABLE (model);
 
-        model = gtk_tree_view_get_model (GTK_TREE_VIEW (priv->treeview));
-        gtk_tree_store_set (GTK_TREE_STORE (model),
-                            &iter,
-                            COL_STATUS, pixbuf,
-                            -1);
+    /* The rows take over the nicks */
+    pending = priv->pending;
+    priv->pending = g_hash_table_new_full (g_str_hash,
+                                           g_str_equal,
+                                           g_free,
+                                           NULL);
 
-        gdk_pixbuf_unref (pixbuf);
-    } else {
-        g_signal_handlers_disconnect_by_func (contact,
-                                              group_chat_contact_presence_updated_cb,
-                                              chat);
+    nicks = g_hash_table_get_keys (pending);
+    n = g_list_length (nicks);
+    iters = g_array_sized_new (FALSE, FALSE, sizeof (GtkTreeIter), n);
+
+    batch = n >= CL_BATCH_THRESHOLD;
+
+    if (batch) {
+        /* Keep the view and the sorting out of it until all rows
+         * are in, then sort once.
+         */
+        g_object_ref (model);
+        gtk_tree_view_set_model (view, NULL);
+        gtk_tree_sortable_set_sort_column_id (sortable,
+                                              GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID,
+                                              GTK_SORT_ASCENDING);
+    }
+
+    for (l = nicks; l; l = l->next) {
+        GtkTreeIter iter;
+
+        if (!group_chat_cl_insert (chat, model, l->data, &iter)) {
+            /* Left again before we got to them */
+            l->data = NULL;
+            continue;
+        }
+
+        g_array_append_val (iters, iter);
+    }
+
+    if (batch) {
+        gtk_tree_sortable_set_sort_column_id (sortable,
+                                              GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID,
+                                              GTK_SORT_ASCENDING);
+    }
+
+    /* Tree store iters persist, so they are still good after sorting */
+    for (l = nicks, i = 0; l; l = l->next) {
+        if (!l->data) {
+            continue;
+        }
+
+        g_hash_table_steal (pending, l->data);
+        g_hash_table_replace (priv->rows, l->data,
+                              group_chat_cl_row_reference_new (model,
+                                                               &g_array_index (iters, GtkTreeIter, i)));
+        i++;
+    }
+
+    if (batch) {
+        gtk_tree_view_set_model (view, model);
+        g_object_unref (model);
+    }
+
+    gtk_tree_view_expand_all (view);
+
+    gossip_debug (DEBUG_DOMAIN, 
+                  "Added %d occupants to the nick list in %.2f ms%s",
+                  i,
+                  g_timer_elapsed (timer, NULL) * 1000,
+                  batch ? " (batched)" : "");
+
+    if (priv->join_timer) {
+        gossip_debug (DEBUG_DOMAIN, 
+                      "Nick list has %d occupants %.2f ms after joining",
+                      g_hash_table_size (priv->rows),
+                      g_timer_elapsed (priv->join_timer, NULL) * 1000);
     }
+
+    g_timer_destroy (timer);
+    g_array_free (iters, TRUE);
+    g_list_free (nicks);
+    g_hash_table_destroy (pending);
+
+    return FALSE;
 }
 
 static void
-group_chat_contact_updated_cb (GossipContact   *contact,
-                               GParamSpec      *param,
-                               GossipGroupChat *chat)
+group_chat_occupant_remove (GossipGroupChat *chat,
+                            const gchar     *nick)
 {
     GossipGroupChatPriv *priv;
     GtkTreeIter          iter;
 
     priv = GET_PRIV (chat);
 
-    if (group_chat_cl_find (chat, contact, &iter)) {
-        GtkTreeModel *model;
+    if (g_hash_table_remove (priv->pending, nick)) {
+        return;
+    }
+
+    if (group_chat_cl_find (chat, nick, &iter)) {
+        GtkTreeModel       *model;
+        GtkTreeIter         parent;
+        GossipChatroomRole  role;
 
         model = gtk_tree_view_get_model (GTK_TREE_VIEW (priv->treeview));
-        gtk_tree_store_set (GTK_TREE_STORE (model),
-                            &iter,
-                            COL_NAME, gossip_contact_get_name (contact),
-                            -1);
-    } else {
-        g_signal_handlers_disconnect_by_func (contact,
-                                              group_chat_contact_updated_cb,
-                                              chat);
+        gtk_tree_model_iter_parent (model, &parent, &iter);
+
+        g_hash_table_remove (priv->rows, nick);
+        gtk_tree_store_remove (GTK_TREE_STORE (model), &iter);
+
+        if (!gtk_tree_model_iter_has_child (model, &parent)) {
+            gtk_tree_model_get (model, &parent,
+                                COL_HEADER_ROLE, &role,
+                                -1);
+            gtk_tree_store_remove (GTK_TREE_STORE (model), &parent);
+
+            if (priv->role_rows[role]) {
+                gtk_tree_row_reference_free (priv->role_rows[role]);
+                priv->role_rows[role] = NULL;
+            }
+        }
     }
 }
 
@@ -2275,32 +2346,32 @@ group_chat_send (GossipGroupChat *chat)
         handled_command = TRUE;
     }
     else if (g_ascii_strncasecmp (msg, "/kick ", 6) == 0 && strlen (msg) > 6) {
-        GList         *contacts, *l;
+        GList         *nicks, *l;
         GossipContact *contact = NULL;
         const gchar   *nick;
 
         nick = msg + 6;
 
-        contacts = gossip_chatroom_get_contacts (priv->chatroom);
+        nicks = gossip_chatroom_get_occupant_nicks (priv->chatroom);
 
-        for (l = contacts; l && !contact; l = l->next) {
+        for (l = nicks; l && !contact; l = l->next) {
             const gchar *name;
             gchar       *name_caseless;
             gchar       *nick_caseless;
                         
-            name = gossip_contact_get_name (l->data);
+            name = l->data;
             name_caseless = g_utf8_casefold (name, -1);
             nick_caseless = g_utf8_casefold (nick, -1);
 
             if (strcmp (name_caseless, nick_caseless) == 0) {
-                contact = l->data;
+                contact = gossip_chatroom_get_occupant (priv->chatroom, name);
             }
 
             g_free (nick_caseless);
             g_free (name_caseless);
         }
 
-        g_list_free (contacts);
+        g_list_free (nicks);
                 
         if (contact) {
             gossip_group_chat_contact_kick (chat, contact);
@@ -2353,47 +2424,6 @@ group_chat_send (GossipGroupChat *chat)
     GOSSIP_CHAT (chat)->is_first_char = TRUE;
 }
 
-static gboolean
-group_chat_get_nick_list_foreach (GtkTreeModel  *model,
-                                  GtkTreePath   *path,
-                                  GtkTreeIter   *iter,
-                                  GList        **list)
-{
-    gchar *name;
-
-    if (gtk_tree_path_get_depth (path) == 1) {
-        /* No contacts on depth 1 */
-        return FALSE;
-    }
-
-    gtk_tree_model_get (model,
-                        iter,
-                        COL_NAME, &name,
-                        -1);
-
-    *list = g_list_prepend (*list, name);
-
-    return FALSE;
-}
-
-static GList *
-group_chat_get_nick_list (GossipGroupChat *chat)
-{
-    GossipGroupChatPriv *priv;
-    GtkTreeModel        *model;
-    GList               *list = NULL;
-
-    priv = GET_PRIV (chat);
-
-    model = gtk_tree_view_get_model (GTK_TREE_VIEW (priv->treeview));
-
-    gtk_tree_model_foreach (model,
-                            (GtkTreeModelForeachFunc) group_chat_get_nick_list_foreach,
-                            &list);
-
-    return list;
-}
-
 static GtkWidget *
 group_chat_get_widget (GossipChat *chat)
 {
@@ -2567,61 +2597,40 @@ group_chat_is_connected (GossipChat *chat)
     return status == GOSSIP_CHATROOM_STATUS_ACTIVE;
 }
 
-static gboolean
-group_chat_get_role_iter_foreach (GtkTreeModel     *model,
-                                  GtkTreePath      *path,
-                                  GtkTreeIter      *iter,
-                                  FindRoleIterData *fr)
-{
-    GossipChatroomRole role;
-    gboolean           is_header;
-
-    /* Headers are only at the top level. */
-    if (gtk_tree_path_get_depth (path) != 1) {
-        return FALSE;
-    }
-
-    gtk_tree_model_get (model, iter,
-                        COL_IS_HEADER, &is_header,
-                        COL_HEADER_ROLE, &role,
-                        -1);
-
-    if (is_header && role == fr->role) {
-        fr->iter = *iter;
-        fr->found = TRUE;
-    }
-
-    return fr->found;
-}
-
 static void
 group_chat_get_role_iter (GossipGroupChat    *chat,
+                          GtkTreeModel       *model,
                           GossipChatroomRole  role,
                           GtkTreeIter        *iter)
 {
     GossipGroupChatPriv *priv;
-    GtkTreeModel        *model;
-    FindRoleIterData     fr;
+    GtkTreePath         *path = NULL;
 
     priv = GET_PRIV (chat);
 
-    fr.found = FALSE;
-    fr.role = role;
+    if (priv->role_rows[role]) {
+        path = gtk_tree_row_reference_get_path (priv->role_rows[role]);
+    }
 
-    model = gtk_tree_view_get_model (GTK_TREE_VIEW (priv->treeview));
-    gtk_tree_model_foreach (model,
-                            (GtkTreeModelForeachFunc) group_chat_get_role_iter_foreach,
-                            &fr);
-
-    if (!fr.found) {
-        gtk_tree_store_append (GTK_TREE_STORE (model), iter, NULL);
-        gtk_tree_store_set (GTK_TREE_STORE (model), iter,
-                            COL_IS_HEADER, TRUE,
-                            COL_HEADER_ROLE, role,
-                            -1);
-    } else {
-        *iter = fr.iter;
+    if (path && gtk_tree_model_get_iter (model, iter, path)) {
+        gtk_tree_path_free (path);
+        return;
     }
+
+    if (path) {
+        gtk_tree_path_free (path);
+    }
+
+    if (priv->role_rows[role]) {
+        gtk_tree_row_reference_free (priv->role_rows[role]);
+    }
+
+    gtk_tree_store_insert_with_values (GTK_TREE_STORE (model), iter, NULL, -1,
+                                       COL_IS_HEADER, TRUE,
+                                       COL_HEADER_ROLE, role,
+                                       -1);
+
+    priv->role_rows[role] = group_chat_cl_row_reference_new (model, iter);
 }
 
 GossipGroupChat *
@@ -2630,6 +2639,7 @@ gossip_group_chat_new (GossipChatroomProvider *provider,
 {
     GossipGroupChat     *chat;
     GossipGroupChatPriv *priv;
+    GossipLogManager    *log_manager;
     GossipChatroomId     id;
 
     g_return_val_if_fail (GOSSIP_IS_CHATROOM_PROVIDER (provider), NULL);
@@ -2663,6 +2673,15 @@ gossip_group_chat_new (GossipChatroomProvider *provider,
 
     g_hash_table_insert (group_chats, GINT_TO_POINTER (id), chat);
 
+    /* Older messages are read from the log when scrolling up, the
+     * senders are all shown as others like the log window does.
+     */
+    log_manager = gossip_session_get_log_manager (gossip_app_get_session ());
+    gossip_chat_view_set_history (GOSSIP_CHAT (chat)->view,
+                                  gossip_log_reader_new_for_chatroom (log_manager,
+                                                                      chatroom),
+                                  NULL);
+
     g_signal_connect (chatroom, "notify::name",
                       G_CALLBACK (group_chat_chatroom_name_cb),
                       chat);
@@ -2687,14 +2706,14 @@ gossip_group_chat_new (GossipChatroomProvider *provider,
     g_signal_connect (provider, "chatroom-error",
                       G_CALLBACK (group_chat_error_cb),
                       chat);
-    g_signal_connect (chatroom, "contact-joined",
-                      G_CALLBACK (group_chat_contact_joined_cb),
+    g_signal_connect (chatroom, "occupant-joined",
+                      G_CALLBACK (group_chat_occupant_joined_cb),
                       chat);
-    g_signal_connect (chatroom, "contact-left",
-                      G_CALLBACK (group_chat_contact_left_cb),
+    g_signal_connect (chatroom, "occupant-left",
+                      G_CALLBACK (group_chat_occupant_left_cb),
                       chat);
-    g_signal_connect (chatroom, "contact-info-changed",
-                      G_CALLBACK (group_chat_contact_info_changed_cb),
+    g_signal_connect (chatroom, "occupant-changed",
+                      G_CALLBACK (group_chat_occupant_changed_cb),
                       chat);
 
     /* Actually join the chat room */
@@ -310,10 +310,7 @@ log_window_find_changed_cb (GtkTreeSelection *selection,
     GossipContact *contact;
     gchar         *date;
     GossipContact *own_contact;
-    GossipContact *sender;
-    GossipMessage *message;
     GList         *messages;
-    GList         *l;
     gboolean       can_do_previous;
     gboolean       can_do_next;
 
@@ -355,23 +352,9 @@ log_window_find_changed_cb (GtkTreeSelection *selection,
     g_object_unref (contact);
     g_free (date);
 
-    for (l = messages; l; l = l->next) {
-        message = l->data;
-
-        sender = gossip_message_get_sender (message);
-
-        if (gossip_contact_equal (own_contact, sender)) {
-            gossip_chat_view_append_message_from_self (window->chatview_find,
-                                                       message,
-                                                       own_contact,
-                                                       NULL);
-        } else {
-            gossip_chat_view_append_message_from_other (window->chatview_find,
-                                                        message,
-                                                        sender,
-                                                        NULL);
-        }
-    }
+    gossip_chat_view_append_messages (window->chatview_find,
+                                      messages,
+                                      own_contact);
 
     g_list_foreach (messages, (GFunc) g_object_unref, NULL);
     g_list_free (messages);
@@ -945,8 +928,6 @@ log_window_contacts_get_messages (GossipLogWindow *window,
     GossipAccount *account;
     GossipContact *contact;
     GossipContact *own_contact;
-    GossipContact *sender;
-    GossipMessage *message;
     GList         *messages;
     GList         *dates = NULL;
     GList         *l;
@@ -1073,23 +1054,9 @@ log_window_contacts_get_messages (GossipLogWindow *window,
     /* Get messages */
     messages = gossip_log_get_messages_for_contact (window->log_manager, contact, date);
 
-    for (l = messages; l; l = l->next) {
-        message = l->data;
-
-        sender = gossip_message_get_sender (message);
-
-        if (gossip_contact_equal (own_contact, sender)) {
-            gossip_chat_view_append_message_from_self (window->chatview_contacts,
-                                                       message,
-                                                       own_contact,
-                                                       NULL);
-        } else {
-            gossip_chat_view_append_message_from_other (window->chatview_contacts,
-                                                        message,
-                                                        sender,
-                                                        NULL);
-        }
-    }
+    gossip_chat_view_append_messages (window->chatview_contacts,
+                                      messages,
+                                      own_contact);
 
     g_list_foreach (messages, (GFunc) g_object_unref, NULL);
     g_list_free (messages);
@@ -1538,7 +1505,6 @@ log_window_chatrooms_get_messages (GossipLogWindow *window,
     GossipAccount  *account;
     GossipChatroom *chatroom;
     GossipContact  *own_contact;
-    GossipMessage  *message;
     GList          *messages;
     GList          *dates = NULL;
     GList          *l;
@@ -1669,14 +1635,9 @@ log_window_chatrooms_get_messages (GossipLogWindow *window,
     /* Get messages */
     messages = gossip_log_get_messages_for_chatroom (window->log_manager, chatroom, date);
 
-    for (l = messages; l; l = l->next) {
-        message = l->data;
-
-        gossip_chat_view_append_message_from_other (window->chatview_chatrooms,
-                                                    message,
-                                                    gossip_message_get_sender (message),
-                                                    NULL);
-    }
+    gossip_chat_view_append_messages (window->chatview_chatrooms,
+                                      messages,
+                                      NULL);
 
     g_list_foreach (messages, (GFunc) g_object_unref, NULL);
     g_list_free (messages);
@@ -75,6 +75,13 @@ typedef struct {
     GtkTreeModel     *filter_model;
     GtkTreeModel     *sort_model;
 
+    /* Rows by chatroom JID, to update them when room info comes in */
+    GHashTable       *rows;
+    guint             info_idle_id;
+
+    gboolean          browsing;
+    gchar            *browsed_server;
+
     GtkWidget        *button_join;
     GtkWidget        *button_close;
 
@@ -83,6 +90,14 @@ typedef struct {
 
 static void     new_chatroom_dialog_update_buttons                  (GossipNewChatroomDialog *dialog);
 static void     new_chatroom_dialog_update_widgets                  (GossipNewChatroomDialog *dialog);
+static GossipChatroomProvider *
+                new_chatroom_dialog_get_provider                    (GossipNewChatroomDialog *dialog);
+static void     new_chatroom_dialog_model_set                       (GtkListStore            *store,
+                                                                     GtkTreeIter             *iter,
+                                                                     GossipChatroom          *chatroom);
+static void     new_chatroom_dialog_model_chatroom_notify_cb        (GossipChatroom          *chatroom,
+                                                                     GParamSpec              *param,
+                                                                     GossipNewChatroomDialog *dialog);
 static void     new_chatroom_dialog_model_add                       (GossipNewChatroomDialog *dialog,
                                                                      GossipChatroom          *chatroom,
                                                                      gboolean                 prepend);
@@ -114,6 +129,10 @@ static void     new_chatroom_dialog_model_text_cell_data_func       (GtkTreeView
                                                                      GtkTreeModel            *model,
                                                                      GtkTreeIter             *iter,
                                                                      GossipNewChatroomDialog *dialog);
+static gboolean new_chatroom_dialog_update_info_idle_cb             (GossipNewChatroomDialog *dialog);
+static void     new_chatroom_dialog_update_info_queue               (GossipNewChatroomDialog *dialog);
+static void     new_chatroom_dialog_model_scrolled_cb               (GtkAdjustment           *adjustment,
+                                                                     GossipNewChatroomDialog *dialog);
 static void     new_chatroom_dialog_model_setup                     (GossipNewChatroomDialog *dialog);
 static void     new_chatroom_dialog_set_defaults                    (GossipNewChatroomDialog *dialog);
 static void     new_chatroom_dialog_join                            (GossipNewChatroomDialog *window);
@@ -122,6 +141,7 @@ static void     new_chatroom_dialog_entry_changed_cb                (GtkWidget
 static void     new_chatroom_dialog_browse_cb                       (GossipChatroomProvider  *provider,
                                                                      const gchar             *server,
                                                                      GList                   *rooms,
+                                                                     gboolean                 last_page,
                                                                      GError                  *error,
                                                                      GossipNewChatroomDialog *dialog);
 static void     new_chatroom_dialog_browse_start                    (GossipNewChatroomDialog *dialog);
@@ -245,20 +265,99 @@ new_chatroom_dialog_account_changed_cb (GtkComboBox             *combobox,
     new_chatroom_dialog_update_widgets (dialog);
 }
 
+static GossipChatroomProvider *
+new_chatroom_dialog_get_provider (GossipNewChatroomDialog *dialog)
+{
+    GossipSession          *session;
+    GossipAccount          *account;
+    GossipAccountChooser   *account_chooser;
+    GossipChatroomProvider *provider;
+
+    session = gossip_app_get_session ();
+
+    account_chooser = GOSSIP_ACCOUNT_CHOOSER (dialog->account_chooser);
+    account = gossip_account_chooser_get_account (account_chooser);
+        
+    if (!account) {
+        return NULL;
+    }
+
+    provider = gossip_session_get_chatroom_provider (session, account);
+    g_object_unref (account);
+
+    return provider;
+}
+
+static void
+new_chatroom_dialog_model_set (GtkListStore   *store,
+                               GtkTreeIter    *iter,
+                               GossipChatroom *chatroom)
+{
+    GossipChatroomFeature  features;
+    const gchar           *stock_id = NULL;
+
+    features = gossip_chatroom_get_features (chatroom);
+    if (features & GOSSIP_CHATROOM_FEATURE_PASSWORD_PROTECTED) {
+        stock_id = GTK_STOCK_DIALOG_AUTHENTICATION;
+    }
+
+    gtk_list_store_set (store, iter,
+                        COL_NAME, gossip_chatroom_get_name (chatroom),
+                        COL_OCCUPANTS, gossip_chatroom_get_occupants (chatroom),
+                        COL_PASSWORD_PROTECTED, stock_id,
+                        COL_DESCRIPTION, gossip_chatroom_get_description (chatroom),
+                        COL_POINTER, chatroom,
+                        -1);
+}
+
+static void
+new_chatroom_dialog_model_chatroom_notify_cb (GossipChatroom          *chatroom,
+                                              GParamSpec              *param,
+                                              GossipNewChatroomDialog *dialog)
+{
+    GtkTreeRowReference *row;
+    GtkTreePath         *path;
+    GtkTreeIter          iter;
+
+    if (strcmp (param->name, "features") != 0 &&
+        strcmp (param->name, "description") != 0 &&
+        strcmp (param->name, "occupants") != 0) {
+        return;
+    }
+
+    row = g_hash_table_lookup (dialog->rows, chatroom);
+    if (!row) {
+        return;
+    }
+
+    path = gtk_tree_row_reference_get_path (row);
+    if (!path) {
+        return;
+    }
+
+    if (gtk_tree_model_get_iter (dialog->model, &iter, path)) {
+        new_chatroom_dialog_model_set (GTK_LIST_STORE (dialog->model), 
+                                       &iter, chatroom);
+    }
+
+    gtk_tree_path_free (path);
+}
 
 static void
 new_chatroom_dialog_model_add (GossipNewChatroomDialog *dialog,
                                GossipChatroom          *chatroom,
                                gboolean                 prepend)
 {
-    GtkTreeView      *view;
-    GtkTreeSelection *selection;
-    GtkListStore     *store;
-    GtkTreeIter       iter;
+    GtkListStore *store;
+    GtkTreeIter   iter;
+    GtkTreePath  *path;
+
+    /* Rooms listed already, by JID, keep their row */
+    if (chatroom && g_hash_table_lookup (dialog->rows, chatroom)) {
+        return;
+    }
 
     /* Add to model */
-    view = GTK_TREE_VIEW (dialog->treeview);
-    selection = gtk_tree_view_get_selection (view);
     store = GTK_LIST_STORE (dialog->model);
 
     if (prepend) {
@@ -267,29 +366,37 @@ new_chatroom_dialog_model_add (GossipNewChatroomDialog *dialog,
         gtk_list_store_append (store, &iter);
     }
 
-    if (chatroom) {
-        GossipChatroomFeature  features;
-        const gchar           *stock_id = NULL;
-                
-        features = gossip_chatroom_get_features (chatroom);
-        if (features & GOSSIP_CHATROOM_FEATURE_PASSWORD_PROTECTED) {
-            stock_id = GTK_STOCK_DIALOG_AUTHENTICATION;
-        }
-
-        gtk_list_store_set (store, &iter,
-                            COL_NAME, gossip_chatroom_get_name (chatroom),
-                            COL_OCCUPANTS, gossip_chatroom_get_occupants (chatroom),
-                            COL_PASSWORD_PROTECTED, stock_id,
-                            COL_DESCRIPTION, gossip_chatroom_get_description (chatroom),
-                            COL_POINTER, chatroom,
-                            -1);
+    if (!chatroom) {
+        return;
     }
+
+    new_chatroom_dialog_model_set (store, &iter, chatroom);
+
+    path = gtk_tree_model_get_path (dialog->model, &iter);
+    g_hash_table_insert (dialog->rows, chatroom,
+                         gtk_tree_row_reference_new (dialog->model, path));
+    gtk_tree_path_free (path);
+
+    g_signal_connect (chatroom, "notify",
+                      G_CALLBACK (new_chatroom_dialog_model_chatroom_notify_cb),
+                      dialog);
 }
 
 static void
 new_chatroom_dialog_model_clear (GossipNewChatroomDialog *dialog)
 {
     GtkListStore *store;
+    GList        *chatrooms, *l;
+
+    chatrooms = g_hash_table_get_keys (dialog->rows);
+    for (l = chatrooms; l; l = l->next) {
+        g_signal_handlers_disconnect_by_func (l->data,
+                                              new_chatroom_dialog_model_chatroom_notify_cb,
+                                              dialog);
+    }
+    g_list_free (chatrooms);
+
+    g_hash_table_remove_all (dialog->rows);
 
     store = GTK_LIST_STORE (dialog->model);
     gtk_list_store_clear (store);
@@ -465,6 +572,76 @@ new_chatroom_dialog_model_text_cell_data_func (GtkTreeViewColumn       *tree_col
     g_free (name);
 }
 
+/* Rooms are listed with what the server said in the list, the rest of
+ * what there is to know about them is only asked for once they are
+ * scrolled into view.
+ */
+static gboolean
+new_chatroom_dialog_update_info_idle_cb (GossipNewChatroomDialog *dialog)
+{
+    GossipChatroomProvider *provider;
+    GtkTreeView            *view;
+    GtkTreeModel           *model;
+    GtkTreePath            *start, *end;
+    GtkTreeIter             iter;
+    gboolean                done = FALSE;
+
+    dialog->info_idle_id = 0;
+
+    provider = new_chatroom_dialog_get_provider (dialog);
+    if (!provider) {
+        return FALSE;
+    }
+
+    view = GTK_TREE_VIEW (dialog->treeview);
+    if (!gtk_tree_view_get_visible_range (view, &start, &end)) {
+        return FALSE;
+    }
+
+    model = gtk_tree_view_get_model (view);
+
+    if (gtk_tree_model_get_iter (model, &iter, start)) {
+        do {
+            GossipChatroom *chatroom;
+            GtkTreePath    *path;
+
+            gtk_tree_model_get (model, &iter, COL_POINTER, &chatroom, -1);
+            if (chatroom) {
+                gossip_chatroom_provider_update_room_info (provider, chatroom);
+                g_object_unref (chatroom);
+            }
+
+            path = gtk_tree_model_get_path (model, &iter);
+            done = gtk_tree_path_compare (path, end) >= 0;
+            gtk_tree_path_free (path);
+        } while (!done && gtk_tree_model_iter_next (model, &iter));
+    }
+
+    gtk_tree_path_free (start);
+    gtk_tree_path_free (end);
+
+    return FALSE;
+}
+
+static void
+new_chatroom_dialog_update_info_queue (GossipNewChatroomDialog *dialog)
+{
+    if (dialog->info_idle_id) {
+        return;
+    }
+
+    dialog->info_idle_id = 
+        g_idle_add ((GSourceFunc) new_chatroom_dialog_update_info_idle_cb, 
+                    dialog);
+}
+
+static void
+new_chatroom_dialog_model_scrolled_cb (GtkAdjustment           *adjustment,
+                                       GossipNewChatroomDialog *dialog)
+{
+    new_chatroom_dialog_update_info_queue (dialog);
+}
+
 static void
 new_chatroom_dialog_model_setup (GossipNewChatroomDialog *dialog)
 {
@@ -492,6 +669,14 @@ new_chatroom_dialog_model_setup (GossipNewChatroomDialog *dialog)
     g_signal_connect (view, "row-activated",
                       G_CALLBACK (new_chatroom_dialog_model_row_activated_cb),
                       dialog);
+    g_signal_connect (gtk_tree_view_get_vadjustment (view), "value-changed",
+                      G_CALLBACK (new_chatroom_dialog_model_scrolled_cb),
+                      dialog);
+
+    dialog->rows = g_hash_table_new_full (gossip_chatroom_hash,
+                                          gossip_chatroom_equal,
+                                          NULL,
+                                          (GDestroyNotify) gtk_tree_row_reference_free);
     /* Create store */
     store = gtk_list_store_new (COL_COUNT,
                                 GDK_TYPE_PIXBUF,       /* Image */
@@ -773,6 +958,7 @@ new_chatroom_dialog_entry_changed_cb (GtkWidget               *entry,
 {
     if (entry == dialog->entry_room) {
         gtk_tree_model_filter_refilter (GTK_TREE_MODEL_FILTER (dialog->filter_model));
+        new_chatroom_dialog_update_info_queue (dialog);
     } 
 
     new_chatroom_dialog_update_buttons (dialog);
@@ -782,27 +968,32 @@ static void
 new_chatroom_dialog_browse_cb (GossipChatroomProvider  *provider,
                                const gchar             *server,
                                GList                   *rooms,
+                               gboolean                 last_page,
                                GError                  *error,
                                GossipNewChatroomDialog *dialog)
 {
     GList *l;
     gchar *str;
+    gint   count;
 
-    if (!dialog_p) {
+    if (!dialog_p || dialog != dialog_p || !dialog->browsing) {
         return;
     }
 
-    gossip_toggle_button_set_state_quietly (dialog->togglebutton_refresh, 
-                                            G_CALLBACK (new_chatroom_dialog_togglebutton_refresh_toggled_cb),
-                                            dialog,
-                                            FALSE);
+    if (last_page) {
+        dialog->browsing = FALSE;
 
-    gtk_spinner_stop (GTK_SPINNER (dialog->throbber));
+        gossip_toggle_button_set_state_quietly (dialog->togglebutton_refresh, 
+                                                G_CALLBACK (new_chatroom_dialog_togglebutton_refresh_toggled_cb),
+                                                dialog,
+                                                FALSE);
 
-    gtk_widget_hide (dialog->throbber);
-    gtk_widget_show (dialog->button_size);
+        gtk_spinner_stop (GTK_SPINNER (dialog->throbber));
+
+        gtk_widget_hide (dialog->throbber);
+        gtk_widget_show (dialog->button_size);
+    }
 
-    new_chatroom_dialog_model_clear (dialog);
     gtk_widget_set_sensitive (dialog->treeview, TRUE);
 
     if (error) {
@@ -819,34 +1010,50 @@ new_chatroom_dialog_browse_cb (GossipChatroomProvider  *provider,
                                   GTK_STOCK_FIND,
                                   GTK_ICON_SIZE_BUTTON); 
 
-    str = g_strdup_printf (ngettext ("Found %d conference room", 
-                                     "Found %d conference rooms", 
-                                     g_list_length (rooms)), 
-                           g_list_length (rooms));
-    gtk_label_set_text (GTK_LABEL (dialog->label_status), str);
-    g_free (str);
-
     for (l = rooms; l; l = l->next) {
         new_chatroom_dialog_model_add (dialog, l->data, FALSE);
     }
+
+    count = gtk_tree_model_iter_n_children (dialog->model, NULL);
+
+    if (last_page) {
+        str = g_strdup_printf (ngettext ("Found %d conference room", 
+                                         "Found %d conference rooms", 
+                                         count), 
+                               count);
+    } else {
+        str = g_strdup_printf (ngettext ("Found %d conference room so far...", 
+                                         "Found %d conference rooms so far...", 
+                                         count), 
+                               count);
+    }
+
+    gtk_label_set_text (GTK_LABEL (dialog->label_status), str);
+    g_free (str);
+
+    new_chatroom_dialog_update_info_queue (dialog);
 }
 
 static void
 new_chatroom_dialog_browse_start (GossipNewChatroomDialog *dialog)
 {
-    GossipSession          *session;
-
-    GossipAccount          *account;
-    GossipAccountChooser   *account_chooser;
-
     GossipChatroomProvider *provider;
     const gchar            *server;
+    gboolean                refresh;
 
     server = gtk_entry_get_text (GTK_ENTRY (dialog->entry_server));
     if (G_STR_EMPTY (server)) {
         return;
     }
 
+    /* Asking again for the server already listed means the user wants
+     * it fresh, otherwise what was found earlier will do.
+     */
+    refresh = dialog->browsed_server && strcmp (dialog->browsed_server, server) == 0;
+
+    g_free (dialog->browsed_server);
+    dialog->browsed_server = g_strdup (server);
+
     /* Set UI */
     gossip_toggle_button_set_state_quietly (dialog->togglebutton_refresh, 
                                             G_CALLBACK (new_chatroom_dialog_togglebutton_refresh_toggled_cb),
@@ -866,20 +1073,19 @@ new_chatroom_dialog_browse_start (GossipNewChatroomDialog *dialog)
 
     gtk_spinner_start (GTK_SPINNER (dialog->throbber));
 
-    /* Fire off request */
-    session = gossip_app_get_session ();
+    new_chatroom_dialog_model_clear (dialog);
 
-    account_chooser = GOSSIP_ACCOUNT_CHOOSER (dialog->account_chooser);
-    account = gossip_account_chooser_get_account (account_chooser);
-        
-    if (!account) {
+    /* Fire off request */
+    provider = new_chatroom_dialog_get_provider (dialog);
+    if (!provider) {
         return;
     }
 
-    provider = gossip_session_get_chatroom_provider (session, account);
+    dialog->browsing = TRUE;
 
     gossip_chatroom_provider_browse_rooms (provider,
                                            server,
+                                           refresh,
                                            (GossipChatroomBrowseCb) 
                                            new_chatroom_dialog_browse_cb,
                                            dialog);
@@ -895,6 +1101,9 @@ new_chatroom_dialog_browse_stop (GossipNewChatroomDialog *dialog)
 
     GossipChatroomProvider *provider;
 
+    /* Pages still coming in are dropped, they stay cached for next time */
+    dialog->browsing = FALSE;
+
     /* Set UI */
     gossip_toggle_button_set_state_quietly (dialog->togglebutton_refresh, 
                                             G_CALLBACK (new_chatroom_dialog_togglebutton_refresh_toggled_cb),
@@ -1019,10 +1228,22 @@ static void
 new_chatroom_dialog_destroy_cb (GtkWidget               *widget,
                                 GossipNewChatroomDialog *dialog)
 {
+    if (dialog->info_idle_id) {
+        g_source_remove (dialog->info_idle_id);
+    }
+
+    g_signal_handlers_disconnect_by_func (gtk_tree_view_get_vadjustment (GTK_TREE_VIEW (dialog->treeview)),
+                                          new_chatroom_dialog_model_scrolled_cb,
+                                          dialog);
+
+    new_chatroom_dialog_model_clear (dialog);
+    g_hash_table_destroy (dialog->rows);
+
     g_object_unref (dialog->model);
     g_object_unref (dialog->filter_model);
     g_object_unref (dialog->sort_model);
-        
+
+    g_free (dialog->browsed_server);
     g_free (dialog);
 }
 
@@ -0,0 +1,441 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * Copyright (C) 2007 Imendio AB
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * The nicks in a room for tab completion, in a trie over the nicks
+ * normalized and case folded once when they are added. Every node
+ * knows how many nicks are below it and which of them spoke last, so
+ * completing is a walk down the typed prefix with no allocations, at
+ * least for the plain ASCII prefixes people type.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "gossip-nick-trie.h"
+
+/* Prefixes up to this long are folded on the stack */
+#define NICK_TRIE_BUF 128
+
+typedef struct _NickEntry NickEntry;
+typedef struct _NickNode  NickNode;
+
+struct _NickEntry {
+    gchar     *nick;
+    gchar     *key;
+    guint      stamp;        /* When they last spoke, 0 if never */
+    gboolean   chars_match;  /* Folding kept the number of characters */
+    NickEntry *next;         /* Other nicks folding to the same key */
+};
+
+struct _NickNode {
+    guchar     c;
+    NickNode  *parent;
+    NickNode  *child;        /* Children are sorted by c */
+    NickNode  *next;
+    NickEntry *entries;
+    guint      n_entries;    /* In this node and below */
+    NickEntry *best;         /* Last one to speak in this node and below */
+};
+
+struct _GossipNickTrie {
+    NickNode root;
+    guint    clock;
+};
+
+static gchar *     nick_trie_fold      (const gchar *str,
+                                        gchar       *buf,
+                                        gsize       *len);
+static NickNode *  nick_trie_lookup    (NickNode    *root,
+                                        const gchar *key,
+                                        gsize        len);
+static NickEntry * nick_trie_find      (GossipNickTrie *trie,
+                                        const gchar *nick,
+                                        NickNode   **node);
+static void        nick_trie_update    (NickNode    *node);
+static void        nick_trie_node_free (NickNode    *node);
+
+GossipNickTrie *
+gossip_nick_trie_new (void)
+{
+    return g_new0 (GossipNickTrie, 1);
+}
+
+void
+gossip_nick_trie_free (GossipNickTrie *trie)
+{
+    NickNode  *child, *next;
+    NickEntry *entry;
+
+    g_return_if_fail (trie != NULL);
+
+    for (child = trie->root.child; child; child = next) {
+        next = child->next;
+        nick_trie_node_free (child);
+    }
+
+    while ((entry = trie->root.entries)) {
+        trie->root.entries = entry->next;
+        g_free (entry->nick);
+        g_free (entry->key);
+        g_slice_free (NickEntry, entry);
+    }
+
+    g_free (trie);
+}
+
+/* Normalizes and case folds, composed so the key keeps as many
+ * characters as the nick where it can. Plain ASCII is just lowered
+ * into buf.
+ */
+static gchar *
+nick_trie_fold (const gchar *str,
+                gchar       *buf,
+                gsize       *len)
+{
+    const gchar *p;
+    gchar       *tmp, *folded;
+    gsize        i;
+
+    for (p = str, i = 0; *p && i < NICK_TRIE_BUF - 1; p++, i++) {
+        if (*p & 0x80) {
+            break;
+        }
+
+        buf[i] = g_ascii_tolower (*p);
+    }
+
+    if (!*p) {
+        buf[i] = '\0';
+        *len = i;
+        return buf;
+    }
+
+    tmp = g_utf8_normalize (str, -1, G_NORMALIZE_DEFAULT_COMPOSE);
+    if (!tmp) {
+        tmp = g_strdup (str);
+    }
+
+    folded = g_utf8_casefold (tmp, -1);
+    g_free (tmp);
+
+    *len = strlen (folded);
+
+    return folded;
+}
+
+static NickNode *
+nick_trie_lookup (NickNode    *root,
+                  const gchar *key,
+                  gsize        len)
+{
+    NickNode *node;
+    gsize     i;
+
+    node = root;
+
+    for (i = 0; i < len && node; i++) {
+        NickNode *child;
+
+        for (child = node->child; child; child = child->next) {
+            if (child->c >= (guchar) key[i]) {
+                break;
+            }
+        }
+
+        if (child && child->c == (guchar) key[i]) {
+            node = child;
+        } else {
+            node = NULL;
+        }
+    }
+
+    return node;
+}
+
+static NickEntry *
+nick_trie_find (GossipNickTrie  *trie,
+                const gchar     *nick,
+                NickNode       **node)
+{
+    NickEntry *entry = NULL;
+    gchar      buf[NICK_TRIE_BUF];
+    gchar     *key;
+    gsize      len;
+
+    key = nick_trie_fold (nick, buf, &len);
+
+    *node = nick_trie_lookup (&trie->root, key, len);
+    if (*node) {
+        for (entry = (*node)->entries; entry; entry = entry->next) {
+            if (strcmp (entry->nick, nick) == 0) {
+                break;
+            }
+        }
+    }
+
+    if (key != buf) {
+        g_free (key);
+    }
+
+    return entry;
+}
+
+/* Works out who spoke last from the node's own nicks and children */
+static void
+nick_trie_update (NickNode *node)
+{
+    NickEntry *entry;
+    NickNode  *child;
+
+    node->best = NULL;
+
+    for (entry = node->entries; entry; entry = entry->next) {
+        if (!node->best || entry->stamp > node->best->stamp) {
+            node->best = entry;
+        }
+    }
+
+    for (child = node->child; child; child = child->next) {
+        if (child->best &&
+            (!node->best || child->best->stamp > node->best->stamp)) {
+            node->best = child->best;
+        }
+    }
+}
+
+static void
+nick_trie_node_free (NickNode *node)
+{
+    NickNode  *child, *next;
+    NickEntry *entry;
+
+    for (child = node->child; child; child = next) {
+        next = child->next;
+        nick_trie_node_free (child);
+    }
+
+    while ((entry = node->entries)) {
+        node->entries = entry->next;
+        g_free (entry->nick);
+        g_free (entry->key);
+        g_slice_free (NickEntry, entry);
+    }
+
+    g_slice_free (NickNode, node);
+}
+
+void
+gossip_nick_trie_add (GossipNickTrie *trie,
+                      const gchar    *nick)
+{
+    NickEntry  *entry;
+    NickNode   *node;
+    NickEntry **last;
+    gchar       buf[NICK_TRIE_BUF];
+    gchar      *key;
+    gsize       len, i;
+
+    g_return_if_fail (trie != NULL);
+    g_return_if_fail (nick != NULL);
+
+    key = nick_trie_fold (nick, buf, &len);
+
+    entry = g_slice_new0 (NickEntry);
+    entry->nick = g_strdup (nick);
+    entry->key = g_strndup (key, len);
+    entry->chars_match = g_utf8_strlen (entry->key, -1) == g_utf8_strlen (nick, -1);
+
+    if (key != buf) {
+        g_free (key);
+    }
+
+    node = &trie->root;
+    node->n_entries++;
+    if (!node->best) {
+        node->best = entry;
+    }
+
+    for (i = 0; i < len; i++) {
+        NickNode **link;
+        guchar     c;
+
+        c = entry->key[i];
+
+        for (link = &node->child; *link; link = &(*link)->next) {
+            if ((*link)->c >= c) {
+                break;
+            }
+        }
+
+        if (!*link || (*link)->c != c) {
+            NickNode *child;
+
+            child = g_slice_new0 (NickNode);
+            child->c = c;
+            child->parent = node;
+            child->next = *link;
+            *link = child;
+        }
+
+        node = *link;
+        node->n_entries++;
+        if (!node->best) {
+            node->best = entry;
+        }
+    }
+
+    /* Keep the order they joined in for nicks that fold the same */
+    for (last = &node->entries; *last; last = &(*last)->next);
+    *last = entry;
+}
+
+void
+gossip_nick_trie_remove (GossipNickTrie *trie,
+                         const gchar    *nick)
+{
+    NickEntry  *entry;
+    NickEntry **link;
+    NickNode   *node;
+
+    g_return_if_fail (trie != NULL);
+    g_return_if_fail (nick != NULL);
+
+    entry = nick_trie_find (trie, nick, &node);
+    if (!entry) {
+        return;
+    }
+
+    for (link = &node->entries; *link != entry; link = &(*link)->next);
+    *link = entry->next;
+
+    g_free (entry->nick);
+    g_free (entry->key);
+    g_slice_free (NickEntry, entry);
+
+    /* Drop nodes nothing is below any more and fix up the rest */
+    while (node) {
+        NickNode *parent;
+
+        parent = node->parent;
+        node->n_entries--;
+
+        if (node->n_entries == 0 && parent) {
+            NickNode **child;
+
+            for (child = &parent->child; *child != node; child = &(*child)->next);
+            *child = node->next;
+
+            g_slice_free (NickNode, node);
+        } else {
+            nick_trie_update (node);
+        }
+
+        node = parent;
+    }
+}
+
+void
+gossip_nick_trie_touch (GossipNickTrie *trie,
+                        const gchar    *nick)
+{
+    NickEntry *entry;
+    NickNode  *node;
+
+    g_return_if_fail (trie != NULL);
+    g_return_if_fail (nick != NULL);
+
+    entry = nick_trie_find (trie, nick, &node);
+    if (!entry) {
+        return;
+    }
+
+    entry->stamp = ++trie->clock;
+
+    /* Nobody spoke after this, so it is the best all the way up */
+    for (; node; node = node->parent) {
+        node->best = entry;
+    }
+}
+
+/* Returns how many nicks start with prefix. nick is set to the one of
+ * them who spoke last, or any of them if none did, and common_len to
+ * how many bytes at the start of it all of them share, or -1 if that
+ * can't be told because folding changed its length.
+ */
+guint
+gossip_nick_trie_complete (GossipNickTrie  *trie,
+                           const gchar     *prefix,
+                           const gchar    **nick,
+                           gint            *common_len,
+                           gboolean        *spoke)
+{
+    NickNode  *node;
+    NickEntry *best;
+    gchar      buf[NICK_TRIE_BUF];
+    gchar     *key;
+    gsize      len;
+    guint      n;
+
+    g_return_val_if_fail (trie != NULL, 0);
+    g_return_val_if_fail (prefix != NULL, 0);
+
+    key = nick_trie_fold (prefix, buf, &len);
+    node = nick_trie_lookup (&trie->root, key, len);
+
+    if (key != buf) {
+        g_free (key);
+    }
+
+    if (!node || !node->best) {
+        return 0;
+    }
+
+    n = node->n_entries;
+    best = node->best;
+
+    if (nick) {
+        *nick = best->nick;
+    }
+
+    if (spoke) {
+        *spoke = best->stamp > 0;
+    }
+
+    if (common_len) {
+        /* Follow the prefix down as long as it doesn't branch */
+        while (!node->entries && node->child && !node->child->next) {
+            node = node->child;
+            len++;
+        }
+
+        if (best->chars_match) {
+            glong chars;
+
+            chars = g_utf8_strlen (best->key, len);
+            *common_len = g_utf8_offset_to_pointer (best->nick, chars) - best->nick;
+        } else {
+            *common_len = -1;
+        }
+    }
+
+    return n;
+}
@@ -0,0 +1,46 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * Copyright (C) 2007 Imendio AB
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GOSSIP_NICK_TRIE_H__
+#define __GOSSIP_NICK_TRIE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GossipNickTrie GossipNickTrie;
+
+GossipNickTrie *gossip_nick_trie_new      (void);
+void            gossip_nick_trie_free     (GossipNickTrie  *trie);
+void            gossip_nick_trie_add      (GossipNickTrie  *trie,
+                                           const gchar     *nick);
+void            gossip_nick_trie_remove   (GossipNickTrie  *trie,
+                                           const gchar     *nick);
+void            gossip_nick_trie_touch    (GossipNickTrie  *trie,
+                                           const gchar     *nick);
+guint           gossip_nick_trie_complete (GossipNickTrie  *trie,
+                                           const gchar     *prefix,
+                                           const gchar    **nick,
+                                           gint            *common_len,
+                                           gboolean        *spoke);
+
+G_END_DECLS
+
+#endif /* __GOSSIP_NICK_TRIE_H__ */
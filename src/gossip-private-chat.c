@@ -970,10 +970,6 @@ gossip_private_chat_new (GossipContact *own_contact,
     GossipPrivateChat     *chat;
     GossipLogManager      *log_manager;
     GossipChatView        *view;
-    GossipContact         *sender;
-    GossipMessage         *message;
-    GList                 *messages, *l;
-    gint                   num_messages, i;
 
     g_return_val_if_fail (GOSSIP_IS_CONTACT (own_contact), NULL);
     g_return_val_if_fail (GOSSIP_IS_CONTACT (contact), NULL);
@@ -1022,34 +1018,15 @@ gossip_private_chat_new (GossipContact *own_contact,
     /* Turn off scrolling temporarily */
     gossip_chat_view_allow_scroll (view, FALSE);
 
-    /* Add messages from last conversation */
+    /* Add messages from last conversation, older ones are read from
+     * the log as the user scrolls up.
+     */
     log_manager = gossip_session_get_log_manager (gossip_app_get_session ());
-    messages = gossip_log_get_last_for_contact (log_manager, priv->contact);
-    num_messages  = g_list_length (messages);
-
-    for (l = messages, i = 0; l; l = l->next, i++) {
-        message = l->data;
-
-        if (num_messages - i > 10) {
-            continue;
-        }
-
-        sender = gossip_message_get_sender (message);
-        if (gossip_contact_equal (priv->own_contact, sender)) {
-            gossip_chat_view_append_message_from_self (view,
-                                                       message,
-                                                       priv->own_contact,
-                                                       priv->own_avatar);
-        } else {
-            gossip_chat_view_append_message_from_other (view,
-                                                        message,
-                                                        sender,
-                                                        priv->other_avatar);
-        }
-    }
-
-    g_list_foreach (messages, (GFunc) g_object_unref, NULL);
-    g_list_free (messages);
+    gossip_chat_view_set_history (view,
+                                  gossip_log_reader_new_for_contact (log_manager,
+                                                                     priv->contact),
+                                  priv->own_contact);
+    gossip_chat_view_load_history (view, 10);
 
     /* Turn back on scrolling */
     gossip_chat_view_allow_scroll (view, TRUE);
@@ -0,0 +1,440 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * Copyright (C) 2007 Imendio AB
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * A copy of a text buffer's text, case folded and decomposed like
+ * gossip_text_iter_forward_search() does it, so that finding every
+ * match of a string is one substring scan. It only handles text being
+ * added at the end and removed from the start, which is all a chat
+ * view does; anything else means building a new one.
+ *
+ * Every place the last string was found is kept, overlapping or not,
+ * so typing one more letter only has to look at those again, and text
+ * added since only has to be scanned once. The matches handed out are
+ * picked from those from the start, without overlapping, like
+ * searching forward through the buffer would find them.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "gossip-search-index.h"
+
+struct _GossipSearchIndex {
+    /* The folded text, the first text_base bytes have been trimmed
+     * off so all positions below count from when it was created.
+     */
+    GString *text;
+    guint    text_base;
+
+    /* Where in text each character of the buffer starts */
+    GArray  *char_starts;
+
+    /* The last string looked for, everywhere it is in the text, the
+     * matches picked from those and how much of the text has been
+     * scanned for it.
+     */
+    gchar   *query;
+    guint    query_len;
+    GArray  *found;
+    GArray  *matches;
+    guint    scanned;
+};
+
+static void  search_index_fold_append (GString           *str,
+                                       const gchar       *text,
+                                       gint               len,
+                                       GArray            *char_starts,
+                                       guint              base);
+static gint  search_index_char_at     (GossipSearchIndex *index,
+                                       guint              pos);
+static void  search_index_scan        (GossipSearchIndex *index);
+static void  search_index_narrow      (GossipSearchIndex *index,
+                                       const gchar       *query,
+                                       guint              query_len);
+static void  search_index_select      (GossipSearchIndex *index);
+
+GossipSearchIndex *
+gossip_search_index_new (void)
+{
+    GossipSearchIndex *index;
+
+    index = g_new0 (GossipSearchIndex, 1);
+
+    index->text = g_string_new (NULL);
+    index->char_starts = g_array_new (FALSE, FALSE, sizeof (guint));
+    index->found = g_array_new (FALSE, FALSE, sizeof (guint));
+    index->matches = g_array_new (FALSE, FALSE, sizeof (guint));
+
+    return index;
+}
+
+void
+gossip_search_index_free (GossipSearchIndex *index)
+{
+    g_return_if_fail (index != NULL);
+
+    g_string_free (index->text, TRUE);
+    g_array_free (index->char_starts, TRUE);
+    g_array_free (index->found, TRUE);
+    g_array_free (index->matches, TRUE);
+    g_free (index->query);
+
+    g_free (index);
+}
+
+static void
+search_index_fold_append (GString     *str,
+                          const gchar *text,
+                          gint         len,
+                          GArray      *char_starts,
+                          guint        base)
+{
+    const gchar *p, *end;
+
+    if (len < 0) {
+        len = strlen (text);
+    }
+
+    end = text + len;
+
+    for (p = text; p < end; p = g_utf8_next_char (p)) {
+        if (char_starts) {
+            guint start;
+
+            start = base + str->len;
+            g_array_append_val (char_starts, start);
+        }
+
+        /* Most of what people type folds to itself */
+        if ((guchar) *p < 0x80) {
+            g_string_append_c (str, g_ascii_tolower (*p));
+        } else {
+            gchar *casefold;
+            gchar *normal;
+
+            casefold = g_utf8_casefold (p, g_utf8_next_char (p) - p);
+            normal = g_utf8_normalize (casefold, -1, G_NORMALIZE_NFD);
+
+            g_string_append (str, normal ? normal : casefold);
+
+            g_free (casefold);
+            g_free (normal);
+        }
+    }
+}
+
+void
+gossip_search_index_append (GossipSearchIndex *index,
+                            const gchar       *text,
+                            gint               len)
+{
+    g_return_if_fail (index != NULL);
+    g_return_if_fail (text != NULL);
+
+    search_index_fold_append (index->text, text, len,
+                              index->char_starts, index->text_base);
+}
+
+void
+gossip_search_index_trim (GossipSearchIndex *index,
+                          gint               n_chars)
+{
+    guint new_base;
+    guint i;
+
+    g_return_if_fail (index != NULL);
+
+    n_chars = MIN (n_chars, index->char_starts->len);
+    if (n_chars <= 0) {
+        return;
+    }
+
+    if (n_chars < (gint) index->char_starts->len) {
+        new_base = g_array_index (index->char_starts, guint, n_chars);
+    } else {
+        new_base = index->text_base + index->text->len;
+    }
+
+    g_string_erase (index->text, 0, new_base - index->text_base);
+    g_array_remove_range (index->char_starts, 0, n_chars);
+    index->text_base = new_base;
+
+    /* Places found are in order, drop the ones that were cut */
+    for (i = 0; i < index->found->len; i++) {
+        if (g_array_index (index->found, guint, i) >= new_base) {
+            break;
+        }
+    }
+
+    if (i > 0) {
+        g_array_remove_range (index->found, 0, i);
+    }
+
+    index->scanned = MAX (index->scanned, new_base);
+
+    /* What overlapped one that was cut may be a match now */
+    search_index_select (index);
+}
+
+static gint
+search_index_char_at (GossipSearchIndex *index,
+                      guint              pos)
+{
+    gint low, high;
+
+    /* The last character starting at or before pos */
+    low = 0;
+    high = index->char_starts->len - 1;
+
+    while (low < high) {
+        gint mid;
+
+        mid = (low + high + 1) / 2;
+
+        if (g_array_index (index->char_starts, guint, mid) <= pos) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return low;
+}
+
+static void
+search_index_scan (GossipSearchIndex *index)
+{
+    const gchar *p;
+    guint        from;
+
+    /* Text added since last time, plus enough before it to catch a
+     * match running into it.
+     */
+    from = index->text_base;
+    if (index->scanned > from + index->query_len - 1) {
+        from = index->scanned - (index->query_len - 1);
+    }
+
+    if (index->found->len > 0) {
+        guint last;
+
+        last = g_array_index (index->found, guint, index->found->len - 1);
+        from = MAX (from, last + 1);
+    }
+
+    if (from < index->text_base + index->text->len) {
+        p = index->text->str + (from - index->text_base);
+
+        /* The query starts a character, so it can't be found in the
+         * middle of one by moving on a byte at a time.
+         */
+        while ((p = strstr (p, index->query)) != NULL) {
+            guint pos;
+
+            pos = index->text_base + (p - index->text->str);
+            g_array_append_val (index->found, pos);
+
+            p++;
+        }
+    }
+
+    index->scanned = index->text_base + index->text->len;
+}
+
+static void
+search_index_narrow (GossipSearchIndex *index,
+                     const gchar       *query,
+                     guint              query_len)
+{
+    guint i, n;
+
+    /* Anywhere the longer string is, the shorter one was found too,
+     * so we only need to check those places again.
+     */
+    for (i = 0, n = 0; i < index->found->len; i++) {
+        guint pos;
+        guint rel;
+
+        pos = g_array_index (index->found, guint, i);
+        rel = pos - index->text_base;
+
+        if (rel + query_len > index->text->len ||
+            memcmp (index->text->str + rel, query, query_len) != 0) {
+            continue;
+        }
+
+        g_array_index (index->found, guint, n++) = pos;
+    }
+
+    g_array_set_size (index->found, n);
+}
+
+static void
+search_index_select (GossipSearchIndex *index)
+{
+    guint i;
+    guint next = 0;
+
+    g_array_set_size (index->matches, 0);
+
+    for (i = 0; i < index->found->len; i++) {
+        guint pos;
+
+        pos = g_array_index (index->found, guint, i);
+        if (pos < next) {
+            continue;
+        }
+
+        g_array_append_val (index->matches, pos);
+        next = pos + index->query_len;
+    }
+}
+
+/* Looks for str in the text and returns how many times it is there,
+ * the matches are then got with gossip_search_index_get_match().
+ */
+guint
+gossip_search_index_find (GossipSearchIndex *index,
+                          const gchar       *str)
+{
+    GString *folded;
+
+    g_return_val_if_fail (index != NULL, 0);
+
+    if (!str || !str[0]) {
+        g_free (index->query);
+        index->query = NULL;
+        index->query_len = 0;
+        g_array_set_size (index->found, 0);
+        g_array_set_size (index->matches, 0);
+
+        return 0;
+    }
+
+    folded = g_string_new (NULL);
+    search_index_fold_append (folded, str, -1, NULL, 0);
+
+    if (index->query && strcmp (folded->str, index->query) == 0) {
+        g_string_free (folded, TRUE);
+    } else {
+        if (index->query && g_str_has_prefix (folded->str, index->query)) {
+            /* Bring what was found up to date before narrowing */
+            search_index_scan (index);
+            search_index_narrow (index, folded->str, folded->len);
+        } else {
+            g_array_set_size (index->found, 0);
+            index->scanned = index->text_base;
+        }
+
+        g_free (index->query);
+        index->query_len = folded->len;
+        index->query = g_string_free (folded, FALSE);
+    }
+
+    search_index_scan (index);
+    search_index_select (index);
+
+    return index->matches->len;
+}
+
+/* Gives the nth match of the last find as character offsets. */
+void
+gossip_search_index_get_match (GossipSearchIndex *index,
+                               guint              n,
+                               gint              *start,
+                               gint              *end)
+{
+    guint pos;
+
+    g_return_if_fail (index != NULL);
+    g_return_if_fail (n < index->matches->len);
+
+    pos = g_array_index (index->matches, guint, n);
+
+    if (start) {
+        *start = search_index_char_at (index, pos);
+    }
+
+    if (end) {
+        *end = search_index_char_at (index, pos + index->query_len - 1) + 1;
+    }
+}
+
+/* The first match of the last find starting at or after offset, -1 if
+ * there is none.
+ */
+gint
+gossip_search_index_find_forward (GossipSearchIndex *index,
+                                  gint               offset)
+{
+    gint low, high;
+
+    g_return_val_if_fail (index != NULL, -1);
+
+    low = 0;
+    high = index->matches->len;
+
+    while (low < high) {
+        gint mid, start;
+
+        mid = (low + high) / 2;
+        gossip_search_index_get_match (index, mid, &start, NULL);
+
+        if (start < offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low < (gint) index->matches->len ? low : -1;
+}
+
+/* The last match of the last find ending at or before offset, -1 if
+ * there is none.
+ */
+gint
+gossip_search_index_find_backward (GossipSearchIndex *index,
+                                   gint               offset)
+{
+    gint low, high;
+
+    g_return_val_if_fail (index != NULL, -1);
+
+    low = 0;
+    high = index->matches->len;
+
+    while (low < high) {
+        gint mid, end;
+
+        mid = (low + high) / 2;
+        gossip_search_index_get_match (index, mid, NULL, &end);
+
+        if (end <= offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low - 1;
+}
@@ -0,0 +1,50 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * Copyright (C) 2007 Imendio AB
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GOSSIP_SEARCH_INDEX_H__
+#define __GOSSIP_SEARCH_INDEX_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GossipSearchIndex GossipSearchIndex;
+
+GossipSearchIndex *gossip_search_index_new           (void);
+void               gossip_search_index_free          (GossipSearchIndex *index);
+void               gossip_search_index_append        (GossipSearchIndex *index,
+                                                      const gchar       *text,
+                                                      gint               len);
+void               gossip_search_index_trim          (GossipSearchIndex *index,
+                                                      gint               n_chars);
+guint              gossip_search_index_find          (GossipSearchIndex *index,
+                                                      const gchar       *str);
+void               gossip_search_index_get_match     (GossipSearchIndex *index,
+                                                      guint              n,
+                                                      gint              *start,
+                                                      gint              *end);
+gint               gossip_search_index_find_forward  (GossipSearchIndex *index,
+                                                      gint               offset);
+gint               gossip_search_index_find_backward (GossipSearchIndex *index,
+                                                      gint               offset);
+
+G_END_DECLS
+
+#endif /* __GOSSIP_SEARCH_INDEX_H__ */
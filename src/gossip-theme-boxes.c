@@ -379,14 +379,12 @@ static void
 theme_boxes_define_theme_tags (GossipTheme *theme, GossipChatView *view)
 {
     GossipThemeBoxesPriv *priv;
-    GtkTextBuffer   *buffer;
     GtkTextTagTable *table;
     GtkTextTag      *tag;
 
     priv = GET_PRIV (theme);
 
-    buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
-    table = gtk_text_buffer_get_tag_table (buffer);
+    table = gossip_theme_get_tag_table ();
 
     tag = gossip_theme_utils_init_tag_by_name (table, "fancy-spacing");
     g_object_set (tag,
@@ -501,7 +499,7 @@ theme_boxes_define_theme_tags (GossipTheme *theme, GossipChatView *view)
     }
     gossip_theme_utils_add_tag (table, tag);
 
-    tag = gossip_theme_utils_init_tag_by_name (table, "invite");
+    tag = gossip_theme_utils_init_tag_by_name (table, "fancy-invite");
     if (priv->invite_foreground) {
         g_object_set (tag,
                       "foreground", priv->invite_foreground,
@@ -554,9 +552,13 @@ theme_boxes_setup_with_view (GossipTheme *theme, GossipChatView *view)
 
     priv = GET_PRIV (theme);
 
-    theme_boxes_fixup_tag_table (theme, view);
-
-    theme_boxes_define_theme_tags (theme, view);
+    /* The tags live in the shared table, only the first view set up
+     * with this theme has to (re)define them.
+     */
+    if (gossip_theme_claim_tags (theme, "fancy")) {
+        theme_boxes_fixup_tag_table (theme, view);
+        theme_boxes_define_theme_tags (theme, view);
+    }
         
     gossip_chat_view_set_margin (view, MARGIN);
 
@@ -662,7 +664,7 @@ theme_boxes_maybe_append_header (GossipTheme        *theme,
 
     gossip_theme_append_spacing (theme, context, view);
 
-    gtk_text_buffer_get_end_iter (buffer, &iter);
+    gossip_chat_view_get_end_iter (view, &iter);
     gtk_text_buffer_insert_with_tags_by_name (buffer,
                                               &iter,
                                               "\n",
@@ -670,7 +672,7 @@ theme_boxes_maybe_append_header (GossipTheme        *theme,
                                               "fancy-header-line",
                                               NULL);
 
-    gtk_text_buffer_get_end_iter (buffer, &iter);
+    gossip_chat_view_get_end_iter (view, &iter);
     anchor = gtk_text_buffer_create_child_anchor (buffer, &iter);
 
     box = gtk_hbox_new (FALSE, 0);
@@ -736,7 +738,7 @@ theme_boxes_maybe_append_header (GossipTheme        *theme,
 
     gtk_widget_show_all (box);
 
-    gtk_text_buffer_get_end_iter (buffer, &iter);
+    gossip_chat_view_get_end_iter (view, &iter);
     start = iter;
     gtk_text_iter_backward_char (&start);
     gtk_text_buffer_apply_tag_by_name (buffer,
@@ -750,7 +752,7 @@ theme_boxes_maybe_append_header (GossipTheme        *theme,
                                               "fancy-header",
                                               NULL);
 
-    gtk_text_buffer_get_end_iter (buffer, &iter);
+    gossip_chat_view_get_end_iter (view, &iter);
     gtk_text_buffer_insert_with_tags_by_name (buffer,
                                               &iter,
                                               "\n",
@@ -836,7 +838,7 @@ theme_boxes_append_event (GossipTheme        *theme,
 
     gossip_theme_append_time_maybe (theme, context, view, NULL);
 
-    gtk_text_buffer_get_end_iter (buffer, &iter);
+    gossip_chat_view_get_end_iter (view, &iter);
 
     msg = g_strdup_printf (" - %s\n", str);
 
@@ -905,7 +907,7 @@ theme_boxes_append_timestamp (GossipTheme        *theme,
     if (show_time || show_date) {
         g_string_append (str, " -\n");
 
-        gtk_text_buffer_get_end_iter (buffer, &iter);
+        gossip_chat_view_get_end_iter (view, &iter);
         gtk_text_buffer_insert_with_tags_by_name (buffer,
                                                   &iter,
                                                   str->str, -1,
@@ -933,7 +935,7 @@ theme_boxes_append_spacing (GossipTheme        *theme,
 
     buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
 
-    gtk_text_buffer_get_end_iter (buffer, &iter);
+    gossip_chat_view_get_end_iter (view, &iter);
     gtk_text_buffer_insert_with_tags_by_name (buffer,
                                               &iter,
                                               "\n",
@@ -1012,6 +1014,9 @@ theme_boxes_theme_changed_cb (GtkWidget *widget,
 {
     theme_boxes_setup_themed (GOSSIP_THEME (user_data));
 
+    /* Have the next view set up redefine the tags with the new colors */
+    gossip_theme_invalidate_tags ("fancy");
+
     g_signal_emit_by_name (G_OBJECT (user_data), "updated");
 }
 
@@ -201,14 +201,12 @@ static void
 theme_irc_apply_theme_classic (GossipTheme *theme, GossipChatView *view)
 {
     GossipThemeIrcPriv *priv;
-    GtkTextBuffer      *buffer;
     GtkTextTagTable    *table;
     GtkTextTag         *tag;
 
     priv = GET_PRIV (theme);
 
-    buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
-    table = gtk_text_buffer_get_tag_table (buffer);
+    table = gossip_theme_get_tag_table ();
 
     tag = gossip_theme_utils_init_tag_by_name (table, "irc-spacing");
     g_object_set (tag,
@@ -277,7 +275,7 @@ theme_irc_apply_theme_classic (GossipTheme *theme, GossipChatView *view)
                   NULL);
     gossip_theme_utils_add_tag (table, tag);
 
-    tag = gossip_theme_utils_init_tag_by_name (table, "invite");
+    tag = gossip_theme_utils_init_tag_by_name (table, "irc-invite");
     g_object_set (tag,
                   "foreground", "sienna",
                   NULL);
@@ -295,8 +293,11 @@ theme_irc_apply_theme_classic (GossipTheme *theme, GossipChatView *view)
 static GossipThemeContext *
 theme_irc_setup_with_view (GossipTheme *theme, GossipChatView *view)
 {
-    theme_irc_fixup_tag_table (theme, view);
-    theme_irc_apply_theme_classic (theme, view);
+    if (gossip_theme_claim_tags (theme, "irc")) {
+        theme_irc_fixup_tag_table (theme, view);
+        theme_irc_apply_theme_classic (theme, view);
+    }
+
     gossip_chat_view_set_margin (view, 3);
 
     return NULL;
@@ -348,7 +349,7 @@ theme_irc_append_message (GossipTheme        *theme,
         body_tag = "irc-body-other";
     }
                 
-    gtk_text_buffer_get_end_iter (buffer, &iter);
+    gossip_chat_view_get_end_iter (view, &iter);
 
     /* The nickname. */
     tmp = g_strdup_printf ("%s: ", name);
@@ -412,7 +413,7 @@ theme_irc_append_event (GossipTheme        *theme,
         
     gossip_theme_append_time_maybe (theme, context, view, NULL);
 
-    gtk_text_buffer_get_end_iter (buffer, &iter);
+    gossip_chat_view_get_end_iter (view, &iter);
 
     msg = g_strdup_printf (" - %s\n", str);
     gtk_text_buffer_insert_with_tags_by_name (buffer, &iter,
@@ -474,7 +475,7 @@ theme_irc_append_timestamp (GossipTheme        *theme,
     if (show_time || show_date) {
         g_string_append (str, " -\n");
 
-        gtk_text_buffer_get_end_iter (buffer, &iter);
+        gossip_chat_view_get_end_iter (view, &iter);
         gtk_text_buffer_insert_with_tags_by_name (buffer,
                                                   &iter,
                                                   str->str, -1,
@@ -500,7 +501,7 @@ theme_irc_append_spacing (GossipTheme        *theme,
 
     buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
 
-    gtk_text_buffer_get_end_iter (buffer, &iter);
+    gossip_chat_view_get_end_iter (view, &iter);
     gtk_text_buffer_insert_with_tags_by_name (buffer,
                                               &iter,
                                               "\n",
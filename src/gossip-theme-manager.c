@@ -35,6 +35,8 @@
 #include "gossip-theme-irc.h"
 #include "gossip-theme-manager.h"
 
+#define DEBUG_DOMAIN "ThemeManager"
+
 #define GET_PRIV(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GOSSIP_TYPE_THEME_MANAGER, GossipThemeManagerPriv))
 
 typedef struct {
@@ -57,6 +59,7 @@ static void        theme_manager_finalize                 (GObject            *o
 static void        theme_manager_notify_name_cb           (GossipConf         *conf,
                                                            const gchar        *key,
                                                            gpointer            user_data);
+static void        theme_manager_emit_changed             (GossipThemeManager *manager);
 static void        theme_manager_notify_room_cb           (GossipConf         *conf,
                                                            const gchar        *key,
                                                            gpointer            user_data);
@@ -188,7 +191,22 @@ theme_manager_notify_name_cb (GossipConf  *conf,
         priv->name = name;
     }
 
+    theme_manager_emit_changed (manager);
+}
+
+static void
+theme_manager_emit_changed (GossipThemeManager *manager)
+{
+    GTimer *timer;
+
+    /* Every open chat view switches theme from this signal */
+    timer = g_timer_new ();
+
     g_signal_emit (manager, signals[THEME_CHANGED], 0, NULL);
+
+    gossip_debug (DEBUG_DOMAIN, "Switched theme in %.2f ms",
+                  g_timer_elapsed (timer, NULL) * 1000);
+    g_timer_destroy (timer);
 }
 
 static void
@@ -196,7 +214,7 @@ theme_manager_notify_room_cb (GossipConf  *conf,
                               const gchar *key,
                               gpointer     user_data)
 {
-    g_signal_emit (user_data, signals[THEME_CHANGED], 0, NULL);
+    theme_manager_emit_changed (user_data);
 }
 
 static void
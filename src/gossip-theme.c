@@ -39,21 +39,53 @@
 
 #define GET_PRIV(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GOSSIP_TYPE_THEME, GossipThemePriv))
 
+/* Smiley patterns are plain ASCII, anything else takes us back to the
+ * root of the automaton.
+ */
+#define SMILEY_ALPHABET 128
+
 typedef struct _GossipThemePriv GossipThemePriv;
 
 struct _GossipThemePriv {
-    gboolean show_avatars;
+    gboolean  show_avatars;
+    gchar    *tag_family;
 };
 
-static void theme_finalize     (GObject      *object);
-static void theme_get_property (GObject      *object,
-                                guint         param_id,
-                                GValue       *value,
-                                GParamSpec   *pspec);
-static void theme_set_property (GObject      *object,
-                                guint         param_id,
-                                const GValue *value,
-                                GParamSpec   *pspec);
+/* A node in the smiley automaton, next[] already has the failure
+ * transitions folded in so matching never has to backtrack.
+ */
+typedef struct {
+    guint16 next[SMILEY_ALPHABET];
+    guint16 output;   /* Node of the longest pattern that is a proper suffix */
+    gint16  pattern;  /* Index in smileys[] ending here, or -1 */
+    guint8  depth;
+} SmileyNode;
+
+static void        theme_finalize                   (GObject       *object);
+static void        theme_get_property               (GObject       *object,
+                                                     guint          param_id,
+                                                     GValue        *value,
+                                                     GParamSpec    *pspec);
+static void        theme_set_property               (GObject       *object,
+                                                     guint          param_id,
+                                                     const GValue  *value,
+                                                     GParamSpec    *pspec);
+static SmileyNode *theme_smiley_automaton_get       (void);
+static gint        theme_smiley_match               (SmileyNode    *nodes,
+                                                     guint16        state,
+                                                     gsize          word_len);
+static void        theme_notify_show_smileys_cb     (GossipConf    *conf,
+                                                     const gchar   *key,
+                                                     gpointer       user_data);
+static gboolean    theme_get_show_smileys           (void);
+static void        theme_insert_smiley              (GtkTextBuffer *buf,
+                                                     GtkTextIter   *iter,
+                                                     const gchar   *str,
+                                                     const gchar   *word,
+                                                     gint           match);
+static void        theme_insert_text_with_emoticons (GtkTextBuffer *buf,
+                                                     GtkTextIter   *iter,
+                                                     const gchar   *str);
 
 G_DEFINE_TYPE (GossipTheme, gossip_theme, G_TYPE_OBJECT);
 
@@ -116,6 +148,12 @@ gossip_theme_init (GossipTheme *presence)
 static void
 theme_finalize (GObject *object)
 {
+    GossipThemePriv *priv;
+
+    priv = GET_PRIV (object);
+
+    g_free (priv->tag_family);
+
     (G_OBJECT_CLASS (gossip_theme_parent_class)->finalize) (object);
 }
 
@@ -204,6 +242,84 @@ gossip_theme_new (void)
     return g_object_new (GOSSIP_TYPE_THEME, NULL);
 }
 
+/* All chat views share this tag table so that the tags are only
+ * created once and changing a theme only has to touch them once,
+ * however many chats are open.
+ */
+GtkTextTagTable *
+gossip_theme_get_tag_table (void)
+{
+    static GtkTextTagTable *table = NULL;
+
+    if (!table) {
+        table = gtk_text_tag_table_new ();
+    }
+
+    return table;
+}
+
+/* Themes keep their tags under a name prefix (the "family"), returns
+ * TRUE if the tags of that family in the shared table were last set up
+ * by another theme (or not at all) and need to be defined again.
+ */
+gboolean
+gossip_theme_claim_tags (GossipTheme *theme,
+                         const gchar *family)
+{
+    GossipThemePriv *priv;
+    GtkTextTagTable *table;
+
+    g_return_val_if_fail (GOSSIP_IS_THEME (theme), FALSE);
+    g_return_val_if_fail (family != NULL, FALSE);
+
+    priv = GET_PRIV (theme);
+
+    if (!priv->tag_family) {
+        priv->tag_family = g_strdup (family);
+    }
+
+    table = gossip_theme_get_tag_table ();
+
+    if (g_object_get_data (G_OBJECT (table), family) == theme) {
+        return FALSE;
+    }
+
+    g_object_set_data (G_OBJECT (table), family, theme);
+
+    gossip_debug (DEBUG_DOMAIN, "Defining %s tags in the shared tag table", family);
+
+    return TRUE;
+}
+
+/* The name of a tag the theme's family defines for others to use, like
+ * "invite", or just the name if the theme hasn't claimed any tags.
+ */
+gchar *
+gossip_theme_get_tag_name (GossipTheme *theme,
+                           const gchar *name)
+{
+    GossipThemePriv *priv;
+
+    g_return_val_if_fail (GOSSIP_IS_THEME (theme), NULL);
+    g_return_val_if_fail (name != NULL, NULL);
+
+    priv = GET_PRIV (theme);
+
+    if (!priv->tag_family) {
+        return g_strdup (name);
+    }
+
+    return g_strconcat (priv->tag_family, "-", name, NULL);
+}
+
+void
+gossip_theme_invalidate_tags (const gchar *family)
+{
+    g_return_if_fail (family != NULL);
+
+    g_object_set_data (G_OBJECT (gossip_theme_get_tag_table ()), family, NULL);
+}
+
 GossipThemeContext *
 gossip_theme_setup_with_view (GossipTheme    *theme,
                               GossipChatView *view)
@@ -289,113 +405,244 @@ gossip_theme_append_action (GossipTheme        *theme,
                                                   message, from_self);
 }
 
+static SmileyNode *
+theme_smiley_automaton_get (void)
+{
+    static GArray *nodes = NULL;
+    SmileyNode     node;
+    guint16       *fail;
+    guint16       *queue;
+    guint          head, tail;
+    guint          i, c;
+
+    /* The smiley table is fixed at compile time so the automaton is
+     * only ever built once.
+     */
+    if (nodes) {
+        return (SmileyNode *) nodes->data;
+    }
+
+    nodes = g_array_new (FALSE, TRUE, sizeof (SmileyNode));
+
+    memset (&node, 0, sizeof (node));
+    node.pattern = -1;
+    g_array_append_val (nodes, node);
+
+    /* Build the trie, 0 means "no child" for now since nothing can
+     * point back at the root yet.
+     */
+    for (i = 0; i < G_N_ELEMENTS (smileys); i++) {
+        const gchar *p;
+        guint16      state = 0;
+
+        for (p = smileys[i].pattern; *p; p++) {
+            SmileyNode *current;
+
+            c = (guchar) *p;
+            g_assert (c < SMILEY_ALPHABET);
+
+            current = &g_array_index (nodes, SmileyNode, state);
+            if (current->next[c] == 0) {
+                node.depth = current->depth + 1;
+                current->next[c] = nodes->len;
+                g_array_append_val (nodes, node);
+            }
+
+            state = g_array_index (nodes, SmileyNode, state).next[c];
+        }
+
+        if (g_array_index (nodes, SmileyNode, state).pattern == -1) {
+            g_array_index (nodes, SmileyNode, state).pattern = i;
+        }
+    }
+
+    /* Breadth first to fill in the failure transitions. */
+    fail = g_new0 (guint16, nodes->len);
+    queue = g_new0 (guint16, nodes->len);
+    head = tail = 0;
+
+    for (c = 0; c < SMILEY_ALPHABET; c++) {
+        guint16 child;
+
+        child = g_array_index (nodes, SmileyNode, 0).next[c];
+        if (child) {
+            queue[tail++] = child;
+        }
+    }
+
+    while (head < tail) {
+        SmileyNode *current;
+        guint16     state;
+
+        state = queue[head++];
+        current = &g_array_index (nodes, SmileyNode, state);
+
+        for (c = 0; c < SMILEY_ALPHABET; c++) {
+            SmileyNode *fallback;
+            SmileyNode *child;
+            guint16     child_state;
+
+            fallback = &g_array_index (nodes, SmileyNode, fail[state]);
+            child_state = current->next[c];
+
+            if (child_state == 0) {
+                current->next[c] = fallback->next[c];
+                continue;
+            }
+
+            fail[child_state] = fallback->next[c];
+
+            child = &g_array_index (nodes, SmileyNode, child_state);
+            fallback = &g_array_index (nodes, SmileyNode, fail[child_state]);
+            child->output = fallback->pattern != -1 ? fail[child_state] : fallback->output;
+
+            queue[tail++] = child_state;
+        }
+    }
+
+    g_free (fail);
+    g_free (queue);
+
+    gossip_debug (DEBUG_DOMAIN, "Built smiley automaton with %d nodes for %d patterns",
+                  nodes->len, (gint) G_N_ELEMENTS (smileys));
+
+    return (SmileyNode *) nodes->data;
+}
+
+static gint
+theme_smiley_match (SmileyNode *nodes,
+                    guint16     state,
+                    gsize       word_len)
+{
+    /* Smileys are only replaced when they make up a whole word, so
+     * look for a pattern ending here that is exactly as long.
+     */
+    if (nodes[state].pattern == -1) {
+        state = nodes[state].output;
+    }
+
+    while (state != 0) {
+        if (nodes[state].depth == word_len) {
+            return nodes[state].pattern;
+        }
+
+        if (nodes[state].depth < word_len) {
+            break;
+        }
+
+        state = nodes[state].output;
+    }
+
+    return -1;
+}
+
+static gboolean theme_show_smileys = FALSE;
+
+static void
+theme_notify_show_smileys_cb (GossipConf  *conf,
+                              const gchar *key,
+                              gpointer     user_data)
+{
+    theme_show_smileys = FALSE;
+    gossip_conf_get_bool (conf, key, &theme_show_smileys);
+}
+
+static gboolean
+theme_get_show_smileys (void)
+{
+    static guint notify_id = 0;
+
+    if (!notify_id) {
+        notify_id = gossip_conf_notify_add (gossip_conf_get (),
+                                            GOSSIP_PREFS_CHAT_SHOW_SMILEYS,
+                                            theme_notify_show_smileys_cb,
+                                            NULL);
+
+        theme_notify_show_smileys_cb (gossip_conf_get (),
+                                      GOSSIP_PREFS_CHAT_SHOW_SMILEYS,
+                                      NULL);
+    }
+
+    return theme_show_smileys;
+}
+
+static void
+theme_insert_smiley (GtkTextBuffer *buf,
+                     GtkTextIter   *iter,
+                     const gchar   *str,
+                     const gchar   *word,
+                     gint           match)
+{
+    GdkPixbuf *pixbuf;
+
+    if (word > str) {
+        gtk_text_buffer_insert (buf, iter, str, word - str);
+    }
+
+    pixbuf = gossip_chat_view_get_smiley_image (smileys[match].smiley);
+    gtk_text_buffer_insert_pixbuf (buf, iter, pixbuf);
+
+    gtk_text_buffer_insert (buf, iter, " ", 1);
+}
+
 static void
 theme_insert_text_with_emoticons (GtkTextBuffer *buf,
                                   GtkTextIter   *iter,
                                   const gchar   *str)
 {
+    SmileyNode  *nodes;
     const gchar *p;
-    gunichar     c, prev_c;
-    gint         i;
+    const gchar *word;
+    guint16      state;
     gint         match;
-    gint         submatch;
-    gboolean     use_smileys = FALSE;
-
-    gossip_conf_get_bool (gossip_conf_get (),
-                          GOSSIP_PREFS_CHAT_SHOW_SMILEYS,
-                          &use_smileys);
 
-    if (!use_smileys) {
+    if (!theme_get_show_smileys ()) {
         gtk_text_buffer_insert (buf, iter, str, -1);
         return;
     }
 
-    while (*str) {
-        GdkPixbuf   *pixbuf;
-        const gchar *start;
-        gint         len;
-        gint         smileys_index[G_N_ELEMENTS (smileys)];
+    nodes = theme_smiley_automaton_get ();
 
-        memset (smileys_index, 0, sizeof (smileys_index));
+    /* One pass over the text, str is what is not inserted yet and
+     * word is where the current word started.
+     */
+    state = 0;
+    p = word = str;
 
-        match = -1;
-        submatch = -1;
-        p = str;
-        prev_c = 0;
-
-        while (*p) {
-            c = g_utf8_get_char (p);
-
-            if (match != -1 && g_unichar_isspace (c)) {
-                break;
-            } else {
-                match = -1;
-            }
+    while (*p) {
+        gunichar c;
 
-            if (submatch != -1 || 
-                prev_c == 0 || 
-                g_unichar_isspace (prev_c)) {
-                submatch = -1;
-
-                for (i = 0; i < G_N_ELEMENTS (smileys); i++) {
-                    gboolean is_start;
-                    gboolean is_middle;
-                    gboolean is_match_for_next_char;
-                    gint     s;
-
-                    /* Only try to match if we already have
-                     * a beginning match for the pattern, or
-                     * if it's the first character in the
-                     * pattern, if it's not in the middle of
-                     * a word.
-                     */
-                    s = smileys_index[i];
-
-                    is_start = \
-                        s == 0 && 
-                        (prev_c == 0 || 
-                         g_unichar_isspace (prev_c));
-                    is_middle = \
-                        s > 0;
-                    is_match_for_next_char = \
-                        smileys[i].pattern[s] == c;
-
-                    if ((is_start || is_middle) && 
-                        (is_match_for_next_char)) {
-                        submatch = i;
-                        s = smileys_index[i]++;
-
-                        if (!smileys[i].pattern[smileys_index[i]]) {
-                            match = i;
-                        }
-                    } else {
-                        smileys_index[i] = 0;
-                    }
-                }
-            }
+        c = g_utf8_get_char (p);
 
-            prev_c = c;
+        if (g_unichar_isspace (c)) {
+            match = theme_smiley_match (nodes, state, p - word);
             p = g_utf8_next_char (p);
-        }
-
-        if (match == -1) {
-            gtk_text_buffer_insert (buf, iter, str, -1);
-            return;
-        }
 
-        start = p - strlen (smileys[match].pattern);
+            /* The smiley and the space after it are replaced by
+             * the image and a space.
+             */
+            if (match != -1) {
+                theme_insert_smiley (buf, iter, str, word, match);
+                str = p;
+            }
 
-        if (start > str) {
-            len = start - str;
-            gtk_text_buffer_insert (buf, iter, str, len);
+            state = 0;
+            word = p;
+            continue;
         }
 
-        pixbuf = gossip_chat_view_get_smiley_image (smileys[match].smiley);
-        gtk_text_buffer_insert_pixbuf (buf, iter, pixbuf);
+        state = c < SMILEY_ALPHABET ? nodes[state].next[c] : 0;
+        p = g_utf8_next_char (p);
+    }
 
-        gtk_text_buffer_insert (buf, iter, " ", 1);
+    match = theme_smiley_match (nodes, state, p - word);
+    if (match != -1) {
+        theme_insert_smiley (buf, iter, str, word, match);
+        str = p;
+    }
 
-        str = g_utf8_find_next_char (p, NULL);
+    if (*str) {
+        gtk_text_buffer_insert (buf, iter, str, -1);
     }
 }
 
@@ -422,7 +669,7 @@ gossip_theme_append_text (GossipTheme        *theme,
 
     buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
 
-    gtk_text_buffer_get_end_iter (buffer, &start_iter);
+    gossip_chat_view_get_end_iter (view, &start_iter);
     mark = gtk_text_buffer_create_mark (buffer, NULL, &start_iter, TRUE);
 
     start = g_array_new (FALSE, FALSE, sizeof (gint));
@@ -431,7 +678,7 @@ gossip_theme_append_text (GossipTheme        *theme,
     num_matches = gossip_regex_match (GOSSIP_REGEX_ALL, body, start, end);
 
     if (num_matches == 0) {
-        gtk_text_buffer_get_end_iter (buffer, &iter);
+        gossip_chat_view_get_end_iter (view, &iter);
         theme_insert_text_with_emoticons (buffer, &iter, body);
     } else {
         gint   last = 0;
@@ -445,7 +692,7 @@ gossip_theme_append_text (GossipTheme        *theme,
             if (s > last) {
                 tmp = gossip_substring (body, last, s);
 
-                gtk_text_buffer_get_end_iter (buffer, &iter);
+                gossip_chat_view_get_end_iter (view, &iter);
                 theme_insert_text_with_emoticons (buffer,
                                                   &iter,
                                                   tmp);
@@ -454,7 +701,7 @@ gossip_theme_append_text (GossipTheme        *theme,
 
             tmp = gossip_substring (body, s, e);
 
-            gtk_text_buffer_get_end_iter (buffer, &iter);
+            gossip_chat_view_get_end_iter (view, &iter);
             if (!link_tag) {
                 gtk_text_buffer_insert (buffer, &iter,
                                         tmp, -1);
@@ -476,7 +723,7 @@ gossip_theme_append_text (GossipTheme        *theme,
         if (e < strlen (body)) {
             tmp = gossip_substring (body, e, strlen (body));
 
-            gtk_text_buffer_get_end_iter (buffer, &iter);
+            gossip_chat_view_get_end_iter (view, &iter);
             theme_insert_text_with_emoticons (buffer,
                                               &iter,
                                               tmp);
@@ -487,12 +734,12 @@ gossip_theme_append_text (GossipTheme        *theme,
     g_array_free (start, TRUE);
     g_array_free (end, TRUE);
 
-    gtk_text_buffer_get_end_iter (buffer, &iter);
+    gossip_chat_view_get_end_iter (view, &iter);
     gtk_text_buffer_insert (buffer, &iter, "\n", 1);
 
     /* Apply the style to the inserted text. */
     gtk_text_buffer_get_iter_at_mark (buffer, &start_iter, mark);
-    gtk_text_buffer_get_end_iter (buffer, &end_iter);
+    gossip_chat_view_get_end_iter (view, &end_iter);
 
     gtk_text_buffer_apply_tag_by_name (buffer,
                                        tag,
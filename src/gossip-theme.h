@@ -88,6 +88,13 @@ struct _GossipThemeClass {
 GType        gossip_theme_get_type              (void) G_GNUC_CONST;
 
 GossipTheme *gossip_theme_new                   (void);
+GtkTextTagTable *
+gossip_theme_get_tag_table         (void);
+gboolean     gossip_theme_claim_tags            (GossipTheme        *theme,
+                                                 const gchar        *family);
+gchar *      gossip_theme_get_tag_name          (GossipTheme        *theme,
+                                                 const gchar        *name);
+void         gossip_theme_invalidate_tags       (const gchar        *family);
 
 GossipThemeContext *
 gossip_theme_setup_with_view       (GossipTheme        *theme,